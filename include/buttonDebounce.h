@@ -0,0 +1,50 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include "config.h"
+#include <Arduino.h>
+
+// Per-button contact bounce measurement and adaptive debounce window.
+// Every raw edge is timestamped; a burst of edges ends after BUTTON_BOUNCE_GAP_MS
+// of quiet and its length feeds the debounce window for that switch.
+struct ButtonBounceStats {
+    uint32_t windowUs;        // Current debounce window
+    uint32_t peakBounceUs;    // Slowly decaying peak of recent bursts
+    uint32_t avgBounceUs;     // Running average of burst length
+    uint32_t maxBounceUs;     // Longest burst seen since boot
+    uint32_t lastBounceUs;    // Length of the most recent burst
+    uint16_t lastEdgeCount;   // Edges in the most recent burst
+    uint32_t bursts;          // Number of measured bursts
+    uint32_t glitches;        // Bursts where the window was too short
+
+    // Burst tracking (internal)
+    bool burstOpen;
+    uint8_t acceptedInBurst;
+    uint16_t burstEdges;
+    unsigned long burstStartUs;
+    unsigned long lastEdgeUs;
+};
+
+extern ButtonBounceStats buttonBounce[NUM_BUTTONS];
+
+void initButtonDebounce();
+void recordButtonEdge(int buttonIndex, unsigned long nowUs);
+void recordButtonTransition(int buttonIndex);
+void updateButtonBounce(int buttonIndex, unsigned long nowUs);
+void saveButtonDebounceIfChanged();
+void printButtonDebounceStats();
+
+inline uint32_t getButtonDebounceUs(int buttonIndex) {
+    return buttonBounce[buttonIndex].windowUs;
+}
@@ -0,0 +1,46 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include "config.h"
+#include "globals.h"
+#include <Arduino.h>
+
+// Row/column footswitch matrix scanned from an esp_timer at a fixed rate.
+// Rows are open-drain outputs driven low one at a time, columns are pulled-up
+// inputs. The scanner publishes one bit per key (1 = pressed) which the normal
+// button state machine reads through readButtonLevel().
+
+#if HAS_BUTTON_MATRIX
+struct ButtonMatrixStats {
+    uint32_t scans;          // Completed matrix scans
+    uint32_t ghostScans;     // Scans where a possible ghost key was held back
+    uint32_t maxScanUs;      // Longest scan duration
+};
+
+extern volatile uint32_t buttonMatrixState;
+extern ButtonMatrixStats buttonMatrixStats;
+#endif
+
+void initButtonMatrix();
+void printButtonMatrixStatus();
+
+// Raw level for a button index in the same sense as digitalRead() on a
+// pulled-up switch: LOW = pressed, HIGH = released.
+inline uint8_t readButtonLevel(int buttonIndex) {
+#if HAS_BUTTON_MATRIX
+    return (buttonMatrixState & (1UL << buttonIndex)) ? LOW : HIGH;
+#else
+    return digitalRead(ampButtonPins[buttonIndex]);
+#endif
+}
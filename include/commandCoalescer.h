@@ -0,0 +1,27 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include "config.h"
+#include <Arduino.h>
+
+// Toggle-storm coalescing for remote and MIDI channel commands. The first
+// command after a quiet period switches immediately; commands following it
+// within COMMAND_COALESCE_MS only move the pending target, which the loop
+// applies once the burst goes quiet (or after COMMAND_COALESCE_MAX_MS), so a
+// burst costs at most two relay operations per relay group.
+
+void coalesceAmpChannel(uint8_t channel);
+uint8_t getCoalescedAmpChannel(); // Channel toggles should be computed from
+void pollCommandCoalescer();
+void printCommandCoalescerStatus();
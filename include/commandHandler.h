@@ -17,13 +17,16 @@
 
 void handleCommand(uint8_t commandType, uint8_t value);
 void setAmpChannel(uint8_t channel);
+void setAmpOutputs(uint32_t outputs);
+void setAmpGroupOff(uint8_t group);
 void checkAmpChannelButtons();
 void handleProgramChange(byte midiChannel, byte program);
+void handleControlChange(byte midiChannel, byte number, byte value);
 
 // Helper functions for button processing (broken down from large functions)
 bool handleMidiLearnTimeout();
 void processButtonState(int buttonIndex, uint8_t reading, 
-                       unsigned long* lastDebounceTime, uint8_t* lastButtonState,
+                       unsigned long* lastTransitionUs, uint8_t* lastButtonState,
                        bool* buttonPressed, unsigned long* buttonPressStart,
                        bool* buttonLongPressHandled);
 void handleButtonPress(int buttonIndex, bool* buttonPressed, unsigned long* buttonPressStart,
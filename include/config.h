@@ -25,6 +25,9 @@ enum ClientType {
 #define CLIENT_TYPE AMP_SWITCHER
 #endif
 
+#define CONFIG_STRINGIFY_(x) #x
+#define CONFIG_STRINGIFY(x) CONFIG_STRINGIFY_(x)
+
 // Client Type Configuration
 #if CLIENT_TYPE == AMP_SWITCHER
     #define CLIENT_TYPE_ENUM CLIENT_AMP_SWITCHER
@@ -41,12 +44,188 @@ enum ClientType {
     #ifndef AMP_BUTTON_PINS
     #define AMP_BUTTON_PINS "9,10"
     #endif
+    
+    #ifndef MAX_SCENES
+    #define MAX_SCENES 8 // Relay output combinations recallable by PC/CC/button/ESP-NOW
+    #endif
+
+    #ifndef SCENE_CC
+    #define SCENE_CC 80 // MIDI CC whose value recalls scene N (0 = all off); -1 disables
+    #endif
+
+    // Relay group topology: comma-separated groups in output order, 'E' for an
+    // exclusive group (one output on at a time, e.g. one amp's channels) or
+    // 'I' for independent toggles, followed by the output count. "E2,E2,I1"
+    // is two 2-channel amps plus a boost. Default: one exclusive group.
+    #ifndef RELAY_GROUPS
+    #define RELAY_GROUPS "E" CONFIG_STRINGIFY(MAX_AMPSWITCHS)
+    #endif
+    #define MAX_RELAY_GROUPS 8
 
 #else // CUSTOM
     #define CLIENT_TYPE_ENUM CLIENT_CUSTOM
     #define HAS_AMP_SWITCHING false
 #endif
 
+// Relay switching order for channel changes. Break-before-make clears the old
+// relay first, make-before-break sets the new one first; RELAY_SWITCH_GAP_US is
+// the dead time (or overlap) between the two register writes.
+#define RELAY_BREAK_BEFORE_MAKE 0
+#define RELAY_MAKE_BEFORE_BREAK 1
+#ifndef RELAY_SWITCH_ORDER
+#define RELAY_SWITCH_ORDER RELAY_BREAK_BEFORE_MAKE
+#endif
+#ifndef RELAY_SWITCH_GAP_US
+#define RELAY_SWITCH_GAP_US 0
+#endif
+
+// Relay output backend. GPIO drives one pin per output from AMP_SWITCH_PINS.
+// SHIFT_REG drives chained 74HC595s over SPI (data/clock/latch), updating up
+// to 32 outputs with one transfer and one latch pulse; output N is Q(N%8) of
+// chip N/8, chip 0 nearest the MCU.
+#define RELAY_BACKEND_GPIO 0
+#define RELAY_BACKEND_SHIFT_REG 1
+#ifndef RELAY_OUTPUT_BACKEND
+#define RELAY_OUTPUT_BACKEND RELAY_BACKEND_GPIO
+#endif
+#if RELAY_OUTPUT_BACKEND == RELAY_BACKEND_SHIFT_REG
+    #if !defined(SHIFT_REG_DATA_PIN) || !defined(SHIFT_REG_CLOCK_PIN) || !defined(SHIFT_REG_LATCH_PIN)
+    #error "RELAY_BACKEND_SHIFT_REG needs SHIFT_REG_DATA_PIN, SHIFT_REG_CLOCK_PIN and SHIFT_REG_LATCH_PIN"
+    #endif
+    #ifndef SHIFT_REG_SPI_HZ
+    #define SHIFT_REG_SPI_HZ 8000000 // 74HC595 is good for >20MHz at 3.3V
+    #endif
+    #ifndef SHIFT_REG_LATCH_HOLD_NS
+    #define SHIFT_REG_LATCH_HOLD_NS 100 // RCLK high time; 74HC595 tW is 80ns at 2V, 16ns at 4.5V
+    #endif
+    // SHIFT_REG_OE_PIN (optional) holds the outputs disabled until the first latch
+#endif
+
+// Relay output drive mode. LEVEL holds each relay pin at a steady level.
+// LATCHING pulses a set coil (AMP_SWITCH_PINS) or reset coil (AMP_RESET_PINS)
+// per output. MOMENTARY pulses one pin per output on every state change, for
+// amps with momentary/opto footswitch inputs that toggle internally.
+#define RELAY_DRIVE_LEVEL 0
+#define RELAY_DRIVE_LATCHING 1
+#define RELAY_DRIVE_MOMENTARY 2
+#ifndef RELAY_DRIVE_MODE
+#define RELAY_DRIVE_MODE RELAY_DRIVE_LEVEL
+#endif
+#if RELAY_DRIVE_MODE == RELAY_DRIVE_LATCHING && RELAY_OUTPUT_BACKEND == RELAY_BACKEND_GPIO && !defined(AMP_RESET_PINS)
+#error "RELAY_DRIVE_LATCHING needs AMP_RESET_PINS (one reset coil per output)"
+#endif
+#if RELAY_OUTPUT_BACKEND == RELAY_BACKEND_SHIFT_REG
+    // Latching reset coils follow the set coils: outputs 0..N-1 set, N..2N-1 reset
+    #if RELAY_DRIVE_MODE == RELAY_DRIVE_LATCHING
+    #define SHIFT_REG_OUTPUTS (MAX_AMPSWITCHS * 2)
+    #else
+    #define SHIFT_REG_OUTPUTS MAX_AMPSWITCHS
+    #endif
+    #if SHIFT_REG_OUTPUTS > 32
+    #error "Shift register backend supports at most 32 outputs"
+    #endif
+    #define SHIFT_REG_CHIPS ((SHIFT_REG_OUTPUTS + 7) / 8)
+#endif
+#ifndef RELAY_PULSE_US
+#define RELAY_PULSE_US 10000 // Coil / input pulse width
+#endif
+#ifndef RELAY_PULSE_GAP_US
+#define RELAY_PULSE_GAP_US 2000 // Minimum idle time between consecutive pulses
+#endif
+
+// Relay readback verification. RELAY_VERIFY reads the relay pads back from
+// GPIO_IN_REG once per switch (direct GPIO, level drive). RELAY_SENSE_PINS
+// optionally lists one coil/contact sense input per output, checked
+// RELAY_SENSE_SETTLE_MS after a switch; it works with every backend.
+#ifndef RELAY_VERIFY
+#define RELAY_VERIFY 0
+#endif
+#ifdef RELAY_SENSE_PINS
+    #define HAS_RELAY_SENSE 1
+    #ifndef RELAY_SENSE_ACTIVE_LEVEL
+    #define RELAY_SENSE_ACTIVE_LEVEL HIGH // Sense level while the output is on
+    #endif
+    #ifndef RELAY_SENSE_SETTLE_MS
+    #define RELAY_SENSE_SETTLE_MS 20 // Relay operate time before the sense input is trusted
+    #endif
+#else
+    #define HAS_RELAY_SENSE 0
+#endif
+
+// Optional mute output (audio mute relay / optocoupler) asserted around every
+// relay change to suppress switching pops
+#ifdef SWITCH_MUTE_PIN
+    #define HAS_SWITCH_MUTE 1
+    #ifndef SWITCH_MUTE_ACTIVE_LEVEL
+    #define SWITCH_MUTE_ACTIVE_LEVEL HIGH
+    #endif
+    #ifndef SWITCH_MUTE_SETTLE_US
+    #define SWITCH_MUTE_SETTLE_US 3000 // Mute engaged -> relay change
+    #endif
+    #ifndef SWITCH_MUTE_RELEASE_US
+    #define SWITCH_MUTE_RELEASE_US 5000 // Relay change -> unmute (contact settle)
+    #endif
+#else
+    #define HAS_SWITCH_MUTE 0
+#endif
+
+// Optional footswitch matrix. Set BUTTON_MATRIX_ROW_PINS / BUTTON_MATRIX_COL_PINS
+// (comma-separated, like AMP_BUTTON_PINS) plus their counts to replace the
+// one-GPIO-per-button inputs. Buttons are numbered row-major.
+#if defined(BUTTON_MATRIX_ROW_PINS) && defined(BUTTON_MATRIX_COL_PINS)
+    #define HAS_BUTTON_MATRIX 1
+    #if !defined(BUTTON_MATRIX_ROWS) || !defined(BUTTON_MATRIX_COLS)
+    #error "BUTTON_MATRIX_ROWS and BUTTON_MATRIX_COLS must be set with the matrix pin lists"
+    #endif
+    #define NUM_BUTTONS (BUTTON_MATRIX_ROWS * BUTTON_MATRIX_COLS)
+    #if NUM_BUTTONS > 32
+    #error "Button matrix supports at most 32 keys"
+    #endif
+    #ifndef BUTTON_MATRIX_SCAN_US
+    #define BUTTON_MATRIX_SCAN_US 1000 // Full matrix scan period (1kHz)
+    #endif
+    #ifndef BUTTON_MATRIX_SETTLE_US
+    #define BUTTON_MATRIX_SETTLE_US 3 // Row drive to column sample delay
+    #endif
+    #ifndef BUTTON_MATRIX_DIODES
+    #define BUTTON_MATRIX_DIODES 1 // 0 = no per-key diodes, suppress ghost keys
+    #endif
+#else
+    #define HAS_BUTTON_MATRIX 0
+    #define NUM_BUTTONS MAX_AMPSWITCHS
+#endif
+
+// Optional expression pedal on an ADC pin, sent as MIDI CC and over ESP-NOW
+#ifdef EXPRESSION_PEDAL_PIN
+    #define HAS_EXPRESSION_PEDAL 1
+    #ifndef EXPRESSION_CC
+    #define EXPRESSION_CC 11 // MIDI CC number (11 = Expression)
+    #endif
+    #ifndef EXPRESSION_SAMPLE_US
+    #define EXPRESSION_SAMPLE_US 1000 // One ADC conversion per timer tick
+    #endif
+    #ifndef EXPRESSION_OVERSAMPLE
+    #define EXPRESSION_OVERSAMPLE 8 // Conversions averaged per filter update
+    #endif
+    #ifndef EXPRESSION_IIR_SHIFT
+    #define EXPRESSION_IIR_SHIFT 2 // IIR smoothing, alpha = 1/2^shift
+    #endif
+    #ifndef EXPRESSION_HYSTERESIS
+    #define EXPRESSION_HYSTERESIS 4 // Extra 1/16 steps needed to leave the current value
+    #endif
+    #ifndef EXPRESSION_MIN_INTERVAL_MS
+    #define EXPRESSION_MIN_INTERVAL_MS 10 // Rate limit for CC / ESP-NOW updates
+    #endif
+    #ifndef EXPRESSION_CAL_MIN_DEFAULT
+    #define EXPRESSION_CAL_MIN_DEFAULT 100
+    #endif
+    #ifndef EXPRESSION_CAL_MAX_DEFAULT
+    #define EXPRESSION_CAL_MAX_DEFAULT 3995
+    #endif
+#else
+    #define HAS_EXPRESSION_PEDAL 0
+#endif
+
 // Device name configuration
 #ifndef DEVICE_NAME
 #define DEVICE_NAME "ESP32_CLIENT"
@@ -72,6 +251,46 @@ enum ClientType {
 #ifndef LEDC_BASE_FREQ
 #define LEDC_BASE_FREQ 1000
 #endif
+#ifndef LED_HW_FADE
+#define LED_HW_FADE 1 // Pairing fade runs in the LEDC hardware fader (0 = stepped from the loop)
+#endif
+#ifndef LED_FADE_RAMP_MS
+#define LED_FADE_RAMP_MS 1000 // Pairing fade: one ramp up or down
+#endif
+#ifndef LED_FADE_STEP_MS
+#define LED_FADE_STEP_MS 40 // Loop-stepped fade resolution when LED_HW_FADE is 0
+#endif
+// Status LED backend. LEDC drives a single LED on PAIRING_LED_PIN with PWM.
+// WS2812 drives one addressable RGB LED on RGB_LED_PIN from the RMT
+// peripheral: the same patterns, coloured by mode, amp channel and link.
+#define STATUS_LED_LEDC 0
+#define STATUS_LED_WS2812 1
+#ifndef STATUS_LED_BACKEND
+#define STATUS_LED_BACKEND STATUS_LED_LEDC
+#endif
+#if STATUS_LED_BACKEND == STATUS_LED_WS2812
+    #ifndef RGB_LED_PIN
+    #define RGB_LED_PIN PAIRING_LED_PIN // GPIO8 is the on-board WS2812 on C3 dev kits
+    #endif
+    #ifndef RGB_LED_BRIGHTNESS
+    #define RGB_LED_BRIGHTNESS 64 // Full-scale brightness, 0-255
+    #endif
+    #ifndef RGB_LED_IDLE_PERCENT
+    #define RGB_LED_IDLE_PERCENT 15 // Channel colour glow between flashes
+    #endif
+    #ifndef RGB_LED_RMT_CHANNEL
+    #define RGB_LED_RMT_CHANNEL 0
+    #endif
+    #ifndef ESPNOW_LINK_LOST_FAILS
+    #define ESPNOW_LINK_LOST_FAILS 3 // Consecutive failed sends shown as link lost
+    #endif
+#endif
+#ifndef LED_QUEUE_DEPTH
+#define LED_QUEUE_DEPTH 4 // Pending one-shot LED sequences (flashes, confirmations)
+#endif
+#ifndef LED_QUEUE_STALE_MS
+#define LED_QUEUE_STALE_MS 2000 // A queued sequence not started within this is dropped
+#endif
 #ifndef PAIRING_LED_BLINK
 #define PAIRING_LED_BLINK 100
 #endif
@@ -88,14 +307,137 @@ enum ClientType {
 #define NVS_NAMESPACE "pairing"
 #endif
 #ifndef BUTTON_DEBOUNCE_MS
-#define BUTTON_DEBOUNCE_MS 100 // Button debounce duration in ms
+#define BUTTON_DEBOUNCE_MS 20 // Initial debounce window in ms, used until a switch has been measured
+#endif
+#ifndef BUTTON_DEBOUNCE_MIN_MS
+#define BUTTON_DEBOUNCE_MIN_MS 10 // Lower bound of the adaptive debounce window, at least BUTTON_BOUNCE_GAP_MS
+#endif
+#ifndef BUTTON_DEBOUNCE_MAX_MS
+#define BUTTON_DEBOUNCE_MAX_MS 50 // Upper bound of the adaptive debounce window
+#endif
+#ifndef BUTTON_BOUNCE_GAP_MS
+#define BUTTON_BOUNCE_GAP_MS 10 // Quiet time that ends a bounce measurement burst
+#endif
+// A window shorter than the burst gap could accept an edge of a bounce the
+// measurement still counts as one burst
+#if BUTTON_DEBOUNCE_MIN_MS < BUTTON_BOUNCE_GAP_MS
+#error "BUTTON_DEBOUNCE_MIN_MS must be at least BUTTON_BOUNCE_GAP_MS"
+#endif
+#ifndef BUTTON_BOUNCE_MARGIN_US
+#define BUTTON_BOUNCE_MARGIN_US 1000 // Safety margin added to the measured bounce
+#endif
+#ifndef BUTTON_DEBOUNCE_SAVE_INTERVAL_MS
+#define BUTTON_DEBOUNCE_SAVE_INTERVAL_MS 60000 // Minimum time between debounce NVS writes
+#endif
+#ifndef RELAY_STATS_SAVE_INTERVAL_MS
+#define RELAY_STATS_SAVE_INTERVAL_MS 900000 // Relay wear journal write period (15 min, only when changed)
+#endif
+#ifndef COMMAND_COALESCE_MS
+#define COMMAND_COALESCE_MS 150 // Remote/MIDI commands this close together collapse into their net state (0 = off)
+#endif
+#ifndef COMMAND_COALESCE_MAX_MS
+#define COMMAND_COALESCE_MAX_MS 500 // Upper bound on how long a continuous burst can defer the net state
 #endif
 #ifndef BUTTON_LONGPRESS_MS
 #define BUTTON_LONGPRESS_MS 5000 // Button long-press duration in ms
 #endif
 
+// Compile-time log floor. Calls above LOG_LEVEL compile to nothing; levels
+// at or below it are filtered at runtime by the setlog level. Numeric, so it
+// can be used in #if (the LogLevel enum cannot).
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+#ifndef LOG_LEVEL
+    #ifdef FAST_SWITCHING
+    #define LOG_LEVEL LOG_LEVEL_INFO // Debug logging off the switching path
+    #else
+    #define LOG_LEVEL LOG_LEVEL_DEBUG
+    #endif
+#endif
+
+// Asynchronous logging. log()/logf() capture the level, timestamp, format
+// pointer and raw arguments into a ring of fixed-size records; a background
+// task formats them and writes the serial port. LOG_ASYNC 0 formats and
+// writes inline as before.
+#ifndef LOG_ASYNC
+#define LOG_ASYNC 1
+#endif
+#ifndef LOG_RING_SLOTS
+#define LOG_RING_SLOTS 48 // Records in flight
+#endif
+#ifndef LOG_RECORD_BYTES
+#define LOG_RECORD_BYTES 112 // Captured arguments / message text per record
+#endif
+#ifndef LOG_TOKENIZED
+#define LOG_TOKENIZED 0 // Boot in tokenised output mode (binary frames, see tools/logdecode.py)
+#endif
+#define LOG_TOKEN_MARKER 0xA5 // First byte of a tokenised log frame
+#ifndef LOG_TOKEN_SYNC_FRAMES
+#define LOG_TOKEN_SYNC_FRAMES 32 // Tokenised frames sent with a time delta between full timestamps
+#endif
+#ifndef LOG_DRAIN_INTERVAL_MS
+#define LOG_DRAIN_INTERVAL_MS 5 // Log task poll period while the ring is empty
+#endif
+#ifndef LOG_TASK_PRIORITY
+#define LOG_TASK_PRIORITY 1 // Same as the Arduino loop task, which never blocks
+#endif
+#ifndef LOG_TASK_STACK
+#define LOG_TASK_STACK 3072
+#endif
+
+// Serial console line input
+#ifndef SERIAL_LINE_MAX
+#define SERIAL_LINE_MAX 64 // Longest command line; longer lines are dropped whole
+#endif
+#ifndef SERIAL_BYTES_PER_POLL
+#define SERIAL_BYTES_PER_POLL 32 // Bytes taken from the UART per checkSerialCommands() call
+#endif
+
+// Telemetry frames (telemetry command, tools/telemetry.py)
+#ifndef TELEMETRY_STREAM_MS
+#define TELEMETRY_STREAM_MS 0 // Stream status frames from boot at this period; 0 = off until asked
+#endif
+#ifndef TELEMETRY_MIN_PERIOD_MS
+#define TELEMETRY_MIN_PERIOD_MS 20 // Fastest stream rate, keeps the console usable at 115200 baud
+#endif
+#define TELEMETRY_FRAME_MARKER 0xA6 // First byte of a telemetry frame
+
+// Per-call-site log rate limiting (LOG_LIMITED / LOGF_LIMITED): a burst of
+// LOG_RATE_BURST lines, then one per LOG_RATE_INTERVAL_MS
+#ifndef LOG_RATE_BURST
+#define LOG_RATE_BURST 5
+#endif
+#ifndef LOG_RATE_INTERVAL_MS
+#define LOG_RATE_INTERVAL_MS 1000
+#endif
+#ifndef LOG_RATE_SITES
+#define LOG_RATE_SITES 16 // Limited call sites tracked for summaries and debugperf
+#endif
+
+// Postmortem event log in RTC memory, kept through software, panic and
+// watchdog resets (not power cycles). 12 bytes per event.
+#ifndef EVENT_LOG_SLOTS
+#define EVENT_LOG_SLOTS 64
+#endif
+
+// Metrics registry (metrics.h): counters, gauges and histograms registered
+// by the subsystems, exported by debugmetrics, metrics and STATUS_REQUEST
+#ifndef METRICS_MAX
+#define METRICS_MAX 32
+#endif
+#define METRICS_PREFIX "ampswitch_" // Prometheus metric name prefix
+
+// STATUS_REQUEST replies (status, group, relay wear and metric frames) are
+// sent from the loop with at most this many frames awaiting OnDataSent
+#ifndef STATUS_REPLY_IN_FLIGHT
+#define STATUS_REPLY_IN_FLIGHT 4
+#endif
+#define STATUS_REPLY_STALL_MS 100 // No send callback for this long: stop waiting for it
+
 // Function declarations
-uint8_t* parsePinArray(const char* pinString);
 String getClientTypeString();
 void printClientConfiguration();
 void initializeClientConfiguration(); 
\ No newline at end of file
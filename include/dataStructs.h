@@ -16,12 +16,16 @@
 
 #define MAX_PEER_NAME_LEN 32
 
-enum MessageType { PAIRING, DATA, COMMAND };
+enum MessageType { PAIRING, DATA, COMMAND, RELAY_STATS, GROUP_STATUS, METRIC };
 enum CommandType { 
     PROGRAM_CHANGE = 0,     // MIDI program change - Type 0
     RESERVED1 = 1,           // (formerly CHANNEL_CHANGE) reserved to keep enum values stable
     ALL_CHANNELS_OFF = 2,    // Turn all channels off - Type 2
-    STATUS_REQUEST = 3       // Request current status - Type 3
+    STATUS_REQUEST = 3,      // Request current status - Type 3
+    EXPRESSION = 4,          // Expression pedal value 0-127 in commandValue - Type 4
+    SCENE_SELECT = 5,        // Recall relay scene commandValue (0 = all off) - Type 5
+    RELAY_FAULT = 6,         // Client -> server: output commandValue (1-based) failed verification - Type 6
+    GROUP_OFF = 7            // Turn relay group commandValue (1-based, 0 = all) off - Type 7
 };
 
 typedef struct struct_message {
@@ -34,6 +38,50 @@ typedef struct struct_message {
     uint32_t timestamp;        // Timestamp for message ordering
 } struct_message;
 
+// Client -> server, one per relay output in reply to STATUS_REQUEST
+typedef struct struct_relay_stats {
+    uint8_t msgType;           // RELAY_STATS
+    uint8_t id;                // BOARD_ID
+    uint8_t output;            // Relay output, 1-based
+    uint8_t outputCount;       // MAX_AMPSWITCHS
+    uint32_t actuations;       // Times the output was energised
+    uint32_t onSeconds;        // Cumulative energised time
+    uint32_t timestamp;
+} struct_relay_stats;
+
+// Client -> server, one per relay group in reply to STATUS_REQUEST
+typedef struct struct_group_status {
+    uint8_t msgType;           // GROUP_STATUS
+    uint8_t id;                // BOARD_ID
+    uint8_t group;             // Relay group, 1-based
+    uint8_t groupCount;
+    uint8_t exclusive;         // 1 = one output at a time, 0 = independent toggles
+    uint8_t firstOutput;       // First output of the group, 1-based
+    uint8_t outputCount;
+    uint8_t activeOutput;      // Exclusive groups: active output (1-based, 0 = none)
+    uint32_t outputs;          // Active outputs of the group, bit N = output N+1
+    uint32_t timestamp;
+} struct_group_status;
+
+#define METRIC_NAME_LEN 32
+#define METRIC_FRAME_BUCKETS 16
+
+// Client -> server, one per registered metric in reply to STATUS_REQUEST
+typedef struct struct_metric {
+    uint8_t msgType;           // METRIC
+    uint8_t id;                // BOARD_ID
+    uint8_t index;             // Metric, 0-based
+    uint8_t count;             // Registered metrics
+    uint8_t kind;              // 0 = counter, 1 = gauge, 2 = histogram
+    char name[METRIC_NAME_LEN];  // Without the Prometheus prefix, NUL terminated
+    uint32_t value;            // Counter / gauge value, histogram sample count
+    uint32_t min;              // Histograms only, 0 otherwise
+    uint32_t max;
+    uint64_t sum;
+    uint32_t buckets[METRIC_FRAME_BUCKETS]; // Log2 buckets: zeros, then [2^(k-1), 2^k)
+    uint32_t timestamp;
+} struct_metric;
+
 typedef struct struct_pairing {
     uint8_t msgType;
     uint8_t id;
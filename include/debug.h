@@ -14,6 +14,7 @@
 #pragma once
 #include "config.h"
 #include "globals.h"
+#include "metrics.h"
 #include <Arduino.h>
 
 // Debug and monitoring functions
@@ -27,21 +28,14 @@ void printESPNowStats();
 void updateMemoryStats();
 void printMemoryLeakInfo();
 
-// Performance monitoring
-struct PerformanceMetrics {
-    unsigned long loopCount;
-    unsigned long lastLoopTime;
-    unsigned long maxLoopTime;
-    unsigned long minLoopTime;
-    unsigned long totalLoopTime;
-    unsigned long startTime;
-};
-
-extern PerformanceMetrics perfMetrics;
+// Main loop timing (standard loop only; FAST_SWITCHING does not time it)
+extern MetricHistogram loopTimeUs;
+extern MetricGauge lastLoopTimeUs;
 
 // Debug commands
-void handleDebugCommand(const char* cmd);
+void handleDebugCommand(const char* cmd);  // "" = full debug info
+void printDebugCommandList(const char* prefix);
 void printDebugHelp();
 
 // Performance monitoring functions
-void updatePerformanceMetrics(unsigned long loopTime); 
\ No newline at end of file
+void updatePerformanceMetrics(uint32_t elapsedUs); 
\ No newline at end of file
@@ -18,6 +18,22 @@
 
 void setupEspNow();
 void sendData();
+void sendExpressionData(uint8_t value);
+void sendRelayFault(uint8_t output);
+void requestStatusReply();
+void pollStatusReply();
+uint8_t getEspNowFailStreak();
+
+// Send/receive counters since boot
+struct EspNowStats {
+    uint32_t sent;           // Acknowledged by the peer
+    uint32_t sendFailed;
+    uint32_t received;
+    uint32_t ignored;        // Dropped while not paired
+    uint32_t unknownType;
+};
+
+EspNowStats getEspNowStats();
 void OnDataSent(const uint8_t *mac_addr, esp_now_send_status_t status);
 void OnDataRecv(const uint8_t * mac_addr, const uint8_t *incomingData, int len) ;
 void initESP_NOW();
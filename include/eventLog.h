@@ -0,0 +1,51 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include "config.h"
+#include <Arduino.h>
+
+// Postmortem event log: a small ring of fixed 12-byte events (switches,
+// pairing changes, warnings and errors, restarts, one boot event with the
+// reset reason) in RTC memory. The ring is RTC_NOINIT, so it survives
+// software, panic and watchdog resets; a power-on reset clears it. Recording
+// is one short critical section and a 12-byte store, from any task.
+// Messages are kept as pointers to their format strings in flash and are
+// only printed back when the events were recorded by the running build.
+
+enum EventType : uint8_t {
+    EVENT_BOOT,      // arg: reset reason | boot number << 8, data: build id
+    EVENT_SWITCH,    // arg: channel, data: output bitmask
+    EVENT_PAIRING,   // arg: new PairingStatus, data: previous status
+    EVENT_LOG,       // arg: LogLevel, data: message / format pointer
+    EVENT_RESTART,   // data: reason string
+    EVENT_OTA        // arg: 1 = update written, 0 = failed
+};
+
+struct EventRecord {
+    uint32_t ms;     // millis() at the event
+    uint32_t data;
+    uint16_t arg;
+    uint8_t type;
+    uint8_t check;   // Rejects torn or decayed entries after a reset
+};
+
+void initEventLog();
+void updateEventLog();           // Loop: pairing status changes
+void recordEvent(EventType type, uint16_t arg, uint32_t data);
+void printPostmortem();
+const char* getResetReasonString();
+
+inline void recordEvent(EventType type, const char* text) {
+    recordEvent(type, 0, (uint32_t)(uintptr_t)text);
+}
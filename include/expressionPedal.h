@@ -0,0 +1,26 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include "config.h"
+#include <Arduino.h>
+
+// Expression pedal input. The ADC is sampled from an esp_timer (not from loop()),
+// oversampled and IIR-filtered there; loop() only polls for a new quantised
+// 0-127 value, which is rate limited and reported only when it changes.
+
+void initExpressionPedal();
+bool pollExpressionPedal(uint8_t* value);
+void calibrateExpressionMin();
+void calibrateExpressionMax();
+void printExpressionPedalStatus();
@@ -28,8 +28,10 @@ extern bool serialOtaTrigger;
 #define BOARD_ID 1
 
 extern uint8_t currentAmpChannel;
-extern uint8_t ampSwitchPins[MAX_AMPSWITCHS];
-extern uint8_t ampButtonPins[MAX_AMPSWITCHS];
+#define AMP_CHANNEL_SCENE 0xFF // currentAmpChannel value while more than one output is active
+extern uint32_t ampOutputs;    // Active relay outputs, bit N = output N+1
+// ampSwitchPins / ampButtonPins are constexpr, parsed from the build flags
+#include "pinConfig.h"
 
 // PairingStatus now in pairing.h
 
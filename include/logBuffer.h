@@ -0,0 +1,48 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include "config.h"
+#include "globals.h"
+#include <Arduino.h>
+#include <stdarg.h>
+
+// Deferred log output. Callers reserve a record (one short critical section:
+// the C3 has no atomic read-modify-write instructions), copy the timestamp,
+// level, format pointer and packed arguments into it and publish it with a
+// release store. The log task formats and writes published records in
+// order. Arguments are packed by walking the format once; %s strings are
+// copied, since they often live on the caller's stack. A record that cannot
+// be packed (too large, '*' widths) is formatted into the record instead.
+//
+// Tokenised mode (LOG_TOKENIZED, or the logmode command) writes each record
+// as a binary frame instead of a text line: a 24-bit hash of the level and
+// format string, the time since the previous frame and the arguments as
+// varints. Literal log() messages are tokenised too; text copied from RAM is
+// sent as-is.
+// tools/logtokens.py builds the token table from the sources and
+// tools/logdecode.py turns a capture back into text lines; anything outside
+// a frame (help, direct prints) passes through unchanged.
+//
+// When the ring is full the record is dropped and counted (log_dropped_total),
+// from every task: the loop may be switching relays and must not wait on the
+// serial port.
+
+void initLogBuffer();
+void logCapture(LogLevel level, const char* format, va_list args);
+void logCaptureText(LogLevel level, const char* text);
+void flushLogs();
+void setLogTokenized(bool tokenized);
+bool isLogTokenized();
+void printLogBufferStats();
+void runLogBenchmark();
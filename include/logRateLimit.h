@@ -0,0 +1,54 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include "config.h"
+#include "utils.h"
+#include <Arduino.h>
+
+// Per-call-site log rate limiting. LOG_LIMITED / LOGF_LIMITED give each call
+// site its own token bucket: LOG_RATE_BURST messages pass at once, then one
+// per LOG_RATE_INTERVAL_MS. Suppressed calls cost a short critical section
+// and a counter; the count is reported as one "repeated N more times" line
+// when the site next logs, or from the loop once the storm is over. Use it
+// where a peer or the radio decides how often a line is logged.
+
+struct LogRateLimit {
+    const char* format;
+    uint32_t lastRefill;
+    uint32_t suppressed;       // Since the last summary
+    uint32_t totalSuppressed;
+    LogLevel level;
+    uint8_t tokens;
+    bool registered;           // In the loop's flush list
+
+    constexpr LogRateLimit(LogLevel lvl, const char* fmt)
+        : format(fmt), lastRefill(0), suppressed(0), totalSuppressed(0), level(lvl),
+          tokens(LOG_RATE_BURST), registered(false) {}
+};
+
+bool logRateAllow(LogRateLimit& limit);
+void flushLogRateLimits();       // Loop: summaries for sites that went quiet
+void printLogRateStats();
+
+// The bucket is a function-local static, one per expansion; calls above the
+// compile-time floor fold away as with log()/logf()
+#define LOG_LIMITED(level, msg) do { \
+        static LogRateLimit logRateLimit_(level, msg); \
+        if ((level) <= LOG_LEVEL && logRateAllow(logRateLimit_)) log(level, msg); \
+    } while (0)
+
+#define LOGF_LIMITED(level, format, ...) do { \
+        static LogRateLimit logRateLimit_(level, format); \
+        if ((level) <= LOG_LEVEL && logRateAllow(logRateLimit_)) logf(level, format, __VA_ARGS__); \
+    } while (0)
@@ -0,0 +1,96 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include "config.h"
+#include "dataStructs.h"
+#include <Arduino.h>
+
+// Metrics registry: counters, gauges and log2-bucket histograms, defined as
+// statics by the subsystem that owns them and registered by their
+// constructors into a fixed table of METRICS_MAX entries. Nothing allocates.
+// Exporters walk the table: printMetrics() for the console (debugmetrics),
+// printMetricsPrometheus() for the metrics command and the status reply in
+// espnow.cpp for the server.
+//
+// Updates are plain loads and stores, lock-free and exact as long as one
+// task writes the metric, which is how most are used. Counters bumped from
+// several tasks use incShared(), one short critical section (the C3 has no
+// atomic read-modify-write instructions). Readers in other tasks see each
+// 32-bit field whole, but a histogram's fields may come from different
+// samples.
+//
+// Names are Prometheus style (lower_snake_case, counters end in _total) and
+// at most METRIC_NAME_LEN - 1 characters, the ESP-NOW frame's limit.
+
+#define METRIC_HISTOGRAM_BUCKETS METRIC_FRAME_BUCKETS // Sent whole in the ESP-NOW metric frame
+
+enum MetricKind : uint8_t {
+    METRIC_COUNTER,
+    METRIC_GAUGE,
+    METRIC_HISTOGRAM
+};
+
+struct Metric {
+    const char* name;
+    const char* help;
+    volatile uint32_t value;   // Counter / gauge value, histogram sample count
+    MetricKind kind;
+
+    Metric(const char* name, const char* help, MetricKind kind, uint32_t initial);
+};
+
+struct MetricCounter : Metric {
+    MetricCounter(const char* name, const char* help) : Metric(name, help, METRIC_COUNTER, 0) {}
+
+    void inc() { value = value + 1; }
+    void add(uint32_t n) { value = value + n; }
+    void incShared();
+};
+
+struct MetricGauge : Metric {
+    MetricGauge(const char* name, const char* help, uint32_t initial = 0)
+        : Metric(name, help, METRIC_GAUGE, initial) {}
+
+    void set(uint32_t v) { value = v; }
+    void setMin(uint32_t v) { if (v < value) value = v; }
+};
+
+// Bucket 0 counts zeros, bucket k samples in [2^(k-1), 2^k), the last
+// bucket everything from 2^(METRIC_HISTOGRAM_BUCKETS-2) up
+struct MetricHistogram : Metric {
+    uint64_t sum;
+    uint32_t min;
+    uint32_t max;
+    uint32_t buckets[METRIC_HISTOGRAM_BUCKETS];
+
+    MetricHistogram(const char* name, const char* help)
+        : Metric(name, help, METRIC_HISTOGRAM, 0), sum(0), min(UINT32_MAX), max(0), buckets() {}
+
+    void record(uint32_t sample) {
+        uint32_t bucket = sample ? 32 - __builtin_clz(sample) : 0;
+        if (bucket >= METRIC_HISTOGRAM_BUCKETS) bucket = METRIC_HISTOGRAM_BUCKETS - 1;
+        buckets[bucket]++;
+        sum += sample;
+        if (sample < min) min = sample;
+        if (sample > max) max = sample;
+        value = value + 1;
+    }
+};
+
+uint8_t getMetricCount();
+const Metric* getMetric(uint8_t index);
+uint32_t getMetricBucketBound(uint8_t bucket);   // Largest sample in the bucket
+
+void printMetrics();             // Console, human readable
+void printMetricsPrometheus();   // Prometheus text exposition format
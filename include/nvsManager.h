@@ -29,6 +29,24 @@ void saveLogLevelToNVS(LogLevel level);
 LogLevel loadLogLevelFromNVS();
 void clearLogLevelNVS();
 
+// Button debounce window management
+void saveButtonDebounceToNVS(const uint32_t* windowsUs);
+bool loadButtonDebounceFromNVS(uint32_t* windowsUs);
+
+// Expression pedal calibration
+void saveExpressionCalibrationToNVS(uint16_t calMin, uint16_t calMax);
+bool loadExpressionCalibrationFromNVS(uint16_t* calMin, uint16_t* calMax);
+
+// Relay scene management
+struct AmpScene;
+void saveScenesToNVS(const AmpScene* scenes);
+bool loadScenesFromNVS(AmpScene* scenes);
+
+// Relay wear journal
+struct RelayStatsRecord;
+void saveRelayStatsToNVS(const RelayStatsRecord* record);
+bool loadRelayStatsFromNVS(RelayStatsRecord* record);
+
 // ESP-NOW pairing management
 void saveServerToNVS(const uint8_t* mac, uint8_t channel);
 bool loadServerFromNVS(uint8_t* mac, uint8_t* channel);
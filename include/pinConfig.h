@@ -0,0 +1,221 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include "config.h"
+#include <stdint.h>
+
+// Compile-time parsing of the comma-separated pin list build flags
+// (AMP_SWITCH_PINS, AMP_BUTTON_PINS, ...). The lists become constexpr arrays
+// and GPIO masks, and malformed lists fail the build instead of booting with
+// whatever a runtime parser made of them. Written as single-return constexpr
+// functions so it also builds as C++11.
+
+#define PIN_INVALID 0xFF
+
+namespace pinparse {
+
+constexpr bool isDigit(char c) { return c >= '0' && c <= '9'; }
+constexpr bool isSpace(char c) { return c == ' ' || c == '\t'; }
+
+constexpr const char* skipSpaces(const char* s) {
+    return isSpace(*s) ? skipSpaces(s + 1) : s;
+}
+
+constexpr unsigned countCommas(const char* s) {
+    return *s == '\0' ? 0 : (*s == ',' ? 1 : 0) + countCommas(s + 1);
+}
+
+constexpr unsigned countEntries(const char* s) {
+    return *s == '\0' ? 0 : 1 + countCommas(s);
+}
+
+// Start of entry 'index'
+constexpr const char* seekEntry(const char* s, unsigned index) {
+    return (index == 0 || *s == '\0') ? s : seekEntry(s + 1, *s == ',' ? index - 1 : index);
+}
+
+constexpr unsigned parseDigits(const char* s, unsigned acc) {
+    return acc > 255 ? PIN_INVALID
+         : isDigit(*s) ? parseDigits(s + 1, acc * 10 + (*s - '0'))
+         : (*s == '\0' || *s == ',' || isSpace(*s)) ? acc
+         : PIN_INVALID;
+}
+
+constexpr unsigned parseEntry(const char* s) {
+    return isDigit(*skipSpaces(s)) ? parseDigits(skipSpaces(s), 0) : PIN_INVALID;
+}
+
+// Pin number of entry 'index', PIN_INVALID when missing or malformed
+constexpr uint8_t pinAt(const char* s, unsigned index) {
+    return index < countEntries(s) ? (uint8_t)parseEntry(seekEntry(s, index)) : PIN_INVALID;
+}
+
+// ESP32-C3: GPIO0-21, with GPIO11-17 taken by the SPI flash (VDD_SPI, SPICS0...)
+constexpr bool isUsableGpio(unsigned pin) {
+    return pin <= 21 && !(pin >= 11 && pin <= 17);
+}
+
+// Sampled at reset to pick the boot mode; an external load can brick the boot
+constexpr bool isStrappingPin(unsigned pin) {
+    return pin == 2 || pin == 8 || pin == 9;
+}
+
+// Native USB D-/D+
+constexpr bool isUsbPin(unsigned pin) {
+    return pin == 18 || pin == 19;
+}
+
+constexpr uint32_t pinMask(const char* s, unsigned n) {
+    return n == 0 ? 0
+         : pinMask(s, n - 1) | (pinAt(s, n - 1) < 32 ? (1UL << pinAt(s, n - 1)) : 0);
+}
+
+constexpr bool allUsable(const char* s, unsigned n) {
+    return n == 0 || (isUsableGpio(pinAt(s, n - 1)) && allUsable(s, n - 1));
+}
+
+constexpr bool anyStrapping(const char* s, unsigned n) {
+    return n != 0 && (isStrappingPin(pinAt(s, n - 1)) || anyStrapping(s, n - 1));
+}
+
+constexpr bool anyUsb(const char* s, unsigned n) {
+    return n != 0 && (isUsbPin(pinAt(s, n - 1)) || anyUsb(s, n - 1));
+}
+
+constexpr bool matchesEarlier(const char* s, unsigned i, unsigned j) {
+    return j < i && (pinAt(s, i) == pinAt(s, j) || matchesEarlier(s, i, j + 1));
+}
+
+constexpr bool hasDuplicates(const char* s, unsigned n) {
+    return n > 1 && (matchesEarlier(s, n - 1, 0) || hasDuplicates(s, n - 1));
+}
+
+template <unsigned... I> struct IndexSeq {};
+template <unsigned N, unsigned... I> struct MakeIndexSeq : MakeIndexSeq<N - 1, N - 1, I...> {};
+template <unsigned... I> struct MakeIndexSeq<0, I...> { typedef IndexSeq<I...> type; };
+
+} // namespace pinparse
+
+template <unsigned N>
+struct PinList {
+    uint8_t pins[N];
+    constexpr uint8_t operator[](unsigned i) const { return pins[i]; }
+};
+
+template <unsigned N, unsigned... I>
+constexpr PinList<N> makePinList(const char* s, pinparse::IndexSeq<I...>) {
+    return PinList<N>{{ pinparse::pinAt(s, I)... }};
+}
+
+template <unsigned N>
+constexpr PinList<N> parsePinList(const char* s) {
+    return makePinList<N>(s, typename pinparse::MakeIndexSeq<N>::type());
+}
+
+#if HAS_AMP_SWITCHING
+
+// ---- Relay outputs ----
+#if RELAY_OUTPUT_BACKEND == RELAY_BACKEND_GPIO
+constexpr PinList<MAX_AMPSWITCHS> ampSwitchPins = parsePinList<MAX_AMPSWITCHS>(AMP_SWITCH_PINS);
+constexpr uint32_t AMP_SWITCH_PIN_MASK = pinparse::pinMask(AMP_SWITCH_PINS, MAX_AMPSWITCHS);
+
+static_assert(pinparse::countEntries(AMP_SWITCH_PINS) == MAX_AMPSWITCHS,
+              "AMP_SWITCH_PINS must list exactly MAX_AMPSWITCHS pins");
+static_assert(pinparse::allUsable(AMP_SWITCH_PINS, MAX_AMPSWITCHS),
+              "AMP_SWITCH_PINS has a malformed entry or a GPIO the ESP32-C3 cannot use (>21, or 11-17 SPI flash)");
+static_assert(!pinparse::hasDuplicates(AMP_SWITCH_PINS, MAX_AMPSWITCHS),
+              "AMP_SWITCH_PINS lists the same GPIO twice");
+#ifndef ALLOW_STRAPPING_PIN_OUTPUTS
+static_assert(!pinparse::anyStrapping(AMP_SWITCH_PINS, MAX_AMPSWITCHS),
+              "AMP_SWITCH_PINS drives a strapping pin (GPIO2/8/9); the relay driver can change the boot mode. "
+              "Define ALLOW_STRAPPING_PIN_OUTPUTS if the hardware keeps them at their boot levels");
+#endif
+#if ARDUINO_USB_CDC_ON_BOOT
+static_assert(!pinparse::anyUsb(AMP_SWITCH_PINS, MAX_AMPSWITCHS),
+              "AMP_SWITCH_PINS uses GPIO18/19, which carry USB serial (ARDUINO_USB_CDC_ON_BOOT)");
+#endif
+#else
+// Relays are on the shift register chain; no relay GPIOs
+constexpr PinList<MAX_AMPSWITCHS> ampSwitchPins = parsePinList<MAX_AMPSWITCHS>("");
+constexpr uint32_t AMP_SWITCH_PIN_MASK = 0;
+#endif
+
+#if RELAY_DRIVE_MODE == RELAY_DRIVE_LATCHING && RELAY_OUTPUT_BACKEND == RELAY_BACKEND_GPIO
+constexpr PinList<MAX_AMPSWITCHS> ampResetPins = parsePinList<MAX_AMPSWITCHS>(AMP_RESET_PINS);
+
+static_assert(pinparse::countEntries(AMP_RESET_PINS) == MAX_AMPSWITCHS,
+              "AMP_RESET_PINS must list exactly MAX_AMPSWITCHS pins");
+static_assert(pinparse::allUsable(AMP_RESET_PINS, MAX_AMPSWITCHS),
+              "AMP_RESET_PINS has a malformed entry or a GPIO the ESP32-C3 cannot use");
+static_assert(!pinparse::hasDuplicates(AMP_RESET_PINS, MAX_AMPSWITCHS),
+              "AMP_RESET_PINS lists the same GPIO twice");
+static_assert((pinparse::pinMask(AMP_RESET_PINS, MAX_AMPSWITCHS) & AMP_SWITCH_PIN_MASK) == 0,
+              "AMP_RESET_PINS overlaps AMP_SWITCH_PINS");
+#endif
+
+#if HAS_RELAY_SENSE
+constexpr PinList<MAX_AMPSWITCHS> relaySensePins = parsePinList<MAX_AMPSWITCHS>(RELAY_SENSE_PINS);
+
+static_assert(pinparse::countEntries(RELAY_SENSE_PINS) == MAX_AMPSWITCHS,
+              "RELAY_SENSE_PINS must list exactly MAX_AMPSWITCHS pins");
+static_assert(pinparse::allUsable(RELAY_SENSE_PINS, MAX_AMPSWITCHS),
+              "RELAY_SENSE_PINS has a malformed entry or a GPIO the ESP32-C3 cannot use");
+static_assert(!pinparse::hasDuplicates(RELAY_SENSE_PINS, MAX_AMPSWITCHS),
+              "RELAY_SENSE_PINS lists the same GPIO twice");
+static_assert((pinparse::pinMask(RELAY_SENSE_PINS, MAX_AMPSWITCHS) & AMP_SWITCH_PIN_MASK) == 0,
+              "RELAY_SENSE_PINS overlaps AMP_SWITCH_PINS");
+#endif
+
+// ---- Buttons ----
+#if HAS_BUTTON_MATRIX
+// Buttons are read through the matrix; no per-button GPIOs
+constexpr PinList<MAX_AMPSWITCHS> ampButtonPins = parsePinList<MAX_AMPSWITCHS>("");
+constexpr PinList<BUTTON_MATRIX_ROWS> matrixRowPins = parsePinList<BUTTON_MATRIX_ROWS>(BUTTON_MATRIX_ROW_PINS);
+constexpr PinList<BUTTON_MATRIX_COLS> matrixColPins = parsePinList<BUTTON_MATRIX_COLS>(BUTTON_MATRIX_COL_PINS);
+
+static_assert(pinparse::countEntries(BUTTON_MATRIX_ROW_PINS) == BUTTON_MATRIX_ROWS,
+              "BUTTON_MATRIX_ROW_PINS must list exactly BUTTON_MATRIX_ROWS pins");
+static_assert(pinparse::countEntries(BUTTON_MATRIX_COL_PINS) == BUTTON_MATRIX_COLS,
+              "BUTTON_MATRIX_COL_PINS must list exactly BUTTON_MATRIX_COLS pins");
+static_assert(pinparse::allUsable(BUTTON_MATRIX_ROW_PINS, BUTTON_MATRIX_ROWS) &&
+              pinparse::allUsable(BUTTON_MATRIX_COL_PINS, BUTTON_MATRIX_COLS),
+              "Button matrix pins have a malformed entry or a GPIO the ESP32-C3 cannot use");
+static_assert(!pinparse::hasDuplicates(BUTTON_MATRIX_ROW_PINS, BUTTON_MATRIX_ROWS) &&
+              !pinparse::hasDuplicates(BUTTON_MATRIX_COL_PINS, BUTTON_MATRIX_COLS),
+              "Button matrix pin lists repeat a GPIO");
+static_assert((pinparse::pinMask(BUTTON_MATRIX_ROW_PINS, BUTTON_MATRIX_ROWS) &
+               pinparse::pinMask(BUTTON_MATRIX_COL_PINS, BUTTON_MATRIX_COLS)) == 0,
+              "Button matrix rows and columns share a GPIO");
+static_assert(((pinparse::pinMask(BUTTON_MATRIX_ROW_PINS, BUTTON_MATRIX_ROWS) |
+                pinparse::pinMask(BUTTON_MATRIX_COL_PINS, BUTTON_MATRIX_COLS)) & AMP_SWITCH_PIN_MASK) == 0,
+              "Button matrix pins overlap AMP_SWITCH_PINS");
+#else
+constexpr PinList<MAX_AMPSWITCHS> ampButtonPins = parsePinList<MAX_AMPSWITCHS>(AMP_BUTTON_PINS);
+constexpr uint32_t AMP_BUTTON_PIN_MASK = pinparse::pinMask(AMP_BUTTON_PINS, MAX_AMPSWITCHS);
+
+static_assert(pinparse::countEntries(AMP_BUTTON_PINS) == MAX_AMPSWITCHS,
+              "AMP_BUTTON_PINS must list exactly MAX_AMPSWITCHS pins");
+static_assert(pinparse::allUsable(AMP_BUTTON_PINS, MAX_AMPSWITCHS),
+              "AMP_BUTTON_PINS has a malformed entry or a GPIO the ESP32-C3 cannot use (>21, or 11-17 SPI flash)");
+static_assert(!pinparse::hasDuplicates(AMP_BUTTON_PINS, MAX_AMPSWITCHS),
+              "AMP_BUTTON_PINS lists the same GPIO twice");
+static_assert((AMP_BUTTON_PIN_MASK & AMP_SWITCH_PIN_MASK) == 0,
+              "AMP_BUTTON_PINS overlaps AMP_SWITCH_PINS");
+#if ARDUINO_USB_CDC_ON_BOOT
+static_assert(!pinparse::anyUsb(AMP_BUTTON_PINS, MAX_AMPSWITCHS),
+              "AMP_BUTTON_PINS uses GPIO18/19, which carry USB serial (ARDUINO_USB_CDC_ON_BOOT)");
+#endif
+#endif
+
+#endif // HAS_AMP_SWITCHING
@@ -0,0 +1,72 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include "config.h"
+#include <Arduino.h>
+#include <soc/gpio_reg.h>
+
+// Relay output masks, precomputed once from ampSwitchPins[] so a channel change
+// is at most one W1TC and one W1TS register write. Index 0 is "all off".
+// With the shift register backend the masks are shift register bits instead
+// of GPIO bits, and a masked update is one SPI transfer plus a latch.
+extern uint32_t ampChannelSetMask[MAX_AMPSWITCHS + 1];
+extern uint32_t ampChannelClearMask[MAX_AMPSWITCHS + 1];
+extern uint32_t ampRelayMask; // Every relay output bit
+
+void initRelayMasks();
+uint32_t relayOutputsToGpioMask(uint32_t outputs);
+void driveRelayOutputs(uint32_t outputs);
+const char* getRelaySwitchOrderString();
+const char* getRelayBackendString();
+const char* getRelayDriveModeString();
+
+// Pulse driver for RELAY_DRIVE_LATCHING / RELAY_DRIVE_MOMENTARY. Callers set
+// the desired output bitmask; an esp_timer emits pulses for the difference
+// between the desired and latched state, one pulse at a time, never blocking.
+void initRelayPulseDriver();
+void requestRelayOutputs(uint32_t outputs);
+void printRelayDriverStatus();
+
+#if RELAY_OUTPUT_BACKEND == RELAY_BACKEND_SHIFT_REG
+void initShiftRegister();
+void shiftRegisterUpdate(uint32_t setMask, uint32_t clearMask);
+uint32_t getShiftRegisterState();
+
+inline void relayOutputsSet(uint32_t mask) { shiftRegisterUpdate(mask, 0); }
+inline void relayOutputsClear(uint32_t mask) { shiftRegisterUpdate(0, mask); }
+#else
+inline void IRAM_ATTR relayOutputsSet(uint32_t mask) { REG_WRITE(GPIO_OUT_W1TS_REG, mask); }
+inline void IRAM_ATTR relayOutputsClear(uint32_t mask) { REG_WRITE(GPIO_OUT_W1TC_REG, mask); }
+#endif
+
+// Apply a precomputed set/clear pair in the configured order with the
+// configured gap (break-before-make) or overlap (make-before-break).
+inline void IRAM_ATTR writeRelayMasks(uint32_t setMask, uint32_t clearMask) {
+#if RELAY_OUTPUT_BACKEND == RELAY_BACKEND_SHIFT_REG && RELAY_SWITCH_GAP_US == 0
+    // Every output latches at once, so order only matters with a gap
+    shiftRegisterUpdate(setMask, clearMask);
+#elif RELAY_SWITCH_ORDER == RELAY_MAKE_BEFORE_BREAK
+    if (setMask) relayOutputsSet(setMask);
+    #if RELAY_SWITCH_GAP_US > 0
+    if (setMask && clearMask) delayMicroseconds(RELAY_SWITCH_GAP_US);
+    #endif
+    if (clearMask) relayOutputsClear(clearMask);
+#else
+    if (clearMask) relayOutputsClear(clearMask);
+    #if RELAY_SWITCH_GAP_US > 0
+    if (setMask && clearMask) delayMicroseconds(RELAY_SWITCH_GAP_US);
+    #endif
+    if (setMask) relayOutputsSet(setMask);
+#endif
+}
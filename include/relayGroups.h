@@ -0,0 +1,158 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include "config.h"
+#include "globals.h"
+#include <Arduino.h>
+
+// Relay group topology, parsed from RELAY_GROUPS at compile time. Outputs are
+// numbered globally (channel N = output N) and split into consecutive groups.
+// Selecting an output of an exclusive group clears the rest of that group
+// only; selecting an output of an independent group toggles it. Channel 0
+// turns every group off. The per-channel tables below make the next output
+// state a couple of mask operations, whatever the topology.
+
+#if HAS_AMP_SWITCHING
+
+namespace groupparse {
+
+using pinparse::countEntries;
+using pinparse::seekEntry;
+using pinparse::skipSpaces;
+using pinparse::parseDigits;
+
+constexpr uint32_t lowMask(unsigned n) {
+    return n >= 32 ? 0xFFFFFFFFUL : ((1UL << n) - 1);
+}
+
+// 'E' exclusive, 'I' independent, anything else is malformed
+constexpr char kindAt(const char* s, unsigned g) {
+    return (*skipSpaces(seekEntry(s, g)) == 'E' || *skipSpaces(seekEntry(s, g)) == 'e') ? 'E'
+         : (*skipSpaces(seekEntry(s, g)) == 'I' || *skipSpaces(seekEntry(s, g)) == 'i') ? 'I'
+         : '?';
+}
+
+constexpr unsigned sizeAt(const char* s, unsigned g) {
+    return kindAt(s, g) == '?' ? PIN_INVALID : parseDigits(skipSpaces(seekEntry(s, g)) + 1, 0);
+}
+
+constexpr unsigned firstOutput(const char* s, unsigned g) {
+    return g == 0 ? 0 : firstOutput(s, g - 1) + sizeAt(s, g - 1);
+}
+
+constexpr unsigned totalOutputs(const char* s, unsigned n) {
+    return n == 0 ? 0 : totalOutputs(s, n - 1) + sizeAt(s, n - 1);
+}
+
+constexpr bool allValid(const char* s, unsigned n) {
+    return n == 0 || (sizeAt(s, n - 1) >= 1 && sizeAt(s, n - 1) <= 32 && allValid(s, n - 1));
+}
+
+constexpr uint32_t groupMask(const char* s, unsigned g) {
+    return lowMask(sizeAt(s, g)) << firstOutput(s, g);
+}
+
+constexpr uint8_t groupOf(const char* s, unsigned output, unsigned g) {
+    return (g + 1 >= countEntries(s) || output < firstOutput(s, g + 1)) ? g : groupOf(s, output, g + 1);
+}
+
+constexpr uint32_t independentMask(const char* s, unsigned n) {
+    return n == 0 ? 0 : independentMask(s, n - 1) | (kindAt(s, n - 1) == 'I' ? groupMask(s, n - 1) : 0);
+}
+
+// Channel 0 "belongs" to every output
+constexpr uint32_t channelGroupMask(const char* s, unsigned channel) {
+    return channel == 0 ? lowMask(totalOutputs(s, countEntries(s))) : groupMask(s, groupOf(s, channel - 1, 0));
+}
+
+} // namespace groupparse
+
+template <class T, unsigned N>
+struct ConstList {
+    T v[N];
+    constexpr T operator[](unsigned i) const { return v[i]; }
+};
+
+template <unsigned N, unsigned... I>
+constexpr ConstList<uint32_t, N> makeGroupMasks(const char* s, pinparse::IndexSeq<I...>) {
+    return ConstList<uint32_t, N>{{ groupparse::groupMask(s, I)... }};
+}
+
+template <unsigned N, unsigned... I>
+constexpr ConstList<uint32_t, N> makeChannelGroupMasks(const char* s, pinparse::IndexSeq<I...>) {
+    return ConstList<uint32_t, N>{{ groupparse::channelGroupMask(s, I)... }};
+}
+
+template <unsigned N, unsigned... I>
+constexpr ConstList<uint8_t, N> makeOutputGroups(const char* s, pinparse::IndexSeq<I...>) {
+    return ConstList<uint8_t, N>{{ groupparse::groupOf(s, I, 0)... }};
+}
+
+constexpr uint8_t RELAY_GROUP_COUNT = pinparse::countEntries(RELAY_GROUPS);
+
+static_assert(RELAY_GROUP_COUNT >= 1 && RELAY_GROUP_COUNT <= MAX_RELAY_GROUPS,
+              "RELAY_GROUPS must list 1-8 groups");
+static_assert(groupparse::allValid(RELAY_GROUPS, RELAY_GROUP_COUNT),
+              "RELAY_GROUPS entries must be E<count> (exclusive) or I<count> (independent), e.g. \"E2,E2,I1\"");
+static_assert(groupparse::totalOutputs(RELAY_GROUPS, RELAY_GROUP_COUNT) == MAX_AMPSWITCHS,
+              "RELAY_GROUPS output counts must add up to MAX_AMPSWITCHS");
+
+// Outputs (bit N = output N+1) of each group
+constexpr ConstList<uint32_t, RELAY_GROUP_COUNT> relayGroupOutputs =
+    makeGroupMasks<RELAY_GROUP_COUNT>(RELAY_GROUPS, pinparse::MakeIndexSeq<RELAY_GROUP_COUNT>::type());
+// Group outputs of each channel, [0] = every output
+constexpr ConstList<uint32_t, MAX_AMPSWITCHS + 1> ampChannelGroupOutputs =
+    makeChannelGroupMasks<MAX_AMPSWITCHS + 1>(RELAY_GROUPS, pinparse::MakeIndexSeq<MAX_AMPSWITCHS + 1>::type());
+// 0-based group index of each output
+constexpr ConstList<uint8_t, MAX_AMPSWITCHS> relayOutputGroup =
+    makeOutputGroups<MAX_AMPSWITCHS>(RELAY_GROUPS, pinparse::MakeIndexSeq<MAX_AMPSWITCHS>::type());
+constexpr uint32_t RELAY_INDEPENDENT_OUTPUTS = groupparse::independentMask(RELAY_GROUPS, RELAY_GROUP_COUNT);
+
+inline bool isRelayGroupExclusive(uint8_t group) {
+    return (relayGroupOutputs[group] & RELAY_INDEPENDENT_OUTPUTS) == 0;
+}
+
+// Output state after selecting 'channel' from 'outputs'
+inline uint32_t nextAmpOutputs(uint32_t outputs, uint8_t channel) {
+    if (channel == 0) {
+        return 0;
+    }
+    uint32_t bit = 1UL << (channel - 1);
+    if (RELAY_INDEPENDENT_OUTPUTS & bit) {
+        return outputs ^ bit;
+    }
+    return (outputs & ~ampChannelGroupOutputs[channel]) | bit;
+}
+
+// currentAmpChannel for an output state: 0, the one active output, or
+// AMP_CHANNEL_SCENE when several outputs are on
+inline uint8_t ampChannelFromOutputs(uint32_t outputs) {
+    if (outputs == 0) {
+        return 0;
+    }
+    if ((outputs & (outputs - 1)) == 0) {
+        return __builtin_ctz(outputs) + 1;
+    }
+    return AMP_CHANNEL_SCENE;
+}
+
+// Active output of an exclusive group (1-based, 0 = none)
+inline uint8_t getRelayGroupChannel(uint8_t group) {
+    uint32_t active = ampOutputs & relayGroupOutputs[group];
+    return active ? __builtin_ctz(active) + 1 : 0;
+}
+
+void printRelayGroups();
+
+#endif // HAS_AMP_SWITCHING
@@ -0,0 +1,45 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include "config.h"
+#include <Arduino.h>
+
+// Relay wear statistics: per-output actuation counts and cumulative on-time.
+// The switching path counts actuations and credits the time since the last
+// sample to the outputs it is leaving; the loop samples once a second in
+// between. Persistence is one NVS record rewritten every
+// RELAY_STATS_SAVE_INTERVAL_MS at most, never per switch. NVS appends each
+// write to a fresh entry and only then drops the old one, so a torn write
+// keeps the previous record.
+
+struct RelayStatsRecord {
+    uint32_t seq;                          // Journal writes since the counters were created
+    uint32_t actuations[MAX_AMPSWITCHS];
+    uint32_t onSeconds[MAX_AMPSWITCHS];
+};
+
+extern uint32_t relayActuations[MAX_AMPSWITCHS];
+extern uint32_t relayWearOutputs; // Outputs energised as last recorded
+
+void initRelayStats();
+void updateRelayStats();          // Loop: on-time sampling + journal writes
+void flushRelayStats();           // Write now if anything changed
+void resetRelayStats(uint8_t output);
+uint32_t getRelayOnSeconds(uint8_t output);
+void printRelayStats();
+
+// Switching path: credit on-time to the old outputs, then count outputs that
+// went from off to on. One short critical section; the loop and the ESP-NOW
+// task both switch.
+void recordRelayOutputs(uint32_t outputs);
@@ -0,0 +1,62 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include "config.h"
+#include <Arduino.h>
+#include <soc/gpio_reg.h>
+#include "relayDriver.h"
+#include "metrics.h"
+
+// Relay readback verification. The switching path only records what it
+// expects (plus one GPIO_IN_REG read with RELAY_VERIFY on direct GPIO);
+// pollRelayVerify() confirms mismatches from the loop, checks the optional
+// sense inputs and reports faults via log, status LED and ESP-NOW.
+
+// GPIO readback works on direct GPIO level drive only
+#define RELAY_VERIFY_READBACK \
+    (RELAY_VERIFY && RELAY_OUTPUT_BACKEND == RELAY_BACKEND_GPIO && RELAY_DRIVE_MODE == RELAY_DRIVE_LEVEL)
+
+#if RELAY_VERIFY_READBACK
+extern MetricCounter relayVerifyChecks;  // Readbacks taken on the switching path
+#endif
+extern MetricGauge relayFaultMask;       // Outputs (bit N = output N+1) that have faulted
+extern volatile uint32_t relayVerifySuspect;  // GPIO bits that read back wrong
+extern volatile uint32_t relayVerifyExpected; // GPIO relay bits expected high
+extern volatile bool relaySenseDue;
+
+void initRelayVerify();
+void pollRelayVerify();
+void printRelayVerifyStatus();
+
+// Hot path, direct GPIO level drive: one register read, no logging. Takes
+// the set/clear pair just written; relays outside it keep their expected level
+inline void IRAM_ATTR verifyRelayGpio(uint32_t setMask, uint32_t clearMask) {
+#if RELAY_VERIFY_READBACK
+    uint32_t expected = (relayVerifyExpected & ~clearMask) | setMask;
+    relayVerifyExpected = expected;
+    relayVerifySuspect = (REG_READ(GPIO_IN_REG) ^ expected) & ampRelayMask;
+    relayVerifyChecks.inc();
+#endif
+#if HAS_RELAY_SENSE
+    relaySenseDue = true;
+#endif
+}
+
+// Backends that switch later (pulses, mute sequencing) or cannot be read
+// back (shift register): only the sense inputs can verify them
+inline void verifyRelayOutputsLater() {
+#if HAS_RELAY_SENSE
+    relaySenseDue = true;
+#endif
+}
@@ -0,0 +1,64 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include "config.h"
+#include <Arduino.h>
+
+// WS2812 status LED on the RMT peripheral. A frame is 24 bits (G, R, B, MSB
+// first), each bit one RMT item; the items are handed to the RMT driver
+// without waiting for the transfer, so the loop never bit-bangs the LED.
+
+#define WS2812_FRAME_BITS 24
+
+struct RgbColour {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+};
+
+inline bool operator==(const RgbColour& a, const RgbColour& b) {
+    return a.r == b.r && a.g == b.g && a.b == b.b;
+}
+inline bool operator!=(const RgbColour& a, const RgbColour& b) {
+    return !(a == b);
+}
+
+// RMT ticks at 40MHz (APB / 2): 25ns per tick
+#define WS2812_RMT_CLK_DIV 2
+#define WS2812_T0H 16 // 0.40us
+#define WS2812_T0L 34 // 0.85us
+#define WS2812_T1H 32 // 0.80us
+#define WS2812_T1L 18 // 0.45us
+#define WS2812_FRAME_US 30 // 24 bits at 1.25us, on the wire after rmt_write_items() returns
+#define WS2812_RESET_US 300 // Line held low between frames; WS2812B latches after 280us
+
+// One RMT item (rmt_item32_t::val): high for 'high' ticks, then low
+constexpr uint32_t ws2812Item(uint16_t high, uint16_t low) {
+    return (uint32_t)high | (1UL << 15) | ((uint32_t)low << 16);
+}
+
+// Encode one pixel as RMT item values; no driver state, so it can be checked
+// off target against the timing table above
+inline void encodeWs2812Frame(RgbColour colour, uint32_t* items) {
+    uint32_t grb = ((uint32_t)colour.g << 16) | ((uint32_t)colour.r << 8) | colour.b;
+    for (int i = 0; i < WS2812_FRAME_BITS; i++) {
+        bool one = grb & (1UL << (WS2812_FRAME_BITS - 1 - i));
+        items[i] = one ? ws2812Item(WS2812_T1H, WS2812_T1L) : ws2812Item(WS2812_T0H, WS2812_T0L);
+    }
+}
+
+void initRgbLed();
+void showRgbLed(RgbColour colour);
+void pollRgbLed();
+void printRgbLedStats();
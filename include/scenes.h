@@ -0,0 +1,36 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include "config.h"
+#include <Arduino.h>
+
+// Relay scenes: arbitrary combinations of relay outputs (channel + boost + FX
+// loop...) stored as bitmasks, bit N = ampSwitchPins[N]. Each scene's GPIO
+// set/clear masks are precomputed so recalling one is a single masked update.
+
+#define SCENE_NO_PROGRAM 0xFF // Scene not mapped to a Program Change
+
+struct AmpScene {
+    uint32_t outputs;   // Output bitmask
+    uint8_t program;    // MIDI Program Change that recalls the scene
+};
+
+extern AmpScene ampScenes[MAX_SCENES];
+
+void initScenes();
+void rebuildSceneMasks();
+bool applyAmpScene(uint8_t scene);
+int findSceneForProgram(uint8_t program);
+uint32_t getAmpOutputs();
+void printScenes();
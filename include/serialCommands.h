@@ -0,0 +1,81 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include "config.h"
+#include <Arduino.h>
+
+// Serial console plumbing: an incremental line assembler fed one byte at a
+// time (never waits for the rest of a line, never allocates) and sorted
+// command tables searched by binary search. Each table entry carries its
+// help text, so the help menus are generated from the same table that
+// dispatches. Tables are constexpr and checked for order at compile time
+// with serialCommandsSorted().
+
+enum SerialLineResult : uint8_t {
+    LINE_PARTIAL,    // Keep feeding
+    LINE_READY,      // line.data holds a complete, trimmed, non-empty line
+    LINE_OVERFLOW    // A line longer than SERIAL_LINE_MAX was dropped
+};
+
+struct SerialLineBuffer {
+    char data[SERIAL_LINE_MAX + 1];
+    uint8_t length;
+    bool overflow;
+};
+
+SerialLineResult feedSerialLine(SerialLineBuffer& line, char c);
+
+// How an entry's arguments are written. Names are matched case-insensitively.
+enum SerialCommandFlags : uint8_t {
+    CMD_EXACT = 0,          // Name alone
+    CMD_ARGS = 1,           // Name, space, arguments
+    CMD_NUMBER = 2,         // A number may follow the name directly (setlog3, scene2)
+    CMD_SUBCOMMAND = 4,     // A subcommand may follow the name directly (debugperf)
+    CMD_CHANNEL = 8,        // A bare number (channel select)
+    CMD_HIDDEN = 16         // Alias, left out of help
+};
+
+typedef void (*SerialCommandHandler)(const char* args);
+
+struct SerialCommand {
+    const char* name;
+    const char* usage;       // Help column, nullptr = name
+    const char* help;
+    SerialCommandHandler handler;
+    uint8_t section;         // Help grouping, meaning is up to the table owner
+    uint8_t flags;
+};
+
+// Find the entry for a command line; *args points at its arguments
+// (never null). Returns nullptr for an unknown command.
+const SerialCommand* findSerialCommand(const SerialCommand* table, size_t count, const char* line,
+                                       const char** args);
+bool runSerialCommand(const SerialCommand* table, size_t count, const char* line);
+void printSerialCommandHelp(const SerialCommand* table, size_t count, uint8_t section, const char* prefix);
+
+// Compile-time order check: names strictly ascending, case-insensitive
+constexpr char serialNameLower(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c + ('a' - 'A')) : c;
+}
+
+constexpr bool serialNameLess(const char* a, const char* b) {
+    return *b == '\0' ? false
+         : *a == '\0' ? true
+         : serialNameLower(*a) != serialNameLower(*b) ? serialNameLower(*a) < serialNameLower(*b)
+         : serialNameLess(a + 1, b + 1);
+}
+
+constexpr bool serialCommandsSorted(const SerialCommand* table, size_t count) {
+    return count < 2 || (serialNameLess(table[0].name, table[1].name) && serialCommandsSorted(table + 1, count - 1));
+}
@@ -0,0 +1,42 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include "config.h"
+#include "globals.h"
+#include <Arduino.h>
+
+// Status LED engine. Patterns are constexpr step tables (hold a level, or fade
+// to one); the LEDC channel is only written when a step starts, and fades run
+// in the LEDC hardware fader, so updateStatusLED() is a time comparison on
+// most loop iterations.
+//
+// Continuous patterns (off, solid, blink, fade) set the background. One-shot
+// patterns (flashes, confirmations) go into a small priority queue and play
+// over the background when they outrank it, then the background resumes.
+// Pairing and OTA raise the background priority, so feedback flashes wait
+// (and go stale) instead of clobbering them.
+
+enum LedPriority : uint8_t {
+    LED_PRIORITY_BACKGROUND = 0, // Normal background patterns
+    LED_PRIORITY_FEEDBACK,       // Button / command / MIDI flashes
+    LED_PRIORITY_CONFIRM,        // Channel select confirmation
+    LED_PRIORITY_PAIRING,        // Pairing fade (background)
+    LED_PRIORITY_OTA             // OTA blink (background)
+};
+
+void initStatusLed();
+void setStatusLedPattern(StatusLedPattern pattern);
+void queueStatusLedFlashes(uint8_t flashes, LedPriority priority);
+void updateStatusLED();
+void printStatusLedStats();
@@ -0,0 +1,200 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include "config.h"
+#include "globals.h"
+#include "relayDriver.h"
+#include "switchMute.h"
+#include "relayVerify.h"
+#include "relayStats.h"
+#include "relayGroups.h"
+#include "eventLog.h"
+#include "utils.h"
+#include <Arduino.h>
+
+// Amp channel switching, assembled at compile time from a channel count, an
+// output backend (how relays move) and a policy (what gets reported). Every
+// combination has the same semantics: channel > N is rejected, a selection
+// that leaves the outputs unchanged does nothing, anything else drives the
+// outputs and updates ampOutputs / currentAmpChannel. Which outputs a channel
+// clears or toggles comes from the relay group topology (relayGroups.h).
+// Policies and backends are static and inline, so the silent register path
+// compiles down to the mask writes alone (plus one readback when
+// RELAY_VERIFY is set).
+
+// ---- Backends ----
+// apply() gets the GPIO / shift register set and clear masks and the new
+// output bitmask; each backend uses whichever suits it.
+
+// Masked writes through writeRelayMasks(): GPIO registers or the 74HC595 chain
+struct RegisterSwitchBackend {
+    static inline void IRAM_ATTR apply(uint32_t setMask, uint32_t clearMask, uint32_t outputs) {
+        writeRelayMasks(setMask, clearMask);
+    }
+    static inline void IRAM_ATTR verify(uint32_t setMask, uint32_t clearMask) {
+        verifyRelayGpio(setMask, clearMask);
+    }
+};
+
+// Per-pin digitalWrite() in the configured order, for standard GPIO builds
+struct DigitalWriteSwitchBackend {
+    static void writePins(uint32_t gpioMask, uint8_t level) {
+        for (int i = 0; i < MAX_AMPSWITCHS; i++) {
+            if (gpioMask & ampChannelSetMask[i + 1]) {
+                digitalWrite(ampSwitchPins[i], level);
+            }
+        }
+    }
+    static void apply(uint32_t setMask, uint32_t clearMask, uint32_t outputs) {
+#if RELAY_SWITCH_ORDER == RELAY_MAKE_BEFORE_BREAK
+        writePins(setMask, HIGH);
+        #if RELAY_SWITCH_GAP_US > 0
+        if (setMask && clearMask) delayMicroseconds(RELAY_SWITCH_GAP_US);
+        #endif
+        writePins(clearMask, LOW);
+#else
+        writePins(clearMask, LOW);
+        #if RELAY_SWITCH_GAP_US > 0
+        if (setMask && clearMask) delayMicroseconds(RELAY_SWITCH_GAP_US);
+        #endif
+        writePins(setMask, HIGH);
+#endif
+    }
+    static inline void verify(uint32_t setMask, uint32_t clearMask) {
+        verifyRelayGpio(setMask, clearMask);
+    }
+};
+
+// Latching / momentary relays: the pulse driver's timer does the work
+struct PulseSwitchBackend {
+    static inline void apply(uint32_t setMask, uint32_t clearMask, uint32_t outputs) {
+        requestRelayOutputs(outputs);
+    }
+    static inline void verify(uint32_t setMask, uint32_t clearMask) {
+        verifyRelayOutputsLater();
+    }
+};
+
+// Mute -> settle -> switch -> unmute, sequenced from a timer
+struct MutedSwitchBackend {
+    static inline void apply(uint32_t setMask, uint32_t clearMask, uint32_t outputs) {
+        requestMutedSwitch(outputs);
+    }
+    static inline void verify(uint32_t setMask, uint32_t clearMask) {
+        verifyRelayOutputsLater();
+    }
+};
+
+// ---- Policies ----
+
+// FAST_SWITCHING: no logging on the switching path (it costs ~500us)
+struct SilentSwitchPolicy {
+    static inline void rejected(uint8_t channel, uint8_t maxChannel) {}
+    static inline void unchanged(uint8_t channel) {}
+    static inline void switching(uint8_t from, uint8_t to) {}
+    static inline void switched(uint8_t channel, uint32_t outputs) {}
+};
+
+struct LoggingSwitchPolicy {
+    static void rejected(uint8_t channel, uint8_t maxChannel) {
+        logf(LOG_ERROR, "Invalid channel %u requested (max: %u)", channel, maxChannel);
+    }
+    static void unchanged(uint8_t channel) {
+        logf(LOG_DEBUG, "Channel %u already active, ignoring", channel);
+    }
+    static void switching(uint8_t from, uint8_t to) {
+        logf(LOG_INFO, "Switching amp channel from %u to %u", from, to);
+    }
+    static void switched(uint8_t channel, uint32_t outputs) {
+        if (channel == 0) {
+            log(LOG_INFO, "All amp channels turned off");
+        } else if (outputs & (1UL << (channel - 1))) {
+            logf(LOG_INFO, "Amp channel %u activated", channel);
+        } else {
+            logf(LOG_INFO, "Amp channel %u turned off", channel);
+        }
+    }
+};
+
+// ---- Driver ----
+
+template <uint8_t N, class Backend, class Policy>
+struct SwitchDriver {
+    static_assert(N >= 1 && N <= 32, "SwitchDriver supports 1-32 outputs");
+
+    static inline void set(uint8_t channel) {
+        if (channel > N) {
+            Policy::rejected(channel, N);
+            return;
+        }
+        uint32_t next = nextAmpOutputs(ampOutputs, channel);
+        if (next == ampOutputs) {
+            Policy::unchanged(channel);
+            return;
+        }
+        uint32_t setMask = ampChannelSetMask[channel];
+        uint32_t clearMask = ampChannelClearMask[channel];
+        if (channel && !(next & (1UL << (channel - 1)))) {
+            // Independent output toggled off
+            clearMask = setMask;
+            setMask = 0;
+        }
+        Policy::switching(currentAmpChannel, channel);
+        commit(setMask, clearMask, next);
+        Policy::switched(channel, next);
+    }
+
+    // Arbitrary output state (scenes, group off, coalesced bursts) with
+    // precomputed masks that cover every relay output
+    static inline void setOutputs(uint32_t outputs, uint32_t setMask, uint32_t clearMask) {
+        if (outputs == ampOutputs) {
+            return;
+        }
+        commit(setMask, clearMask, outputs);
+    }
+
+    static void setOutputs(uint32_t outputs) {
+        uint32_t setMask = relayOutputsToGpioMask(outputs);
+        setOutputs(outputs, setMask, ampRelayMask & ~setMask);
+    }
+
+private:
+    static inline void commit(uint32_t setMask, uint32_t clearMask, uint32_t outputs) {
+        Backend::apply(setMask, clearMask, outputs);
+        ampOutputs = outputs;
+        currentAmpChannel = ampChannelFromOutputs(outputs);
+        Backend::verify(setMask, clearMask);
+        recordRelayOutputs(outputs);
+        recordEvent(EVENT_SWITCH, currentAmpChannel, outputs);
+    }
+};
+
+// Build configuration -> concrete driver used by setAmpChannel()
+#if HAS_SWITCH_MUTE
+typedef MutedSwitchBackend AmpSwitchBackend;
+#elif RELAY_DRIVE_MODE != RELAY_DRIVE_LEVEL
+typedef PulseSwitchBackend AmpSwitchBackend;
+#elif RELAY_OUTPUT_BACKEND == RELAY_BACKEND_SHIFT_REG || defined(FAST_SWITCHING)
+typedef RegisterSwitchBackend AmpSwitchBackend;
+#else
+typedef DigitalWriteSwitchBackend AmpSwitchBackend;
+#endif
+
+#ifdef FAST_SWITCHING
+typedef SilentSwitchPolicy AmpSwitchPolicy;
+#else
+typedef LoggingSwitchPolicy AmpSwitchPolicy;
+#endif
+
+typedef SwitchDriver<MAX_AMPSWITCHS, AmpSwitchBackend, AmpSwitchPolicy> AmpSwitchDriver;
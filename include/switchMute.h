@@ -0,0 +1,25 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include "config.h"
+#include <Arduino.h>
+
+// Mute-before-switch sequencer. With SWITCH_MUTE_PIN set, every relay change
+// runs mute -> SWITCH_MUTE_SETTLE_US -> relays -> SWITCH_MUTE_RELEASE_US ->
+// unmute from an esp_timer. Added latency is bounded by the settle time and
+// measured for debugrelay.
+
+void initSwitchMute();
+void requestMutedSwitch(uint32_t outputs);
+void printSwitchMuteStatus();
@@ -0,0 +1,102 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+#include "config.h"
+#include <Arduino.h>
+
+// Machine-readable telemetry on the serial console. Each response is one
+// binary frame, written with a single Serial.write so it never interleaves
+// with log lines or tokenised log frames:
+//
+//     A6 len type seq payload... sum
+//
+// len counts type..payload, seq counts frames sent (drops show as gaps) and
+// sum is the two's complement of the byte sum of type..payload, as in the
+// tokenised log frames (0xA5). Payloads are the packed little-endian structs
+// below; tools/telemetry.py has the matching layouts. Fields are only ever
+// appended, and TELEMETRY_VERSION in the config frame goes up when a layout
+// changes in any other way.
+
+#define TELEMETRY_VERSION 1
+
+enum TelemetryFrameType : uint8_t {
+    TELEMETRY_STATUS = 1,
+    TELEMETRY_CONFIG,
+    TELEMETRY_PERF,
+    TELEMETRY_ESPNOW
+};
+
+struct __attribute__((packed)) TelemetryStatus {
+    uint32_t uptimeMs;
+    uint32_t outputs;        // Active relay outputs, bit N = output N+1
+    uint32_t freeHeap;
+    uint32_t minFreeHeap;
+    uint8_t channel;         // currentAmpChannel (0xFF = scene)
+    uint8_t pairingStatus;
+    uint8_t failStreak;      // Consecutive failed ESP-NOW sends
+    uint8_t logLevel;
+    uint8_t midiChannel;
+    uint8_t wifiChannel;
+};
+
+struct __attribute__((packed)) TelemetryConfig {
+    uint8_t version;         // TELEMETRY_VERSION
+    uint8_t clientType;      // ClientType
+    uint8_t outputs;         // MAX_AMPSWITCHS
+    uint8_t boardId;
+    uint8_t relayBackend;    // RELAY_OUTPUT_BACKEND
+    uint8_t relayDrive;      // RELAY_DRIVE_MODE
+    uint8_t ledBackend;      // STATUS_LED_BACKEND
+    uint8_t logLevelFloor;   // LOG_LEVEL
+    uint8_t flags;           // TELEMETRY_FLAG_*
+    uint8_t clientMac[6];
+    uint8_t serverMac[6];
+    char firmware[16];       // FIRMWARE_VERSION, NUL padded
+};
+
+#define TELEMETRY_FLAG_FAST_SWITCHING 0x01
+#define TELEMETRY_FLAG_LOG_ASYNC 0x02
+#define TELEMETRY_FLAG_LOG_TOKENIZED 0x04
+
+struct __attribute__((packed)) TelemetryPerf {
+    uint32_t uptimeMs;
+    uint32_t loopCount;      // Loop metrics (debug.h); all zero with FAST_SWITCHING
+    uint32_t lastLoopMs;
+    uint32_t maxLoopMs;
+    uint32_t minLoopMs;
+    uint32_t totalLoopMs;
+};
+
+struct __attribute__((packed)) TelemetryEspNow {
+    uint32_t sent;           // Acknowledged by the server
+    uint32_t sendFailed;
+    uint32_t received;
+    uint32_t ignored;        // Dropped while not paired
+    uint32_t unknownType;
+    uint8_t pairingStatus;
+    uint8_t wifiChannel;
+    uint8_t failStreak;
+    uint8_t serverMac[6];
+};
+
+static_assert(sizeof(TelemetryStatus) == 22, "TelemetryStatus layout is shared with tools/telemetry.py");
+static_assert(sizeof(TelemetryConfig) == 37, "TelemetryConfig layout is shared with tools/telemetry.py");
+static_assert(sizeof(TelemetryPerf) == 24, "TelemetryPerf layout is shared with tools/telemetry.py");
+static_assert(sizeof(TelemetryEspNow) == 29, "TelemetryEspNow layout is shared with tools/telemetry.py");
+
+void sendTelemetry(TelemetryFrameType type);
+void pollTelemetry();            // Loop: streamed frames
+void setTelemetryStream(uint32_t periodMs, uint8_t typeMask);
+uint32_t getTelemetryStreamPeriod();
+void handleTelemetryCommand(const char* args);
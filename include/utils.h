@@ -14,11 +14,50 @@
 #pragma once
 #include "config.h"
 #include "globals.h"
+#include "statusLed.h"
+#include "eventLog.h"
 #include <Arduino.h>
 
-// Enhanced logging functions
-void log(LogLevel level, const String& msg);
-void logf(LogLevel level, const char* format, ...);
+// Logging. LOG_LEVEL (config.h) is the compile-time floor: a call above it
+// folds away after inlining, arguments included when they have no side
+// effects. Calls at or below it still check currentLogLevel at runtime.
+// The wrappers are always_inline: at -Os GCC would otherwise keep a shared
+// out-of-line copy taking the level as a variable, and nothing would fold
+// (test/host/run.sh checks an object file built with LOG_LEVEL_WARN).
+// Warnings and errors also go to the postmortem event log (eventLog.h),
+// whatever the runtime level.
+static_assert(LOG_ERROR == LOG_LEVEL_ERROR && LOG_DEBUG == LOG_LEVEL_DEBUG,
+              "LogLevel must match the LOG_LEVEL_* numbers");
+
+void logText(LogLevel level, const char* msg);
+void logFormat(LogLevel level, const char* format, ...);
+
+#define LOG_INLINE inline __attribute__((always_inline))
+
+LOG_INLINE bool logEnabled(LogLevel level) {
+    return level <= LOG_LEVEL && level <= currentLogLevel;
+}
+
+LOG_INLINE void logEvent(LogLevel level, const char* msg) {
+    if (level == LOG_ERROR || level == LOG_WARN) recordEvent(EVENT_LOG, level, (uint32_t)(uintptr_t)msg);
+}
+
+LOG_INLINE void log(LogLevel level, const char* msg) {
+    logEvent(level, msg);
+    if (logEnabled(level)) logText(level, msg);
+}
+
+LOG_INLINE void log(LogLevel level, const String& msg) {
+    logEvent(level, nullptr);
+    if (logEnabled(level)) logText(level, msg.c_str());
+}
+
+template <typename... Args>
+LOG_INLINE void logf(LogLevel level, const char* format, Args... args) {
+    logEvent(level, format);
+    if (logEnabled(level)) logFormat(level, format, args...);
+}
+
 void logWithTimestamp(LogLevel level, const String& msg);
 void printMAC(const uint8_t *mac, LogLevel level);
 void blinkLED(uint8_t pin, int times, int delayMs);
@@ -31,37 +70,25 @@ void printNetworkStatus();
 void printAmpChannelStatus();
 void printPairingStatus();
 
-// Enhanced serial command handling
+// Serial console: non-blocking line input and the command table (utils.cpp)
 void checkSerialCommands();
+void handleSerialCommand(const char* line);
 void printHelpMenu();
-void handleSerialCommand(const String& cmd);
-
-// Command handler helper functions (broken down from large functions)
-bool handleSystemCommands(const String& cmd);
-bool handleMIDICommands(const String& cmd);
-bool handleControlCommands(const String& cmd);
-bool handleTestCommands(const String& cmd);
-bool handleDebugCommands(const String& cmd);
-bool handleAmpChannelCommands(const String& cmd);
+void runCommandBenchmark();
 void handlePinCommand();
-void showUnknownCommand(const String& cmd);
-
-// Help menu helper functions
-void printHelpHeader();
-void printSystemCommandsHelp();
-void printMIDICommandsHelp();
-void printControlCommandsHelp();
-void printTestCommandsHelp();
-void printDebugCommandsHelp();
-void printAmpChannelCommandsHelp();
+void showUnknownCommand(const char* cmd);
+
+// Static help menu sections
 void printLogLevelsHelp();
 void printExamplesHelp();
 void printHelpFooter();
 
 // Utility functions - Memory optimized versions
-const char* getLogLevelString(LogLevel level);
-const char* getPairingStatusString(PairingStatus status);
+// pure: a compiled-out log call can drop these when used as arguments
+const char* getLogLevelString(LogLevel level) __attribute__((pure));
+const char* getPairingStatusString(PairingStatus status) __attribute__((pure));
 void getUptimeString(char* buffer, size_t bufferSize);
+void formatUptime(unsigned long uptime, char* buffer, size_t bufferSize);
 
 uint32_t getFreeHeap();
 uint32_t getMinFreeHeap();
@@ -72,5 +99,3 @@ void printClientConfiguration();
 // Pairing helper functions
 void resetPairingToDefaults();
 
-void setStatusLedPattern(StatusLedPattern pattern);
-void updateStatusLED();
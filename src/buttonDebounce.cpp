@@ -0,0 +1,155 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <Arduino.h>
+#include "buttonDebounce.h"
+#include "globals.h"
+#include "utils.h"
+#include "nvsManager.h"
+
+ButtonBounceStats buttonBounce[NUM_BUTTONS] = {};
+
+// Window values last written to NVS, used to avoid needless flash writes
+static uint32_t savedWindowUs[NUM_BUTTONS] = {0};
+static unsigned long lastDebounceSave = 0;
+
+static const uint32_t minWindowUs = (uint32_t)BUTTON_DEBOUNCE_MIN_MS * 1000UL;
+static const uint32_t maxWindowUs = (uint32_t)BUTTON_DEBOUNCE_MAX_MS * 1000UL;
+
+static uint32_t clampWindow(uint32_t windowUs) {
+    if (windowUs < minWindowUs) return minWindowUs;
+    if (windowUs > maxWindowUs) return maxWindowUs;
+    return windowUs;
+}
+
+void initButtonDebounce() {
+    uint32_t stored[NUM_BUTTONS];
+    bool loaded = loadButtonDebounceFromNVS(stored);
+
+    for (int i = 0; i < NUM_BUTTONS; i++) {
+        ButtonBounceStats& b = buttonBounce[i];
+        memset(&b, 0, sizeof(b));
+        b.windowUs = clampWindow(loaded ? stored[i] : (uint32_t)BUTTON_DEBOUNCE_MS * 1000UL);
+        // Seed the peak so the stored window is kept until new bursts are measured
+        if (b.windowUs > BUTTON_BOUNCE_MARGIN_US) {
+            b.peakBounceUs = (b.windowUs - BUTTON_BOUNCE_MARGIN_US) * 2 / 3;
+        }
+        savedWindowUs[i] = b.windowUs;
+    }
+    logf(LOG_DEBUG, "Button debounce initialized (%s, window %u-%ums)",
+         loaded ? "from NVS" : "defaults", BUTTON_DEBOUNCE_MIN_MS, BUTTON_DEBOUNCE_MAX_MS);
+}
+
+// Called on every raw level change seen by the button scanner
+void recordButtonEdge(int buttonIndex, unsigned long nowUs) {
+    ButtonBounceStats& b = buttonBounce[buttonIndex];
+    if (!b.burstOpen) {
+        b.burstOpen = true;
+        b.burstStartUs = nowUs;
+        b.burstEdges = 0;
+        b.acceptedInBurst = 0;
+    }
+    if (b.burstEdges < UINT16_MAX) {
+        b.burstEdges++;
+    }
+    b.lastEdgeUs = nowUs;
+}
+
+// Called when the debounced state machine accepts a press or release
+void recordButtonTransition(int buttonIndex) {
+    ButtonBounceStats& b = buttonBounce[buttonIndex];
+    if (b.burstOpen && b.acceptedInBurst < UINT8_MAX) {
+        b.acceptedInBurst++;
+    }
+}
+
+// Close the burst once the contacts have been quiet long enough and adapt the window
+void updateButtonBounce(int buttonIndex, unsigned long nowUs) {
+    ButtonBounceStats& b = buttonBounce[buttonIndex];
+    if (!b.burstOpen || (nowUs - b.lastEdgeUs) < (unsigned long)BUTTON_BOUNCE_GAP_MS * 1000UL) {
+        return;
+    }
+    b.burstOpen = false;
+
+    uint32_t bounceUs = b.lastEdgeUs - b.burstStartUs;
+    b.lastBounceUs = bounceUs;
+    b.lastEdgeCount = b.burstEdges;
+    b.bursts++;
+    if (bounceUs > b.maxBounceUs) {
+        b.maxBounceUs = bounceUs;
+    }
+    if (b.bursts == 1) {
+        b.avgBounceUs = bounceUs;
+    } else {
+        b.avgBounceUs = (uint32_t)((int32_t)b.avgBounceUs + ((int32_t)bounceUs - (int32_t)b.avgBounceUs) / 8);
+    }
+
+    // Peak rises immediately and decays over a few dozen presses, so one long
+    // bounce widens the window at once while a healthy switch narrows it slowly
+    b.peakBounceUs -= b.peakBounceUs / 16;
+    if (bounceUs > b.peakBounceUs) {
+        b.peakBounceUs = bounceUs;
+    }
+
+    uint32_t target = b.peakBounceUs + b.peakBounceUs / 2 + BUTTON_BOUNCE_MARGIN_US;
+
+    // More than one accepted transition within a single burst means the window
+    // let a bounce through - back off hard
+    if (b.acceptedInBurst > 1) {
+        b.glitches++;
+        if (target < b.windowUs * 2) {
+            target = b.windowUs * 2;
+        }
+        logf(LOG_DEBUG, "Button %d bounce glitch (%u edges over %luus), widening debounce",
+             buttonIndex + 1, b.lastEdgeCount, (unsigned long)bounceUs);
+    }
+
+    b.windowUs = clampWindow(target);
+}
+
+void saveButtonDebounceIfChanged() {
+    if (millis() - lastDebounceSave < BUTTON_DEBOUNCE_SAVE_INTERVAL_MS) {
+        return;
+    }
+
+    bool changed = false;
+    uint32_t windows[NUM_BUTTONS];
+    for (int i = 0; i < NUM_BUTTONS; i++) {
+        windows[i] = buttonBounce[i].windowUs;
+        uint32_t diff = windows[i] > savedWindowUs[i] ? windows[i] - savedWindowUs[i]
+                                                      : savedWindowUs[i] - windows[i];
+        if (diff >= 1000) { // Only persist changes of 1ms or more
+            changed = true;
+        }
+    }
+    if (!changed) return;
+
+    lastDebounceSave = millis();
+    saveButtonDebounceToNVS(windows);
+    memcpy(savedWindowUs, windows, sizeof(savedWindowUs));
+}
+
+void printButtonDebounceStats() {
+    log(LOG_INFO, "Button Debounce Statistics:");
+    logf(LOG_INFO, "  Window Bounds: %u-%ums (default %ums)",
+         BUTTON_DEBOUNCE_MIN_MS, BUTTON_DEBOUNCE_MAX_MS, BUTTON_DEBOUNCE_MS);
+    for (int i = 0; i < NUM_BUTTONS; i++) {
+        const ButtonBounceStats& b = buttonBounce[i];
+        logf(LOG_INFO, "  Button %d: window %.1fms", i + 1, b.windowUs / 1000.0f);
+        logf(LOG_INFO, "    Last Bounce: %luus (%u edges)", (unsigned long)b.lastBounceUs, b.lastEdgeCount);
+        logf(LOG_INFO, "    Avg/Peak/Max Bounce: %lu/%lu/%luus",
+             (unsigned long)b.avgBounceUs, (unsigned long)b.peakBounceUs, (unsigned long)b.maxBounceUs);
+        logf(LOG_INFO, "    Bursts: %lu, Glitches: %lu", (unsigned long)b.bursts, (unsigned long)b.glitches);
+    }
+}
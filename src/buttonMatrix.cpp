@@ -0,0 +1,139 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <Arduino.h>
+#include "buttonMatrix.h"
+#include "config.h"
+#include "utils.h"
+
+#if HAS_BUTTON_MATRIX
+#include <esp_timer.h>
+#include <soc/gpio_reg.h>
+
+volatile uint32_t buttonMatrixState = 0;
+ButtonMatrixStats buttonMatrixStats = {0};
+
+static uint32_t matrixRowMasks[BUTTON_MATRIX_ROWS];
+static uint32_t matrixColMasks[BUTTON_MATRIX_COLS];
+static esp_timer_handle_t matrixTimer = nullptr;
+
+// Without per-key diodes, three pressed corners of a rectangle make the fourth
+// corner read as pressed too. Any two rows sharing two or more pressed columns
+// are ambiguous; those keys keep their previous state until the pattern clears.
+static uint32_t findGhostCandidates(const uint16_t* rowBits) {
+    uint32_t ambiguous = 0;
+#if !BUTTON_MATRIX_DIODES
+    for (int r1 = 0; r1 < BUTTON_MATRIX_ROWS; r1++) {
+        if (rowBits[r1] == 0) continue;
+        for (int r2 = r1 + 1; r2 < BUTTON_MATRIX_ROWS; r2++) {
+            uint16_t common = rowBits[r1] & rowBits[r2];
+            if (__builtin_popcount(common) < 2) continue;
+            for (int c = 0; c < BUTTON_MATRIX_COLS; c++) {
+                if (common & (1U << c)) {
+                    ambiguous |= 1UL << (r1 * BUTTON_MATRIX_COLS + c);
+                    ambiguous |= 1UL << (r2 * BUTTON_MATRIX_COLS + c);
+                }
+            }
+        }
+    }
+#endif
+    return ambiguous;
+}
+
+// Timer callback - runs in the esp_timer task, never in loop()
+static void scanButtonMatrix(void* arg) {
+    int64_t scanStart = esp_timer_get_time();
+    uint16_t rowBits[BUTTON_MATRIX_ROWS];
+    uint32_t pressed = 0;
+
+    for (int r = 0; r < BUTTON_MATRIX_ROWS; r++) {
+        REG_WRITE(GPIO_OUT_W1TC_REG, matrixRowMasks[r]); // Drive row low
+        delayMicroseconds(BUTTON_MATRIX_SETTLE_US);
+        uint32_t inputs = REG_READ(GPIO_IN_REG);
+        REG_WRITE(GPIO_OUT_W1TS_REG, matrixRowMasks[r]); // Release row (open drain)
+
+        rowBits[r] = 0;
+        for (int c = 0; c < BUTTON_MATRIX_COLS; c++) {
+            if (!(inputs & matrixColMasks[c])) { // Pulled-up column reads low when pressed
+                rowBits[r] |= 1U << c;
+                pressed |= 1UL << (r * BUTTON_MATRIX_COLS + c);
+            }
+        }
+    }
+
+    uint32_t ambiguous = findGhostCandidates(rowBits);
+    if (ambiguous) {
+        pressed = (pressed & ~ambiguous) | (buttonMatrixState & ambiguous);
+        buttonMatrixStats.ghostScans++;
+    }
+    buttonMatrixState = pressed;
+
+    buttonMatrixStats.scans++;
+    uint32_t scanUs = (uint32_t)(esp_timer_get_time() - scanStart);
+    if (scanUs > buttonMatrixStats.maxScanUs) {
+        buttonMatrixStats.maxScanUs = scanUs;
+    }
+}
+
+void initButtonMatrix() {
+    // matrixRowPins / matrixColPins are constexpr, see pinConfig.h
+    for (int r = 0; r < BUTTON_MATRIX_ROWS; r++) {
+        pinMode(matrixRowPins[r], OUTPUT_OPEN_DRAIN);
+        digitalWrite(matrixRowPins[r], HIGH); // Idle released
+        matrixRowMasks[r] = 1UL << matrixRowPins[r];
+    }
+    for (int c = 0; c < BUTTON_MATRIX_COLS; c++) {
+        pinMode(matrixColPins[c], INPUT_PULLUP);
+        matrixColMasks[c] = 1UL << matrixColPins[c];
+    }
+
+    // Populate the state once so the boot-time OTA button check sees real levels
+    scanButtonMatrix(nullptr);
+
+    const esp_timer_create_args_t timerArgs = {
+        .callback = &scanButtonMatrix,
+        .arg = nullptr,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "btn_matrix",
+        .skip_unhandled_events = true
+    };
+    if (esp_timer_create(&timerArgs, &matrixTimer) != ESP_OK ||
+        esp_timer_start_periodic(matrixTimer, BUTTON_MATRIX_SCAN_US) != ESP_OK) {
+        log(LOG_ERROR, "Failed to start button matrix scan timer");
+        return;
+    }
+    logf(LOG_INFO, "Button matrix %dx%d scanning every %uus", BUTTON_MATRIX_ROWS, BUTTON_MATRIX_COLS,
+         BUTTON_MATRIX_SCAN_US);
+}
+
+void printButtonMatrixStatus() {
+    log(LOG_INFO, "Button Matrix:");
+    logf(LOG_INFO, "  Size: %d rows x %d cols (%d keys)", BUTTON_MATRIX_ROWS, BUTTON_MATRIX_COLS, NUM_BUTTONS);
+    logf(LOG_INFO, "  Scan Period: %uus, Diodes: %s", BUTTON_MATRIX_SCAN_US, BUTTON_MATRIX_DIODES ? "YES" : "NO");
+    logf(LOG_INFO, "  Pressed Mask: 0x%08lX", (unsigned long)buttonMatrixState);
+    logf(LOG_INFO, "  Scans: %lu, Ghost Holds: %lu, Max Scan: %luus",
+         (unsigned long)buttonMatrixStats.scans, (unsigned long)buttonMatrixStats.ghostScans,
+         (unsigned long)buttonMatrixStats.maxScanUs);
+}
+
+#else
+
+void initButtonMatrix() {
+}
+
+void printButtonMatrixStatus() {
+    log(LOG_INFO, "Button Matrix: Disabled (direct button pins)");
+}
+
+#endif
@@ -0,0 +1,255 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+#include <Arduino.h>
+#include "commandCoalescer.h"
+#include "commandHandler.h"
+#include "globals.h"
+#include "relayGroups.h"
+#include "metrics.h"
+#include "utils.h"
+
+#if COMMAND_COALESCE_MS > 0
+
+// Bursts are tracked per relay group, so commands for different groups
+// (one Program Change selecting a channel on two amps) never delay each other
+struct GroupBurst {
+    bool open;
+    bool pending;
+    uint32_t target;          // Pending outputs of this group
+    uint32_t applied;         // Group outputs as the coalescer last left them
+    unsigned long startMs;
+    unsigned long lastMs;
+    unsigned long deferredSinceMs;
+};
+
+// Commands arrive from the ESP-NOW receive callback (WiFi task) and MIDI
+// (loop), and the loop settles bursts: all state below, metrics included, is
+// under coalesceMux. Relays are switched outside it.
+static portMUX_TYPE coalesceMux = portMUX_INITIALIZER_UNLOCKED;
+static GroupBurst bursts[RELAY_GROUP_COUNT];
+static uint32_t naiveOutputs = 0;     // Where every command applied directly would be
+// Set with the first burst, cleared once all are settled: lets the loop's
+// per-pass poll skip the critical section while nothing is open. A burst
+// opened just after the check is seen on the next pass.
+static volatile bool burstsOpen = false;
+
+static MetricCounter commandsSeen("coalesce_commands_total", "Channel commands seen by the coalescer");
+static MetricCounter commandsDeferred("coalesce_deferred_total", "Commands folded into a pending burst");
+static MetricCounter naiveOperations("coalesce_uncoalesced_ops_total",
+                                     "Relay changes the commands would have made one by one");
+static MetricCounter relayOperations("coalesce_relay_ops_total", "Relay changes the coalescer made");
+static MetricGauge lastAddedLatencyMs("coalesce_latency_last_ms", "Delay added to the last settled burst");
+static MetricGauge maxAddedLatencyMs("coalesce_latency_max_ms", "Largest delay added to a settled burst");
+
+// Caller holds coalesceMux
+static void markApplied(uint32_t groups) {
+    for (uint8_t g = 0; g < RELAY_GROUP_COUNT; g++) {
+        if (groups & (1UL << g)) {
+            bursts[g].applied = ampOutputs & relayGroupOutputs[g];
+        }
+    }
+}
+
+// Outputs with every pending group target applied; caller holds coalesceMux
+static uint32_t coalescedOutputs() {
+    uint32_t outputs = ampOutputs;
+    for (uint8_t g = 0; g < RELAY_GROUP_COUNT; g++) {
+        if (bursts[g].pending) {
+            outputs = (outputs & ~relayGroupOutputs[g]) | bursts[g].target;
+        }
+    }
+    return outputs;
+}
+
+void coalesceAmpChannel(uint8_t channel) {
+    if (channel > MAX_AMPSWITCHS) {
+        setAmpChannel(channel); // Let the driver reject it
+        return;
+    }
+    unsigned long now = millis();
+    uint32_t groups = channel ? (1UL << relayOutputGroup[channel - 1]) : ((1UL << RELAY_GROUP_COUNT) - 1);
+    uint32_t immediate = 0;
+    uint32_t immediateOutputs = 0;
+
+    portENTER_CRITICAL(&coalesceMux);
+    commandsSeen.inc();
+    uint32_t naiveNext = nextAmpOutputs(naiveOutputs, channel);
+    if (naiveNext != naiveOutputs) {
+        naiveOperations.inc();
+        naiveOutputs = naiveNext;
+    }
+
+    for (uint8_t g = 0; g < RELAY_GROUP_COUNT; g++) {
+        if (!(groups & (1UL << g))) continue;
+        GroupBurst& burst = bursts[g];
+        if (!burst.open) {
+            // Quiet group: nothing to collapse with, act now
+            burst.open = true;
+            burstsOpen = true;
+            burst.pending = false;
+            burst.startMs = now;
+            burst.lastMs = now;
+            immediate |= 1UL << g;
+            immediateOutputs |= relayGroupOutputs[g];
+            continue;
+        }
+        if (!burst.pending) {
+            burst.pending = true;
+            burst.target = ampOutputs & relayGroupOutputs[g];
+            burst.deferredSinceMs = now;
+        }
+        burst.target = nextAmpOutputs(burst.target, channel) & relayGroupOutputs[g];
+        burst.lastMs = now;
+        commandsDeferred.inc();
+    }
+    portEXIT_CRITICAL(&coalesceMux);
+
+    if (!immediate) return;
+    uint32_t before = ampOutputs;
+    if (immediate == groups) {
+        setAmpChannel(channel); // Constant-time switching path
+    } else {
+        // All-off reaching only some groups
+        setAmpOutputs((ampOutputs & ~immediateOutputs) | (nextAmpOutputs(ampOutputs, channel) & immediateOutputs));
+    }
+    portENTER_CRITICAL(&coalesceMux);
+    if (ampOutputs != before) {
+        relayOperations.inc();
+    }
+    markApplied(immediate);
+    portEXIT_CRITICAL(&coalesceMux);
+}
+
+uint8_t getCoalescedAmpChannel() {
+    portENTER_CRITICAL(&coalesceMux);
+    uint32_t outputs = coalescedOutputs();
+    portEXIT_CRITICAL(&coalesceMux);
+    return ampChannelFromOutputs(outputs);
+}
+
+void pollCommandCoalescer() {
+    if (!burstsOpen) return;
+    unsigned long now = millis();
+    uint32_t settleMask = 0;
+    uint32_t settleOutputs = 0;
+    uint32_t settledGroups = 0;
+    bool anyOpen = false;
+
+    portENTER_CRITICAL(&coalesceMux);
+    for (uint8_t g = 0; g < RELAY_GROUP_COUNT; g++) {
+        GroupBurst& burst = bursts[g];
+        if (!burst.open) continue;
+        bool quiet = now - burst.lastMs >= COMMAND_COALESCE_MS;
+        bool overdue = now - burst.startMs >= COMMAND_COALESCE_MAX_MS;
+        if (!quiet && !overdue) {
+            anyOpen = true;
+            continue;
+        }
+
+        if (burst.pending) {
+            // Something else (button, scene) switched this group meanwhile: it wins
+            uint32_t groupMask = relayGroupOutputs[g];
+            if ((ampOutputs & groupMask) == burst.applied && burst.target != burst.applied) {
+                settleMask |= groupMask;
+                settleOutputs |= burst.target;
+                settledGroups |= 1UL << g;
+                uint32_t latency = now - burst.deferredSinceMs;
+                lastAddedLatencyMs.set(latency);
+                if (latency > maxAddedLatencyMs.value) {
+                    maxAddedLatencyMs.set(latency);
+                }
+            }
+            burst.pending = false;
+        }
+
+        if (quiet) {
+            burst.open = false;
+        } else {
+            // A burst that never goes quiet settles every COMMAND_COALESCE_MAX_MS
+            burst.startMs = now;
+            anyOpen = true;
+        }
+    }
+
+    portEXIT_CRITICAL(&coalesceMux);
+
+    if (settleMask) {
+        setAmpOutputs((ampOutputs & ~settleMask) | settleOutputs);
+    }
+    portENTER_CRITICAL(&coalesceMux);
+    if (settleMask) {
+        relayOperations.inc();
+        markApplied(settledGroups);
+    }
+    if (!anyOpen) {
+        naiveOutputs = ampOutputs;
+        burstsOpen = false;
+    }
+    portEXIT_CRITICAL(&coalesceMux);
+}
+
+void printCommandCoalescerStatus() {
+    // Snapshot first: logging may block, which a critical section must not
+    portENTER_CRITICAL(&coalesceMux);
+    uint32_t seen = commandsSeen.value;
+    uint32_t deferred = commandsDeferred.value;
+    uint32_t operations = relayOperations.value;
+    uint32_t naive = naiveOperations.value;
+    uint32_t lastLatency = lastAddedLatencyMs.value;
+    uint32_t maxLatency = maxAddedLatencyMs.value;
+    uint32_t pendingGroups = 0;
+    uint32_t pendingTargets[RELAY_GROUP_COUNT];
+    for (uint8_t g = 0; g < RELAY_GROUP_COUNT; g++) {
+        pendingTargets[g] = bursts[g].target;
+        if (bursts[g].pending) pendingGroups |= 1UL << g;
+    }
+    portEXIT_CRITICAL(&coalesceMux);
+
+    log(LOG_INFO, "=== COMMAND COALESCING ===");
+    logf(LOG_INFO, "  Window: %ums (max hold %ums)", COMMAND_COALESCE_MS, COMMAND_COALESCE_MAX_MS);
+    logf(LOG_INFO, "  Commands: %lu, deferred: %lu",
+         (unsigned long)seen, (unsigned long)deferred);
+    logf(LOG_INFO, "  Relay operations: %lu (uncoalesced: %lu, saved: %lu)",
+         (unsigned long)operations, (unsigned long)naive,
+         (unsigned long)(naive > operations ? naive - operations : 0));
+    logf(LOG_INFO, "  Added latency: last %lums, max %lums",
+         (unsigned long)lastLatency, (unsigned long)maxLatency);
+    for (uint8_t g = 0; g < RELAY_GROUP_COUNT; g++) {
+        if (pendingGroups & (1UL << g)) {
+            logf(LOG_INFO, "  Group %u pending: outputs 0x%lX", g + 1, (unsigned long)pendingTargets[g]);
+        }
+    }
+    log(LOG_INFO, "==========================");
+}
+
+#else
+
+void coalesceAmpChannel(uint8_t channel) {
+    setAmpChannel(channel);
+}
+
+uint8_t getCoalescedAmpChannel() {
+    return currentAmpChannel;
+}
+
+void pollCommandCoalescer() {
+}
+
+void printCommandCoalescerStatus() {
+    log(LOG_INFO, "Command coalescing: Disabled (COMMAND_COALESCE_MS=0)");
+}
+
+#endif
@@ -17,12 +17,19 @@
 #include "pairing.h"
 #include "globals.h"
 #include "espnow-pairing.h"
+#include "espnow.h"
 #include "utils.h"
 #include "nvsManager.h"
-// Include for fast GPIO register access
-#ifdef FAST_SWITCHING
-#include <soc/gpio_reg.h>
-#include <soc/io_mux_reg.h>
+#include "buttonDebounce.h"
+#include "buttonMatrix.h"
+#include "relayDriver.h"
+#include "switchDriver.h"
+#include "scenes.h"
+#include "commandCoalescer.h"
+#include "relayGroups.h"
+
+#if MAX_AMPSWITCHS > 1
+static bool applyMappedProgram(uint8_t program);
 #endif
 
 unsigned long midiLearnStartTime = 0;
@@ -47,45 +54,10 @@ static uint8_t tempMidiChannel = 1;
 static unsigned long channelSelectStart = 0;
 static unsigned long lastChannelButtonPress = 0;
 
-// Channel confirmation variables for non-blocking LED feedback
-static bool showingChannelConfirmation = false;
-static uint8_t confirmationChannel = 0;
-static uint8_t confirmationFlashCount = 0;
-static unsigned long lastConfirmationFlash = 0;
-static bool confirmationLedState = false;
-
-// Function to start non-blocking channel confirmation
+// Flash the selected channel number once channel select mode ends
 void showChannelConfirmation(uint8_t channel) {
-    showingChannelConfirmation = true;
-    confirmationChannel = channel;
-    confirmationFlashCount = 0;
-    lastConfirmationFlash = millis();
-    confirmationLedState = false;
-    setStatusLedPattern(LED_OFF); // Start with LED off
-}
-
-// Function to handle non-blocking channel confirmation LED flashing
-void updateChannelConfirmation() {
-    if (!showingChannelConfirmation) return;
-    
-    unsigned long now = millis();
-    
-    if (confirmationFlashCount < confirmationChannel * 2) { // *2 because we flash on and off
-        if (now - lastConfirmationFlash >= 200) { // 200ms intervals
-            confirmationLedState = !confirmationLedState;
-            if (confirmationLedState) {
-                setStatusLedPattern(LED_SINGLE_FLASH);
-            } else {
-                setStatusLedPattern(LED_OFF);
-            }
-            confirmationFlashCount++;
-            lastConfirmationFlash = now;
-        }
-    } else {
-        // Finished flashing, return to normal operation
-        showingChannelConfirmation = false;
-        setStatusLedPattern(LED_OFF); // Return to normal operation (LED off)
-    }
+    setStatusLedPattern(LED_OFF); // Leave the channel select fade
+    queueStatusLedFlashes(channel, LED_PRIORITY_CONFIRM);
 }
 
 // Shared function to reset milestone flags
@@ -158,7 +130,6 @@ void handleChannelSelectAutoSave() {
         logf(LOG_INFO, "Channel %u selected and saved", currentMidiChannel);
         
         // Non-blocking LED feedback showing the selected channel number
-        // This will be handled by a separate function to avoid blocking
         showChannelConfirmation(currentMidiChannel);
     }
 }
@@ -166,7 +137,7 @@ void handleChannelSelectAutoSave() {
 // Forward declarations for button handler helper functions
 bool handleMidiLearnTimeout();
 void processButtonState(int buttonIndex, uint8_t reading, 
-                       unsigned long* lastDebounceTime, uint8_t* lastButtonState,
+                       unsigned long* lastTransitionUs, uint8_t* lastButtonState,
                        bool* buttonPressed, unsigned long* buttonPressStart,
                        bool* buttonLongPressHandled);
 void handleButtonPress(int buttonIndex, bool* buttonPressed, unsigned long* buttonPressStart,
@@ -181,44 +152,44 @@ void checkAmpChannelButtons() {
         return;
     }
     
-    static unsigned long lastDebounceTime[MAX_AMPSWITCHS] = {0};
-    static uint8_t lastButtonState[MAX_AMPSWITCHS] = {HIGH};
-    static bool buttonPressed[MAX_AMPSWITCHS] = {false};
-    static unsigned long buttonPressStart[MAX_AMPSWITCHS] = {0};
-    static bool buttonLongPressHandled[MAX_AMPSWITCHS] = {false};
+    static unsigned long lastTransitionUs[NUM_BUTTONS] = {0}; // micros() of last accepted press/release
+    static uint8_t lastButtonState[NUM_BUTTONS] = {HIGH};
+    static bool buttonPressed[NUM_BUTTONS] = {false};
+    static unsigned long buttonPressStart[NUM_BUTTONS] = {0};
+    static bool buttonLongPressHandled[NUM_BUTTONS] = {false};
 
     // Block all button actions during MIDI Learn lockout
     if (handleMidiLearnTimeout()) {
         // Handle timeout and reset button states
-        for (int i = 0; i < MAX_AMPSWITCHS; i++) {
+        for (int i = 0; i < NUM_BUTTONS; i++) {
             buttonLongPressHandled[i] = true; // Mark as handled to prevent further actions
         }
         return;
     }
 
     // Unified button processing for all buttons with bounds checking
-    for (int i = 0; i < MAX_AMPSWITCHS; i++) {
+    for (int i = 0; i < NUM_BUTTONS; i++) {
         // Validate array index bounds
-        if (i < 0 || i >= MAX_AMPSWITCHS) {
+        if (i < 0 || i >= NUM_BUTTONS) {
             logf(LOG_ERROR, "Button index out of bounds: %d", i);
             break;
         }
         
+        #if !HAS_BUTTON_MATRIX
         // Validate pin configuration
         if (ampButtonPins[i] < 0 || ampButtonPins[i] > 255) {
             logf(LOG_ERROR, "Invalid button pin %d at index %d", ampButtonPins[i], i);
             continue;
         }
+        #endif
         
-        uint8_t reading = digitalRead(ampButtonPins[i]);
+        // Direct GPIO or the latest matrix scan, same LOW = pressed sense
+        uint8_t reading = readButtonLevel(i);
         
-        processButtonState(i, reading, lastDebounceTime, lastButtonState,
+        processButtonState(i, reading, lastTransitionUs, lastButtonState,
                           buttonPressed, buttonPressStart, buttonLongPressHandled);
     }
     
-    // Update non-blocking channel confirmation LED feedback
-    updateChannelConfirmation();
-    
     // Shared auto-save logic
     handleChannelSelectAutoSave();
 }
@@ -240,33 +211,45 @@ bool handleMidiLearnTimeout() {
 }
 
 void processButtonState(int buttonIndex, uint8_t reading, 
-                       unsigned long* lastDebounceTime, uint8_t* lastButtonState,
+                       unsigned long* lastTransitionUs, uint8_t* lastButtonState,
                        bool* buttonPressed, unsigned long* buttonPressStart,
                        bool* buttonLongPressHandled) {
-    const unsigned long debounceDelay = BUTTON_DEBOUNCE_MS;
+    // Adaptive per-button debounce window (microseconds), see buttonDebounce.cpp
+    const unsigned long debounceDelay = getButtonDebounceUs(buttonIndex);
+    unsigned long nowUs = micros();
     
-    // Debounce check
+    // Every raw edge feeds the bounce measurement
     if (reading != lastButtonState[buttonIndex]) {
-        lastDebounceTime[buttonIndex] = millis();
-    }
-    
-    if ((millis() - lastDebounceTime[buttonIndex]) > debounceDelay) {
-        // Button pressed
-        if (reading == LOW && !buttonPressed[buttonIndex]) {
-            handleButtonPress(buttonIndex, buttonPressed, buttonPressStart, buttonLongPressHandled);
-        }
-        // Button held
-        else if (reading == LOW && buttonPressed[buttonIndex]) {
-            unsigned long held = millis() - buttonPressStart[buttonIndex];
-            handleButtonHeld(buttonIndex, held);
-        }
-        // Button released
-        else if (reading == HIGH && buttonPressed[buttonIndex]) {
-            unsigned long held = millis() - buttonPressStart[buttonIndex];
-            handleButtonRelease(buttonIndex, held, buttonPressed, buttonLongPressHandled);
-        }
+        recordButtonEdge(buttonIndex, nowUs);
+    } else {
+        updateButtonBounce(buttonIndex, nowUs);
     }
     lastButtonState[buttonIndex] = reading;
+
+    // Leading edge: the first edge of a press or release is acted on at once,
+    // then the window locks the button out while the contacts bounce
+    bool locked = (nowUs - lastTransitionUs[buttonIndex]) <= debounceDelay;
+
+    // Button pressed
+    if (reading == LOW && !buttonPressed[buttonIndex]) {
+        if (locked) return;
+        lastTransitionUs[buttonIndex] = nowUs;
+        recordButtonTransition(buttonIndex);
+        handleButtonPress(buttonIndex, buttonPressed, buttonPressStart, buttonLongPressHandled);
+    }
+    // Button held
+    else if (reading == LOW && buttonPressed[buttonIndex]) {
+        unsigned long held = millis() - buttonPressStart[buttonIndex];
+        handleButtonHeld(buttonIndex, held);
+    }
+    // Button released
+    else if (reading == HIGH && buttonPressed[buttonIndex]) {
+        if (locked) return;
+        unsigned long held = millis() - buttonPressStart[buttonIndex];
+        lastTransitionUs[buttonIndex] = nowUs;
+        recordButtonTransition(buttonIndex);
+        handleButtonRelease(buttonIndex, held, buttonPressed, buttonLongPressHandled);
+    }
 }
 
 void handleButtonPress(int buttonIndex, bool* buttonPressed, unsigned long* buttonPressStart,
@@ -283,7 +266,7 @@ void handleButtonPress(int buttonIndex, bool* buttonPressed, unsigned long* butt
     
     // Multi-button MIDI Learn channel selection
     #if MAX_AMPSWITCHS > 1
-    if (midiLearnArmed) {
+    if (midiLearnArmed && buttonIndex < MAX_AMPSWITCHS) {
         midiLearnChannel = buttonIndex;
         midiLearnArmed = false;
         midiLearnStartTime = millis();
@@ -339,28 +322,30 @@ void handleButtonRelease(int buttonIndex, unsigned long held, bool* buttonPresse
             // Check cooldown period after MIDI Learn completion
             if (midiLearnCompleteTime > 0 && (millis() - midiLearnCompleteTime < MIDI_LEARN_COOLDOWN)) {
                 log(LOG_DEBUG, "Button press ignored during post-learn cooldown period");
+            } else if (buttonIndex >= MAX_AMPSWITCHS) {
+                // Footswitches beyond the relay channels recall scenes in order
+                uint8_t scene = buttonIndex - MAX_AMPSWITCHS + 1;
+                if (applyAmpScene(scene)) {
+                    logf(LOG_INFO, "Button %d: scene %u", buttonIndex + 1, scene);
+                } else {
+                    logf(LOG_DEBUG, "Button %d has no channel or scene assigned", buttonIndex + 1);
+                }
             } else if (!midiLearnArmed) {
                 #if MAX_AMPSWITCHS == 1
                 // Single button: toggle relay - FAST PATH
                 if (currentAmpChannel == 1) {
                     setAmpChannel(0);
                     // Defer logging to avoid button response delay
-                    #if LOG_LEVEL >= LOG_INFO
                     log(LOG_INFO, "Toggled relay OFF");
-                    #endif
                 } else {
                     setAmpChannel(1);
-                    #if LOG_LEVEL >= LOG_INFO
                     log(LOG_INFO, "Toggled relay ON");
-                    #endif
                 }
                 #else
                 // Multi-button: switch to specific channel
                 setAmpChannel(buttonIndex + 1);
-                #if LOG_LEVEL >= LOG_INFO
                 logf(LOG_INFO, "Button %d: channel %d", buttonIndex + 1, buttonIndex + 1);
                 #endif
-                #endif
             }
         }
     }
@@ -391,64 +376,89 @@ void handleCommand(uint8_t commandType, uint8_t value) {
             // Single channel device logic
             if (program == 0) {
                 log(LOG_INFO, "Remote: Program 0 -> all off");
-                setAmpChannel(0);
+                coalesceAmpChannel(0);
                 setStatusLedPattern(LED_DOUBLE_FLASH); // distinct off feedback
                 handled = true;
             } else if (program == midiChannelMap[0] || program == 1) {
                 // Learned program or legacy '1' acts as TOGGLE
-                if (currentAmpChannel == 1) {
+                if (getCoalescedAmpChannel() == 1) {
                     logf(LOG_INFO, "Remote: Program %u -> toggle OFF", program);
-                    setAmpChannel(0);
+                    coalesceAmpChannel(0);
                     setStatusLedPattern(LED_DOUBLE_FLASH);
                 } else {
                     logf(LOG_INFO, "Remote: Program %u -> toggle ON", program);
-                    setAmpChannel(1);
+                    coalesceAmpChannel(1);
                     setStatusLedPattern(LED_TRIPLE_FLASH);
                 }
                 handled = true;
             }
 #else
             // Multi-channel device: search mapping first
-            int mappedChannel = -1;
-            for (int i = 0; i < MAX_AMPSWITCHS; i++) {
-                if (midiChannelMap[i] == program) {
-                    mappedChannel = i + 1;
-                    break;
-                }
-            }
             if (program == 0) {
                 log(LOG_INFO, "Remote: Program 0 -> all off");
-                setAmpChannel(0);
+                coalesceAmpChannel(0);
                 setStatusLedPattern(LED_DOUBLE_FLASH);
                 handled = true;
-            } else if (mappedChannel != -1) {
-                logf(LOG_INFO, "Remote: Program %u mapped -> channel %d", program, mappedChannel);
-                setAmpChannel(mappedChannel);
+            } else if (applyMappedProgram(program)) {
+                logf(LOG_INFO, "Remote: Program %u mapped -> outputs 0x%lX", program, (unsigned long)ampOutputs);
                 setStatusLedPattern(LED_TRIPLE_FLASH);
                 handled = true;
             } else if (program >= 1 && program <= MAX_AMPSWITCHS) {
                 // Legacy direct mode (server sending raw channel number)
                 logf(LOG_INFO, "Remote: Direct channel select %u", program);
-                setAmpChannel(program);
+                coalesceAmpChannel(program);
                 setStatusLedPattern(LED_SINGLE_FLASH);
                 handled = true;
             }
 #endif
+            if (!handled) {
+                int scene = findSceneForProgram(program);
+                if (scene > 0) {
+                    logf(LOG_INFO, "Remote: Program %u mapped -> scene %d", program, scene);
+                    applyAmpScene(scene);
+                    setStatusLedPattern(LED_TRIPLE_FLASH);
+                    handled = true;
+                }
+            }
             if (!handled) {
                 logf(LOG_DEBUG, "Remote: Program %u has no mapping (ignored)", program);
             }
             break; }
+        case SCENE_SELECT:
+            if (value == 0) {
+                log(LOG_INFO, "Remote: scene 0 -> all off");
+                coalesceAmpChannel(0);
+                setStatusLedPattern(LED_DOUBLE_FLASH);
+            } else if (applyAmpScene(value)) {
+                logf(LOG_INFO, "Remote: scene %u", value);
+                setStatusLedPattern(LED_TRIPLE_FLASH);
+            } else {
+                logf(LOG_WARN, "Remote: invalid scene %u (max: %d)", value, MAX_SCENES);
+            }
+            break;
+        case GROUP_OFF:
+            if (value == 0) {
+                coalesceAmpChannel(0);
+                setStatusLedPattern(LED_DOUBLE_FLASH);
+            } else if (value <= RELAY_GROUP_COUNT) {
+                logf(LOG_INFO, "Remote: group %u off", value);
+                setAmpGroupOff(value);
+                setStatusLedPattern(LED_DOUBLE_FLASH);
+            } else {
+                logf(LOG_WARN, "Remote: invalid group %u (max: %u)", value, RELAY_GROUP_COUNT);
+            }
+            break;
         case RESERVED1:
             // Reserved / legacy - ignore silently
             break;
         case ALL_CHANNELS_OFF:
             log(LOG_INFO, "All channels off command received");
-            setAmpChannel(0);
+            coalesceAmpChannel(0);
             setStatusLedPattern(LED_DOUBLE_FLASH);
             break;
         case STATUS_REQUEST:
             logf(LOG_INFO, "Status request received - current channel: %u", currentAmpChannel);
-            // Could send back status if needed in the future
+            requestStatusReply(); // Dozens of frames: sent from the loop, paced
             setStatusLedPattern(LED_SINGLE_FLASH);
             break;
         default:
@@ -496,6 +506,7 @@ void handleProgramChange(byte midiChannel, byte program) {
             midiChannelMap[midiLearnChannel] = program;
             saveMidiMapToNVS();
             logf(LOG_INFO, "MIDI PC#%u assigned to channel 1", program);
+            setStatusLedPattern(LED_OFF); // Stop the learn blink
             setStatusLedPattern(LED_SINGLE_FLASH);
             midiLearnChannel = -1;
             midiLearnArmed = false;
@@ -515,18 +526,23 @@ void handleProgramChange(byte midiChannel, byte program) {
     
     // Validate array access before checking MIDI map
     if (0 < MAX_AMPSWITCHS && program == midiChannelMap[0]) {
-        // FAST MIDI switching - minimal logging
-        if (currentAmpChannel == 1) {
-            setAmpChannel(0);
+        // FAST MIDI switching - minimal logging. Resent PCs collapse into
+        // their net state instead of chattering the relay
+        if (getCoalescedAmpChannel() == 1) {
+            coalesceAmpChannel(0);
         } else {
-            setAmpChannel(1);
+            coalesceAmpChannel(1);
         }
         setStatusLedPattern(LED_TRIPLE_FLASH);
         
-        // Optional logging only if debug enabled
-        #if LOG_LEVEL >= LOG_INFO
+        // Compiled out when LOG_LEVEL is below INFO
         log(LOG_INFO, "MIDI PC: Toggled relay");
-        #endif
+    } else {
+        int scene = findSceneForProgram(program);
+        if (scene > 0) {
+            applyAmpScene(scene);
+            setStatusLedPattern(LED_TRIPLE_FLASH);
+        }
     }
     return;
 #else
@@ -537,6 +553,7 @@ void handleProgramChange(byte midiChannel, byte program) {
             log(LOG_WARN, "MIDI Learn timed out, exiting learn mode.");
             midiLearnArmed = false;
             midiLearnChannel = -1;
+            setStatusLedPattern(LED_OFF);
             return;
         }
         
@@ -544,6 +561,7 @@ void handleProgramChange(byte midiChannel, byte program) {
         midiChannelMap[midiLearnChannel] = program;
         saveMidiMapToNVS();
         logf(LOG_INFO, "MIDI PC#%u assigned to channel %d", program, midiLearnChannel + 1);
+        setStatusLedPattern(LED_OFF); // Stop the learn blink
         setStatusLedPattern(LED_SINGLE_FLASH);
         midiLearnChannel = -1;
         midiLearnCompleteTime = millis(); // Set cooldown time
@@ -557,126 +575,75 @@ void handleProgramChange(byte midiChannel, byte program) {
         return;
     }
     
-    // FAST MIDI switching for multi-channel - optimized loop
-    for (int i = 0; i < MAX_AMPSWITCHS; i++) {
-        if (midiChannelMap[i] == program) {
-            setAmpChannel(i + 1);
-            setStatusLedPattern(LED_TRIPLE_FLASH);
-            
-            // Optional logging only if debug enabled
-            #if LOG_LEVEL >= LOG_INFO
-            logf(LOG_INFO, "MIDI PC: Channel %d", i + 1);
-            #endif
-            return;
-        }
+    // FAST MIDI switching for multi-channel - one pass over the map
+    if (applyMappedProgram(program)) {
+        setStatusLedPattern(LED_TRIPLE_FLASH);
+        
+        // Compiled out when LOG_LEVEL is below INFO
+        logf(LOG_INFO, "MIDI PC: outputs 0x%lX", (unsigned long)ampOutputs);
+        return;
+    }
+    
+    // Scenes are checked after plain channels
+    int scene = findSceneForProgram(program);
+    if (scene > 0) {
+        applyAmpScene(scene);
+        setStatusLedPattern(LED_TRIPLE_FLASH);
+        return;
     }
     
     // No mapping found - minimal logging
-    #if LOG_LEVEL >= LOG_DEBUG
     logf(LOG_DEBUG, "MIDI PC#%u: No mapping", program);
-    #endif
 #endif
 }
 
-void setAmpChannel(uint8_t channel) {
-    // Ultra-fast path for single channel mode
-    #if MAX_AMPSWITCHS == 1 && defined(FAST_SWITCHING)
-    
-    if (channel > 1 || channel == currentAmpChannel) return;
-    
-    // Direct GPIO register access for maximum speed (ESP32-C3)
-    // Use ESP32-C3 specific GPIO registers
-    if (channel == 0) {
-        // Clear bit (LOW) - direct register write
-        REG_WRITE(GPIO_OUT_W1TC_REG, (1UL << ampSwitchPins[0]));
-        currentAmpChannel = 0;
-    } else {
-        // Set bit (HIGH) - direct register write
-        REG_WRITE(GPIO_OUT_W1TS_REG, (1UL << ampSwitchPins[0]));
-        currentAmpChannel = 1;
-    }
-    
-    // No logging in fast mode - adds ~500μs delay
-    
-    #elif MAX_AMPSWITCHS == 1
-    // Standard fast path
-    if (channel > 1) return;
-    if (channel == currentAmpChannel) return;
-    
-    if (channel == 0) {
-        digitalWrite(ampSwitchPins[0], LOW);
-        currentAmpChannel = 0;
-    } else {
-        digitalWrite(ampSwitchPins[0], HIGH);
-        currentAmpChannel = 1;
-    }
-    
-    #else
-    // Multi-channel mode - optimized for speed when FAST_SWITCHING enabled
-    #ifdef FAST_SWITCHING
-    // Ultra-fast multi-channel with direct register access
-    if (channel > MAX_AMPSWITCHS) return;
-    if (channel == currentAmpChannel) return;
-    
-    // Turn all channels OFF - direct register writes
-    for (int i = 0; i < MAX_AMPSWITCHS; i++) {
-        REG_WRITE(GPIO_OUT_W1TC_REG, (1UL << ampSwitchPins[i]));
-    }
-    
-    // Turn ON the requested channel (if valid)
-    if (channel >= 1 && channel <= MAX_AMPSWITCHS) {
-        int pinIndex = channel - 1;
-        REG_WRITE(GPIO_OUT_W1TS_REG, (1UL << ampSwitchPins[pinIndex]));
-        currentAmpChannel = channel;
-    } else if (channel == 0) {
-        currentAmpChannel = 0;
-    }
-    
-    // No logging in fast mode
-    
-    #else
-    // Standard multi-channel mode with full validation and logging
-    if (channel > MAX_AMPSWITCHS) {
-        logf(LOG_ERROR, "Invalid channel %u requested (max: %d)", channel, MAX_AMPSWITCHS);
-        return;
-    }
-    
-    if (channel == currentAmpChannel) {
-        logf(LOG_DEBUG, "Channel %u already active, ignoring", channel);
+// Scene recall by CC: value N recalls scene N, 0 turns everything off.
+// Controllers that send a CC per footswitch need no PC mapping at all.
+void handleControlChange(byte midiChannel, byte number, byte value) {
+#if SCENE_CC >= 0
+    if (midiChannel != currentMidiChannel || number != SCENE_CC) return;
+    if (value == 0) {
+        coalesceAmpChannel(0);
+    } else if (!applyAmpScene(value)) {
+        logf(LOG_DEBUG, "MIDI CC%u: no scene %u", number, value);
         return;
     }
+    setStatusLedPattern(LED_TRIPLE_FLASH);
+#endif
+}
 
-    logf(LOG_INFO, "Switching amp channel from %u to %u", currentAmpChannel, channel);
+void setAmpChannel(uint8_t channel) {
+    // Backend and logging policy are picked at compile time, see switchDriver.h
+    AmpSwitchDriver::set(channel);
+}
 
-    // Turn all channels OFF
-    for (int i = 0; i < MAX_AMPSWITCHS; i++) {
-        // Validate array bounds and pin values
-        if (i < 0 || i >= MAX_AMPSWITCHS) {
-            logf(LOG_ERROR, "Switch index out of bounds: %d", i);
-            break;
-        }
-        
-        if (ampSwitchPins[i] < 0 || ampSwitchPins[i] > 255) {
-            logf(LOG_ERROR, "Invalid switch pin %d at index %d", ampSwitchPins[i], i);
-            continue;
-        }
-        
-        digitalWrite(ampSwitchPins[i], LOW);
+void setAmpOutputs(uint32_t outputs) {
+    AmpSwitchDriver::setOutputs(outputs);
+}
+
+// Turn off every output of one group (1-based), leaving the others alone
+void setAmpGroupOff(uint8_t group) {
+    if (group == 0 || group > RELAY_GROUP_COUNT) {
+        return;
     }
+    setAmpOutputs(ampOutputs & ~relayGroupOutputs[group - 1]);
+}
 
-    // Turn ON the requested channel
-    if (channel >= 1 && channel <= MAX_AMPSWITCHS) {
-        int pinIndex = channel - 1;
-        digitalWrite(ampSwitchPins[pinIndex], HIGH);
-        currentAmpChannel = channel;
-        logf(LOG_INFO, "Amp channel %u activated", channel);
-    } else if (channel == 0) {
-        currentAmpChannel = 0;
-        log(LOG_INFO, "All amp channels turned off");
-    } else {
-        currentAmpChannel = 0; // None selected
-        logf(LOG_WARN, "Invalid channel number: %u (valid range: 0-%d)", channel, MAX_AMPSWITCHS);
+#if MAX_AMPSWITCHS > 1
+// Select every output mapped to a Program Change, at most one per group (the
+// first mapped output wins within a group). Returns false when none is mapped.
+static bool applyMappedProgram(uint8_t program) {
+    uint32_t groupsDone = 0;
+    bool matched = false;
+    for (int i = 0; i < MAX_AMPSWITCHS; i++) {
+        if (midiChannelMap[i] != program) continue;
+        uint32_t groupBit = 1UL << relayOutputGroup[i];
+        if (groupsDone & groupBit) continue;
+        groupsDone |= groupBit;
+        coalesceAmpChannel(i + 1);
+        matched = true;
+        if (RELAY_GROUP_COUNT == 1) break;
     }
-    #endif
-    #endif
-}
\ No newline at end of file
+    return matched;
+}
+#endif
\ No newline at end of file
@@ -15,30 +15,17 @@
 #include <Arduino.h>
 #include "config.h"
 #include "utils.h"
+#include "buttonMatrix.h"
+#include "relayDriver.h"
+#include "switchMute.h"
+#include "relayVerify.h"
+#include "relayStats.h"
 #include <cstring>
 
 // Global configuration variables
 ClientType currentClientType = CLIENT_TYPE_ENUM;
 
-// Pin arrays are defined in globals.cpp
-// These are just references to the existing arrays
-
-// Parse pin array from string (e.g., "4,5,6,7")
-uint8_t* parsePinArray(const char* pinString) {
-    static uint8_t pins[16]; // Max 16 pins
-    int pinCount = 0;
-    
-    char* str = strdup(pinString);
-    char* token = strtok(str, ",");
-    
-    while (token != NULL && pinCount < 16) {
-        pins[pinCount++] = atoi(token);
-        token = strtok(NULL, ",");
-    }
-    
-    free(str);
-    return pins;
-}
+// Pin arrays are constexpr, parsed and validated at compile time in pinConfig.h
 
 String getClientTypeString() {
     switch (currentClientType) {
@@ -85,8 +72,19 @@ void printClientConfiguration() {
             switchStrLen++;
         }
     }
+#if RELAY_OUTPUT_BACKEND == RELAY_BACKEND_SHIFT_REG
+    logf(LOG_INFO, "Relay Outputs: %d x 74HC595, data %u, clock %u, latch %u", SHIFT_REG_CHIPS,
+         SHIFT_REG_DATA_PIN, SHIFT_REG_CLOCK_PIN, SHIFT_REG_LATCH_PIN);
+#else
     logf(LOG_INFO, "Amp Switch Pins: %s", switchPinsStr);
+#endif
+    logf(LOG_INFO, "Relay Switch Order: %s, gap %uus", getRelaySwitchOrderString(), RELAY_SWITCH_GAP_US);
     
+#if HAS_BUTTON_MATRIX
+    logf(LOG_INFO, "Button Matrix: %dx%d, rows %s, cols %s", BUTTON_MATRIX_ROWS, BUTTON_MATRIX_COLS,
+         BUTTON_MATRIX_ROW_PINS, BUTTON_MATRIX_COL_PINS);
+#else
+
     // Print ampButtonPins as comma-separated string with bounds checking
     char buttonPinsStr[64] = "";
     size_t buttonStrLen = 0;
@@ -113,6 +111,7 @@ void printClientConfiguration() {
         }
     }
     logf(LOG_INFO, "Amp Button Pins: %s", buttonPinsStr);
+#endif
 #else
     log(LOG_INFO, "Amp Switching: Disabled");
 #endif
@@ -123,19 +122,36 @@ void initializeClientConfiguration() {
     log(LOG_INFO, "Initializing client configuration...");
     
 #if HAS_AMP_SWITCHING
-    // Parse and set amp switch pins from macro
-    uint8_t* switchPins = parsePinArray(AMP_SWITCH_PINS);
+#if RELAY_OUTPUT_BACKEND == RELAY_BACKEND_SHIFT_REG
+    // Relays hang off the shift register chain, AMP_SWITCH_PINS is unused
+    initShiftRegister();
+#else
     for (int i = 0; i < MAX_AMPSWITCHS; i++) {
-        ampSwitchPins[i] = switchPins[i];
+        pinMode(ampSwitchPins[i], OUTPUT);
+        digitalWrite(ampSwitchPins[i], LOW); // Ensure relays are off at boot
     }
-    uint8_t* buttonPins = parsePinArray(AMP_BUTTON_PINS);
+#endif
+#if HAS_BUTTON_MATRIX
+    initButtonMatrix();
+#else
     for (int i = 0; i < MAX_AMPSWITCHS; i++) {
-        ampButtonPins[i] = buttonPins[i];
         pinMode(ampButtonPins[i], INPUT_PULLUP);
-        pinMode(ampSwitchPins[i], OUTPUT);
-        digitalWrite(ampSwitchPins[i], LOW); // Ensure relays are off at boot
     }
+#endif
+    initRelayMasks();
+#if RELAY_DRIVE_MODE == RELAY_DRIVE_LEVEL && RELAY_OUTPUT_BACKEND == RELAY_BACKEND_GPIO
     digitalWrite(ampSwitchPins[0], HIGH);
+    // Start from the state the pins are in, so group masks, GROUP_OFF, sense
+    // checks and wear stats all see relay 1 as on
+    ampOutputs = 1;
+    currentAmpChannel = 1;
+    relayWearOutputs = 1;
+#elif RELAY_DRIVE_MODE != RELAY_DRIVE_LEVEL
+    // Pins are coil / input pulse lines here, never held high
+    initRelayPulseDriver();
+#endif
+    initSwitchMute();
+    initRelayVerify();
     log(LOG_DEBUG, "Amp switching pins initialized");
 #endif
     // Set device name from macro
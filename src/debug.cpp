@@ -13,17 +13,27 @@
 // limitations under the License.
 #include "debug.h"
 #include "utils.h"
+#include "buttonDebounce.h"
+#include "buttonMatrix.h"
+#include "relayDriver.h"
+#include "switchMute.h"
+#include "relayVerify.h"
+#include "statusLed.h"
+#include "commandCoalescer.h"
+#include "logBuffer.h"
+#include "logRateLimit.h"
+#include "serialCommands.h"
+#include "espnow.h"
 #include <esp_system.h>
 #include <esp_heap_caps.h>
 #include <esp_task_wdt.h>
 
-// Global performance metrics
-PerformanceMetrics perfMetrics = {0};
+MetricHistogram loopTimeUs("loop_time_us", "Main loop pass duration in microseconds");
+MetricGauge lastLoopTimeUs("loop_time_last_us", "Duration of the last main loop pass in microseconds");
 
-// Memory tracking
-uint32_t initialFreeHeap = 0;
-uint32_t lastFreeHeap = 0;
-unsigned long lastMemoryCheck = 0;
+// Memory tracking; the current and lowest free heap are gauges in utils.cpp
+static uint32_t initialFreeHeap = 0;
+static uint32_t lastFreeHeap = 0;
 
 void printDebugInfo() {
     log(LOG_INFO, "=== DEBUG INFORMATION ===");
@@ -35,16 +45,19 @@ void printDebugInfo() {
 }
 
 void printPerformanceMetrics() {
-    unsigned long uptime = millis() - perfMetrics.startTime;
-    float avgLoopTime = perfMetrics.loopCount > 0 ? (float)perfMetrics.totalLoopTime / perfMetrics.loopCount : 0;
+    uint32_t loopCount = loopTimeUs.value;
+    float avgLoopTime = loopCount > 0 ? (float)loopTimeUs.sum / loopCount : 0;
     
     log(LOG_INFO, "Performance Metrics:");
-    logf(LOG_INFO, "  Loop Count: %lu", perfMetrics.loopCount);
-    logf(LOG_INFO, "  Last Loop Time: %lums", perfMetrics.lastLoopTime);
-    logf(LOG_INFO, "  Max Loop Time: %lums", perfMetrics.maxLoopTime);
-    logf(LOG_INFO, "  Min Loop Time: %lums", perfMetrics.minLoopTime);
-    logf(LOG_INFO, "  Avg Loop Time: %.2fms", avgLoopTime);
-    logf(LOG_INFO, "  Uptime: %lums", uptime);
+    logf(LOG_INFO, "  Loop Count: %lu", (unsigned long)loopCount);
+    logf(LOG_INFO, "  Last Loop Time: %luus", (unsigned long)lastLoopTimeUs.value);
+    logf(LOG_INFO, "  Max Loop Time: %luus", (unsigned long)loopTimeUs.max);
+    logf(LOG_INFO, "  Min Loop Time: %luus", (unsigned long)(loopCount ? loopTimeUs.min : 0));
+    logf(LOG_INFO, "  Avg Loop Time: %.1fus", avgLoopTime);
+    printStatusLedStats();
+    printLogBufferStats();
+    printLogRateStats();
+    logf(LOG_INFO, "  Uptime: %lums", millis());
 }
 
 void printTaskStats() {
@@ -66,6 +79,10 @@ void printESPNowStats() {
     logf(LOG_INFO, "  Pairing Status: %s", getPairingStatusString(pairingStatus));
     log(LOG_INFO, "  Peers: 1");
     log(LOG_INFO, "  Max Peers: 20");
+    EspNowStats stats = getEspNowStats();
+    logf(LOG_INFO, "  Sent: %lu ok, %lu failed", (unsigned long)stats.sent, (unsigned long)stats.sendFailed);
+    logf(LOG_INFO, "  Received: %lu (%lu ignored unpaired, %lu unknown type)", (unsigned long)stats.received,
+         (unsigned long)stats.ignored, (unsigned long)stats.unknownType);
 }
 
 void updateMemoryStats() {
@@ -80,7 +97,6 @@ void updateMemoryStats() {
     }
     
     lastFreeHeap = currentFreeHeap;
-    lastMemoryCheck = millis();
 }
 
 void printMemoryLeakInfo() {
@@ -101,88 +117,108 @@ void printMemoryLeakInfo() {
     }
 }
 
+static void debugCmdButtons(const char* args) {
+    printButtonDebounceStats();
+    printButtonMatrixStatus();
+}
+
+static void debugCmdCommands(const char* args) {
+    runCommandBenchmark();
+}
+
+static void debugCmdEspNow(const char* args) {
+    printESPNowStats();
+}
+
+static void debugCmdHelp(const char* args) {
+    printDebugHelp();
+}
+
+static void debugCmdLog(const char* args) {
+    runLogBenchmark();
+    printLogBufferStats();
+}
+
+static void debugCmdMemory(const char* args) {
+    printMemoryInfo();
+    printMemoryLeakInfo();
+}
+
+static void debugCmdMetrics(const char* args) {
+    printMetrics();
+}
+
+static void debugCmdPerf(const char* args) {
+    printPerformanceMetrics();
+}
+
+static void debugCmdRelay(const char* args) {
+    printRelayDriverStatus();
+    printSwitchMuteStatus();
+    printRelayVerifyStatus();
+    printCommandCoalescerStatus();
+}
+
+static void debugCmdTask(const char* args) {
+    printTaskStats();
+}
+
+static void debugCmdWifi(const char* args) {
+    printWiFiStats();
+}
+
+// Subcommands of "debug", sorted by name; "debugperf" and "debug perf" both work
+static constexpr SerialCommand debugCommands[] = {
+    {"buttons", nullptr, "Show button bounce measurements and debounce windows", debugCmdButtons, 0, CMD_EXACT},
+    {"cmd", nullptr, "Measure command lookup and line assembly cost", debugCmdCommands, 0, CMD_EXACT},
+    {"espnow", nullptr, "Show ESP-NOW stats", debugCmdEspNow, 0, CMD_EXACT},
+    {"help", nullptr, "Show debug commands", debugCmdHelp, 0, CMD_EXACT},
+    {"log", nullptr, "Measure log capture cost, show log ring stats", debugCmdLog, 0, CMD_EXACT},
+    {"memory", nullptr, "Show memory usage and leak analysis", debugCmdMemory, 0, CMD_EXACT},
+    {"metrics", nullptr, "Show the metrics registry (counters, gauges, histograms)", debugCmdMetrics, 0, CMD_EXACT},
+    {"perf", nullptr, "Show performance metrics", debugCmdPerf, 0, CMD_EXACT},
+    {"relay", nullptr, "Show relay drive, verification and coalescing stats", debugCmdRelay, 0, CMD_EXACT},
+    {"task", nullptr, "Show task stats", debugCmdTask, 0, CMD_EXACT},
+    {"wifi", nullptr, "Show WiFi stats", debugCmdWifi, 0, CMD_EXACT},
+};
+
+#define DEBUG_COMMAND_COUNT (sizeof(debugCommands) / sizeof(debugCommands[0]))
+static_assert(serialCommandsSorted(debugCommands, DEBUG_COMMAND_COUNT),
+              "debugCommands[] must stay sorted by name");
+
 void handleDebugCommand(const char* cmd) {
-    // Input validation - ensure cmd is not null
     if (cmd == nullptr) {
         log(LOG_ERROR, "Debug command pointer is null!");
         return;
     }
-    
-    // Validate command length to prevent buffer overflow
-    size_t cmdLen = strlen(cmd);
-    if (cmdLen == 0 || cmdLen > 32) {
-        logf(LOG_ERROR, "Invalid debug command length: %zu", cmdLen);
+    if (*cmd == '\0') {
+        printDebugInfo();
         return;
     }
-    
-    if (strcasecmp(cmd, "debug") == 0) {
-        printDebugInfo();
-    } else if (strcasecmp(cmd, "perf") == 0) {
-        printPerformanceMetrics();
-    } else if (strcasecmp(cmd, "memory") == 0) {
-        printMemoryInfo();
-        printMemoryLeakInfo();
-    } else if (strcasecmp(cmd, "wifi") == 0) {
-        printWiFiStats();
-    } else if (strcasecmp(cmd, "espnow") == 0) {
-        printESPNowStats();
-    } else if (strcasecmp(cmd, "task") == 0) {
-        printTaskStats();
-    } else if (strcasecmp(cmd, "debughelp") == 0) {
-        printDebugHelp();
-    } else {
+    if (!runSerialCommand(debugCommands, DEBUG_COMMAND_COUNT, cmd)) {
         logf(LOG_WARN, "Unknown debug command: '%s'", cmd);
         log(LOG_INFO, "Type 'debughelp' for debug commands");
     }
 }
 
+void printDebugCommandList(const char* prefix) {
+    printSerialCommandHelp(debugCommands, DEBUG_COMMAND_COUNT, 0, prefix);
+}
+
 void printDebugHelp() {
     Serial.println(F("\n========== DEBUG COMMANDS =========="));
-    Serial.println(F("debug       : Show complete debug information"));
-    Serial.println(F("perf        : Show performance metrics"));
-    Serial.println(F("memory      : Show memory usage and leak analysis"));
-    Serial.println(F("wifi        : Show WiFi statistics"));
-    Serial.println(F("espnow      : Show ESP-NOW statistics"));
-    Serial.println(F("task        : Show task statistics"));
-    Serial.println(F("debughelp   : Show this debug help"));
+    Serial.println(F("  debug       : Show complete debug information"));
+    printDebugCommandList("debug");
     Serial.println(F("=====================================\n"));
 }
 
 // Performance monitoring functions
-void updatePerformanceMetrics(unsigned long loopTime) {
-    // Validate input to prevent overflow/underflow issues
-    if (loopTime > 10000) {  // Sanity check: loop time shouldn't exceed 10 seconds
-        logf(LOG_WARN, "Suspicious loop time detected: %lums", loopTime);
+void updatePerformanceMetrics(uint32_t elapsedUs) {
+    // Sanity check: loop time shouldn't exceed 10 seconds
+    if (elapsedUs > 10000000UL) {
+        logf(LOG_WARN, "Suspicious loop time detected: %luus", (unsigned long)elapsedUs);
         return;
     }
-    
-    // Prevent overflow on loop count
-    if (perfMetrics.loopCount == ULONG_MAX) {
-        logf(LOG_WARN, "Performance metrics loop count overflow, resetting");
-        perfMetrics.loopCount = 0;
-        perfMetrics.totalLoopTime = 0;
-        perfMetrics.maxLoopTime = 0;
-        perfMetrics.minLoopTime = 0;
-        perfMetrics.startTime = millis();
-    }
-    
-    perfMetrics.loopCount++;
-    perfMetrics.lastLoopTime = loopTime;
-    
-    // Prevent totalLoopTime overflow
-    if (perfMetrics.totalLoopTime > (ULONG_MAX - loopTime)) {
-        logf(LOG_WARN, "Performance metrics total time overflow, resetting");
-        perfMetrics.totalLoopTime = loopTime;
-        perfMetrics.loopCount = 1;
-    } else {
-        perfMetrics.totalLoopTime += loopTime;
-    }
-    
-    if (loopTime > perfMetrics.maxLoopTime) {
-        perfMetrics.maxLoopTime = loopTime;
-    }
-    
-    if (perfMetrics.minLoopTime == 0 || loopTime < perfMetrics.minLoopTime) {
-        perfMetrics.minLoopTime = loopTime;
-    }
-} 
\ No newline at end of file
+    lastLoopTimeUs.set(elapsedUs);
+    loopTimeUs.record(elapsedUs);
+}
@@ -21,24 +21,71 @@
 #include "espnow-pairing.h"
 #include "commandHandler.h"
 #include "dataStructs.h"
+#include "relayStats.h"
+#include "relayGroups.h"
+#include "logRateLimit.h"
+#include "metrics.h"
 #include <esp_now.h>
 #include <WiFi.h>
 #include <espnow-pairing.h>
 
+// Consecutive failed sends, saturating; 0 while the server acknowledges
+static volatile uint8_t sendFailStreak = 0;
+
+// Written only from the WiFi task callbacks
+static MetricCounter sendOkCount("espnow_sent_total", "ESP-NOW sends acknowledged by the peer");
+static MetricCounter sendFailCount("espnow_send_failed_total", "ESP-NOW sends that failed");
+static MetricCounter recvCount("espnow_received_total", "ESP-NOW messages received");
+static MetricCounter recvIgnoredCount("espnow_ignored_total", "ESP-NOW messages dropped while not paired");
+static MetricCounter recvUnknownCount("espnow_unknown_type_total", "ESP-NOW messages of unknown type");
+
+// STATUS_REQUEST reply: the receive callback only flags it, pollStatusReply()
+// walks the frames from the loop (status, groups, relay wear, metrics)
+static volatile bool statusReplyRequested = false;
+static bool replyActive = false;
+static uint16_t replyNext = 0;
+static unsigned long replyLastSendMs = 0;
+static portMUX_TYPE replyMux = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t replyInFlight = 0; // Queued, not yet reported by OnDataSent
+
+uint8_t getEspNowFailStreak() {
+    return sendFailStreak;
+}
+
+EspNowStats getEspNowStats() {
+    EspNowStats stats;
+    stats.sent = sendOkCount.value;
+    stats.sendFailed = sendFailCount.value;
+    stats.received = recvCount.value;
+    stats.ignored = recvIgnoredCount.value;
+    stats.unknownType = recvUnknownCount.value;
+    return stats;
+}
+
 void OnDataSent(const uint8_t *mac_addr, esp_now_send_status_t status) {
+    // Any frame's callback frees a slot: other sends in flight only loosen the pacing
+    portENTER_CRITICAL(&replyMux);
+    if (replyInFlight) replyInFlight--;
+    portEXIT_CRITICAL(&replyMux);
     if (status == ESP_NOW_SEND_SUCCESS) {
+        sendFailStreak = 0;
+        sendOkCount.inc();
         log(LOG_DEBUG, "Data sent successfully to ");
         printMAC(mac_addr, LOG_DEBUG);
     } else {
-        log(LOG_WARN, "Data send failed to ");
-        printMAC(mac_addr, LOG_WARN);
+        if (sendFailStreak < 0xFF) sendFailStreak++;
+        sendFailCount.inc();
+        LOGF_LIMITED(LOG_WARN, "Data send failed to %02X:%02X:%02X:%02X:%02X:%02X",
+                     mac_addr[0], mac_addr[1], mac_addr[2], mac_addr[3], mac_addr[4], mac_addr[5]);
     }
 }
 
 void OnDataRecv(const uint8_t * mac_addr, const uint8_t *incomingData, int len) { 
     uint8_t type = incomingData[0];
+    recvCount.inc();
     
     if (pairingStatus != PAIR_PAIRED && type != PAIRING) {
+        recvIgnoredCount.inc();
         log(LOG_DEBUG, "Ignoring data: not paired");
         return;
     }
@@ -102,7 +149,8 @@ void OnDataRecv(const uint8_t * mac_addr, const uint8_t *incomingData, int len)
             break;
             
         default:
-            logf(LOG_WARN, "Unknown message type: %u", type);
+            recvUnknownCount.inc();
+            LOGF_LIMITED(LOG_WARN, "Unknown message type: %u", type);
             break;
     }  
 }
@@ -122,6 +170,19 @@ void initESP_NOW(){
     log(LOG_DEBUG, "ESP-NOW callbacks registered");
 }
 
+static esp_err_t sendStatusFrame() {
+    // Prepare outgoing message with current status
+    myData.msgType = DATA;
+    myData.id = BOARD_ID;
+    myData.commandType = STATUS_REQUEST; // Indicating this is a status response
+    myData.commandValue = currentAmpChannel;
+    myData.targetChannel = currentAmpChannel;
+    myData.readingId++;
+    myData.timestamp = millis();
+    
+    return esp_now_send(serverAddress, (uint8_t *) &myData, sizeof(myData));
+}
+
 // Send data/status back to server (optional - for acknowledgments or status reports)
 void sendData() {
     if (pairingStatus != PAIR_PAIRED) {
@@ -129,19 +190,168 @@ void sendData() {
         return;
     }
     
-    // Prepare outgoing message with current status
+    esp_err_t result = sendStatusFrame();
+    if (result == ESP_OK) {
+        log(LOG_DEBUG, "Status data sent successfully");
+    } else {
+        logf(LOG_WARN, "Error sending status data: %s", esp_err_to_name(result));
+    }
+}
+
+// Send an expression pedal update (already rate limited and change-only)
+void sendExpressionData(uint8_t value) {
+    if (pairingStatus != PAIR_PAIRED) {
+        return;
+    }
+    
     myData.msgType = DATA;
     myData.id = BOARD_ID;
-    myData.commandType = STATUS_REQUEST; // Indicating this is a status response
-    myData.commandValue = currentAmpChannel;
+    myData.commandType = EXPRESSION;
+    myData.commandValue = value;
     myData.targetChannel = currentAmpChannel;
     myData.readingId++;
     myData.timestamp = millis();
     
     esp_err_t result = esp_now_send(serverAddress, (uint8_t *) &myData, sizeof(myData));
-    if (result == ESP_OK) {
-        log(LOG_DEBUG, "Status data sent successfully");
+    if (result != ESP_OK) {
+        logf(LOG_DEBUG, "Error sending expression data: %s", esp_err_to_name(result));
+    }
+}
+
+// Report an output that failed readback / sense verification
+void sendRelayFault(uint8_t output) {
+    if (pairingStatus != PAIR_PAIRED) {
+        return;
+    }
+    
+    myData.msgType = DATA;
+    myData.id = BOARD_ID;
+    myData.commandType = RELAY_FAULT;
+    myData.commandValue = output;
+    myData.targetChannel = currentAmpChannel;
+    myData.readingId++;
+    myData.timestamp = millis();
+    
+    esp_err_t result = esp_now_send(serverAddress, (uint8_t *) &myData, sizeof(myData));
+    if (result != ESP_OK) {
+        logf(LOG_WARN, "Error sending relay fault: %s", esp_err_to_name(result));
+    }
+}
+
+// Relay group frame for group index g
+static esp_err_t sendRelayGroupFrame(uint8_t g) {
+    struct_group_status frame;
+    uint32_t groupMask = relayGroupOutputs[g];
+    frame.msgType = GROUP_STATUS;
+    frame.id = BOARD_ID;
+    frame.groupCount = RELAY_GROUP_COUNT;
+    frame.timestamp = millis();
+    frame.group = g + 1;
+    frame.exclusive = isRelayGroupExclusive(g) ? 1 : 0;
+    frame.firstOutput = __builtin_ctz(groupMask) + 1;
+    frame.outputCount = __builtin_popcount(groupMask);
+    frame.outputs = ampOutputs & groupMask;
+    frame.activeOutput = frame.exclusive ? getRelayGroupChannel(g) : 0;
+    return esp_now_send(serverAddress, (uint8_t *) &frame, sizeof(frame));
+}
+
+// Relay wear frame for output index i
+static esp_err_t sendRelayStatsFrame(uint8_t i) {
+    struct_relay_stats frame;
+    frame.msgType = RELAY_STATS;
+    frame.id = BOARD_ID;
+    frame.outputCount = MAX_AMPSWITCHS;
+    frame.timestamp = millis();
+    frame.output = i + 1;
+    frame.actuations = relayActuations[i];
+    frame.onSeconds = getRelayOnSeconds(i + 1);
+    return esp_now_send(serverAddress, (uint8_t *) &frame, sizeof(frame));
+}
+
+// Metric frame for registry index i
+static esp_err_t sendMetricFrame(uint8_t i) {
+    struct_metric frame;
+    const Metric* metric = getMetric(i);
+    frame.msgType = METRIC;
+    frame.id = BOARD_ID;
+    frame.count = getMetricCount();
+    frame.index = i;
+    frame.kind = metric->kind;
+    strncpy(frame.name, metric->name, sizeof(frame.name) - 1);
+    frame.name[sizeof(frame.name) - 1] = '\0';
+    frame.value = metric->value;
+    if (metric->kind == METRIC_HISTOGRAM) {
+        const MetricHistogram* histogram = static_cast<const MetricHistogram*>(metric);
+        frame.min = histogram->min;
+        frame.max = histogram->max;
+        frame.sum = histogram->sum;
+        memcpy(frame.buckets, histogram->buckets, sizeof(frame.buckets));
     } else {
-        logf(LOG_WARN, "Error sending status data: %s", esp_err_to_name(result));
+        frame.min = 0;
+        frame.max = 0;
+        frame.sum = 0;
+        memset(frame.buckets, 0, sizeof(frame.buckets));
+    }
+    frame.timestamp = millis();
+    return esp_now_send(serverAddress, (uint8_t *) &frame, sizeof(frame));
+}
+
+// Called from the receive callback: sending the reply there would queue
+// dozens of frames at once and overrun the ESP-NOW TX queue
+void requestStatusReply() {
+    statusReplyRequested = true;
+}
+
+// Called every loop pass: sends the next reply frames while fewer than
+// STATUS_REPLY_IN_FLIGHT await their send callback. A full TX queue retries
+// the same frame on a later pass; a new request restarts with fresh values.
+void pollStatusReply() {
+    if (statusReplyRequested) {
+        statusReplyRequested = false;
+        replyActive = true;
+        replyNext = 0;
     }
-} 
\ No newline at end of file
+    if (!replyActive) return;
+    if (pairingStatus != PAIR_PAIRED) {
+        replyActive = false;
+        return;
+    }
+
+    uint16_t total = 1 + RELAY_GROUP_COUNT + MAX_AMPSWITCHS + getMetricCount();
+    while (replyNext < total) {
+        portENTER_CRITICAL(&replyMux);
+        if (replyInFlight >= STATUS_REPLY_IN_FLIGHT && millis() - replyLastSendMs >= STATUS_REPLY_STALL_MS) {
+            replyInFlight = 0; // Callbacks lost (e.g. ESP-NOW restarted)
+        }
+        bool full = replyInFlight >= STATUS_REPLY_IN_FLIGHT;
+        if (!full) replyInFlight++; // Before the send: its callback may run first
+        portEXIT_CRITICAL(&replyMux);
+        if (full) return;
+
+        uint16_t index = replyNext;
+        esp_err_t result;
+        if (index == 0) {
+            result = sendStatusFrame();
+        } else if (--index < RELAY_GROUP_COUNT) {
+            result = sendRelayGroupFrame(index);
+        } else if ((index -= RELAY_GROUP_COUNT) < MAX_AMPSWITCHS) {
+            result = sendRelayStatsFrame(index);
+        } else {
+            result = sendMetricFrame(index - MAX_AMPSWITCHS);
+        }
+
+        if (result != ESP_OK) {
+            portENTER_CRITICAL(&replyMux);
+            if (replyInFlight) replyInFlight--;
+            portEXIT_CRITICAL(&replyMux);
+            if (result == ESP_ERR_ESPNOW_NO_MEM) return; // TX queue full: retry next pass
+            logf(LOG_WARN, "Error sending status reply frame %u: %s", replyNext, esp_err_to_name(result));
+            replyActive = false;
+            return;
+        }
+        replyLastSendMs = millis();
+        replyNext++;
+    }
+    replyActive = false;
+    log(LOG_DEBUG, "Status reply sent");
+}
@@ -0,0 +1,188 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <Arduino.h>
+#include <esp_system.h>
+#include <esp_ota_ops.h>
+#include <soc/soc_memory_layout.h>
+#include "eventLog.h"
+#include "globals.h"
+#include "utils.h"
+
+#define EVENT_LOG_MAGIC (0x45560000UL | (EVENT_LOG_SLOTS << 4) | sizeof(EventRecord))
+
+static_assert(sizeof(EventRecord) == 12, "EventRecord layout is part of the RTC image");
+static_assert(EVENT_LOG_SLOTS > 0, "EVENT_LOG_SLOTS must be at least 1");
+
+struct EventLogState {
+    uint32_t magic;
+    uint32_t count;  // Events ever written since power-on; newest is count - 1
+    uint32_t boots;
+    EventRecord events[EVENT_LOG_SLOTS];
+};
+
+static RTC_NOINIT_ATTR EventLogState eventLog;
+static portMUX_TYPE eventMux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t buildId = 0;
+static esp_reset_reason_t resetReason = ESP_RST_UNKNOWN;
+static PairingStatus lastPairingStatus = NOT_PAIRED;
+
+static uint8_t eventCheck(const EventRecord& e) {
+    const uint8_t* bytes = (const uint8_t*)&e;
+    uint8_t check = 0x5A;
+    for (size_t i = 0; i < offsetof(EventRecord, check); i++) {
+        check ^= bytes[i];
+    }
+    return check;
+}
+
+static const char* resetReasonString(uint8_t reason) {
+    switch (reason) {
+        case ESP_RST_POWERON: return "power-on";
+        case ESP_RST_EXT: return "external pin";
+        case ESP_RST_SW: return "software restart";
+        case ESP_RST_PANIC: return "PANIC";
+        case ESP_RST_INT_WDT: return "interrupt watchdog";
+        case ESP_RST_TASK_WDT: return "task watchdog";
+        case ESP_RST_WDT: return "watchdog";
+        case ESP_RST_DEEPSLEEP: return "deep sleep wake";
+        case ESP_RST_BROWNOUT: return "brownout";
+        case ESP_RST_SDIO: return "SDIO";
+        default: return "unknown";
+    }
+}
+
+static bool isCrashReset(esp_reset_reason_t reason) {
+    return reason == ESP_RST_PANIC || reason == ESP_RST_INT_WDT || reason == ESP_RST_TASK_WDT ||
+           reason == ESP_RST_WDT || reason == ESP_RST_BROWNOUT;
+}
+
+void recordEvent(EventType type, uint16_t arg, uint32_t data) {
+    EventRecord e;
+    e.ms = millis();
+    e.data = data;
+    e.arg = arg;
+    e.type = type;
+    e.check = eventCheck(e);
+
+    portENTER_CRITICAL(&eventMux);
+    eventLog.events[eventLog.count % EVENT_LOG_SLOTS] = e;
+    eventLog.count++;
+    portEXIT_CRITICAL(&eventMux);
+}
+
+// Keep the ring from before the reset unless it is a power-on (RTC memory
+// content is undefined) or the layout does not match this build
+void initEventLog() {
+    resetReason = esp_reset_reason();
+    memcpy(&buildId, esp_ota_get_app_description()->app_elf_sha256, sizeof(buildId));
+
+    if (resetReason == ESP_RST_POWERON || eventLog.magic != EVENT_LOG_MAGIC) {
+        memset(&eventLog, 0, sizeof(eventLog));
+        eventLog.magic = EVENT_LOG_MAGIC;
+    }
+    eventLog.boots++;
+    recordEvent(EVENT_BOOT, (uint16_t)(resetReason | (eventLog.boots & 0xFF) << 8), buildId);
+
+    if (isCrashReset(resetReason)) {
+        logf(LOG_WARN, "Last reset: %s, 'postmortem' shows the events before it",
+             resetReasonString(resetReason));
+    }
+}
+
+// Pairing status is written from several places and tasks; the loop
+// records each change it sees
+void updateEventLog() {
+    PairingStatus status = pairingStatus;
+    if (status != lastPairingStatus) {
+        recordEvent(EVENT_PAIRING, status, lastPairingStatus);
+        lastPairingStatus = status;
+    }
+}
+
+const char* getResetReasonString() {
+    return resetReasonString(resetReason);
+}
+
+// Message pointers are only followed for events recorded by this build,
+// and only into flash; anything else was text built at runtime
+static const char* eventText(uint32_t data, bool sameBuild) {
+    const char* text = (const char*)(uintptr_t)data;
+    if (!sameBuild) return "(text not available, recorded by another build)";
+    if (!esp_ptr_in_drom(text)) return "(runtime text)";
+    return text;
+}
+
+void printPostmortem() {
+    portENTER_CRITICAL(&eventMux);
+    uint32_t count = eventLog.count;
+    portEXIT_CRITICAL(&eventMux);
+    uint32_t first = count > EVENT_LOG_SLOTS ? count - EVENT_LOG_SLOTS : 0;
+
+    log(LOG_INFO, "=== POSTMORTEM EVENT LOG ===");
+    logf(LOG_INFO, "  Boots since power-on: %lu, this boot: %s", (unsigned long)eventLog.boots,
+         resetReasonString(resetReason));
+    logf(LOG_INFO, "  Events: %lu recorded, last %lu kept", (unsigned long)count,
+         (unsigned long)(count - first));
+
+    // Events before the oldest boot event kept belong to an unknown build
+    bool sameBuild = false;
+    uint32_t skipped = 0;
+    for (uint32_t i = first; i < count; i++) {
+        EventRecord e;
+        portENTER_CRITICAL(&eventMux);
+        e = eventLog.events[i % EVENT_LOG_SLOTS];
+        portEXIT_CRITICAL(&eventMux);
+        if (e.check != eventCheck(e)) {
+            skipped++;
+            continue;
+        }
+
+        char timestamp[32];
+        formatUptime(e.ms, timestamp, sizeof(timestamp));
+        switch (e.type) {
+            case EVENT_BOOT:
+                sameBuild = e.data == buildId;
+                logf(LOG_INFO, "  --- Boot %u: %s%s ---", e.arg >> 8, resetReasonString(e.arg & 0xFF),
+                     sameBuild ? "" : " (other firmware)");
+                break;
+            case EVENT_SWITCH:
+                logf(LOG_INFO, "  [%s] Switch: channel %u, outputs 0x%lX", timestamp, e.arg,
+                     (unsigned long)e.data);
+                break;
+            case EVENT_PAIRING:
+                logf(LOG_INFO, "  [%s] Pairing: %s (was %s)", timestamp,
+                     getPairingStatusString((PairingStatus)e.arg),
+                     getPairingStatusString((PairingStatus)e.data));
+                break;
+            case EVENT_LOG:
+                logf(LOG_INFO, "  [%s] %s: %s", timestamp, getLogLevelString((LogLevel)e.arg),
+                     eventText(e.data, sameBuild));
+                break;
+            case EVENT_RESTART:
+                logf(LOG_INFO, "  [%s] Restart: %s", timestamp, eventText(e.data, sameBuild));
+                break;
+            case EVENT_OTA:
+                logf(LOG_INFO, "  [%s] OTA update %s", timestamp, e.arg ? "written" : "failed");
+                break;
+            default:
+                skipped++;
+                break;
+        }
+    }
+    if (skipped) {
+        logf(LOG_INFO, "  %lu damaged events skipped", (unsigned long)skipped);
+    }
+    log(LOG_INFO, "============================");
+}
@@ -0,0 +1,186 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <Arduino.h>
+#include "expressionPedal.h"
+#include "globals.h"
+#include "utils.h"
+#include "nvsManager.h"
+
+#if HAS_EXPRESSION_PEDAL
+#include <esp_timer.h>
+
+// Filtered ADC value in 12.4 fixed point (raw 12-bit reading << 4)
+static volatile int32_t expressionFiltered = 0;
+static volatile uint32_t expressionSamples = 0;
+static esp_timer_handle_t expressionTimer = nullptr;
+
+static uint16_t calMin = EXPRESSION_CAL_MIN_DEFAULT;
+static uint16_t calMax = EXPRESSION_CAL_MAX_DEFAULT;
+static uint8_t lastValue = 0xFF; // Nothing reported yet
+static unsigned long lastReport = 0;
+static uint32_t reportsSent = 0;
+
+// Timer callback - one conversion per tick, EXPRESSION_OVERSAMPLE ticks per
+// filter update, so the ADC never blocks the loop for more than one reading
+static void sampleExpressionPedal(void* arg) {
+    static uint32_t accumulator = 0;
+    static uint8_t count = 0;
+    static bool primed = false;
+
+    accumulator += analogRead(EXPRESSION_PEDAL_PIN);
+    if (++count < EXPRESSION_OVERSAMPLE) {
+        return;
+    }
+
+    int32_t averaged = (int32_t)((accumulator << 4) / EXPRESSION_OVERSAMPLE);
+    accumulator = 0;
+    count = 0;
+
+    if (!primed) {
+        expressionFiltered = averaged;
+        primed = true;
+    } else {
+        expressionFiltered = expressionFiltered + ((averaged - expressionFiltered) >> EXPRESSION_IIR_SHIFT);
+    }
+    expressionSamples++;
+}
+
+void initExpressionPedal() {
+    loadExpressionCalibrationFromNVS(&calMin, &calMax);
+    if (calMax <= calMin) {
+        log(LOG_WARN, "Invalid expression calibration, using defaults");
+        calMin = EXPRESSION_CAL_MIN_DEFAULT;
+        calMax = EXPRESSION_CAL_MAX_DEFAULT;
+    }
+
+    analogReadResolution(12);
+    analogSetPinAttenuation(EXPRESSION_PEDAL_PIN, ADC_11db);
+
+    const esp_timer_create_args_t timerArgs = {
+        .callback = &sampleExpressionPedal,
+        .arg = nullptr,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "exp_pedal",
+        .skip_unhandled_events = true
+    };
+    if (esp_timer_create(&timerArgs, &expressionTimer) != ESP_OK ||
+        esp_timer_start_periodic(expressionTimer, EXPRESSION_SAMPLE_US) != ESP_OK) {
+        log(LOG_ERROR, "Failed to start expression pedal sample timer");
+        return;
+    }
+    logf(LOG_INFO, "Expression pedal on pin %u (CC#%u, cal %u-%u)", EXPRESSION_PEDAL_PIN,
+         EXPRESSION_CC, calMin, calMax);
+}
+
+// Called from loop(): constant time, no ADC access
+bool pollExpressionPedal(uint8_t* value) {
+    if (expressionSamples == 0) return false;
+
+    unsigned long now = millis();
+    if (now - lastReport < EXPRESSION_MIN_INTERVAL_MS) return false;
+
+    // Scale the filtered reading into 0-127 with 4 fractional bits
+    int32_t raw16 = expressionFiltered;
+    int32_t lo = (int32_t)calMin << 4;
+    int32_t hi = (int32_t)calMax << 4;
+    int32_t pos;
+    if (raw16 <= lo) {
+        pos = 0;
+    } else if (raw16 >= hi) {
+        pos = 127 << 4;
+    } else {
+        pos = (raw16 - lo) * (127 << 4) / (hi - lo);
+    }
+
+    // Hysteresis: the position has to leave the current step by more than
+    // EXPRESSION_HYSTERESIS sixteenths before a new value is reported, so a
+    // reading sitting on a step boundary does not flicker
+    if (lastValue != 0xFF) {
+        int32_t centre = (int32_t)lastValue << 4;
+        int32_t band = 8 + EXPRESSION_HYSTERESIS;
+        if (pos > centre - band && pos < centre + band) {
+            return false;
+        }
+    }
+
+    uint8_t quantised = (uint8_t)((pos + 8) >> 4);
+    if (quantised > 127) quantised = 127;
+    if (quantised == lastValue) return false;
+
+    lastValue = quantised;
+    lastReport = now;
+    reportsSent++;
+    *value = quantised;
+    return true;
+}
+
+// A reversed or empty range would make the pedal an on/off switch (and be
+// reset at the next boot), so such a point is rejected rather than saved
+void calibrateExpressionMin() {
+    uint16_t reading = (uint16_t)(expressionFiltered >> 4);
+    if (reading >= calMax) {
+        logf(LOG_WARN, "Expression minimum %u not below maximum %u, calibration unchanged", reading, calMax);
+        return;
+    }
+    calMin = reading;
+    saveExpressionCalibrationToNVS(calMin, calMax);
+    logf(LOG_INFO, "Expression pedal minimum set to %u", calMin);
+}
+
+void calibrateExpressionMax() {
+    uint16_t reading = (uint16_t)(expressionFiltered >> 4);
+    if (reading <= calMin) {
+        logf(LOG_WARN, "Expression maximum %u not above minimum %u, calibration unchanged", reading, calMin);
+        return;
+    }
+    calMax = reading;
+    saveExpressionCalibrationToNVS(calMin, calMax);
+    logf(LOG_INFO, "Expression pedal maximum set to %u", calMax);
+}
+
+void printExpressionPedalStatus() {
+    log(LOG_INFO, "=== EXPRESSION PEDAL ===");
+    logf(LOG_INFO, "  Pin: %u, MIDI CC#%u", EXPRESSION_PEDAL_PIN, EXPRESSION_CC);
+    logf(LOG_INFO, "  Filtered ADC: %.1f (cal %u-%u)", expressionFiltered / 16.0f, calMin, calMax);
+    logf(LOG_INFO, "  Last Value: %u", lastValue == 0xFF ? 0 : lastValue);
+    logf(LOG_INFO, "  Filter Updates: %lu, Reports Sent: %lu",
+         (unsigned long)expressionSamples, (unsigned long)reportsSent);
+    logf(LOG_INFO, "  Sample Period: %uus x%u oversample, min report interval %ums",
+         EXPRESSION_SAMPLE_US, EXPRESSION_OVERSAMPLE, EXPRESSION_MIN_INTERVAL_MS);
+    log(LOG_INFO, "========================");
+}
+
+#else
+
+void initExpressionPedal() {
+}
+
+bool pollExpressionPedal(uint8_t* value) {
+    return false;
+}
+
+void calibrateExpressionMin() {
+    log(LOG_WARN, "Expression pedal not configured (set EXPRESSION_PEDAL_PIN)");
+}
+
+void calibrateExpressionMax() {
+    log(LOG_WARN, "Expression pedal not configured (set EXPRESSION_PEDAL_PIN)");
+}
+
+void printExpressionPedalStatus() {
+    log(LOG_INFO, "Expression pedal: Disabled (set EXPRESSION_PEDAL_PIN)");
+}
+
+#endif
@@ -0,0 +1,554 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <Arduino.h>
+#include "logBuffer.h"
+#include "utils.h"
+#include "metrics.h"
+
+#if LOG_ASYNC
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <soc/soc_memory_layout.h>
+
+// Packed argument kinds, one tag byte each in front of the value
+enum LogArgKind : uint8_t {
+    ARG_INT,
+    ARG_LONG,
+    ARG_LLONG,
+    ARG_SIZE,
+    ARG_PTR,
+    ARG_DOUBLE,
+    ARG_STR
+};
+
+struct LogRecord {
+    uint32_t seq;         // Slot sequence: == position free, position + 1 published
+    uint32_t ms;
+    const char* format;   // nullptr: payload holds the formatted text
+    bool literal;         // format is a plain log() message, printed verbatim
+    uint8_t level;
+    uint8_t size;
+    uint8_t payload[LOG_RECORD_BYTES];
+};
+
+static_assert(LOG_RECORD_BYTES <= 255, "LOG_RECORD_BYTES must fit the 8-bit record size");
+
+static LogRecord logRing[LOG_RING_SLOTS];
+static portMUX_TYPE logMux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t logHead = 0;  // Next position to reserve (under logMux)
+static uint32_t logTail = 0;  // Next position to write (under logDrainLock)
+static SemaphoreHandle_t logDrainLock = nullptr;
+static TaskHandle_t logTaskHandle = nullptr;
+static bool logReady = false;
+
+static MetricCounter logCaptured("log_captured_total", "Log records captured into the ring");
+static MetricCounter logDropped("log_dropped_total", "Log records dropped because the ring was full");
+static volatile uint32_t logFallbacks = 0;     // Formatted at capture time
+static MetricCounter logWritten("log_written_total", "Log records written to the serial port");
+static uint32_t logHighWater = 0;
+static uint32_t logBytesOut = 0;
+static bool logTokenized = LOG_TOKENIZED;
+
+// Conversion at 'p' (just past '%'): returns the kind and conversion letter
+// and advances past the spec, or returns false for specs that cannot be deferred
+static bool parseSpec(const char*& p, LogArgKind* kind, char* conv) {
+    while (*p && strchr("-+ #0", *p)) p++;
+    while (*p >= '0' && *p <= '9') p++;
+    if (*p == '.') {
+        p++;
+        while (*p >= '0' && *p <= '9') p++;
+    }
+    if (*p == '*') return false;
+    int longs = 0;
+    bool sized = false;
+    for (;; p++) {
+        if (*p == 'l') longs++;
+        else if (*p == 'z' || *p == 't') sized = true;
+        else if (*p == 'j') longs = 2;
+        else if (*p != 'h') break;
+    }
+    switch (*p) {
+        case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+            *kind = longs >= 2 ? ARG_LLONG : longs == 1 ? ARG_LONG : sized ? ARG_SIZE : ARG_INT;
+            break;
+        case 'p':
+            *kind = ARG_PTR;
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G':
+            *kind = ARG_DOUBLE;
+            break;
+        case 's':
+            *kind = ARG_STR;
+            break;
+        default:
+            return false;
+    }
+    *conv = *p++;
+    return true;
+}
+
+template <typename T>
+static inline bool packValue(uint8_t* out, uint8_t& size, T value) {
+    if (size + sizeof(T) > LOG_RECORD_BYTES) return false;
+    memcpy(out + size, &value, sizeof(T));
+    size += sizeof(T);
+    return true;
+}
+
+// Walk the format once, copying each argument as its kind; false if the
+// arguments do not fit or the format cannot be deferred
+static bool packArgs(const char* format, va_list args, uint8_t* out, uint8_t* outSize) {
+    uint8_t size = 0;
+    for (const char* p = strchr(format, '%'); p; p = strchr(p, '%')) {
+        p++;
+        if (*p == '%') {
+            p++;
+            continue;
+        }
+        LogArgKind kind;
+        char conv;
+        if (!parseSpec(p, &kind, &conv)) return false;
+        bool ok;
+        switch (kind) {
+            case ARG_INT:    ok = packValue(out, size, va_arg(args, int)); break;
+            case ARG_LONG:   ok = packValue(out, size, va_arg(args, long)); break;
+            case ARG_LLONG:  ok = packValue(out, size, va_arg(args, long long)); break;
+            case ARG_SIZE:   ok = packValue(out, size, va_arg(args, size_t)); break;
+            case ARG_PTR:    ok = packValue(out, size, va_arg(args, void*)); break;
+            case ARG_DOUBLE: ok = packValue(out, size, va_arg(args, double)); break;
+            case ARG_STR: default: {
+                const char* str = va_arg(args, const char*);
+                if (str == nullptr) str = "(null)";
+                size_t len = strlen(str);
+                if (size + len + 1 > LOG_RECORD_BYTES) return false;
+                memcpy(out + size, str, len + 1);
+                size += len + 1;
+                ok = true;
+                break; }
+        }
+        if (!ok) return false;
+    }
+    *outSize = size;
+    return true;
+}
+
+template <typename T>
+static inline int formatValue(char* out, size_t cap, const char* spec, const uint8_t* in, uint8_t& pos) {
+    T value;
+    memcpy(&value, in + pos, sizeof(T));
+    pos += sizeof(T);
+    return snprintf(out, cap, spec, value);
+}
+
+// Replay a packed record through snprintf one conversion at a time
+static size_t formatPacked(const LogRecord& rec, char* out, size_t cap) {
+    size_t len = 0;
+    uint8_t pos = 0;
+    const char* p = rec.format;
+    while (*p && len + 1 < cap) {
+        if (*p != '%') {
+            out[len++] = *p++;
+            continue;
+        }
+        if (p[1] == '%') {
+            out[len++] = '%';
+            p += 2;
+            continue;
+        }
+        const char* start = p++;
+        LogArgKind kind;
+        char conv;
+        parseSpec(p, &kind, &conv); // Already validated at capture
+        char spec[16];
+        size_t specLen = p - start;
+        if (specLen >= sizeof(spec)) specLen = sizeof(spec) - 1;
+        memcpy(spec, start, specLen);
+        spec[specLen] = '\0';
+
+        int n;
+        switch (kind) {
+            case ARG_INT:    n = formatValue<int>(out + len, cap - len, spec, rec.payload, pos); break;
+            case ARG_LONG:   n = formatValue<long>(out + len, cap - len, spec, rec.payload, pos); break;
+            case ARG_LLONG:  n = formatValue<long long>(out + len, cap - len, spec, rec.payload, pos); break;
+            case ARG_SIZE:   n = formatValue<size_t>(out + len, cap - len, spec, rec.payload, pos); break;
+            case ARG_PTR:    n = formatValue<void*>(out + len, cap - len, spec, rec.payload, pos); break;
+            case ARG_DOUBLE: n = formatValue<double>(out + len, cap - len, spec, rec.payload, pos); break;
+            case ARG_STR: default: {
+                const char* str = (const char*)rec.payload + pos;
+                pos += strlen(str) + 1;
+                n = snprintf(out + len, cap - len, spec, str);
+                break; }
+        }
+        if (n < 0) break;
+        len += (size_t)n < cap - len ? (size_t)n : cap - len - 1;
+    }
+    out[len] = '\0';
+    return len;
+}
+
+static size_t formatTextLine(const LogRecord& rec, char* line, size_t cap) {
+    char timestamp[32];
+    formatUptime(rec.ms, timestamp, sizeof(timestamp));
+    // snprintf returns the untruncated length: clamp so the newline stays inside 'line'
+    int len = snprintf(line, cap, "[%s][%s] ", timestamp, getLogLevelString((LogLevel)rec.level));
+    if (len < 0) len = 0;
+    if (len > (int)cap - 2) len = cap - 2;
+    if (rec.format && !rec.literal) {
+        len += formatPacked(rec, line + len, cap - len - 1);
+    } else {
+        int n = snprintf(line + len, cap - len - 1, "%s", rec.format ? rec.format : (const char*)rec.payload);
+        if (n > 0) len += n;
+    }
+    if (len > (int)cap - 2) len = cap - 2;
+    line[len++] = '\n';
+    return len;
+}
+
+// Token of a level and format string: FNV-1a over the level byte and the
+// format, folded to 24 bits, matching tools/logtokens.py. 0 is reserved for
+// records sent as text.
+static uint32_t logToken(uint8_t level, const char* str) {
+    uint32_t hash = (2166136261UL ^ level) * 16777619UL;
+    while (*str) {
+        hash = (hash ^ (uint8_t)*str++) * 16777619UL;
+    }
+    uint32_t token = (hash >> 24) ^ (hash & 0xFFFFFF);
+    return token ? token : 1;
+}
+
+static inline size_t putVarint(uint8_t* out, uint64_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)value | 0x80;
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+template <typename T>
+static inline T takeValue(const uint8_t* in, uint8_t& pos) {
+    T value;
+    memcpy(&value, in + pos, sizeof(T));
+    pos += sizeof(T);
+    return value;
+}
+
+// Re-encode packed arguments compactly: integers as varints (zigzag for
+// %d/%i), doubles as float, strings as bytes + NUL
+static size_t encodeTokenArgs(const LogRecord& rec, uint8_t* out) {
+    size_t n = 0;
+    uint8_t pos = 0;
+    for (const char* p = strchr(rec.format, '%'); p; p = strchr(p, '%')) {
+        p++;
+        if (*p == '%') {
+            p++;
+            continue;
+        }
+        LogArgKind kind;
+        char conv;
+        parseSpec(p, &kind, &conv);
+        int64_t value;
+        uint8_t width;
+        switch (kind) {
+            case ARG_INT:   value = takeValue<int>(rec.payload, pos); width = sizeof(int); break;
+            case ARG_LONG:  value = takeValue<long>(rec.payload, pos); width = sizeof(long); break;
+            case ARG_LLONG: value = takeValue<long long>(rec.payload, pos); width = 8; break;
+            case ARG_SIZE:  value = (int64_t)takeValue<size_t>(rec.payload, pos); width = sizeof(size_t); break;
+            case ARG_PTR:   value = (int64_t)(uintptr_t)takeValue<void*>(rec.payload, pos); width = sizeof(void*); break;
+            case ARG_DOUBLE: {
+                float f = (float)takeValue<double>(rec.payload, pos);
+                memcpy(out + n, &f, sizeof(f));
+                n += sizeof(f);
+                continue; }
+            case ARG_STR: default: {
+                const char* str = (const char*)rec.payload + pos;
+                size_t len = strlen(str) + 1;
+                memcpy(out + n, str, len);
+                n += len;
+                pos += len;
+                continue; }
+        }
+        if (conv == 'd' || conv == 'i') {
+            n += putVarint(out + n, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+        } else {
+            // Unsigned conversions print the argument's own width
+            uint64_t bits = (uint64_t)value;
+            if (width < 8) bits &= (1ULL << (width * 8)) - 1;
+            n += putVarint(out + n, bits);
+        }
+    }
+    return n;
+}
+
+// Frame: A5 len token[3] [level] time(varint) args... sum, where len counts
+// token..args and sum is the two's complement of their byte sum. The level
+// is part of the token, so only text records (token 0) carry a level byte.
+// time is (ms since the previous frame) << 1, or (uptime ms << 1) | 1 on
+// the first frame, every LOG_TOKEN_SYNC_FRAMES frames and when the clock
+// seems to step back (a record reserved before another but stamped after).
+static uint32_t logFrameMs = 0;
+static uint32_t logFramesToSync = 0;  // 0: next frame carries the uptime
+
+static size_t formatTokenFrame(const LogRecord& rec, uint8_t* frame) {
+    size_t n = 2;
+    uint32_t token = 0;
+    if (rec.format) {
+        token = logToken(rec.level, rec.format);
+    }
+    frame[n++] = token & 0xFF;
+    frame[n++] = (token >> 8) & 0xFF;
+    frame[n++] = (token >> 16) & 0xFF;
+    if (token == 0) {
+        frame[n++] = rec.level;
+    }
+    if (logFramesToSync == 0 || (int32_t)(rec.ms - logFrameMs) < 0) {
+        n += putVarint(frame + n, ((uint64_t)rec.ms << 1) | 1);
+        logFramesToSync = LOG_TOKEN_SYNC_FRAMES;
+    } else {
+        n += putVarint(frame + n, (uint64_t)(rec.ms - logFrameMs) << 1);
+        logFramesToSync--;
+    }
+    logFrameMs = rec.ms;
+    if (rec.format == nullptr) {
+        size_t len = strlen((const char*)rec.payload);
+        memcpy(frame + n, rec.payload, len);
+        n += len;
+    } else if (!rec.literal) {
+        n += encodeTokenArgs(rec, frame + n);
+    }
+    frame[0] = LOG_TOKEN_MARKER;
+    frame[1] = (uint8_t)(n - 2);
+    uint8_t sum = 0;
+    for (size_t i = 2; i < n; i++) sum += frame[i];
+    frame[n++] = (uint8_t)-sum;
+    return n;
+}
+
+// Write the oldest published record; caller holds logDrainLock
+static bool writeOneRecord() {
+    LogRecord& rec = logRing[logTail % LOG_RING_SLOTS];
+    if (__atomic_load_n(&rec.seq, __ATOMIC_ACQUIRE) != logTail + 1) return false;
+
+    uint8_t out[300];
+    size_t len = logTokenized ? formatTokenFrame(rec, out) : formatTextLine(rec, (char*)out, sizeof(out));
+    Serial.write(out, len);
+    logBytesOut += len;
+
+    __atomic_store_n(&rec.seq, logTail + LOG_RING_SLOTS, __ATOMIC_RELEASE);
+    logTail++;
+    logWritten.inc();
+    return true;
+}
+
+static void logTask(void* arg) {
+    for (;;) {
+        xSemaphoreTake(logDrainLock, portMAX_DELAY);
+        bool wrote = writeOneRecord();
+        xSemaphoreGive(logDrainLock);
+        if (!wrote) {
+            vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_INTERVAL_MS));
+        }
+    }
+}
+
+// Full ring: the record is dropped and counted, whichever task logs it. The
+// caller may be on the switch path, so it never waits for the serial port.
+static LogRecord* reserveRecord(uint32_t* position) {
+    portENTER_CRITICAL(&logMux);
+    uint32_t pos = logHead;
+    LogRecord* rec = &logRing[pos % LOG_RING_SLOTS];
+    if (__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) == pos) {
+        logHead = pos + 1;
+        uint32_t depth = logHead - logTail;
+        if (depth > logHighWater) logHighWater = depth;
+        logCaptured.inc();  // Every reserved record is published
+        portEXIT_CRITICAL(&logMux);
+        *position = pos;
+        return rec;
+    }
+    portEXIT_CRITICAL(&logMux);
+    logDropped.incShared();
+    return nullptr;
+}
+
+static inline void publishRecord(LogRecord* rec, uint32_t pos) {
+    __atomic_store_n(&rec->seq, pos + 1, __ATOMIC_RELEASE);
+}
+
+void initLogBuffer() {
+    for (uint32_t i = 0; i < LOG_RING_SLOTS; i++) {
+        logRing[i].seq = i;
+    }
+    logDrainLock = xSemaphoreCreateMutex();
+    if (logDrainLock == nullptr ||
+        xTaskCreate(logTask, "log", LOG_TASK_STACK, nullptr, LOG_TASK_PRIORITY, &logTaskHandle) != pdPASS) {
+        Serial.println("Log task failed to start, logging synchronously");
+        return;
+    }
+    logReady = true;
+}
+
+void logCapture(LogLevel level, const char* format, va_list args) {
+    if (!logReady) {
+        char buffer[256];
+        vsnprintf(buffer, sizeof(buffer), format, args);
+        char timestamp[32];
+        formatUptime(millis(), timestamp, sizeof(timestamp));
+        Serial.printf("[%s][%s] %s\n", timestamp, getLogLevelString(level), buffer);
+        return;
+    }
+    uint32_t pos;
+    LogRecord* rec = reserveRecord(&pos);
+    if (rec == nullptr) return;
+    rec->ms = millis();
+    rec->level = level;
+    rec->literal = false;
+    va_list packed;
+    va_copy(packed, args);
+    bool ok = packArgs(format, packed, rec->payload, &rec->size);
+    va_end(packed);
+    if (ok) {
+        rec->format = format;
+    } else {
+        vsnprintf((char*)rec->payload, LOG_RECORD_BYTES, format, args);
+        rec->format = nullptr;
+        logFallbacks++;
+    }
+    publishRecord(rec, pos);
+}
+
+void logCaptureText(LogLevel level, const char* text) {
+    if (!logReady) {
+        char timestamp[32];
+        formatUptime(millis(), timestamp, sizeof(timestamp));
+        Serial.printf("[%s][%s] %s\n", timestamp, getLogLevelString(level), text);
+        return;
+    }
+    uint32_t pos;
+    LogRecord* rec = reserveRecord(&pos);
+    if (rec == nullptr) return;
+    rec->ms = millis();
+    rec->level = level;
+    if (esp_ptr_in_drom(text)) {
+        // String literal in flash: keep the pointer, it can be tokenised
+        rec->format = text;
+        rec->literal = true;
+    } else {
+        rec->format = nullptr;
+        rec->literal = false;
+        strncpy((char*)rec->payload, text, LOG_RECORD_BYTES - 1);
+        rec->payload[LOG_RECORD_BYTES - 1] = '\0';
+    }
+    publishRecord(rec, pos);
+}
+
+// Write everything queued so far from the calling task (before a restart)
+void flushLogs() {
+    if (!logReady) return;
+    xSemaphoreTake(logDrainLock, portMAX_DELAY);
+    while (writeOneRecord()) {
+    }
+    xSemaphoreGive(logDrainLock);
+    Serial.flush();
+}
+
+void printLogBufferStats() {
+    logf(LOG_INFO, "  Log Ring: %lu/%u in flight (peak %lu), %lu captured, %lu written",
+         (unsigned long)(logHead - logTail), LOG_RING_SLOTS, (unsigned long)logHighWater,
+         (unsigned long)logCaptured.value, (unsigned long)logWritten.value);
+    logf(LOG_INFO, "  Log Ring: %lu dropped when full, %lu formatted at capture",
+         (unsigned long)logDropped.value, (unsigned long)logFallbacks);
+    logf(LOG_INFO, "  Log Output: %s, %lu bytes, %lu bytes/message", logTokenized ? "tokenised" : "text",
+         (unsigned long)logBytesOut, (unsigned long)(logWritten.value ? logBytesOut / logWritten.value : 0));
+}
+
+// Tokenised output needs tools/logdecode.py on the host to read. Records
+// already queued are written in the old mode first.
+void setLogTokenized(bool tokenized) {
+    if (!logReady) {
+        logTokenized = tokenized;
+        logFramesToSync = 0;
+        return;
+    }
+    xSemaphoreTake(logDrainLock, portMAX_DELAY);
+    while (writeOneRecord()) {
+    }
+    logTokenized = tokenized;
+    logFramesToSync = 0;  // The decoder may have just attached
+    xSemaphoreGive(logDrainLock);
+}
+
+bool isLogTokenized() {
+    return logTokenized;
+}
+
+// Per-call capture cost, measured on the loop task with the ring drained
+void runLogBenchmark() {
+    const int calls = LOG_RING_SLOTS / 2;
+    flushLogs();
+    uint32_t start = ESP.getCycleCount();
+    for (int i = 0; i < calls; i++) {
+        logf(LOG_ERROR, "logbench %d: channel %u, %s", i, currentAmpChannel, "ok");
+    }
+    uint32_t cycles = ESP.getCycleCount() - start;
+    flushLogs();
+    uint32_t perCall = cycles / calls;
+    logf(LOG_INFO, "Log capture: %lu cycles/call (%lu ns at %lu MHz), %d calls",
+         (unsigned long)perCall, (unsigned long)(perCall * 1000UL / ESP.getCpuFreqMHz()),
+         (unsigned long)ESP.getCpuFreqMHz(), calls);
+}
+
+#else
+
+void initLogBuffer() {
+}
+
+void logCapture(LogLevel level, const char* format, va_list args) {
+    char buffer[256];
+    vsnprintf(buffer, sizeof(buffer), format, args);
+    char timestamp[32];
+    formatUptime(millis(), timestamp, sizeof(timestamp));
+    Serial.printf("[%s][%s] %s\n", timestamp, getLogLevelString(level), buffer);
+}
+
+void logCaptureText(LogLevel level, const char* text) {
+    char timestamp[32];
+    formatUptime(millis(), timestamp, sizeof(timestamp));
+    Serial.printf("[%s][%s] %s\n", timestamp, getLogLevelString(level), text);
+}
+
+void flushLogs() {
+    Serial.flush();
+}
+
+void printLogBufferStats() {
+    log(LOG_INFO, "  Log Ring: Disabled (LOG_ASYNC=0, synchronous serial writes)");
+}
+
+void setLogTokenized(bool tokenized) {
+    if (tokenized) log(LOG_WARN, "Tokenised logging needs LOG_ASYNC");
+}
+
+bool isLogTokenized() {
+    return false;
+}
+
+void runLogBenchmark() {
+    log(LOG_WARN, "Log benchmark needs LOG_ASYNC");
+}
+
+#endif
@@ -0,0 +1,100 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <Arduino.h>
+#include "logRateLimit.h"
+#include "utils.h"
+#include "metrics.h"
+
+static portMUX_TYPE rateMux = portMUX_INITIALIZER_UNLOCKED;
+static LogRateLimit* rateSites[LOG_RATE_SITES];
+static uint8_t rateSiteCount = 0;
+
+static MetricCounter ratePassed("log_rate_passed_total", "Rate limited log lines let through");
+static MetricCounter rateSuppressed("log_rate_suppressed_total", "Rate limited log lines suppressed");
+static uint32_t rateSummaries = 0;
+static uint32_t rateUntracked = 0;   // Suppressing sites beyond LOG_RATE_SITES
+
+static void logRateSummary(const LogRateLimit& limit, uint32_t count) {
+    logf(limit.level, "\"%s\" repeated %lu more times", limit.format, (unsigned long)count);
+}
+
+bool logRateAllow(LogRateLimit& limit) {
+    uint32_t now = millis();
+    uint32_t pending = 0;
+    bool allowed;
+
+    portENTER_CRITICAL(&rateMux);
+    uint32_t refill = (now - limit.lastRefill) / LOG_RATE_INTERVAL_MS;
+    if (refill) {
+        uint32_t tokens = limit.tokens + refill;
+        limit.tokens = tokens < LOG_RATE_BURST ? tokens : LOG_RATE_BURST;
+        limit.lastRefill += refill * LOG_RATE_INTERVAL_MS;
+    }
+    allowed = limit.tokens > 0;
+    if (allowed) {
+        limit.tokens--;
+        pending = limit.suppressed;
+        limit.suppressed = 0;
+        ratePassed.inc();
+        if (pending) rateSummaries++;
+    } else {
+        limit.suppressed++;
+        limit.totalSuppressed++;
+        rateSuppressed.inc();
+        if (!limit.registered) {
+            if (rateSiteCount < LOG_RATE_SITES) {
+                rateSites[rateSiteCount++] = &limit;
+                limit.registered = true;
+            } else {
+                rateUntracked++;
+            }
+        }
+    }
+    portEXIT_CRITICAL(&rateMux);
+
+    if (pending) logRateSummary(limit, pending);
+    return allowed;
+}
+
+// A site that stops logging mid-storm would keep its count until its next
+// message; report it once a full interval has passed without a call
+void flushLogRateLimits() {
+    uint32_t now = millis();
+    for (uint8_t i = 0; i < rateSiteCount; i++) {
+        LogRateLimit& limit = *rateSites[i];
+        uint32_t pending = 0;
+        portENTER_CRITICAL(&rateMux);
+        if (limit.suppressed && now - limit.lastRefill >= LOG_RATE_INTERVAL_MS) {
+            pending = limit.suppressed;
+            limit.suppressed = 0;
+            rateSummaries++;
+        }
+        portEXIT_CRITICAL(&rateMux);
+        if (pending) logRateSummary(limit, pending);
+    }
+}
+
+void printLogRateStats() {
+    logf(LOG_INFO, "  Log Rate Limit: %lu passed, %lu suppressed, %lu summaries (burst %u, 1 per %ums)",
+         (unsigned long)ratePassed.value, (unsigned long)rateSuppressed.value, (unsigned long)rateSummaries,
+         LOG_RATE_BURST, LOG_RATE_INTERVAL_MS);
+    for (uint8_t i = 0; i < rateSiteCount; i++) {
+        logf(LOG_INFO, "    %lu suppressed: %s", (unsigned long)rateSites[i]->totalSuppressed,
+             rateSites[i]->format);
+    }
+    if (rateUntracked) {
+        logf(LOG_INFO, "    %lu suppressions from sites beyond LOG_RATE_SITES", (unsigned long)rateUntracked);
+    }
+}
@@ -30,6 +30,17 @@
 #include <commandHandler.h>
 #include "nvsManager.h"
 #include "debug.h"
+#include "buttonDebounce.h"
+#include "buttonMatrix.h"
+#include "expressionPedal.h"
+#include "scenes.h"
+#include "relayVerify.h"
+#include "relayStats.h"
+#include "commandCoalescer.h"
+#include "logBuffer.h"
+#include "eventLog.h"
+#include "logRateLimit.h"
+#include "telemetry.h"
 
 MessageType messageType;
 MIDI_CREATE_INSTANCE(HardwareSerial, Serial1, MIDI);
@@ -62,9 +73,11 @@ void setup() {
 void initializeSystemAndLogging() {
     delay(5000);
     Serial.begin(115200);
+    initLogBuffer();
+    initEventLog();
     
-    // Initialize performance metrics
-    perfMetrics.startTime = millis();
+    // Free heap baseline for the memory metrics and leak check
+    updateMemoryStats();
     
     // Load log level from NVS
     currentLogLevel = loadLogLevelFromNVS();
@@ -75,6 +88,9 @@ void initializeSystemAndLogging() {
     // Load MIDI mapping from NVS
     loadMidiMapFromNVS();
     loadMidiChannelFromNVS();
+    initButtonDebounce();
+    initScenes();
+    initRelayStats();
     
     log(LOG_INFO, "=== ESP32 Client Starting ===");
     logf(LOG_INFO, "Firmware Version: %s", FIRMWARE_VERSION);
@@ -82,12 +98,8 @@ void initializeSystemAndLogging() {
 }
 
 void initializeHardware() {
-    // Setup pairing LED
-    pinMode(PAIRING_LED_PIN, OUTPUT);
-    ledcSetup(LEDC_CHANNEL_0, LEDC_BASE_FREQ, LEDC_TIMER_13_BIT);
-    ledcAttachPin(PAIRING_LED_PIN, LEDC_CHANNEL_0);
-    logf(LOG_DEBUG, "Pairing LED initialized on pin %d", PAIRING_LED_PIN);
-    setStatusLedPattern(LED_OFF);
+    // Setup pairing / status LED
+    initStatusLed();
     
     log(LOG_INFO, "Hardware initialization complete");
 }
@@ -123,8 +135,8 @@ bool checkForOTATrigger() {
         delay(10);
         if (serialOtaTrigger) break;
 
-        // Check for long press on button 1 (ampButtonPins[0])
-        int button1State = digitalRead(ampButtonPins[0]);
+        // Check for long press on button 1 (direct pin or matrix key 1)
+        int button1State = readButtonLevel(0);
         if (button1State == LOW && !button1WasPressed) {
             button1PressStart = millis();
             button1WasPressed = true;
@@ -183,9 +195,25 @@ void initializeMIDI() {
     log(LOG_DEBUG, "Initializing MIDI...");
     Serial1.begin(31250, SERIAL_8N1, MIDI_RX_PIN, MIDI_TX_PIN);
     MIDI.setHandleProgramChange(handleProgramChange);
+    MIDI.setHandleControlChange(handleControlChange);
     MIDI.begin(MIDI_CHANNEL_OMNI); // Listen to all channels
     MIDI.turnThruOn();             // Pass incoming MIDI to output (MIDI THRU)
     logf(LOG_INFO, "MIDI initialized on pins RX:%u TX:%u", MIDI_RX_PIN, MIDI_TX_PIN);
+    
+    // Expression pedal sampling runs on its own timer once MIDI TX is up
+    initExpressionPedal();
+}
+
+// Forward a changed expression pedal value to MIDI TX and the server.
+// Constant time when nothing changed - sampling and filtering happen off-loop.
+void processExpressionPedal() {
+#if HAS_EXPRESSION_PEDAL
+    uint8_t value;
+    if (pollExpressionPedal(&value)) {
+        MIDI.sendControlChange(EXPRESSION_CC, value, currentMidiChannel);
+        sendExpressionData(value);
+    }
+#endif
 }
 
 // Forward declarations for loop helper functions
@@ -198,6 +226,8 @@ void loop() {
     // Ultra-fast loop for minimum latency
     checkAmpChannelButtons();    // Highest priority - button response
     MIDI.read();                 // Second priority - MIDI response
+    pollCommandCoalescer();      // Settle bursts on time, one flag test when idle
+    processExpressionPedal();    // Change-only, rate limited
     updateStatusLED();           // Visual feedback
     
     // Reduce frequency of non-critical tasks
@@ -219,7 +249,7 @@ void loop() {
     
     #else
     // Standard loop with performance monitoring
-    unsigned long loopStart = millis();
+    uint32_t loopStart = micros();
     
     processMainTasks();
     
@@ -230,8 +260,7 @@ void loop() {
     }
     
     // Update performance metrics
-    unsigned long loopTime = millis() - loopStart;
-    updatePerformanceMetrics(loopTime);
+    updatePerformanceMetrics(micros() - loopStart);
     
     performPeriodicTasks();
     #endif
@@ -245,6 +274,9 @@ void processMainTasks() {
 
     // Process MIDI messages
     MIDI.read();
+    // Apply the net state of a finished remote/MIDI command burst
+    pollCommandCoalescer();
+    processExpressionPedal();
 
     // Handle pairing if not paired (but don't return early)
     if (pairingStatus != PAIR_PAIRED) {
@@ -257,10 +289,24 @@ void handleOTAMode() {
     updateStatusLED();
     startOTA_AP();
     serialOtaTrigger = false; // Prevent re-entry
+    recordEvent(EVENT_RESTART, "OTA mode ended");
     ESP.restart(); // Optional: reboot after OTA
 }
 
 void performPeriodicTasks() {
+    // Confirm relay readback mismatches and due sense-input checks
+    pollRelayVerify();
+    // Relay on-time sampling and batched wear journal writes
+    updateRelayStats();
+    // Pairing status changes into the postmortem event log
+    updateEventLog();
+    // "repeated N more times" for rate limited log sites that went quiet
+    flushLogRateLimits();
+    // Streamed telemetry frames (telemetry stream)
+    pollTelemetry();
+    // Paced STATUS_REQUEST reply frames
+    pollStatusReply();
+    
     // Periodic memory check (every 30 seconds)
     static unsigned long lastMemoryCheck = 0;
     if (millis() - lastMemoryCheck > 30000) {
@@ -270,5 +316,8 @@ void performPeriodicTasks() {
         if (freeHeap < 10000) { // Warning if less than 10KB free
             logf(LOG_WARN, "Low memory warning: %uB free", freeHeap);
         }
+        
+        // Persist adapted debounce windows (rate limited, only when changed)
+        saveButtonDebounceIfChanged();
     }
 }
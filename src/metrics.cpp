@@ -0,0 +1,134 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <Arduino.h>
+#include "metrics.h"
+#include "utils.h"
+#include <stdarg.h>
+
+static portMUX_TYPE metricMux = portMUX_INITIALIZER_UNLOCKED;
+static Metric* metricTable[METRICS_MAX];
+static uint8_t metricCount = 0;
+static uint8_t metricsUnregistered = 0;  // Defined beyond METRICS_MAX
+
+// Runs from static constructors, before setup() and any other task
+Metric::Metric(const char* name, const char* help, MetricKind kind, uint32_t initial)
+    : name(name), help(help), value(initial), kind(kind) {
+    if (metricCount < METRICS_MAX) {
+        metricTable[metricCount++] = this;
+    } else {
+        metricsUnregistered++;
+    }
+}
+
+void MetricCounter::incShared() {
+    portENTER_CRITICAL(&metricMux);
+    value = value + 1;
+    portEXIT_CRITICAL(&metricMux);
+}
+
+uint8_t getMetricCount() {
+    return metricCount;
+}
+
+const Metric* getMetric(uint8_t index) {
+    return index < metricCount ? metricTable[index] : nullptr;
+}
+
+uint32_t getMetricBucketBound(uint8_t bucket) {
+    if (bucket >= METRIC_HISTOGRAM_BUCKETS - 1) return UINT32_MAX;
+    return (1UL << bucket) - 1;
+}
+
+// Smallest bucket bound covering the given share (per mille) of samples
+static uint32_t histogramQuantile(const MetricHistogram& h, uint32_t count, uint32_t perMille) {
+    uint64_t target = ((uint64_t)count * perMille + 999) / 1000;
+    uint32_t seen = 0;
+    for (uint8_t b = 0; b < METRIC_HISTOGRAM_BUCKETS; b++) {
+        seen += h.buckets[b];
+        if (seen >= target) return b == METRIC_HISTOGRAM_BUCKETS - 1 ? h.max : getMetricBucketBound(b);
+    }
+    return h.max;
+}
+
+void printMetrics() {
+    logf(LOG_INFO, "Metrics (%u of %u registered):", metricCount, METRICS_MAX);
+    for (uint8_t i = 0; i < metricCount; i++) {
+        const Metric* m = metricTable[i];
+        uint32_t value = m->value;
+        if (m->kind != METRIC_HISTOGRAM) {
+            logf(LOG_INFO, "  %-26s %lu", m->name, (unsigned long)value);
+            continue;
+        }
+        const MetricHistogram* h = static_cast<const MetricHistogram*>(m);
+        if (value == 0) {
+            logf(LOG_INFO, "  %-26s no samples", m->name);
+            continue;
+        }
+        logf(LOG_INFO, "  %-26s n=%lu avg=%lu min=%lu max=%lu p50<=%lu p99<=%lu", m->name,
+             (unsigned long)value, (unsigned long)(h->sum / value), (unsigned long)h->min,
+             (unsigned long)h->max, (unsigned long)histogramQuantile(*h, value, 500),
+             (unsigned long)histogramQuantile(*h, value, 990));
+    }
+    if (metricsUnregistered) {
+        logf(LOG_WARN, "  %u metrics not registered, raise METRICS_MAX", metricsUnregistered);
+    }
+}
+
+// One line per write, so the log task's lines cannot split it
+static void writeMetricLine(const char* format, ...) {
+    char line[160];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(line, sizeof(line) - 1, format, args);
+    va_end(args);
+    if (len < 0) return;
+    if (len > (int)sizeof(line) - 2) len = sizeof(line) - 2;
+    line[len++] = '\n';
+    Serial.write((const uint8_t*)line, len);
+}
+
+static void writeMetricHeader(const char* name, const char* suffix, const char* help, const char* type) {
+    writeMetricLine("# HELP " METRICS_PREFIX "%s%s %s", name, suffix, help);
+    writeMetricLine("# TYPE " METRICS_PREFIX "%s%s %s", name, suffix, type);
+}
+
+static void writeHistogram(const MetricHistogram& h) {
+    writeMetricHeader(h.name, "", h.help, "histogram");
+    uint32_t cumulative = 0;
+    for (uint8_t b = 0; b < METRIC_HISTOGRAM_BUCKETS - 1; b++) {
+        cumulative += h.buckets[b];
+        writeMetricLine(METRICS_PREFIX "%s_bucket{le=\"%lu\"} %lu", h.name,
+                        (unsigned long)getMetricBucketBound(b), (unsigned long)cumulative);
+    }
+    cumulative += h.buckets[METRIC_HISTOGRAM_BUCKETS - 1];
+    writeMetricLine(METRICS_PREFIX "%s_bucket{le=\"+Inf\"} %lu", h.name, (unsigned long)cumulative);
+    writeMetricLine(METRICS_PREFIX "%s_sum %llu", h.name, (unsigned long long)h.sum);
+    writeMetricLine(METRICS_PREFIX "%s_count %lu", h.name, (unsigned long)cumulative);
+    writeMetricHeader(h.name, "_max", "Largest sample", "gauge");
+    writeMetricLine(METRICS_PREFIX "%s_max %lu", h.name, (unsigned long)h.max);
+}
+
+void printMetricsPrometheus() {
+    for (uint8_t i = 0; i < metricCount; i++) {
+        const Metric* m = metricTable[i];
+        if (m->kind == METRIC_HISTOGRAM) {
+            writeHistogram(*static_cast<const MetricHistogram*>(m));
+            continue;
+        }
+        writeMetricHeader(m->name, "", m->help, m->kind == METRIC_COUNTER ? "counter" : "gauge");
+        writeMetricLine(METRICS_PREFIX "%s %lu", m->name, (unsigned long)m->value);
+    }
+    writeMetricLine("# EOF");
+}
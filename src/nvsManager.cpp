@@ -17,6 +17,8 @@
 #include "globals.h"
 #include "debug.h"
 #include "utils.h"
+#include "scenes.h"
+#include "relayStats.h"
 #include <Preferences.h>
 
 void saveMidiMapToNVS() {
@@ -180,6 +182,160 @@ void clearLogLevelNVS() {
     }
 }
 
+// Button debounce NVS functions
+void saveButtonDebounceToNVS(const uint32_t* windowsUs) {
+    Preferences nvs;
+    if (nvs.begin("buttons", false)) {
+        size_t expectedSize = NUM_BUTTONS * sizeof(uint32_t);
+        size_t written = nvs.putBytes("debounce", windowsUs, expectedSize);
+        if (written != expectedSize) {
+            logf(LOG_ERROR, "Debounce save incomplete: wrote %zu bytes, expected %zu", written, expectedSize);
+        }
+        nvs.putInt("version", STORAGE_VERSION);
+        nvs.end();
+        log(LOG_DEBUG, "Button debounce windows saved to NVS");
+    } else {
+        log(LOG_ERROR, "Failed to save button debounce windows to NVS");
+    }
+}
+
+bool loadButtonDebounceFromNVS(uint32_t* windowsUs) {
+    Preferences nvs;
+    bool success = false;
+    if (nvs.begin("buttons", true)) {
+        size_t expectedSize = NUM_BUTTONS * sizeof(uint32_t);
+        if (nvs.getInt("version", 0) != STORAGE_VERSION) {
+            log(LOG_DEBUG, "No button debounce data for this storage version");
+        } else if (nvs.getBytesLength("debounce") != expectedSize) {
+            log(LOG_DEBUG, "Button debounce data size mismatch, using defaults");
+        } else {
+            success = nvs.getBytes("debounce", windowsUs, expectedSize) == expectedSize;
+        }
+        nvs.end();
+    }
+    return success;
+}
+
+// Expression pedal NVS functions
+void saveExpressionCalibrationToNVS(uint16_t calMin, uint16_t calMax) {
+    Preferences nvs;
+    if (nvs.begin("expression", false)) {
+        nvs.putUShort("cal_min", calMin);
+        nvs.putUShort("cal_max", calMax);
+        nvs.putInt("version", STORAGE_VERSION);
+        nvs.end();
+        logf(LOG_DEBUG, "Expression calibration saved to NVS: %u-%u", calMin, calMax);
+    } else {
+        log(LOG_ERROR, "Failed to save expression calibration to NVS");
+    }
+}
+
+bool loadExpressionCalibrationFromNVS(uint16_t* calMin, uint16_t* calMax) {
+    Preferences nvs;
+    bool success = false;
+    if (nvs.begin("expression", true)) {
+        if (nvs.getInt("version", 0) == STORAGE_VERSION && nvs.isKey("cal_min") && nvs.isKey("cal_max")) {
+            *calMin = nvs.getUShort("cal_min", *calMin);
+            *calMax = nvs.getUShort("cal_max", *calMax);
+            success = true;
+        }
+        nvs.end();
+    }
+    return success;
+}
+
+// Relay scene NVS functions
+// Stored packed: per scene ceil(MAX_AMPSWITCHS/8) output bytes + 1 program byte
+static const size_t SCENE_MASK_BYTES = (MAX_AMPSWITCHS + 7) / 8;
+static const size_t SCENE_RECORD_BYTES = SCENE_MASK_BYTES + 1;
+
+void saveScenesToNVS(const AmpScene* scenes) {
+    uint8_t packed[MAX_SCENES * SCENE_RECORD_BYTES];
+    for (int i = 0; i < MAX_SCENES; i++) {
+        uint8_t* rec = &packed[i * SCENE_RECORD_BYTES];
+        for (size_t b = 0; b < SCENE_MASK_BYTES; b++) {
+            rec[b] = (scenes[i].outputs >> (8 * b)) & 0xFF;
+        }
+        rec[SCENE_MASK_BYTES] = scenes[i].program;
+    }
+    
+    Preferences nvs;
+    if (nvs.begin("scenes", false)) {
+        size_t written = nvs.putBytes("scenes", packed, sizeof(packed));
+        if (written != sizeof(packed)) {
+            logf(LOG_ERROR, "Scene save incomplete: wrote %zu bytes, expected %zu", written, sizeof(packed));
+        }
+        nvs.putInt("version", STORAGE_VERSION);
+        nvs.end();
+        logf(LOG_INFO, "Relay scenes saved to NVS (%zu bytes)", sizeof(packed));
+    } else {
+        log(LOG_ERROR, "Failed to save relay scenes to NVS");
+    }
+}
+
+bool loadScenesFromNVS(AmpScene* scenes) {
+    uint8_t packed[MAX_SCENES * SCENE_RECORD_BYTES];
+    Preferences nvs;
+    bool success = false;
+    if (nvs.begin("scenes", true)) {
+        if (nvs.getInt("version", 0) != STORAGE_VERSION) {
+            log(LOG_DEBUG, "No relay scenes for this storage version, using defaults");
+        } else if (nvs.getBytesLength("scenes") != sizeof(packed)) {
+            log(LOG_WARN, "Relay scene size mismatch, using defaults");
+        } else if (nvs.getBytes("scenes", packed, sizeof(packed)) == sizeof(packed)) {
+            const uint32_t validOutputs = (MAX_AMPSWITCHS >= 32) ? 0xFFFFFFFFUL : ((1UL << MAX_AMPSWITCHS) - 1);
+            for (int i = 0; i < MAX_SCENES; i++) {
+                const uint8_t* rec = &packed[i * SCENE_RECORD_BYTES];
+                uint32_t outputs = 0;
+                for (size_t b = 0; b < SCENE_MASK_BYTES; b++) {
+                    outputs |= (uint32_t)rec[b] << (8 * b);
+                }
+                scenes[i].outputs = outputs & validOutputs;
+                uint8_t program = rec[SCENE_MASK_BYTES];
+                scenes[i].program = (program <= 127) ? program : SCENE_NO_PROGRAM;
+            }
+            success = true;
+            log(LOG_INFO, "Relay scenes loaded from NVS");
+        }
+        nvs.end();
+    }
+    return success;
+}
+
+// Relay wear journal NVS functions. One record under one key: NVS writes the
+// new entry before erasing the old one and checksums both, so rotating keys
+// would add nothing.
+void saveRelayStatsToNVS(const RelayStatsRecord* record) {
+    Preferences nvs;
+    if (nvs.begin("relaystats", false)) {
+        size_t written = nvs.putBytes("journal", record, sizeof(RelayStatsRecord));
+        if (written != sizeof(RelayStatsRecord)) {
+            logf(LOG_ERROR, "Relay stats save incomplete: wrote %zu bytes, expected %zu", written, sizeof(RelayStatsRecord));
+        }
+        nvs.putInt("version", STORAGE_VERSION);
+        nvs.end();
+        logf(LOG_DEBUG, "Relay stats journal record %lu saved", (unsigned long)record->seq);
+    } else {
+        log(LOG_ERROR, "Failed to save relay stats to NVS");
+    }
+}
+
+bool loadRelayStatsFromNVS(RelayStatsRecord* record) {
+    Preferences nvs;
+    bool success = false;
+    if (nvs.begin("relaystats", true)) {
+        if (nvs.getInt("version", 0) != STORAGE_VERSION) {
+            log(LOG_DEBUG, "No relay stats for this storage version, starting from zero");
+        } else if (nvs.getBytesLength("journal") == sizeof(RelayStatsRecord) && // Else other MAX_AMPSWITCHS
+                   nvs.getBytes("journal", record, sizeof(RelayStatsRecord)) == sizeof(RelayStatsRecord)) {
+            success = true;
+            logf(LOG_INFO, "Relay stats loaded from NVS (journal seq %lu)", (unsigned long)record->seq);
+        }
+        nvs.end();
+    }
+    return success;
+}
+
 // ESP-NOW pairing NVS functions
 void clearPairingNVS() {
     Preferences nvs;
@@ -17,6 +17,8 @@
 #include <ElegantOTA.h>
 #include <globals.h>
 #include "utils.h"
+#include "logBuffer.h"
+#include "eventLog.h"
 
 WebServer server(80);
 
@@ -27,6 +29,8 @@ void startOTA() {
 
   if (!wm.autoConnect("OTA_Config_Portal")) {
     log(LOG_ERROR, "Failed to connect to WiFi during OTA setup");
+    recordEvent(EVENT_RESTART, "OTA WiFi setup failed");
+    flushLogs();
     ESP.restart();
   }
 
@@ -54,6 +58,7 @@ void startOTA() {
   server.on("/reboot", HTTP_POST, []() {
     server.send(200, "text/plain", "Rebooting...");
     log(LOG_INFO, "Reboot requested via web interface");
+    recordEvent(EVENT_RESTART, "OTA web interface");
     delay(1000);
     ESP.restart();
   });
@@ -72,6 +77,8 @@ void startOTA() {
   }
 
   log(LOG_WARN, "OTA timeout reached, rebooting...");
+  recordEvent(EVENT_RESTART, "OTA timeout");
+  flushLogs();
   ESP.restart();
 }
 
@@ -95,6 +102,9 @@ void startOTA_AP() {
     server.begin();
     Serial.println("ElegantOTA server started. Connect to the AP and go to http://192.168.4.1/update");
     ElegantOTA.setAutoReboot(true);
+    ElegantOTA.onEnd([](bool success) {
+        recordEvent(EVENT_OTA, success ? 1 : 0, 0);
+    });
     // 4. Main OTA loop (blocks until timeout or reboot)
     unsigned long start = millis();
     const unsigned long TIMEOUT = 5 * 60 * 1000; // 5 minutes
@@ -106,5 +116,6 @@ void startOTA_AP() {
     }
 
     Serial.println("OTA timeout reached, rebooting...");
+    recordEvent(EVENT_RESTART, "OTA timeout");
     ESP.restart();
 }
\ No newline at end of file
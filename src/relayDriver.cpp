@@ -0,0 +1,359 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <Arduino.h>
+#include "relayDriver.h"
+#include "relayGroups.h"
+#include "globals.h"
+#include "utils.h"
+
+#if RELAY_DRIVE_MODE != RELAY_DRIVE_LEVEL
+#include <esp_timer.h>
+#endif
+#if RELAY_OUTPUT_BACKEND == RELAY_BACKEND_SHIFT_REG
+#include <SPI.h>
+#endif
+
+uint32_t ampChannelSetMask[MAX_AMPSWITCHS + 1] = {0};
+uint32_t ampChannelClearMask[MAX_AMPSWITCHS + 1] = {0};
+uint32_t ampRelayMask = 0;
+
+// Channel N clears the other outputs of its exclusive group, never its own,
+// so re-asserting an active relay cannot glitch it. Independent outputs clear
+// nothing; turning one off uses its set mask as the clear mask.
+static void initRelayGroupClearMasks() {
+    for (int ch = 1; ch <= MAX_AMPSWITCHS; ch++) {
+        uint32_t bit = 1UL << (ch - 1);
+        if (RELAY_INDEPENDENT_OUTPUTS & bit) {
+            ampChannelClearMask[ch] = 0;
+        } else {
+            ampChannelClearMask[ch] = relayOutputsToGpioMask(ampChannelGroupOutputs[ch] & ~bit);
+        }
+    }
+}
+
+// Must run after initShiftRegister() with the shift register backend
+void initRelayMasks() {
+#if RELAY_OUTPUT_BACKEND == RELAY_BACKEND_SHIFT_REG
+    // Output N is shift register bit N
+    ampRelayMask = (MAX_AMPSWITCHS >= 32) ? 0xFFFFFFFFUL : ((1UL << MAX_AMPSWITCHS) - 1);
+    ampChannelSetMask[0] = 0;
+    ampChannelClearMask[0] = ampRelayMask;
+    for (int ch = 1; ch <= MAX_AMPSWITCHS; ch++) {
+        ampChannelSetMask[ch] = 1UL << (ch - 1);
+    }
+    initRelayGroupClearMasks();
+    logf(LOG_DEBUG, "Relay masks initialized (%d shift register outputs, %s, %uus)",
+         MAX_AMPSWITCHS, getRelaySwitchOrderString(), RELAY_SWITCH_GAP_US);
+    return;
+#endif
+    // Pins are validated at compile time, all within the GPIO register
+    ampRelayMask = AMP_SWITCH_PIN_MASK;
+
+    // Channel 0: nothing to set, everything to clear
+    ampChannelSetMask[0] = 0;
+    ampChannelClearMask[0] = ampRelayMask;
+
+    // Channel N: only its own bit set
+    for (int ch = 1; ch <= MAX_AMPSWITCHS; ch++) {
+        ampChannelSetMask[ch] = 1UL << ampSwitchPins[ch - 1];
+    }
+    initRelayGroupClearMasks();
+
+    logf(LOG_DEBUG, "Relay masks initialized (all: 0x%08lX, %s, %uus)",
+         (unsigned long)ampRelayMask, getRelaySwitchOrderString(), RELAY_SWITCH_GAP_US);
+}
+
+// Output bitmask (bit N = ampSwitchPins[N]) to GPIO register bits
+uint32_t relayOutputsToGpioMask(uint32_t outputs) {
+    uint32_t gpio = 0;
+    for (int i = 0; i < MAX_AMPSWITCHS; i++) {
+        if (outputs & (1UL << i)) {
+            gpio |= ampChannelSetMask[i + 1];
+        }
+    }
+    return gpio;
+}
+
+// Drive an arbitrary output bitmask with whichever drive mode is configured
+void driveRelayOutputs(uint32_t outputs) {
+#if RELAY_DRIVE_MODE == RELAY_DRIVE_LEVEL
+    uint32_t setMask = relayOutputsToGpioMask(outputs);
+    writeRelayMasks(setMask, ampRelayMask & ~setMask);
+#else
+    requestRelayOutputs(outputs);
+#endif
+}
+
+#if RELAY_OUTPUT_BACKEND == RELAY_BACKEND_SHIFT_REG
+static uint32_t shiftRegState = 0;     // Last latched outputs
+static uint32_t shiftRegTransfers = 0;
+static uint32_t shiftRegMaxUs = 0;     // Longest transfer + latch
+static const SPISettings shiftRegSettings(SHIFT_REG_SPI_HZ, MSBFIRST, SPI_MODE0);
+
+// Two back-to-back GPIO stores can leave RCLK high for little more than one
+// APB cycle (12.5ns), short of the 74HC595's tW at 3.3V (80ns at 2V), so
+// the latch is held for SHIFT_REG_LATCH_HOLD_NS on the cycle counter
+static inline void holdLatchHigh() {
+    uint32_t cycles = (SHIFT_REG_LATCH_HOLD_NS * ESP.getCpuFreqMHz() + 999) / 1000;
+    uint32_t start = ESP.getCycleCount();
+    while (ESP.getCycleCount() - start < cycles) {
+    }
+}
+
+// Shift out the whole chain and latch it. The SPI transaction lock also
+// serialises the shadow state between the loop and timer callbacks.
+void shiftRegisterUpdate(uint32_t setMask, uint32_t clearMask) {
+    uint8_t frame[SHIFT_REG_CHIPS];
+    uint32_t start = micros();
+
+    SPI.beginTransaction(shiftRegSettings);
+    shiftRegState = (shiftRegState & ~clearMask) | setMask;
+    // Furthest chip first; MSBFIRST puts bit 7 on Q7
+    for (int c = 0; c < SHIFT_REG_CHIPS; c++) {
+        frame[c] = (uint8_t)(shiftRegState >> (8 * (SHIFT_REG_CHIPS - 1 - c)));
+    }
+    SPI.writeBytes(frame, SHIFT_REG_CHIPS);
+    // Storage register loads on the RCLK rising edge
+    REG_WRITE(GPIO_OUT_W1TS_REG, 1UL << SHIFT_REG_LATCH_PIN);
+    holdLatchHigh();
+    REG_WRITE(GPIO_OUT_W1TC_REG, 1UL << SHIFT_REG_LATCH_PIN);
+    SPI.endTransaction();
+
+    uint32_t elapsed = micros() - start;
+    if (elapsed > shiftRegMaxUs) {
+        shiftRegMaxUs = elapsed;
+    }
+    shiftRegTransfers++;
+}
+
+uint32_t getShiftRegisterState() {
+    return shiftRegState;
+}
+
+static void printShiftRegisterStats() {
+    logf(LOG_INFO, "  Shift Register: %d chip(s), state 0x%08lX, %lu transfers, max %luus",
+         SHIFT_REG_CHIPS, (unsigned long)shiftRegState, (unsigned long)shiftRegTransfers,
+         (unsigned long)shiftRegMaxUs);
+}
+
+void initShiftRegister() {
+#ifdef SHIFT_REG_OE_PIN
+    // Outputs off until the registers hold a known state
+    pinMode(SHIFT_REG_OE_PIN, OUTPUT);
+    digitalWrite(SHIFT_REG_OE_PIN, HIGH);
+#endif
+    pinMode(SHIFT_REG_LATCH_PIN, OUTPUT);
+    digitalWrite(SHIFT_REG_LATCH_PIN, LOW);
+    SPI.begin(SHIFT_REG_CLOCK_PIN, -1, SHIFT_REG_DATA_PIN, -1);
+
+    shiftRegisterUpdate(0, 0xFFFFFFFFUL); // All relays off at boot
+#ifdef SHIFT_REG_OE_PIN
+    digitalWrite(SHIFT_REG_OE_PIN, LOW);
+#endif
+    logf(LOG_INFO, "Shift register outputs: %d x 74HC595 (data %u, clock %u, latch %u, %luHz)",
+         SHIFT_REG_CHIPS, SHIFT_REG_DATA_PIN, SHIFT_REG_CLOCK_PIN, SHIFT_REG_LATCH_PIN,
+         (unsigned long)SHIFT_REG_SPI_HZ);
+}
+#endif
+
+const char* getRelayBackendString() {
+#if RELAY_OUTPUT_BACKEND == RELAY_BACKEND_SHIFT_REG
+    return "74HC595 shift register (SPI)";
+#else
+    return "direct GPIO";
+#endif
+}
+
+const char* getRelaySwitchOrderString() {
+#if RELAY_SWITCH_ORDER == RELAY_MAKE_BEFORE_BREAK
+    return "make-before-break";
+#else
+    return "break-before-make";
+#endif
+}
+
+const char* getRelayDriveModeString() {
+#if RELAY_DRIVE_MODE == RELAY_DRIVE_LATCHING
+    return "latching (set/reset pulses)";
+#elif RELAY_DRIVE_MODE == RELAY_DRIVE_MOMENTARY
+    return "momentary (toggle pulses)";
+#else
+    return "level";
+#endif
+}
+
+#if RELAY_DRIVE_MODE != RELAY_DRIVE_LEVEL
+
+#if RELAY_DRIVE_MODE == RELAY_DRIVE_LATCHING
+static uint32_t resetCoilMask[MAX_AMPSWITCHS] = {0};
+#endif
+
+static portMUX_TYPE pulseMux = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t pulseTimer = nullptr;
+static volatile uint32_t desiredOutputs = 0;  // Latest requested state
+static volatile uint32_t latchedOutputs = 0;  // State the last pulse left behind
+static volatile bool pulseBusy = false;       // Pulse or inter-pulse gap in progress
+static bool pulseHigh = false;                // Timer phase: true = pulse end pending
+static uint32_t activePulseMask = 0;
+
+static uint32_t pulsesEmitted = 0;
+static uint32_t requestsMerged = 0;
+static uint32_t maxPulseUs = 0;
+static int64_t pulseStartUs = 0;
+
+// GPIO pins to pulse to move the outputs from 'from' to 'to'
+static uint32_t pulseMaskFor(uint32_t from, uint32_t to) {
+    uint32_t mask = 0;
+    for (int i = 0; i < MAX_AMPSWITCHS; i++) {
+        uint32_t bit = 1UL << i;
+        if ((from ^ to) & bit) {
+#if RELAY_DRIVE_MODE == RELAY_DRIVE_LATCHING
+            mask |= (to & bit) ? ampChannelSetMask[i + 1] : resetCoilMask[i];
+#else
+            mask |= ampChannelSetMask[i + 1]; // Momentary input toggles either way
+#endif
+        }
+    }
+    return mask;
+}
+
+// Start the next pulse if the desired state moved on. Callable from loop()
+// and from the timer callback; only one pulse is ever in flight.
+static void startNextPulse() {
+    uint32_t mask = 0;
+    portENTER_CRITICAL(&pulseMux);
+    if (!pulseBusy && desiredOutputs != latchedOutputs) {
+        mask = pulseMaskFor(latchedOutputs, desiredOutputs);
+        latchedOutputs = desiredOutputs;
+        pulseBusy = true;
+    }
+    portEXIT_CRITICAL(&pulseMux);
+    if (!mask) return;
+
+    activePulseMask = mask;
+    pulseHigh = true;
+    pulseStartUs = esp_timer_get_time();
+    relayOutputsSet(mask);
+    esp_timer_start_once(pulseTimer, RELAY_PULSE_US);
+    pulsesEmitted++;
+}
+
+static void pulseTimerCallback(void* arg) {
+    if (pulseHigh) {
+        relayOutputsClear(activePulseMask);
+        pulseHigh = false;
+        uint32_t width = (uint32_t)(esp_timer_get_time() - pulseStartUs);
+        if (width > maxPulseUs) {
+            maxPulseUs = width;
+        }
+#if RELAY_PULSE_GAP_US > 0
+        // Let the coil driver recover before the next pulse
+        esp_timer_start_once(pulseTimer, RELAY_PULSE_GAP_US);
+        return;
+#endif
+    }
+    portENTER_CRITICAL(&pulseMux);
+    pulseBusy = false;
+    portEXIT_CRITICAL(&pulseMux);
+    startNextPulse();
+}
+
+void initRelayPulseDriver() {
+#if RELAY_DRIVE_MODE == RELAY_DRIVE_LATCHING && RELAY_OUTPUT_BACKEND == RELAY_BACKEND_SHIFT_REG
+    for (int i = 0; i < MAX_AMPSWITCHS; i++) {
+        resetCoilMask[i] = 1UL << (MAX_AMPSWITCHS + i);
+    }
+#elif RELAY_DRIVE_MODE == RELAY_DRIVE_LATCHING
+    for (int i = 0; i < MAX_AMPSWITCHS; i++) {
+        pinMode(ampResetPins[i], OUTPUT);
+        digitalWrite(ampResetPins[i], LOW);
+        resetCoilMask[i] = 1UL << ampResetPins[i];
+    }
+#endif
+    // Coil / input pins idle low; relay pins were configured by initializeClientConfiguration()
+    relayOutputsClear(ampRelayMask);
+
+    const esp_timer_create_args_t timerArgs = {
+        .callback = &pulseTimerCallback,
+        .arg = nullptr,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "relay_pulse",
+        .skip_unhandled_events = false
+    };
+    if (esp_timer_create(&timerArgs, &pulseTimer) != ESP_OK) {
+        log(LOG_ERROR, "Failed to create relay pulse timer");
+        return;
+    }
+
+#if RELAY_DRIVE_MODE == RELAY_DRIVE_LATCHING
+    // A latching relay keeps its state across resets - pulse every reset coil
+    // once so the latched state is known to be all off
+    latchedOutputs = (MAX_AMPSWITCHS >= 32) ? 0xFFFFFFFFUL : ((1UL << MAX_AMPSWITCHS) - 1);
+    desiredOutputs = 0;
+    startNextPulse();
+#endif
+    logf(LOG_INFO, "Relay pulse driver: %s, %uus pulses, %uus gap", getRelayDriveModeString(),
+         RELAY_PULSE_US, RELAY_PULSE_GAP_US);
+}
+
+// Non-blocking: records the new target; pulses happen from the timer
+void requestRelayOutputs(uint32_t outputs) {
+    bool merged;
+    portENTER_CRITICAL(&pulseMux);
+    merged = pulseBusy;
+    desiredOutputs = outputs;
+    portEXIT_CRITICAL(&pulseMux);
+    if (merged) {
+        // Picked up when the current pulse and gap finish; intermediate
+        // states requested meanwhile collapse into one pulse for the net change
+        requestsMerged++;
+        return;
+    }
+    startNextPulse();
+}
+
+void printRelayDriverStatus() {
+    log(LOG_INFO, "Relay Driver:");
+    logf(LOG_INFO, "  Mode: %s, Backend: %s", getRelayDriveModeString(), getRelayBackendString());
+    logf(LOG_INFO, "  Pulse: %uus, Gap: %uus, Max Measured Pulse: %luus", RELAY_PULSE_US,
+         RELAY_PULSE_GAP_US, (unsigned long)maxPulseUs);
+    logf(LOG_INFO, "  Desired: 0x%lX, Latched: 0x%lX, %s", (unsigned long)desiredOutputs,
+         (unsigned long)latchedOutputs, pulseBusy ? "pulsing" : "idle");
+    logf(LOG_INFO, "  Pulses: %lu, Merged Requests: %lu", (unsigned long)pulsesEmitted,
+         (unsigned long)requestsMerged);
+#if RELAY_OUTPUT_BACKEND == RELAY_BACKEND_SHIFT_REG
+    printShiftRegisterStats();
+#endif
+}
+
+#else
+
+void initRelayPulseDriver() {
+}
+
+void requestRelayOutputs(uint32_t outputs) {
+    // Level mode drives outputs directly, see setAmpChannel()/applyAmpScene()
+}
+
+void printRelayDriverStatus() {
+    log(LOG_INFO, "Relay Driver:");
+    logf(LOG_INFO, "  Mode: %s, Backend: %s, %s, gap %uus", getRelayDriveModeString(),
+         getRelayBackendString(), getRelaySwitchOrderString(), RELAY_SWITCH_GAP_US);
+#if RELAY_OUTPUT_BACKEND == RELAY_BACKEND_SHIFT_REG
+    printShiftRegisterStats();
+#endif
+}
+
+#endif
@@ -0,0 +1,42 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+#include <Arduino.h>
+#include "relayGroups.h"
+#include "globals.h"
+#include "utils.h"
+
+void printRelayGroups() {
+    log(LOG_INFO, "=== RELAY GROUPS ===");
+    logf(LOG_INFO, "Topology: %s (%u group%s, %d outputs)", RELAY_GROUPS, RELAY_GROUP_COUNT,
+         RELAY_GROUP_COUNT == 1 ? "" : "s", MAX_AMPSWITCHS);
+    for (uint8_t g = 0; g < RELAY_GROUP_COUNT; g++) {
+        uint32_t groupMask = relayGroupOutputs[g];
+        uint8_t first = __builtin_ctz(groupMask) + 1;
+        uint8_t last = first + __builtin_popcount(groupMask) - 1;
+        if (isRelayGroupExclusive(g)) {
+            uint8_t active = getRelayGroupChannel(g);
+            if (active) {
+                logf(LOG_INFO, "Group %u: exclusive, outputs %u-%u, active %u", g + 1, first, last, active);
+            } else {
+                logf(LOG_INFO, "Group %u: exclusive, outputs %u-%u, off", g + 1, first, last);
+            }
+        } else {
+            logf(LOG_INFO, "Group %u: independent, outputs %u-%u, on 0x%lX", g + 1, first, last,
+                 (unsigned long)(ampOutputs & groupMask));
+        }
+    }
+    log(LOG_INFO, "====================");
+}
@@ -0,0 +1,159 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+#include <Arduino.h>
+#include "relayStats.h"
+#include "globals.h"
+#include "nvsManager.h"
+#include "metrics.h"
+#include "utils.h"
+
+uint32_t relayActuations[MAX_AMPSWITCHS] = {0};
+uint32_t relayWearOutputs = 0;
+
+static uint32_t onSeconds[MAX_AMPSWITCHS] = {0};
+static uint16_t onMsRemainder[MAX_AMPSWITCHS] = {0};
+static uint32_t journalSeq = 0;
+static uint32_t savedActuations = 0;  // Totals at the last journal write
+static uint32_t savedOnSeconds = 0;
+static unsigned long lastSample = 0;
+static unsigned long lastSave = 0;
+static uint32_t journalWrites = 0;
+static portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Lifetime totals over every output, kept with the per-output counters
+// (under statsMux); gauges, since replacing a relay takes its share off
+static MetricGauge totalActuations("relay_actuations", "Relay actuations over all outputs, lifetime");
+static MetricGauge totalOnSeconds("relay_on_seconds", "Relay energised time over all outputs, lifetime");
+
+void initRelayStats() {
+    RelayStatsRecord record;
+    uint32_t actuations = 0;
+    uint32_t seconds = 0;
+    if (loadRelayStatsFromNVS(&record)) {
+        journalSeq = record.seq;
+        for (int i = 0; i < MAX_AMPSWITCHS; i++) {
+            relayActuations[i] = record.actuations[i];
+            onSeconds[i] = record.onSeconds[i];
+            actuations += record.actuations[i];
+            seconds += record.onSeconds[i];
+        }
+    }
+    totalActuations.set(actuations);
+    totalOnSeconds.set(seconds);
+    savedActuations = actuations;
+    savedOnSeconds = seconds;
+    lastSample = lastSave = millis();
+}
+
+// Credit elapsed time to every energised output; caller holds statsMux
+static void creditOnTime() {
+    unsigned long now = millis();
+    uint32_t elapsed = now - lastSample;
+    lastSample = now;
+    uint32_t outputs = relayWearOutputs;
+    while (outputs) {
+        int i = __builtin_ctz(outputs);
+        outputs &= outputs - 1;
+        uint32_t ms = onMsRemainder[i] + elapsed;
+        onSeconds[i] += ms / 1000;
+        totalOnSeconds.set(totalOnSeconds.value + ms / 1000);
+        onMsRemainder[i] = ms % 1000;
+    }
+}
+
+static void sampleOnTime() {
+    portENTER_CRITICAL(&statsMux);
+    creditOnTime();
+    portEXIT_CRITICAL(&statsMux);
+}
+
+void recordRelayOutputs(uint32_t outputs) {
+    portENTER_CRITICAL(&statsMux);
+    creditOnTime();
+    uint32_t energised = outputs & ~relayWearOutputs;
+    relayWearOutputs = outputs;
+    totalActuations.set(totalActuations.value + __builtin_popcount(energised));
+    while (energised) {
+        relayActuations[__builtin_ctz(energised)]++;
+        energised &= energised - 1;
+    }
+    portEXIT_CRITICAL(&statsMux);
+}
+
+void flushRelayStats() {
+    sampleOnTime();
+    uint32_t actuations = totalActuations.value;
+    uint32_t seconds = totalOnSeconds.value;
+    lastSave = millis();
+    if (actuations == savedActuations && seconds == savedOnSeconds) {
+        return;
+    }
+
+    RelayStatsRecord record;
+    record.seq = ++journalSeq;
+    for (int i = 0; i < MAX_AMPSWITCHS; i++) {
+        record.actuations[i] = relayActuations[i];
+        record.onSeconds[i] = onSeconds[i];
+    }
+    saveRelayStatsToNVS(&record);
+    savedActuations = actuations;
+    savedOnSeconds = seconds;
+    journalWrites++;
+}
+
+void updateRelayStats() {
+    if (millis() - lastSample >= 1000) {
+        sampleOnTime();
+    }
+    if (millis() - lastSave >= RELAY_STATS_SAVE_INTERVAL_MS) {
+        flushRelayStats();
+    }
+}
+
+// After replacing a relay; output is 1-based
+void resetRelayStats(uint8_t output) {
+    if (output < 1 || output > MAX_AMPSWITCHS) return;
+    sampleOnTime();
+    portENTER_CRITICAL(&statsMux);
+    totalActuations.set(totalActuations.value - relayActuations[output - 1]);
+    totalOnSeconds.set(totalOnSeconds.value - onSeconds[output - 1]);
+    relayActuations[output - 1] = 0;
+    onSeconds[output - 1] = 0;
+    onMsRemainder[output - 1] = 0;
+    portEXIT_CRITICAL(&statsMux);
+    savedActuations = 0xFFFFFFFFUL; // Force the journal write
+    flushRelayStats();
+}
+
+uint32_t getRelayOnSeconds(uint8_t output) {
+    return (output >= 1 && output <= MAX_AMPSWITCHS) ? onSeconds[output - 1] : 0;
+}
+
+void printRelayStats() {
+    sampleOnTime();
+    log(LOG_INFO, "=== RELAY WEAR ===");
+    for (int i = 0; i < MAX_AMPSWITCHS; i++) {
+        uint32_t s = onSeconds[i];
+        logf(LOG_INFO, "Output %d: %lu actuations, on %luh %02lum %02lus%s", i + 1,
+             (unsigned long)relayActuations[i], (unsigned long)(s / 3600),
+             (unsigned long)((s / 60) % 60), (unsigned long)(s % 60),
+             (relayWearOutputs & (1UL << i)) ? " [on]" : "");
+    }
+    logf(LOG_INFO, "Journal: seq %lu, %lu writes this boot, every %lus when changed",
+         (unsigned long)journalSeq, (unsigned long)journalWrites,
+         (unsigned long)(RELAY_STATS_SAVE_INTERVAL_MS / 1000));
+    log(LOG_INFO, "==================");
+}
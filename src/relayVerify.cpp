@@ -0,0 +1,143 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+#include <Arduino.h>
+#include "relayVerify.h"
+#include "relayDriver.h"
+#include "scenes.h"
+#include "espnow.h"
+#include "utils.h"
+
+#if RELAY_VERIFY_READBACK
+// Switching path (checks) and loop (the rest) each write their own
+MetricCounter relayVerifyChecks("relay_verify_checks_total", "Relay GPIO readbacks on the switching path");
+static MetricCounter relayVerifyGlitches("relay_verify_glitches_total", "Readback mismatches that cleared on re-read");
+static MetricCounter relayGpioFaults("relay_gpio_faults_total", "Readback mismatches confirmed on re-read");
+#endif
+#if HAS_RELAY_SENSE
+static MetricCounter relaySenseChecks("relay_sense_checks_total", "Relay sense input checks");
+static MetricCounter relaySenseFaults("relay_sense_faults_total", "Sense inputs that disagreed with the outputs");
+#endif
+MetricGauge relayFaultMask("relay_fault_mask", "Outputs that have faulted, bit N = output N+1");
+volatile uint32_t relayVerifySuspect = 0;
+volatile uint32_t relayVerifyExpected = 0;
+volatile bool relaySenseDue = false;
+
+#if HAS_RELAY_SENSE
+static unsigned long senseCheckAt = 0;
+static bool senseScheduled = false;
+#endif
+
+void initRelayVerify() {
+#if HAS_RELAY_SENSE
+    for (int i = 0; i < MAX_AMPSWITCHS; i++) {
+        pinMode(relaySensePins[i], INPUT);
+    }
+    logf(LOG_INFO, "Relay sense inputs: %s (settle %ums)", RELAY_SENSE_PINS, RELAY_SENSE_SETTLE_MS);
+#endif
+#if RELAY_VERIFY_READBACK
+    // Expected levels are tracked incrementally from here on, start from the boot state
+    relayVerifyExpected = REG_READ(GPIO_OUT_REG) & ampRelayMask;
+#elif RELAY_VERIFY
+    log(LOG_WARN, "RELAY_VERIFY readback needs direct GPIO level drive; only sense inputs are checked");
+#endif
+}
+
+// New fault on 'outputs': count, tell the player and the server once per output
+static void reportRelayFault(uint32_t outputs, const char* source) {
+    uint32_t fresh = outputs & ~relayFaultMask.value;
+    relayFaultMask.set(relayFaultMask.value | outputs);
+    for (int i = 0; i < MAX_AMPSWITCHS; i++) {
+        if (outputs & (1UL << i)) {
+            logf(LOG_ERROR, "Relay output %d failed %s check", i + 1, source);
+            if (fresh & (1UL << i)) {
+                sendRelayFault(i + 1);
+            }
+        }
+    }
+    setStatusLedPattern(LED_FAST_BLINK);
+}
+
+#if RELAY_VERIFY_READBACK
+// GPIO bits -> output bitmask
+static uint32_t gpioToOutputs(uint32_t gpio) {
+    uint32_t outputs = 0;
+    for (int i = 0; i < MAX_AMPSWITCHS; i++) {
+        if (gpio & ampChannelSetMask[i + 1]) {
+            outputs |= 1UL << i;
+        }
+    }
+    return outputs;
+}
+#endif
+
+void pollRelayVerify() {
+#if RELAY_VERIFY_READBACK
+    if (relayVerifySuspect) {
+        // The hot-path read can race the pad synchroniser; only a second
+        // mismatch on the same bits is a real fault
+        uint32_t still = (REG_READ(GPIO_IN_REG) ^ relayVerifyExpected) & relayVerifySuspect;
+        relayVerifySuspect = 0;
+        if (still) {
+            relayGpioFaults.inc();
+            reportRelayFault(gpioToOutputs(still), "GPIO readback");
+        } else {
+            relayVerifyGlitches.inc();
+        }
+    }
+#endif
+#if HAS_RELAY_SENSE
+    if (relaySenseDue) {
+        // Restart the settle time on every switch
+        relaySenseDue = false;
+        senseCheckAt = millis() + RELAY_SENSE_SETTLE_MS;
+        senseScheduled = true;
+    }
+    if (senseScheduled && (long)(millis() - senseCheckAt) >= 0) {
+        senseScheduled = false;
+        uint32_t sensed = 0;
+        for (int i = 0; i < MAX_AMPSWITCHS; i++) {
+            if (digitalRead(relaySensePins[i]) == RELAY_SENSE_ACTIVE_LEVEL) {
+                sensed |= 1UL << i;
+            }
+        }
+        relaySenseChecks.inc();
+        uint32_t wrong = sensed ^ getAmpOutputs();
+        if (wrong) {
+            relaySenseFaults.inc();
+            reportRelayFault(wrong, "sense input");
+        }
+    }
+#endif
+}
+
+void printRelayVerifyStatus() {
+    log(LOG_INFO, "Relay Verification:");
+#if RELAY_VERIFY_READBACK
+    logf(LOG_INFO, "  Readback: %lu checks, %lu glitches, %lu faults", (unsigned long)relayVerifyChecks.value,
+         (unsigned long)relayVerifyGlitches.value, (unsigned long)relayGpioFaults.value);
+#elif RELAY_VERIFY
+    log(LOG_INFO, "  Readback: Unavailable (needs direct GPIO level drive)");
+#else
+    log(LOG_INFO, "  Readback: Disabled (set RELAY_VERIFY=1)");
+#endif
+#if HAS_RELAY_SENSE
+    logf(LOG_INFO, "  Sense (%s): %lu checks, %lu faults", RELAY_SENSE_PINS,
+         (unsigned long)relaySenseChecks.value, (unsigned long)relaySenseFaults.value);
+#else
+    log(LOG_INFO, "  Sense: Disabled (set RELAY_SENSE_PINS)");
+#endif
+    logf(LOG_INFO, "  Faulted Outputs: 0x%lX", (unsigned long)relayFaultMask.value);
+}
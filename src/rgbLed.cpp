@@ -0,0 +1,92 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <Arduino.h>
+#include "rgbLed.h"
+#include "utils.h"
+
+#if STATUS_LED_BACKEND == STATUS_LED_WS2812
+#include <driver/rmt.h>
+
+static const rmt_channel_t rgbChannel = (rmt_channel_t)RGB_LED_RMT_CHANNEL;
+static bool rgbReady = false;
+static rmt_item32_t rgbItems[WS2812_FRAME_BITS];
+static RgbColour rgbShown = {0, 0, 0};
+static RgbColour rgbPending = {0, 0, 0};
+static bool rgbDirty = false;
+static unsigned long rgbLastSendUs = 0; // Transmit start; the frame ends WS2812_FRAME_US later
+
+static uint32_t rgbFrames = 0;
+static uint32_t rgbDeferred = 0; // Frames held back while the last one was on the wire
+
+void initRgbLed() {
+    rmt_config_t config = RMT_DEFAULT_CONFIG_TX((gpio_num_t)RGB_LED_PIN, rgbChannel);
+    config.clk_div = WS2812_RMT_CLK_DIV;
+    if (rmt_config(&config) != ESP_OK || rmt_driver_install(rgbChannel, 0, 0) != ESP_OK) {
+        log(LOG_ERROR, "RMT init failed, RGB status LED disabled");
+        return;
+    }
+    rgbReady = true;
+    rgbDirty = true; // Push black so a LED left lit by a reset goes dark
+    pollRgbLed();
+    logf(LOG_DEBUG, "RGB status LED on pin %d (RMT channel %d)", RGB_LED_PIN, RGB_LED_RMT_CHANNEL);
+}
+
+// Latest colour wins; a frame still on the wire (or inside the reset gap)
+// defers the new one to pollRgbLed() instead of waiting for it
+void showRgbLed(RgbColour colour) {
+    if (!rgbDirty && colour == rgbShown) return;
+    rgbPending = colour;
+    rgbDirty = true;
+    pollRgbLed();
+}
+
+void pollRgbLed() {
+    if (!rgbDirty || !rgbReady) return;
+    if (micros() - rgbLastSendUs < WS2812_FRAME_US + WS2812_RESET_US || rmt_wait_tx_done(rgbChannel, 0) != ESP_OK) {
+        rgbDeferred++;
+        return;
+    }
+    uint32_t items[WS2812_FRAME_BITS];
+    encodeWs2812Frame(rgbPending, items);
+    for (int i = 0; i < WS2812_FRAME_BITS; i++) {
+        rgbItems[i].val = items[i];
+    }
+    rmt_write_items(rgbChannel, rgbItems, WS2812_FRAME_BITS, false);
+    rgbLastSendUs = micros();
+    rgbShown = rgbPending;
+    rgbDirty = false;
+    rgbFrames++;
+}
+
+void printRgbLedStats() {
+    logf(LOG_INFO, "  RGB LED: %lu frames, %lu deferred, showing #%02X%02X%02X",
+         (unsigned long)rgbFrames, (unsigned long)rgbDeferred, rgbShown.r, rgbShown.g, rgbShown.b);
+}
+
+#else
+
+void initRgbLed() {
+}
+
+void showRgbLed(RgbColour colour) {
+}
+
+void pollRgbLed() {
+}
+
+void printRgbLedStats() {
+}
+
+#endif
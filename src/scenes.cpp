@@ -0,0 +1,92 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <Arduino.h>
+#include "scenes.h"
+#include "globals.h"
+#include "relayDriver.h"
+#include "switchDriver.h"
+#include "nvsManager.h"
+#include "utils.h"
+
+AmpScene ampScenes[MAX_SCENES];
+
+// GPIO-space masks derived from each scene's output bitmask
+static uint32_t sceneSetMask[MAX_SCENES] = {0};
+static uint32_t sceneClearMask[MAX_SCENES] = {0};
+
+// Must run after initRelayMasks() and whenever a scene's outputs change
+void rebuildSceneMasks() {
+    for (int i = 0; i < MAX_SCENES; i++) {
+        sceneSetMask[i] = relayOutputsToGpioMask(ampScenes[i].outputs);
+        sceneClearMask[i] = ampRelayMask & ~sceneSetMask[i];
+    }
+}
+
+void initScenes() {
+    // Defaults: scene N selects channel N alone, unmapped
+    for (int i = 0; i < MAX_SCENES; i++) {
+        ampScenes[i].outputs = (i < MAX_AMPSWITCHS) ? (1UL << i) : 0;
+        ampScenes[i].program = SCENE_NO_PROGRAM;
+    }
+    loadScenesFromNVS(ampScenes);
+    rebuildSceneMasks();
+}
+
+// Recall scene 1..MAX_SCENES with one masked update (clear + set pair).
+// One-hot and empty scenes stay visible as plain channels.
+bool applyAmpScene(uint8_t scene) {
+    if (scene == 0 || scene > MAX_SCENES) {
+        return false;
+    }
+    uint8_t idx = scene - 1;
+    AmpSwitchDriver::setOutputs(ampScenes[idx].outputs, sceneSetMask[idx], sceneClearMask[idx]);
+    return true;
+}
+
+// Returns the 1-based scene mapped to a Program Change, or 0 if none
+int findSceneForProgram(uint8_t program) {
+    for (int i = 0; i < MAX_SCENES; i++) {
+        if (ampScenes[i].program == program) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+uint32_t getAmpOutputs() {
+    return ampOutputs;
+}
+
+void printScenes() {
+    uint32_t active = getAmpOutputs();
+    log(LOG_INFO, "=== RELAY SCENES ===");
+    for (int i = 0; i < MAX_SCENES; i++) {
+        char outputsStr[MAX_AMPSWITCHS + 1];
+        for (int b = 0; b < MAX_AMPSWITCHS; b++) {
+            // Output 1 first, matching ampSwitchPins[] order
+            outputsStr[b] = (ampScenes[i].outputs & (1UL << b)) ? '1' : '0';
+        }
+        outputsStr[MAX_AMPSWITCHS] = '\0';
+        if (ampScenes[i].program == SCENE_NO_PROGRAM) {
+            logf(LOG_INFO, "Scene %d: outputs %s (0x%lX), PC#-%s", i + 1, outputsStr,
+                 (unsigned long)ampScenes[i].outputs, ampScenes[i].outputs == active ? " [active]" : "");
+        } else {
+            logf(LOG_INFO, "Scene %d: outputs %s (0x%lX), PC#%u%s", i + 1, outputsStr,
+                 (unsigned long)ampScenes[i].outputs, ampScenes[i].program,
+                 ampScenes[i].outputs == active ? " [active]" : "");
+        }
+    }
+    log(LOG_INFO, "====================");
+}
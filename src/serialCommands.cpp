@@ -0,0 +1,123 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <Arduino.h>
+#include "serialCommands.h"
+
+SerialLineResult feedSerialLine(SerialLineBuffer& line, char c) {
+    if (c == '\r' || c == '\n') {
+        bool overflow = line.overflow;
+        while (line.length && line.data[line.length - 1] == ' ') line.length--;
+        line.data[line.length] = '\0';
+        bool ready = line.length > 0 && !overflow;
+        line.length = 0;
+        line.overflow = false;
+        if (overflow) return LINE_OVERFLOW;
+        return ready ? LINE_READY : LINE_PARTIAL; // CRLF: the second half is an empty line
+    }
+    if (c == '\b' || c == 0x7F) {
+        if (line.length) line.length--;
+        return LINE_PARTIAL;
+    }
+    if (c == '\t') c = ' ';
+    if ((uint8_t)c < ' ' || (c == ' ' && line.length == 0)) {
+        return LINE_PARTIAL;
+    }
+    if (line.length >= SERIAL_LINE_MAX) {
+        line.overflow = true;
+        return LINE_PARTIAL;
+    }
+    line.data[line.length++] = c;
+    return LINE_PARTIAL;
+}
+
+// Case-insensitive order of a table name against word[0..len)
+static int compareName(const char* name, const char* word, size_t len) {
+    size_t i = 0;
+    for (; i < len && name[i]; i++) {
+        int a = serialNameLower(name[i]);
+        int b = serialNameLower(word[i]);
+        if (a != b) return a - b;
+    }
+    if (i < len) return -1;
+    return name[i] ? 1 : 0;
+}
+
+static const char* skipSpaces(const char* s) {
+    while (*s == ' ') s++;
+    return s;
+}
+
+const SerialCommand* findSerialCommand(const SerialCommand* table, size_t count, const char* line,
+                                       const char** args) {
+    size_t len = strcspn(line, " ");
+
+    size_t lo = 0;
+    size_t hi = count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        int order = compareName(table[mid].name, line, len);
+        if (order == 0) {
+            *args = skipSpaces(line + len);
+            if (**args && table[mid].flags == CMD_EXACT) return nullptr;
+            return &table[mid];
+        }
+        if (order < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    // Arguments run into the name (setlog3, debugperf) or a bare number:
+    // few entries allow it, so scan for the longest name that fits
+    const SerialCommand* best = nullptr;
+    size_t bestLen = 0;
+    bool number = line[0] >= '0' && line[0] <= '9';
+    for (size_t i = 0; i < count; i++) {
+        const SerialCommand& cmd = table[i];
+        if (number && (cmd.flags & CMD_CHANNEL)) {
+            *args = line;
+            return &cmd;
+        }
+        if (!(cmd.flags & (CMD_NUMBER | CMD_SUBCOMMAND))) continue;
+        size_t nameLen = strlen(cmd.name);
+        if (nameLen <= bestLen || nameLen >= len || compareName(cmd.name, line, nameLen) != 0) continue;
+        char next = line[nameLen];
+        if ((cmd.flags & CMD_SUBCOMMAND) || (next >= '0' && next <= '9')) {
+            best = &cmd;
+            bestLen = nameLen;
+        }
+    }
+    if (best) *args = line + bestLen;
+    return best;
+}
+
+bool runSerialCommand(const SerialCommand* table, size_t count, const char* line) {
+    const char* args;
+    const SerialCommand* cmd = findSerialCommand(table, count, line, &args);
+    if (cmd == nullptr) return false;
+    cmd->handler(args);
+    return true;
+}
+
+void printSerialCommandHelp(const SerialCommand* table, size_t count, uint8_t section, const char* prefix) {
+    char usage[32];
+    for (size_t i = 0; i < count; i++) {
+        const SerialCommand& cmd = table[i];
+        if (cmd.section != section || (cmd.flags & CMD_HIDDEN)) continue;
+        snprintf(usage, sizeof(usage), "%s%s", prefix, cmd.usage ? cmd.usage : cmd.name);
+        Serial.printf("  %-11s : %s\n", usage, cmd.help);
+    }
+}
@@ -0,0 +1,428 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// driver/ledc.h first: config.h reuses its LEDC_CHANNEL_0 / LEDC_TIMER_13_BIT
+// names as plain macros
+#include <driver/ledc.h>
+#include <Arduino.h>
+#include "statusLed.h"
+#include "rgbLed.h"
+#include "utils.h"
+#if STATUS_LED_BACKEND == STATUS_LED_WS2812
+#include "espnow.h"
+#include "relayVerify.h"
+#endif
+
+#define LED_DUTY_FULL 8191 // 13-bit LEDC resolution
+#define LED_DUTY_UNKNOWN 0xFFFF
+
+// One step of a pattern: hold (or fade to) 'duty' for 'ms'; ms == 0 holds
+// until something else is shown
+struct LedStep {
+    uint16_t duty;
+    uint16_t ms;
+    bool fade;
+};
+
+// A step table played 'repeats' times; repeats == 0 loops (continuous pattern)
+struct LedSequence {
+    const LedStep* steps;
+    uint8_t count;
+    uint8_t repeats;
+};
+
+#define LED_STEPS(table) table, (uint8_t)(sizeof(table) / sizeof(table[0]))
+
+static constexpr LedStep kOffSteps[] = {{0, 0, false}};
+static constexpr LedStep kSolidSteps[] = {{LED_DUTY_FULL, 0, false}};
+static constexpr LedStep kSingleFlashSteps[] = {{LED_DUTY_FULL, 80, false}, {0, 120, false}};
+static constexpr LedStep kDoubleFlashSteps[] = {{LED_DUTY_FULL, 60, false}, {0, 60, false}};
+static constexpr LedStep kFlashSteps[] = {{LED_DUTY_FULL, 50, false}, {0, 50, false}};
+static constexpr LedStep kBlinkSteps[] = {{LED_DUTY_FULL, 100, false}, {0, 100, false}};
+static constexpr LedStep kFadeSteps[] = {{LED_DUTY_FULL, LED_FADE_RAMP_MS, true},
+                                         {0, LED_FADE_RAMP_MS, true}};
+// Channel confirmation: one slow flash per count
+static constexpr LedStep kConfirmSteps[] = {{0, 200, false}, {LED_DUTY_FULL, 200, false}};
+
+// Indexed by StatusLedPattern
+static constexpr LedSequence kPatterns[] = {
+    {LED_STEPS(kOffSteps), 0},         // LED_OFF
+    {LED_STEPS(kSingleFlashSteps), 1}, // LED_SINGLE_FLASH
+    {LED_STEPS(kDoubleFlashSteps), 2}, // LED_DOUBLE_FLASH
+    {LED_STEPS(kFlashSteps), 3},       // LED_TRIPLE_FLASH
+    {LED_STEPS(kFlashSteps), 4},       // LED_QUAD_FLASH
+    {LED_STEPS(kFlashSteps), 5},       // LED_PENTA_FLASH
+    {LED_STEPS(kFlashSteps), 6},       // LED_HEXA_FLASH
+    {LED_STEPS(kBlinkSteps), 0},       // LED_FAST_BLINK
+    {LED_STEPS(kSolidSteps), 0},       // LED_SOLID_ON
+    {LED_STEPS(kFadeSteps), 0},        // LED_FADE
+    {LED_STEPS(kFadeSteps), 0},        // LED_PAIRING
+    {LED_STEPS(kBlinkSteps), 0},       // LED_OTA_BLINK
+};
+static_assert(sizeof(kPatterns) / sizeof(kPatterns[0]) == LED_OTA_BLINK + 1,
+              "kPatterns must have one entry per StatusLedPattern");
+
+struct LedQueued {
+    LedSequence seq;
+    uint8_t priority;
+    unsigned long queuedAt;
+};
+
+// The queue is filled from the ESP-NOW receive callback as well as the loop
+static portMUX_TYPE ledMux = portMUX_INITIALIZER_UNLOCKED;
+static LedQueued ledQueue[LED_QUEUE_DEPTH]; // Highest priority first, FIFO within one
+static volatile uint8_t ledQueueCount = 0;
+static volatile StatusLedPattern backgroundPattern = LED_OFF;
+
+// What is being played
+static LedSequence playing = {LED_STEPS(kOffSteps), 0};
+static uint8_t playingPriority = LED_PRIORITY_BACKGROUND;
+static bool playingOneShot = false;
+static StatusLedPattern playingBackground = LED_OFF;
+static bool started = false;
+static uint8_t stepIndex = 0;
+static uint8_t repeatCount = 0;
+static unsigned long stepStart = 0;
+static uint16_t stepMs = 0;
+
+static uint16_t currentDuty = LED_DUTY_UNKNOWN;
+static bool hardwareFade = false;
+static unsigned long fadeEnd = 0;
+static bool fadeRunning = false;
+
+// Loop-stepped fade (LED_HW_FADE=0 or fader unavailable)
+static bool softFade = false;
+static uint16_t softFadeFrom = 0;
+static uint16_t softFadeTo = 0;
+static unsigned long lastSoftFadeStep = 0;
+
+static uint32_t ledUpdates = 0;
+static uint32_t ledWrites = 0;
+static uint32_t ledFades = 0;
+static uint32_t ledQueued = 0;
+static uint32_t ledPlayed = 0;
+static uint32_t ledPreempted = 0;
+static uint32_t ledExpired = 0;
+static uint32_t ledDropped = 0;
+
+#if STATUS_LED_BACKEND == STATUS_LED_WS2812
+static constexpr RgbColour kBlack = {0, 0, 0};
+static constexpr RgbColour kWhite = {255, 255, 255};
+static constexpr RgbColour kBlue = {0, 0, 255};
+static constexpr RgbColour kMagenta = {255, 0, 255};
+static constexpr RgbColour kAmber = {255, 120, 0};
+static constexpr RgbColour kRed = {255, 0, 0};
+static constexpr RgbColour kCyan = {0, 255, 255};
+
+// Amp channel 1..8, repeating for higher channels
+static constexpr RgbColour kChannelColours[] = {
+    {0, 255, 0}, {255, 0, 0}, {255, 200, 0}, {0, 0, 255},
+    {0, 255, 255}, {255, 0, 255}, {255, 80, 0}, {255, 255, 255}
+};
+
+static RgbColour lastColour = {0, 0, 0};
+
+// Feedback flashes show the ESP-NOW link: white standalone, cyan when the
+// server acknowledges, amber after a failed send, red once the link is lost
+static RgbColour linkColour() {
+    if (pairingStatus != PAIR_PAIRED) return kWhite;
+    uint8_t fails = getEspNowFailStreak();
+    if (fails == 0) return kCyan;
+    return fails < ESPNOW_LINK_LOST_FAILS ? kAmber : kRed;
+}
+
+// Mode backgrounds have fixed colours; otherwise the amp channel shows
+static RgbColour statusLedColour() {
+    switch (playingBackground) {
+        case LED_PAIRING: return kBlue;
+        case LED_OTA_BLINK: return kMagenta;
+        case LED_FAST_BLINK: return relayFaultMask.value ? kRed : kAmber; // Fault or MIDI learn
+        case LED_FADE:
+        case LED_SOLID_ON: return kWhite;
+        default: break;
+    }
+    if (playingOneShot) {
+        return playingPriority == LED_PRIORITY_CONFIRM ? kWhite : linkColour();
+    }
+    if (currentAmpChannel == 0) return kBlack;
+    if (currentAmpChannel == AMP_CHANNEL_SCENE) return kWhite;
+    return kChannelColours[(currentAmpChannel - 1) % (sizeof(kChannelColours) / sizeof(kChannelColours[0]))];
+}
+
+// Pattern level (0..LED_DUTY_FULL) scales the colour; over the normal
+// background the channel colour never drops below the idle glow
+static void outputDuty(uint16_t duty) {
+    const uint16_t idle = (uint32_t)LED_DUTY_FULL * RGB_LED_IDLE_PERCENT / 100;
+    if (playingBackground == LED_OFF && duty < idle) duty = idle;
+    RgbColour colour = statusLedColour();
+    lastColour = colour;
+    uint32_t scale = (uint32_t)duty * RGB_LED_BRIGHTNESS / LED_DUTY_FULL;
+    RgbColour out = {(uint8_t)(colour.r * scale / 255), (uint8_t)(colour.g * scale / 255),
+                     (uint8_t)(colour.b * scale / 255)};
+    showRgbLed(out);
+}
+#else
+static void outputDuty(uint16_t duty) {
+    ledcWrite(LEDC_CHANNEL_0, duty);
+}
+#endif
+
+static void writeDuty(uint16_t duty) {
+    softFade = false;
+    if (duty == currentDuty) return;
+    outputDuty(duty);
+    currentDuty = duty;
+    ledWrites++;
+}
+
+static void startFade(uint16_t duty, uint16_t ms, unsigned long now) {
+    ledFades++;
+#if LED_HW_FADE
+    if (hardwareFade) {
+        ledc_set_fade_with_time(LEDC_LOW_SPEED_MODE, (ledc_channel_t)LEDC_CHANNEL_0, duty, ms);
+        ledc_fade_start(LEDC_LOW_SPEED_MODE, (ledc_channel_t)LEDC_CHANNEL_0, LEDC_FADE_NO_WAIT);
+        currentDuty = duty;
+        fadeRunning = true;
+        fadeEnd = now + ms;
+        ledWrites++;
+        return;
+    }
+#endif
+    softFadeFrom = currentDuty == LED_DUTY_UNKNOWN ? 0 : currentDuty;
+    softFadeTo = duty;
+    lastSoftFadeStep = now;
+    softFade = true;
+}
+
+static void beginStep(unsigned long now) {
+    const LedStep& step = playing.steps[stepIndex];
+    stepStart = now;
+    stepMs = step.ms;
+    if (step.fade) {
+        startFade(step.duty, step.ms, now);
+    } else {
+        writeDuty(step.duty);
+    }
+}
+
+// Pairing and OTA override whatever background the application asked for
+static StatusLedPattern effectiveBackground(uint8_t* priority) {
+    if (serialOtaTrigger) {
+        *priority = LED_PRIORITY_OTA;
+        return LED_OTA_BLINK;
+    }
+    if (pairingStatus == PAIR_REQUEST || pairingStatus == PAIR_REQUESTED) {
+        *priority = LED_PRIORITY_PAIRING;
+        return LED_PAIRING;
+    }
+    *priority = LED_PRIORITY_BACKGROUND;
+    return backgroundPattern;
+}
+
+// Caller holds ledMux
+static void dropStaleLocked(unsigned long now) {
+    uint8_t kept = 0;
+    for (uint8_t i = 0; i < ledQueueCount; i++) {
+        if (now - ledQueue[i].queuedAt > LED_QUEUE_STALE_MS) {
+            ledExpired++;
+            continue;
+        }
+        ledQueue[kept++] = ledQueue[i];
+    }
+    ledQueueCount = kept;
+}
+
+static void queueSequence(const LedSequence& seq, uint8_t priority) {
+    unsigned long now = millis();
+    portENTER_CRITICAL(&ledMux);
+    dropStaleLocked(now);
+    if (ledQueueCount == LED_QUEUE_DEPTH) {
+        // Full: the lowest-priority (newest among equals) entry loses
+        if (ledQueue[LED_QUEUE_DEPTH - 1].priority >= priority) {
+            ledDropped++;
+            portEXIT_CRITICAL(&ledMux);
+            return;
+        }
+        ledQueueCount--;
+        ledDropped++;
+    }
+    uint8_t pos = ledQueueCount;
+    while (pos > 0 && ledQueue[pos - 1].priority < priority) {
+        ledQueue[pos] = ledQueue[pos - 1];
+        pos--;
+    }
+    ledQueue[pos].seq = seq;
+    ledQueue[pos].priority = priority;
+    ledQueue[pos].queuedAt = now;
+    ledQueueCount++;
+    ledQueued++;
+    portEXIT_CRITICAL(&ledMux);
+}
+
+// Play the head of the queue if it outranks the background, else the background
+static void startNext(unsigned long now, StatusLedPattern background, uint8_t backgroundPriority) {
+    LedQueued next;
+    bool found = false;
+    portENTER_CRITICAL(&ledMux);
+    dropStaleLocked(now);
+    if (ledQueueCount > 0 && ledQueue[0].priority > backgroundPriority) {
+        next = ledQueue[0];
+        for (uint8_t i = 1; i < ledQueueCount; i++) {
+            ledQueue[i - 1] = ledQueue[i];
+        }
+        ledQueueCount--;
+        found = true;
+    }
+    portEXIT_CRITICAL(&ledMux);
+
+    if (found) {
+        playing = next.seq;
+        playingPriority = next.priority;
+        playingOneShot = true;
+        ledPlayed++;
+    } else {
+        playing = kPatterns[background];
+        playingPriority = backgroundPriority;
+        playingOneShot = false;
+    }
+    playingBackground = background;
+    started = true;
+    fadeRunning = false;
+    stepIndex = 0;
+    repeatCount = 0;
+    beginStep(now);
+}
+
+void initStatusLed() {
+#if STATUS_LED_BACKEND == STATUS_LED_WS2812
+    // No hardware fader for a serial pixel: fades are stepped from the loop
+    initRgbLed();
+#else
+    pinMode(PAIRING_LED_PIN, OUTPUT);
+    ledcSetup(LEDC_CHANNEL_0, LEDC_BASE_FREQ, LEDC_TIMER_13_BIT);
+    ledcAttachPin(PAIRING_LED_PIN, LEDC_CHANNEL_0);
+#if LED_HW_FADE
+    hardwareFade = ledc_fade_func_install(0) == ESP_OK;
+    if (!hardwareFade) {
+        log(LOG_WARN, "LEDC fade unavailable, stepping the status LED fade from the loop");
+    }
+#endif
+    logf(LOG_DEBUG, "Status LED initialized on pin %d (%s fade)", PAIRING_LED_PIN,
+         hardwareFade ? "hardware" : "stepped");
+#endif
+    setStatusLedPattern(LED_OFF);
+}
+
+// Continuous patterns replace the background; one-shots are queued as feedback
+void setStatusLedPattern(StatusLedPattern pattern) {
+    const LedSequence& seq = kPatterns[pattern];
+    if (seq.repeats != 0) {
+        queueSequence(seq, LED_PRIORITY_FEEDBACK);
+        return;
+    }
+    if (pattern != backgroundPattern) {
+        ledPatternStart = millis();
+        ledPatternStep = 0;
+    }
+    backgroundPattern = pattern;
+    currentLedPattern = pattern;
+}
+
+void queueStatusLedFlashes(uint8_t flashes, LedPriority priority) {
+    if (flashes == 0) return;
+    LedSequence seq = {LED_STEPS(kConfirmSteps), flashes};
+    queueSequence(seq, priority);
+}
+
+// Called every loop iteration: touches the LEDC channel only when a step
+// starts (or a stepped fade is due)
+void updateStatusLED() {
+    static PairingStatus lastPairingStatus = NOT_PAIRED;
+    unsigned long now = millis();
+    ledUpdates++;
+
+    // Back to LED off once pairing completes
+    if (lastPairingStatus != pairingStatus) {
+        if (pairingStatus == PAIR_PAIRED) {
+            setStatusLedPattern(LED_OFF);
+        }
+        lastPairingStatus = pairingStatus;
+    }
+
+    uint8_t backgroundPriority;
+    StatusLedPattern background = effectiveBackground(&backgroundPriority);
+    int queuedPriority = ledQueueCount > 0 ? ledQueue[0].priority : -1;
+
+    // Something else should be showing: a higher-priority one-shot, a new
+    // background, or a background that now outranks the one-shot
+    bool restart;
+    if (!started) {
+        restart = true;
+    } else if (playingOneShot) {
+        restart = queuedPriority > playingPriority || backgroundPriority >= playingPriority;
+    } else {
+        restart = background != playingBackground || queuedPriority > backgroundPriority;
+    }
+    if (restart) {
+        // The hardware fader owns the channel until its ramp is done
+        if (fadeRunning && (long)(now - fadeEnd) < 0) return;
+        if (playingOneShot) ledPreempted++;
+        startNext(now, background, backgroundPriority);
+        return;
+    }
+
+#if STATUS_LED_BACKEND == STATUS_LED_WS2812
+    // Channel or link changed under a steady level: resend the same level
+    if (!softFade && currentDuty != LED_DUTY_UNKNOWN && statusLedColour() != lastColour) {
+        outputDuty(currentDuty);
+    }
+    pollRgbLed();
+#endif
+
+    if (softFade && now - lastSoftFadeStep >= LED_FADE_STEP_MS) {
+        uint32_t elapsed = now - stepStart;
+        uint16_t duty = softFadeTo;
+        if (elapsed < stepMs) {
+            duty = softFadeFrom + (int32_t)(softFadeTo - softFadeFrom) * (int32_t)elapsed / stepMs;
+        }
+        outputDuty(duty);
+        currentDuty = duty;
+        lastSoftFadeStep = now;
+        ledWrites++;
+    }
+
+    if (stepMs == 0 || now - stepStart < stepMs) return;
+    fadeRunning = false;
+    if (++stepIndex >= playing.count) {
+        stepIndex = 0;
+        if (playing.repeats != 0 && ++repeatCount >= playing.repeats) {
+            // One-shot finished: next queued sequence or the background
+            playingOneShot = false;
+            startNext(now, background, backgroundPriority);
+            return;
+        }
+    }
+    beginStep(now);
+}
+
+void printStatusLedStats() {
+    logf(LOG_INFO, "  Status LED: %lu updates, %lu %s writes, %lu fades (%s)",
+         (unsigned long)ledUpdates, (unsigned long)ledWrites,
+         STATUS_LED_BACKEND == STATUS_LED_WS2812 ? "RGB" : "LEDC", (unsigned long)ledFades,
+         hardwareFade ? "hardware fader" : "stepped");
+    printRgbLedStats();
+    logf(LOG_INFO, "  LED Queue: %u/%u pending, %lu queued, %lu played, %lu preempted, %lu expired, %lu dropped",
+         ledQueueCount, LED_QUEUE_DEPTH, (unsigned long)ledQueued, (unsigned long)ledPlayed,
+         (unsigned long)ledPreempted, (unsigned long)ledExpired, (unsigned long)ledDropped);
+}
@@ -0,0 +1,200 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//
+#include <Arduino.h>
+#include "switchMute.h"
+#include "relayDriver.h"
+#include "utils.h"
+
+#if HAS_SWITCH_MUTE
+#include <esp_timer.h>
+
+#if RELAY_DRIVE_MODE == RELAY_DRIVE_LEVEL
+#define SWITCH_MUTE_HOLD_US SWITCH_MUTE_RELEASE_US
+#else
+// Stay muted until the coil / input pulse is over as well
+#define SWITCH_MUTE_HOLD_US (SWITCH_MUTE_RELEASE_US + RELAY_PULSE_US)
+#endif
+
+enum MuteState : uint8_t {
+    MUTE_IDLE,      // Unmuted
+    MUTE_SETTLING,  // Mute asserted, relays not yet changed
+    MUTE_RELEASING  // Relays changed, waiting to unmute
+};
+
+static portMUX_TYPE muteMux = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t muteTimer = nullptr;
+static volatile MuteState muteState = MUTE_IDLE;
+static volatile uint32_t pendingOutputs = 0;
+static volatile bool switchPending = false;  // Request that missed a release in progress
+static int64_t muteStartUs = 0;
+
+static uint32_t sequencesRun = 0;
+static uint32_t requestsMerged = 0;
+static uint32_t lastSwitchLatencyUs = 0; // Request -> relay change
+static uint32_t maxSwitchLatencyUs = 0;
+static uint32_t lastMuteUs = 0;          // Mute asserted -> released
+static uint32_t maxMuteUs = 0;
+
+static inline void setMute(bool muted) {
+    digitalWrite(SWITCH_MUTE_PIN, muted ? SWITCH_MUTE_ACTIVE_LEVEL : !SWITCH_MUTE_ACTIVE_LEVEL);
+}
+
+static void muteTimerCallback(void* arg) {
+    int64_t now = esp_timer_get_time();
+    if (muteState == MUTE_SETTLING) {
+        uint32_t outputs;
+        portENTER_CRITICAL(&muteMux);
+        outputs = pendingOutputs;
+        muteState = MUTE_RELEASING;
+        portEXIT_CRITICAL(&muteMux);
+
+        driveRelayOutputs(outputs);
+        lastSwitchLatencyUs = (uint32_t)(esp_timer_get_time() - muteStartUs);
+        if (lastSwitchLatencyUs > maxSwitchLatencyUs) {
+            maxSwitchLatencyUs = lastSwitchLatencyUs;
+        }
+        esp_timer_start_once(muteTimer, SWITCH_MUTE_HOLD_US);
+        return;
+    }
+
+    // A request that arrived while this release was already due starts the
+    // next sequence here, still muted
+    bool next;
+    portENTER_CRITICAL(&muteMux);
+    next = switchPending;
+    switchPending = false;
+    muteState = next ? MUTE_SETTLING : MUTE_IDLE;
+    portEXIT_CRITICAL(&muteMux);
+    if (next) {
+        muteStartUs = now;
+        esp_timer_start_once(muteTimer, SWITCH_MUTE_SETTLE_US);
+        sequencesRun++;
+        return;
+    }
+    setMute(false);
+    lastMuteUs = (uint32_t)(now - muteStartUs);
+    if (lastMuteUs > maxMuteUs) {
+        maxMuteUs = lastMuteUs;
+    }
+}
+
+void initSwitchMute() {
+    pinMode(SWITCH_MUTE_PIN, OUTPUT);
+    setMute(false);
+
+    const esp_timer_create_args_t timerArgs = {
+        .callback = &muteTimerCallback,
+        .arg = nullptr,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "switch_mute",
+        .skip_unhandled_events = false
+    };
+    if (esp_timer_create(&timerArgs, &muteTimer) != ESP_OK) {
+        log(LOG_ERROR, "Failed to create switch mute timer, switching unmuted");
+        muteTimer = nullptr;
+        return;
+    }
+    logf(LOG_INFO, "Switch mute on pin %u (settle %uus, release %uus)", SWITCH_MUTE_PIN,
+         SWITCH_MUTE_SETTLE_US, SWITCH_MUTE_HOLD_US);
+}
+
+// Caller has moved muteState from idle to settling
+static void startMuteSequence() {
+    muteStartUs = esp_timer_get_time();
+    setMute(true);
+    esp_timer_start_once(muteTimer, SWITCH_MUTE_SETTLE_US);
+    sequencesRun++;
+}
+
+// Never blocks: the relay change happens from the timer after the mute settles
+void requestMutedSwitch(uint32_t outputs) {
+    if (!muteTimer) {
+        driveRelayOutputs(outputs);
+        return;
+    }
+
+    MuteState state;
+    portENTER_CRITICAL(&muteMux);
+    state = muteState;
+    pendingOutputs = outputs;
+    if (state == MUTE_IDLE) {
+        muteState = MUTE_SETTLING;
+    }
+    portEXIT_CRITICAL(&muteMux);
+
+    switch (state) {
+        case MUTE_IDLE:
+            startMuteSequence();
+            break;
+        case MUTE_SETTLING:
+            // Timer has not switched yet and will pick up the new target
+            requestsMerged++;
+            break;
+        case MUTE_RELEASING:
+            if (esp_timer_stop(muteTimer) == ESP_OK) {
+                // Still muted: switch now and restart the release delay
+                driveRelayOutputs(outputs);
+                esp_timer_start_once(muteTimer, SWITCH_MUTE_HOLD_US);
+                requestsMerged++;
+            } else {
+                // The release is due: hand the target to the timer callback,
+                // unless it has already unmuted, then start a sequence here.
+                // Never retry in place, the callback may need this task to
+                // yield first.
+                portENTER_CRITICAL(&muteMux);
+                MuteState current = muteState;
+                if (current == MUTE_RELEASING) {
+                    switchPending = true;
+                } else if (current == MUTE_IDLE) {
+                    muteState = MUTE_SETTLING;
+                }
+                portEXIT_CRITICAL(&muteMux);
+                if (current == MUTE_IDLE) {
+                    startMuteSequence();
+                } else {
+                    requestsMerged++;
+                }
+            }
+            break;
+    }
+}
+
+void printSwitchMuteStatus() {
+    log(LOG_INFO, "Switch Mute:");
+    logf(LOG_INFO, "  Pin: %u, Settle: %uus, Release: %uus, %s", SWITCH_MUTE_PIN,
+         SWITCH_MUTE_SETTLE_US, SWITCH_MUTE_HOLD_US, muteState == MUTE_IDLE ? "unmuted" : "muted");
+    logf(LOG_INFO, "  Added Latency: last %luus, max %luus", (unsigned long)lastSwitchLatencyUs,
+         (unsigned long)maxSwitchLatencyUs);
+    logf(LOG_INFO, "  Mute Duration: last %luus, max %luus", (unsigned long)lastMuteUs,
+         (unsigned long)maxMuteUs);
+    logf(LOG_INFO, "  Sequences: %lu, Merged Requests: %lu", (unsigned long)sequencesRun,
+         (unsigned long)requestsMerged);
+}
+
+#else
+
+void initSwitchMute() {
+}
+
+void requestMutedSwitch(uint32_t outputs) {
+    driveRelayOutputs(outputs);
+}
+
+void printSwitchMuteStatus() {
+    log(LOG_INFO, "Switch Mute: Disabled (set SWITCH_MUTE_PIN)");
+}
+
+#endif
@@ -0,0 +1,202 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <Arduino.h>
+#include "telemetry.h"
+#include "globals.h"
+#include "pairing.h"
+#include "espnow.h"
+#include "debug.h"
+#include "logBuffer.h"
+#include "utils.h"
+
+static const char* const telemetryFrameNames[] = {nullptr, "status", "config", "perf", "espnow"};
+#define TELEMETRY_FRAME_TYPES (sizeof(telemetryFrameNames) / sizeof(telemetryFrameNames[0]))
+#define TELEMETRY_ALL_FRAMES 0x1E
+
+static_assert(TELEMETRY_STREAM_MS == 0 || TELEMETRY_STREAM_MS >= TELEMETRY_MIN_PERIOD_MS,
+              "TELEMETRY_STREAM_MS is below TELEMETRY_MIN_PERIOD_MS");
+
+static uint8_t telemetrySeq = 0;
+static uint32_t streamPeriod = TELEMETRY_STREAM_MS;
+static uint8_t streamMask = 1 << TELEMETRY_STATUS;
+static uint32_t lastStream = 0;
+
+static void writeTelemetryFrame(TelemetryFrameType type, const void* payload, size_t size) {
+    uint8_t frame[4 + sizeof(TelemetryConfig) + 1];
+    frame[0] = TELEMETRY_FRAME_MARKER;
+    frame[1] = (uint8_t)(size + 2);
+    frame[2] = type;
+    frame[3] = telemetrySeq++;
+    memcpy(frame + 4, payload, size);
+    uint8_t sum = 0;
+    for (size_t i = 2; i < size + 4; i++) sum += frame[i];
+    frame[size + 4] = (uint8_t)-sum;
+    Serial.write(frame, size + 5);
+}
+
+static void sendStatusFrame() {
+    TelemetryStatus status;
+    status.uptimeMs = millis();
+    status.outputs = ampOutputs;
+    status.freeHeap = getFreeHeap();
+    status.minFreeHeap = getMinFreeHeap();
+    status.channel = currentAmpChannel;
+    status.pairingStatus = pairingStatus;
+    status.failStreak = getEspNowFailStreak();
+    status.logLevel = currentLogLevel;
+    status.midiChannel = currentMidiChannel;
+    status.wifiChannel = currentChannel;
+    writeTelemetryFrame(TELEMETRY_STATUS, &status, sizeof(status));
+}
+
+static void sendConfigFrame() {
+    TelemetryConfig config = {};
+    config.version = TELEMETRY_VERSION;
+    config.clientType = CLIENT_TYPE_ENUM;
+    config.outputs = MAX_AMPSWITCHS;
+    config.boardId = BOARD_ID;
+    config.relayBackend = RELAY_OUTPUT_BACKEND;
+    config.relayDrive = RELAY_DRIVE_MODE;
+    config.ledBackend = STATUS_LED_BACKEND;
+    config.logLevelFloor = LOG_LEVEL;
+#ifdef FAST_SWITCHING
+    config.flags |= TELEMETRY_FLAG_FAST_SWITCHING;
+#endif
+#if LOG_ASYNC
+    config.flags |= TELEMETRY_FLAG_LOG_ASYNC;
+#endif
+    if (isLogTokenized()) config.flags |= TELEMETRY_FLAG_LOG_TOKENIZED;
+    memcpy(config.clientMac, clientMacAddress, 6);
+    memcpy(config.serverMac, serverAddress, 6);
+    strncpy(config.firmware, FIRMWARE_VERSION, sizeof(config.firmware));
+    writeTelemetryFrame(TELEMETRY_CONFIG, &config, sizeof(config));
+}
+
+static void sendPerfFrame() {
+    TelemetryPerf perf;
+    perf.uptimeMs = millis();
+    perf.loopCount = loopTimeUs.value;
+    perf.lastLoopMs = lastLoopTimeUs.value / 1000;
+    perf.maxLoopMs = loopTimeUs.max / 1000;
+    perf.minLoopMs = perf.loopCount ? loopTimeUs.min / 1000 : 0;
+    perf.totalLoopMs = (uint32_t)(loopTimeUs.sum / 1000);
+    writeTelemetryFrame(TELEMETRY_PERF, &perf, sizeof(perf));
+}
+
+static void sendEspNowFrame() {
+    EspNowStats stats = getEspNowStats();
+    TelemetryEspNow espnow;
+    espnow.sent = stats.sent;
+    espnow.sendFailed = stats.sendFailed;
+    espnow.received = stats.received;
+    espnow.ignored = stats.ignored;
+    espnow.unknownType = stats.unknownType;
+    espnow.pairingStatus = pairingStatus;
+    espnow.wifiChannel = currentChannel;
+    espnow.failStreak = getEspNowFailStreak();
+    memcpy(espnow.serverMac, serverAddress, 6);
+    writeTelemetryFrame(TELEMETRY_ESPNOW, &espnow, sizeof(espnow));
+}
+
+void sendTelemetry(TelemetryFrameType type) {
+    switch (type) {
+        case TELEMETRY_STATUS: sendStatusFrame(); break;
+        case TELEMETRY_CONFIG: sendConfigFrame(); break;
+        case TELEMETRY_PERF:   sendPerfFrame(); break;
+        case TELEMETRY_ESPNOW: sendEspNowFrame(); break;
+    }
+}
+
+static void sendTelemetryMask(uint8_t mask) {
+    for (uint8_t type = TELEMETRY_STATUS; type < TELEMETRY_FRAME_TYPES; type++) {
+        if (mask & (1 << type)) sendTelemetry((TelemetryFrameType)type);
+    }
+}
+
+void pollTelemetry() {
+    if (streamPeriod == 0) return;
+    uint32_t now = millis();
+    if (now - lastStream < streamPeriod) return;
+    lastStream = now;
+    sendTelemetryMask(streamMask);
+}
+
+void setTelemetryStream(uint32_t periodMs, uint8_t typeMask) {
+    if (periodMs != 0 && periodMs < TELEMETRY_MIN_PERIOD_MS) periodMs = TELEMETRY_MIN_PERIOD_MS;
+    streamPeriod = periodMs;
+    streamMask = typeMask & TELEMETRY_ALL_FRAMES;
+    lastStream = millis() - periodMs; // First frame on the next poll
+}
+
+uint32_t getTelemetryStreamPeriod() {
+    return streamPeriod;
+}
+
+// "status", "perf", ... or "all" to a frame type bitmask; 0 if unknown
+static uint8_t parseTelemetryFrames(const char* word) {
+    size_t len = strcspn(word, " ");
+    if (len == 3 && strncasecmp(word, "all", 3) == 0) return TELEMETRY_ALL_FRAMES;
+    for (uint8_t type = TELEMETRY_STATUS; type < TELEMETRY_FRAME_TYPES; type++) {
+        const char* name = telemetryFrameNames[type];
+        if (strlen(name) == len && strncasecmp(word, name, len) == 0) return 1 << type;
+    }
+    return 0;
+}
+
+static void printTelemetryUsage() {
+    log(LOG_INFO, "Usage: telemetry status|config|perf|espnow|all");
+    logf(LOG_INFO, "       telemetry stream <ms> [frame|all] (min %u ms), telemetry stream off",
+         TELEMETRY_MIN_PERIOD_MS);
+}
+
+void handleTelemetryCommand(const char* args) {
+    if (*args == '\0') {
+        printTelemetryUsage();
+        if (streamPeriod) {
+            logf(LOG_INFO, "Telemetry stream: every %lu ms", (unsigned long)streamPeriod);
+        } else {
+            log(LOG_INFO, "Telemetry stream: off");
+        }
+        return;
+    }
+
+    if (strncasecmp(args, "stream", 6) == 0 && (args[6] == ' ' || args[6] == '\0')) {
+        const char* arg = args + 6;
+        while (*arg == ' ') arg++;
+        if (strcasecmp(arg, "off") == 0 || strcmp(arg, "0") == 0) {
+            setTelemetryStream(0, streamMask);
+            log(LOG_INFO, "Telemetry stream: off");
+            return;
+        }
+        char* end;
+        unsigned long period = strtoul(arg, &end, 10);
+        while (*end == ' ') end++;
+        uint8_t mask = *end ? parseTelemetryFrames(end) : (uint8_t)(1 << TELEMETRY_STATUS);
+        if (end == arg || period == 0 || mask == 0) {
+            printTelemetryUsage();
+            return;
+        }
+        setTelemetryStream(period, mask);
+        logf(LOG_INFO, "Telemetry stream: every %lu ms", (unsigned long)streamPeriod);
+        return;
+    }
+
+    uint8_t mask = parseTelemetryFrames(args);
+    if (mask == 0 || args[strcspn(args, " ")] != '\0') {
+        printTelemetryUsage();
+        return;
+    }
+    sendTelemetryMask(mask);
+}
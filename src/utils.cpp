@@ -20,40 +20,35 @@
 #include <esp_heap_caps.h>
 #include "debug.h"
 #include "nvsManager.h"
+#include "buttonMatrix.h"
+#include "expressionPedal.h"
+#include "scenes.h"
+#include "relayDriver.h"
+#include "relayStats.h"
+#include "relayGroups.h"
+#include "logBuffer.h"
+#include "serialCommands.h"
+#include "telemetry.h"
+#include "metrics.h"
 
-extern unsigned long lastMemoryCheck;
+static MetricGauge heapFreeBytes("heap_free_bytes", "Free 8-bit heap at the last check");
+static MetricGauge heapMinFreeBytes("heap_min_free_bytes", "Lowest free 8-bit heap seen", UINT32_MAX);
 
-// Global variables for memory tracking
-uint32_t minFreeHeap = UINT32_MAX;
-// unsigned long lastMemoryCheck = 0; // Removed to avoid multiple definition
-
-// Enhanced logging with timestamps and proper log levels - Memory optimized
-void log(LogLevel level, const String& msg) {
-    if (level <= currentLogLevel) {
-        char timestamp[32];
-        getUptimeString(timestamp, sizeof(timestamp));
-        const char* levelStr = getLogLevelString(level);
-        Serial.printf("[%s][%s] %s\n", timestamp, levelStr, msg.c_str());
-    }
+// Out-of-line halves of log()/logf(); the level checks are inline in
+// utils.h. Output is deferred to the log task (see logBuffer.h).
+void logText(LogLevel level, const char* msg) {
+    logCaptureText(level, msg);
 }
 
-void logf(LogLevel level, const char* format, ...) {
-    if (level <= currentLogLevel) {
-        char buffer[256];
-        va_list args;
-        va_start(args, format);
-        vsnprintf(buffer, sizeof(buffer), format, args);
-        va_end(args);
-        
-        char timestamp[32];
-        getUptimeString(timestamp, sizeof(timestamp));
-        const char* levelStr = getLogLevelString(level);
-        Serial.printf("[%s][%s] %s\n", timestamp, levelStr, buffer);
-    }
+void logFormat(LogLevel level, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    logCapture(level, format, args);
+    va_end(args);
 }
 
 void logWithTimestamp(LogLevel level, const String& msg) {
-    log(level, msg);
+    log(level, msg); // logtokens: text - a String, sent untokenised
 }
 
 void printMAC(const uint8_t* mac, LogLevel level) {
@@ -69,16 +64,8 @@ void printMAC(const uint8_t* mac, LogLevel level) {
         return;
     }
     
-    if (level <= currentLogLevel) {
-        char timestamp[32];
-        getUptimeString(timestamp, sizeof(timestamp));
-        const char* levelStr = getLogLevelString(level);
-        
-        // MAC addresses are always 6 bytes - verify this assumption
-        Serial.printf("[%s][%s] %02X:%02X:%02X:%02X:%02X:%02X\n", 
-                     timestamp, levelStr,
-                     mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-    }
+    logf(level, "%02X:%02X:%02X:%02X:%02X:%02X",
+         mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
 }
 
 void blinkLED(uint8_t pin, int times, int delayMs) {
@@ -99,6 +86,7 @@ void printSystemStatus() {
     char uptime[32];
     getUptimeString(uptime, sizeof(uptime));
     logf(LOG_INFO, "Uptime: %s", uptime);
+    logf(LOG_INFO, "Last Reset: %s", getResetReasonString());
     
     printMemoryInfo();
     printNetworkStatus();
@@ -114,7 +102,7 @@ void printMemoryInfo() {
     float usagePercent = (float)usedHeap / totalHeap * 100.0;
     
     logf(LOG_INFO, "Memory - Free: %uB, Used: %uB (%.1f%%)", freeHeap, usedHeap, usagePercent);
-    logf(LOG_INFO, "Min Free Heap: %uB", minFreeHeap);
+    logf(LOG_INFO, "Min Free Heap: %uB", getMinFreeHeap());
 }
 
 void printNetworkStatus() {
@@ -127,292 +115,539 @@ void printNetworkStatus() {
 }
 
 void printAmpChannelStatus() {
-    logf(LOG_INFO, "Current Amp Channel: %u", currentAmpChannel);
-    logf(LOG_INFO, "Channel Pins: %u,%u,%u,%u", 
-         ampSwitchPins[0], ampSwitchPins[1], ampSwitchPins[2], ampSwitchPins[3]);
-    logf(LOG_INFO, "Button Pins: %u,%u,%u,%u", 
-         ampButtonPins[0], ampButtonPins[1], ampButtonPins[2], ampButtonPins[3]);
+    if (currentAmpChannel == AMP_CHANNEL_SCENE) {
+        log(LOG_INFO, "Current Amp Channel: scene (multiple outputs)");
+    } else {
+        logf(LOG_INFO, "Current Amp Channel: %u", currentAmpChannel);
+    }
+    logf(LOG_INFO, "Active Outputs: 0x%lX", (unsigned long)getAmpOutputs());
+    logf(LOG_INFO, "Relay Groups: %s", RELAY_GROUPS);
+    // Pin lists are validated against MAX_AMPSWITCHS at compile time
+#if RELAY_OUTPUT_BACKEND == RELAY_BACKEND_GPIO
+    logf(LOG_INFO, "Channel Pins: %s", AMP_SWITCH_PINS);
+#endif
+#if !HAS_BUTTON_MATRIX
+    logf(LOG_INFO, "Button Pins: %s", AMP_BUTTON_PINS);
+#endif
 }
 
 void printPairingStatus() {
     logf(LOG_INFO, "Pairing Status: %s", getPairingStatusString(pairingStatus));
 }
 
-// Enhanced serial command handling
+// Serial console. Bytes are assembled into a line as they arrive, so a
+// partial line never holds up the loop; complete lines are looked up in the
+// command table below.
+static SerialLineBuffer serialLine;
+
 void checkSerialCommands() {
     if (midiLearnChannel >= 0) return; // Block serial commands during MIDI Learn lockout
-    if (Serial.available()) {
-        String cmd = Serial.readStringUntil('\n');
-        cmd.trim();
-        handleSerialCommand(cmd);
+    for (int n = 0; n < SERIAL_BYTES_PER_POLL && Serial.available(); n++) {
+        SerialLineResult result = feedSerialLine(serialLine, (char)Serial.read());
+        if (result == LINE_READY) {
+            handleSerialCommand(serialLine.data);
+            return;
+        }
+        if (result == LINE_OVERFLOW) {
+            logf(LOG_WARN, "Command too long (max %u characters), ignored", SERIAL_LINE_MAX);
+        }
     }
 }
 
-// Forward declarations for command handler helper functions
-bool handleSystemCommands(const String& cmd);
-bool handleMIDICommands(const String& cmd);
-bool handleControlCommands(const String& cmd);
-bool handleTestCommands(const String& cmd);
-bool handleDebugCommands(const String& cmd);
-bool handleAmpChannelCommands(const String& cmd);
-void handlePinCommand();
-void showUnknownCommand(const String& cmd);
+// ---- System commands ----
 
-void handleSerialCommand(const String& cmd) {
-    if (cmd.isEmpty()) return;
+static void cmdHelp(const char* args) {
+    printHelpMenu();
+}
 
-    // Removed automatic LED flash to prevent interference with test patterns
-    
-    // Try each command category
-    if (handleSystemCommands(cmd)) return;
-    if (handleMIDICommands(cmd)) return;
-    if (handleControlCommands(cmd)) return;
-    if (handleTestCommands(cmd)) return;
-    if (handleDebugCommands(cmd)) return;
-    if (handleAmpChannelCommands(cmd)) return;
-    
-    // If no command matched, show unknown command message
-    showUnknownCommand(cmd);
-}
-
-bool handleSystemCommands(const String& cmd) {
-    if (cmd.equalsIgnoreCase("help")) {
-        printHelpMenu();
-        return true;
-    } else if (cmd.equalsIgnoreCase("status")) {
-        printSystemStatus();
-        return true;
-    } else if (cmd.equalsIgnoreCase("memory")) {
-        printMemoryInfo();
-        return true;
-    } else if (cmd.equalsIgnoreCase("network")) {
-        printNetworkStatus();
-        return true;
-    } else if (cmd.equalsIgnoreCase("amp")) {
-        printAmpChannelStatus();
-        return true;
-    } else if (cmd.equalsIgnoreCase("pairing")) {
-        printPairingStatus();
-        return true;
-    } else if (cmd.equalsIgnoreCase("pins")) {
-        handlePinCommand();
-        return true;
-    } else if (cmd.equalsIgnoreCase("uptime")) {
-        char uptime[32];
-        getUptimeString(uptime, sizeof(uptime));
-        logf(LOG_INFO, "Uptime: %s", uptime);
-        return true;
-    } else if (cmd.equalsIgnoreCase("version")) {
-        logf(LOG_INFO, "Firmware Version: %s", FIRMWARE_VERSION);
-        logf(LOG_INFO, "Storage Version: %d", STORAGE_VERSION);
-        return true;
-    } else if (cmd.equalsIgnoreCase("buttons")) {
-        enableButtonChecking = !enableButtonChecking;
-        logf(LOG_INFO, "Button checking %s", enableButtonChecking ? "enabled" : "disabled");
-        return true;
-    } else if (cmd.equalsIgnoreCase("loglevel")) {
-        logf(LOG_INFO, "Current log level: %s (%u)", getLogLevelString(currentLogLevel), (uint8_t)currentLogLevel);
-        return true;
-    } else if (cmd.equalsIgnoreCase("config")) {
-        printClientConfiguration();
-        return true;
-    }
-    return false;
-}
-
-bool handleMIDICommands(const String& cmd) {
-    if (cmd.equalsIgnoreCase("midi")) {
-        log(LOG_INFO, "=== MIDI INFORMATION ===");
-        logf(LOG_INFO, "  Current MIDI Channel: %u (persistent, set via channel select mode)", currentMidiChannel);
-        log(LOG_INFO, "  MIDI Thru: Enabled");
-        logf(LOG_INFO, "  MIDI Pins - RX: %u, TX: %u", MIDI_RX_PIN, MIDI_TX_PIN);
-        log(LOG_INFO, "  Program Change Mapping:");
-        for (int i = 0; i < MAX_AMPSWITCHS; i++) {
-            logf(LOG_INFO, "    Button %d: PC#%u", i+1, midiChannelMap[i]);
-        }
-        log(LOG_INFO, "  (Use 'chset' to change MIDI channel, 'midimap' for detailed mapping)");
-        return true;
-    } else if (cmd.equalsIgnoreCase("midimap")) {
-        log(LOG_INFO, "=== MIDI PROGRAM CHANGE MAP ===");
-        for (int i = 0; i < MAX_AMPSWITCHS; i++) {
-            logf(LOG_INFO, "Button %d: PC#%u", i+1, midiChannelMap[i]);
-        }
-        log(LOG_INFO, "==============================");
-        return true;
-    } else if (cmd.equalsIgnoreCase("ch")) {
-        logf(LOG_INFO, "Current MIDI Channel: %u (persistent, set via channel select mode)", currentMidiChannel);
-        return true;
-    } else if (cmd.equalsIgnoreCase("chset")) {
-        log(LOG_INFO, "To change MIDI channel: Hold Button 1 for 15s to enter channel select mode, then press to increment channel. Auto-saves after 10s of inactivity.");
-        return true;
-    }
-    return false;
-}
-
-bool handleControlCommands(const String& cmd) {
-    if (cmd.equalsIgnoreCase("restart") || cmd.equalsIgnoreCase("reset")) {
-        log(LOG_WARN, "Restarting ESP32...");
-        delay(1000);
-        ESP.restart();
-        return true;
-    } else if (cmd.equalsIgnoreCase("ota")) {
-        serialOtaTrigger = true;
-        log(LOG_INFO, "OTA mode triggered");
-        return true;
-    } else if (cmd.equalsIgnoreCase("pair")) {
-        clearPairingNVS();
-        resetPairingToDefaults();
-        pairingStatus = PAIR_REQUEST;
-        log(LOG_INFO, "Re-pairing requested! Starting discovery from channel 1...");
-        return true;
-    } else if (cmd.startsWith("setlog")) {
-        int level = cmd.substring(6).toInt();
-        if (level >= 0 && level <= 4) {
-            currentLogLevel = (LogLevel)level;
-            saveLogLevelToNVS(currentLogLevel);
-            logf(LOG_INFO, "Log level set to: %s", getLogLevelString(currentLogLevel));
-        } else {
-            log(LOG_WARN, "Invalid log level. Use 0-4 (0=OFF, 1=ERROR, 2=WARN, 3=INFO, 4=DEBUG)");
-        }
-        return true;
-    } else if (cmd.equalsIgnoreCase("clearlog")) {
-        clearLogLevelNVS();
-        currentLogLevel = LOG_INFO;
-        log(LOG_INFO, "Log level reset to default (INFO)");
-        return true;
-    } else if (cmd.equalsIgnoreCase("clearall")) {
-        log(LOG_WARN, "Clearing all NVS data...");
-        clearPairingNVS();
-        clearLogLevelNVS();
-        currentLogLevel = LOG_INFO;
-        resetPairingToDefaults();
-        log(LOG_INFO, "All NVS data cleared - pairing and log level reset to defaults");
-        return true;
-    }
-    return false;
-}
-
-bool handleTestCommands(const String& cmd) {
-    if (cmd.equalsIgnoreCase("testled")) {
-        log(LOG_INFO, "Testing status LED...");
-        setStatusLedPattern(LED_TRIPLE_FLASH);
-        return true;
-    } else if (cmd.equalsIgnoreCase("testpairing")) {
-        log(LOG_INFO, "Testing pairing LED...");
-        for (int i = 0; i < 5; i++) {
-            ledcWrite(LEDC_CHANNEL_0, 512);
-            delay(100);
-            ledcWrite(LEDC_CHANNEL_0, 0);
-            delay(100);
-        }
-        return true;
-    } else if (cmd.equalsIgnoreCase("testbuttons")) {
-        log(LOG_INFO, "=== BUTTON TEST ===");
-        logf(LOG_INFO, "Button checking enabled: %s", enableButtonChecking ? "YES" : "NO");
-        log(LOG_INFO, "Current button states:");
-        for (int i = 0; i < MAX_AMPSWITCHS; i++) {
-            uint8_t state = digitalRead(ampButtonPins[i]);
-            logf(LOG_INFO, "  Button %d (pin %u): %s", i+1, ampButtonPins[i], state ? "HIGH" : "LOW");
-        }
-        log(LOG_INFO, "==================");
-        return true;
-    } else if (cmd.equalsIgnoreCase("forcepair")) {
-        log(LOG_INFO, "=== FORCING PAIRING MODE ===");
-        clearPairingNVS();
-        resetPairingToDefaults();
-        pairingStatus = PAIR_REQUEST;
-        setStatusLedPattern(LED_FADE);
-        log(LOG_INFO, "Pairing mode forced - LED should fade");
-        return true;
-    }
-    return false;
-}
-
-bool handleDebugCommands(const String& cmd) {
-    if (cmd.startsWith("debug")) {
-        String debugCmd = cmd.substring(5);
-        debugCmd.trim();
-        if (debugCmd.isEmpty()) {
-            debugCmd = "debug";
-        }
-        handleDebugCommand(debugCmd.c_str());
-        return true;
+static void cmdStatus(const char* args) {
+    printSystemStatus();
+}
+
+static void cmdMemory(const char* args) {
+    printMemoryInfo();
+}
+
+static void cmdNetwork(const char* args) {
+    printNetworkStatus();
+}
+
+static void cmdAmp(const char* args) {
+    printAmpChannelStatus();
+}
+
+static void cmdPairing(const char* args) {
+    printPairingStatus();
+}
+
+static void cmdPins(const char* args) {
+    handlePinCommand();
+}
+
+static void cmdUptime(const char* args) {
+    char uptime[32];
+    getUptimeString(uptime, sizeof(uptime));
+    logf(LOG_INFO, "Uptime: %s", uptime);
+}
+
+static void cmdPostmortem(const char* args) {
+    printPostmortem();
+}
+
+static void cmdVersion(const char* args) {
+    logf(LOG_INFO, "Firmware Version: %s", FIRMWARE_VERSION);
+    logf(LOG_INFO, "Storage Version: %d", STORAGE_VERSION);
+}
+
+static void cmdButtons(const char* args) {
+    enableButtonChecking = !enableButtonChecking;
+    logf(LOG_INFO, "Button checking %s", enableButtonChecking ? "enabled" : "disabled");
+}
+
+static void cmdLogLevel(const char* args) {
+    logf(LOG_INFO, "Current log level: %s (%u), compiled in up to %s", getLogLevelString(currentLogLevel),
+         (uint8_t)currentLogLevel, getLogLevelString((LogLevel)LOG_LEVEL));
+}
+
+static void cmdConfig(const char* args) {
+    printClientConfiguration();
+}
+
+static void cmdClearLog(const char* args) {
+    clearLogLevelNVS();
+    currentLogLevel = LOG_INFO;
+    log(LOG_INFO, "Log level reset to default (INFO)");
+}
+
+// ---- MIDI commands ----
+
+static void cmdMidi(const char* args) {
+    log(LOG_INFO, "=== MIDI INFORMATION ===");
+    logf(LOG_INFO, "  Current MIDI Channel: %u (persistent, set via channel select mode)", currentMidiChannel);
+    log(LOG_INFO, "  MIDI Thru: Enabled");
+    logf(LOG_INFO, "  MIDI Pins - RX: %u, TX: %u", MIDI_RX_PIN, MIDI_TX_PIN);
+    log(LOG_INFO, "  Program Change Mapping:");
+    for (int i = 0; i < MAX_AMPSWITCHS; i++) {
+        logf(LOG_INFO, "    Button %d: PC#%u", i+1, midiChannelMap[i]);
     }
-    return false;
+    log(LOG_INFO, "  (Use 'chset' to change MIDI channel, 'midimap' for detailed mapping)");
 }
 
-bool handleAmpChannelCommands(const String& cmd) {
-    if (cmd.equalsIgnoreCase("off")) {
-        setAmpChannel(0);
-        log(LOG_INFO, "All amp channels turned off");
-        return true;
-    } else if (cmd.equalsIgnoreCase("speed")) {
-        // Speed test for relay switching
-        log(LOG_INFO, "=== RELAY SPEED TEST ===");
-        
-        unsigned long startTime = micros();
-        setAmpChannel(1);
-        unsigned long time1 = micros();
-        setAmpChannel(0);
-        unsigned long time2 = micros();
-        setAmpChannel(1);
-        unsigned long endTime = micros();
-        
-        logf(LOG_INFO, "Switch ON time: %lu us", time1 - startTime);
-        logf(LOG_INFO, "Switch OFF time: %lu us", time2 - time1);
-        logf(LOG_INFO, "Total cycle time: %lu us", endTime - startTime);
-        logf(LOG_INFO, "Average per switch: %lu us", (endTime - startTime) / 3);
-        
-        #ifdef FAST_SWITCHING
-        log(LOG_INFO, "Mode: Ultra-Fast (Direct register access)");
+static void cmdMidiMap(const char* args) {
+    log(LOG_INFO, "=== MIDI PROGRAM CHANGE MAP ===");
+    for (int i = 0; i < MAX_AMPSWITCHS; i++) {
+        logf(LOG_INFO, "Button %d: PC#%u", i+1, midiChannelMap[i]);
+    }
+    log(LOG_INFO, "==============================");
+}
+
+static void cmdCh(const char* args) {
+    logf(LOG_INFO, "Current MIDI Channel: %u (persistent, set via channel select mode)", currentMidiChannel);
+}
+
+static void cmdChset(const char* args) {
+    log(LOG_INFO, "To change MIDI channel: Hold Button 1 for 15s to enter channel select mode, then press to increment channel. Auto-saves after 10s of inactivity.");
+}
+
+static void cmdExp(const char* args) {
+    printExpressionPedalStatus();
+}
+
+static void cmdExpMin(const char* args) {
+    calibrateExpressionMin();
+}
+
+static void cmdExpMax(const char* args) {
+    calibrateExpressionMax();
+}
+
+// ---- Control commands ----
+
+static void cmdRestart(const char* args) {
+    log(LOG_WARN, "Restarting ESP32...");
+    recordEvent(EVENT_RESTART, "restart command");
+    flushRelayStats();
+    delay(1000);
+    ESP.restart();
+}
+
+static void cmdOta(const char* args) {
+    serialOtaTrigger = true;
+    log(LOG_INFO, "OTA mode triggered");
+}
+
+static void cmdPair(const char* args) {
+    clearPairingNVS();
+    resetPairingToDefaults();
+    pairingStatus = PAIR_REQUEST;
+    log(LOG_INFO, "Re-pairing requested! Starting discovery from channel 1...");
+}
+
+static void cmdSetLog(const char* args) {
+    if (args[0] < '0' || args[0] > '4' || args[1] != '\0') {
+        log(LOG_WARN, "Invalid log level. Use 0-4 (0=OFF, 1=ERROR, 2=WARN, 3=INFO, 4=DEBUG)");
+        return;
+    }
+    int level = args[0] - '0';
+    currentLogLevel = (LogLevel)level;
+    saveLogLevelToNVS(currentLogLevel);
+    logf(LOG_INFO, "Log level set to: %s", getLogLevelString(currentLogLevel));
+    if (level > LOG_LEVEL) {
+        logf(LOG_WARN, "Levels above %s are compiled out (LOG_LEVEL=%d)",
+             getLogLevelString((LogLevel)LOG_LEVEL), LOG_LEVEL);
+    }
+}
+
+static void cmdLogMode(const char* args) {
+    if (*args == '\0') {
+        logf(LOG_INFO, "Log output: %s", isLogTokenized() ? "tokenised" : "text");
+        return;
+    }
+    bool tokenized = strcasecmp(args, "token") == 0;
+    if (!tokenized && strcasecmp(args, "text") != 0) {
+        log(LOG_WARN, "Usage: logmode [text|token]");
+        return;
+    }
+    if (tokenized) {
+        log(LOG_INFO, "Log output: tokenised (decode with tools/logdecode.py)");
+    }
+    setLogTokenized(tokenized);
+    if (!tokenized) {
+        log(LOG_INFO, "Log output: text");
+    }
+}
+
+static void cmdClearAll(const char* args) {
+    log(LOG_WARN, "Clearing all NVS data...");
+    clearPairingNVS();
+    clearLogLevelNVS();
+    currentLogLevel = LOG_INFO;
+    resetPairingToDefaults();
+    log(LOG_INFO, "All NVS data cleared - pairing and log level reset to defaults");
+}
+
+// ---- Test commands ----
+
+static void cmdTestLed(const char* args) {
+    log(LOG_INFO, "Testing status LED...");
+    setStatusLedPattern(LED_TRIPLE_FLASH);
+}
+
+static void cmdTestPairing(const char* args) {
+    log(LOG_INFO, "Testing pairing LED...");
+    // Through the pattern queue: works on either LED backend and keeps the loop running
+    setStatusLedPattern(LED_PENTA_FLASH);
+}
+
+static void cmdTestButtons(const char* args) {
+    log(LOG_INFO, "=== BUTTON TEST ===");
+    logf(LOG_INFO, "Button checking enabled: %s", enableButtonChecking ? "YES" : "NO");
+    log(LOG_INFO, "Current button states:");
+    for (int i = 0; i < NUM_BUTTONS; i++) {
+        uint8_t state = readButtonLevel(i);
+        #if HAS_BUTTON_MATRIX
+        logf(LOG_INFO, "  Button %d (row %d, col %d): %s", i+1, i / BUTTON_MATRIX_COLS + 1,
+             i % BUTTON_MATRIX_COLS + 1, state ? "HIGH" : "LOW");
         #else
-        log(LOG_INFO, "Mode: Standard (digitalWrite)");
+        logf(LOG_INFO, "  Button %d (pin %u): %s", i+1, ampButtonPins[i], state ? "HIGH" : "LOW");
         #endif
-        
-        return true;
-    } else if (cmd.equalsIgnoreCase("test")) {
-        // Test command to manually toggle the relay
-        log(LOG_INFO, "Testing relay - toggling pin state...");
-        int currentState = digitalRead(ampSwitchPins[0]);
-        logf(LOG_INFO, "Current pin %u state: %s", ampSwitchPins[0], currentState ? "HIGH" : "LOW");
-        
-        digitalWrite(ampSwitchPins[0], !currentState);
-        delay(100); // Small delay to ensure write completes
-        
-        int newState = digitalRead(ampSwitchPins[0]);
-        logf(LOG_INFO, "New pin %u state: %s", ampSwitchPins[0], newState ? "HIGH" : "LOW");
-        
-        if (newState != !currentState) {
-            logf(LOG_ERROR, "Pin state didn't change! Expected %s, got %s", 
-                 !currentState ? "HIGH" : "LOW", newState ? "HIGH" : "LOW");
+    }
+    log(LOG_INFO, "==================");
+}
+
+static void cmdForcePair(const char* args) {
+    log(LOG_INFO, "=== FORCING PAIRING MODE ===");
+    clearPairingNVS();
+    resetPairingToDefaults();
+    pairingStatus = PAIR_REQUEST;
+    setStatusLedPattern(LED_FADE);
+    log(LOG_INFO, "Pairing mode forced - LED should fade");
+}
+
+// ---- Debug commands (subcommands are in debug.cpp) ----
+
+static void cmdDebug(const char* args) {
+    handleDebugCommand(args);
+}
+
+// ---- Amp channel commands ----
+
+static void cmdChannel(const char* args) {
+    int ch = atoi(args);
+    if (ch < 1 || ch > MAX_AMPSWITCHS) {
+        logf(LOG_WARN, "Invalid channel. Use 1-%d", MAX_AMPSWITCHS);
+        return;
+    }
+    setAmpChannel(ch);
+    logf(LOG_INFO, "Amp channel set to %u", ch);
+}
+
+static void cmdButtonPress(const char* args) {
+    int btn = atoi(args);
+    if (btn >= 1 && btn <= MAX_AMPSWITCHS) {
+        logf(LOG_INFO, "Simulating button %d press", btn);
+        setAmpChannel(btn);
+    } else {
+        logf(LOG_WARN, "Invalid button number. Use b1-b%d", MAX_AMPSWITCHS);
+    }
+}
+
+static void cmdOff(const char* args) {
+    setAmpChannel(0);
+    log(LOG_INFO, "All amp channels turned off");
+}
+
+static void cmdSpeed(const char* args) {
+    // Speed test for relay switching
+    log(LOG_INFO, "=== RELAY SPEED TEST ===");
+    
+    unsigned long startTime = micros();
+    setAmpChannel(1);
+    unsigned long time1 = micros();
+    setAmpChannel(0);
+    unsigned long time2 = micros();
+    setAmpChannel(1);
+    unsigned long endTime = micros();
+    
+    logf(LOG_INFO, "Switch ON time: %lu us", time1 - startTime);
+    logf(LOG_INFO, "Switch OFF time: %lu us", time2 - time1);
+    logf(LOG_INFO, "Total cycle time: %lu us", endTime - startTime);
+    logf(LOG_INFO, "Average per switch: %lu us", (endTime - startTime) / 3);
+    
+    #ifdef FAST_SWITCHING
+    log(LOG_INFO, "Mode: Ultra-Fast (Direct register access)");
+    #else
+    log(LOG_INFO, "Mode: Standard (digitalWrite)");
+    #endif
+}
+
+static void cmdTest(const char* args) {
+    // Test command to manually toggle the relay
+#if RELAY_OUTPUT_BACKEND == RELAY_BACKEND_SHIFT_REG
+    log(LOG_INFO, "Testing relay - toggling shift register output 1...");
+    bool wasOn = getShiftRegisterState() & 1;
+    writeRelayMasks(wasOn ? 0 : 1, wasOn ? 1 : 0);
+    logf(LOG_INFO, "Output 1: %s -> %s (state 0x%08lX)", wasOn ? "ON" : "OFF",
+         (getShiftRegisterState() & 1) ? "ON" : "OFF", (unsigned long)getShiftRegisterState());
+#else
+    log(LOG_INFO, "Testing relay - toggling pin state...");
+    int currentState = digitalRead(ampSwitchPins[0]);
+    logf(LOG_INFO, "Current pin %u state: %s", ampSwitchPins[0], currentState ? "HIGH" : "LOW");
+    
+    digitalWrite(ampSwitchPins[0], !currentState);
+    delay(100); // Small delay to ensure write completes
+    
+    int newState = digitalRead(ampSwitchPins[0]);
+    logf(LOG_INFO, "New pin %u state: %s", ampSwitchPins[0], newState ? "HIGH" : "LOW");
+    
+    if (newState != !currentState) {
+        logf(LOG_ERROR, "Pin state didn't change! Expected %s, got %s", 
+             !currentState ? "HIGH" : "LOW", newState ? "HIGH" : "LOW");
+    } else {
+        log(LOG_INFO, "Pin toggle successful!");
+    }
+#endif
+}
+
+static void cmdGroups(const char* args) {
+    printRelayGroups();
+}
+
+static void cmdGroupOff(const char* args) {
+    int group = atoi(args);
+    if (group >= 1 && group <= RELAY_GROUP_COUNT) {
+        setAmpGroupOff(group);
+        logf(LOG_INFO, "Relay group %d off", group);
+    } else {
+        logf(LOG_WARN, "Usage: groupoff <1-%u>", RELAY_GROUP_COUNT);
+    }
+}
+
+static void cmdRelayStats(const char* args) {
+    if (*args == '\0') {
+        printRelayStats();
+    } else if (strcasecmp(args, "save") == 0) {
+        flushRelayStats();
+        log(LOG_INFO, "Relay stats journal flushed");
+    } else if (strncasecmp(args, "reset", 5) == 0) {
+        int output = atoi(args + 5);
+        if (output >= 1 && output <= MAX_AMPSWITCHS) {
+            resetRelayStats(output);
+            logf(LOG_INFO, "Relay output %d wear counters reset", output);
         } else {
-            log(LOG_INFO, "Pin toggle successful!");
+            logf(LOG_WARN, "Usage: relaystats reset <1-%d>", MAX_AMPSWITCHS);
         }
-        return true;
-    } else if (cmd.toInt() > 0 && cmd.toInt() <= MAX_AMPSWITCHS) {
-        uint8_t ch = cmd.toInt();
-        setAmpChannel(ch);
-        logf(LOG_INFO, "Amp channel set to %u", ch);
-        return true;
-    } else if (cmd.length() == 2 && cmd[0] == 'b') {
-        int btn = cmd[1] - '0';
-        if (btn >= 1 && btn <= MAX_AMPSWITCHS) {
-            logf(LOG_INFO, "Simulating button %d press", btn);
-            setAmpChannel(btn);
-        } else {
-            logf(LOG_WARN, "Invalid button number. Use b1-b%d", MAX_AMPSWITCHS);
+    } else {
+        log(LOG_WARN, "Usage: relaystats [save | reset <output>]");
+    }
+}
+
+static void cmdMetrics(const char* args) {
+    printMetricsPrometheus();
+}
+
+static void cmdTelemetry(const char* args) {
+    handleTelemetryCommand(args);
+}
+
+static void cmdScenes(const char* args) {
+    printScenes();
+}
+
+static void cmdScene(const char* args) {
+    int scene = atoi(args);
+    if (applyAmpScene(scene)) {
+        logf(LOG_INFO, "Scene %d recalled (outputs 0x%lX)", scene, (unsigned long)getAmpOutputs());
+    } else {
+        logf(LOG_WARN, "Invalid scene. Use scene 1-%d", MAX_SCENES);
+    }
+}
+
+// sceneset <n> <mask>, mask bit 0 = first relay output (hex with 0x or decimal)
+static void cmdSceneSet(const char* args) {
+    int scene = 0;
+    char maskStr[16] = "";
+    if (sscanf(args, "%d %15s", &scene, maskStr) != 2 || scene < 1 || scene > MAX_SCENES) {
+        logf(LOG_WARN, "Usage: sceneset <1-%d> <output mask>", MAX_SCENES);
+        return;
+    }
+    uint32_t outputs = strtoul(maskStr, nullptr, 0);
+    if (MAX_AMPSWITCHS < 32 && (outputs >> MAX_AMPSWITCHS) != 0) {
+        logf(LOG_WARN, "Output mask 0x%lX exceeds %d relay outputs", (unsigned long)outputs, MAX_AMPSWITCHS);
+        return;
+    }
+    ampScenes[scene - 1].outputs = outputs;
+    rebuildSceneMasks();
+    saveScenesToNVS(ampScenes);
+    logf(LOG_INFO, "Scene %d outputs set to 0x%lX", scene, (unsigned long)outputs);
+}
+
+// scenepc <n> <program>, program 128+ removes the mapping
+static void cmdScenePc(const char* args) {
+    int scene = 0;
+    int program = -1;
+    if (sscanf(args, "%d %d", &scene, &program) != 2 || scene < 1 || scene > MAX_SCENES || program < 0) {
+        logf(LOG_WARN, "Usage: scenepc <1-%d> <0-127, 128=none>", MAX_SCENES);
+        return;
+    }
+    ampScenes[scene - 1].program = (program <= 127) ? (uint8_t)program : SCENE_NO_PROGRAM;
+    saveScenesToNVS(ampScenes);
+    logf(LOG_INFO, "Scene %d mapped to PC#%d", scene, program <= 127 ? program : -1);
+}
+
+// ---- Command table ----
+
+enum HelpSection : uint8_t {
+    HELP_SYSTEM,
+    HELP_MIDI,
+    HELP_CONTROL,
+    HELP_TEST,
+    HELP_DEBUG,
+    HELP_AMP,
+    HELP_SECTIONS
+};
+
+static const char* const helpSectionTitles[HELP_SECTIONS] = {
+    "SYSTEM COMMANDS:", "MIDI COMMANDS:", "CONTROL COMMANDS:", "TEST COMMANDS:",
+    "DEBUG COMMANDS:", "AMP CHANNEL COMMANDS:"
+};
+
+// Sorted by name (checked below); help lists each section in table order
+static constexpr SerialCommand serialCommands[] = {
+    {"1", "1-4", "Switch to amp channel 1-4", cmdChannel, HELP_AMP, CMD_CHANNEL},
+    {"amp", nullptr, "Show amp channel status", cmdAmp, HELP_SYSTEM, CMD_EXACT},
+    {"b", "b1-b4", "Simulate button press 1-4", cmdButtonPress, HELP_AMP, CMD_NUMBER},
+    {"buttons", nullptr, "Toggle button checking on/off", cmdButtons, HELP_SYSTEM, CMD_EXACT},
+    {"ch", nullptr, "Show the current MIDI channel (persistent, set via channel select mode)", cmdCh, HELP_MIDI, CMD_EXACT},
+    {"chset", nullptr, "Print instructions for entering channel select mode", cmdChset, HELP_MIDI, CMD_EXACT},
+    {"clearall", nullptr, "Clear all NVS data (pairing + log level)", cmdClearAll, HELP_CONTROL, CMD_EXACT},
+    {"clearlog", nullptr, "Clear saved log level (reset to default)", cmdClearLog, HELP_SYSTEM, CMD_EXACT},
+    {"config", nullptr, "Show build configuration", cmdConfig, HELP_SYSTEM, CMD_EXACT},
+    {"debug", nullptr, "Show complete debug info", cmdDebug, HELP_DEBUG, CMD_ARGS | CMD_SUBCOMMAND},
+    {"exp", nullptr, "Show expression pedal status", cmdExp, HELP_MIDI, CMD_EXACT},
+    {"expmax", nullptr, "Calibrate expression pedal toe position (pedal down)", cmdExpMax, HELP_MIDI, CMD_EXACT},
+    {"expmin", nullptr, "Calibrate expression pedal heel position (pedal up)", cmdExpMin, HELP_MIDI, CMD_EXACT},
+    {"forcepair", nullptr, "Force pairing mode (for testing LED fade)", cmdForcePair, HELP_TEST, CMD_EXACT},
+    {"groupoff", "groupoff N", "Turn every output of group N off", cmdGroupOff, HELP_AMP, CMD_ARGS | CMD_NUMBER},
+    {"groups", nullptr, "Relay group topology and per-group state", cmdGroups, HELP_AMP, CMD_EXACT},
+    {"help", nullptr, "Show this help menu", cmdHelp, HELP_SYSTEM, CMD_EXACT},
+    {"loglevel", nullptr, "Show current log level", cmdLogLevel, HELP_SYSTEM, CMD_EXACT},
+    {"logmode", "logmode text|token", "Text log lines or tokenised binary frames", cmdLogMode, HELP_CONTROL, CMD_ARGS},
+    {"memory", nullptr, "Show memory usage", cmdMemory, HELP_SYSTEM, CMD_EXACT},
+    {"metrics", nullptr, "All metrics in Prometheus text format", cmdMetrics, HELP_DEBUG, CMD_EXACT},
+    {"midi", nullptr, "Show current MIDI configuration and channel", cmdMidi, HELP_MIDI, CMD_EXACT},
+    {"midimap", nullptr, "Show MIDI Program Change to channel mapping", cmdMidiMap, HELP_MIDI, CMD_EXACT},
+    {"network", nullptr, "Show network status", cmdNetwork, HELP_SYSTEM, CMD_EXACT},
+    {"off", nullptr, "Turn all channels off", cmdOff, HELP_AMP, CMD_EXACT},
+    {"ota", nullptr, "Enter OTA update mode", cmdOta, HELP_CONTROL, CMD_EXACT},
+    {"pair", nullptr, "Clear pairing and re-pair", cmdPair, HELP_CONTROL, CMD_EXACT},
+    {"pairing", nullptr, "Show pairing status", cmdPairing, HELP_SYSTEM, CMD_EXACT},
+    {"pins", nullptr, "Show pin assignments (amp, button, LED, MIDI)", cmdPins, HELP_SYSTEM, CMD_EXACT},
+    {"postmortem", nullptr, "Show events kept in RTC memory from before the last reset", cmdPostmortem, HELP_SYSTEM, CMD_EXACT},
+    {"relaystats", "relaystats [save|reset N]", "Relay actuation counts and on-time; write the journal; zero output N", cmdRelayStats, HELP_AMP, CMD_ARGS},
+    {"reset", nullptr, "Reboot the device", cmdRestart, HELP_CONTROL, CMD_HIDDEN},
+    {"restart", nullptr, "Reboot the device", cmdRestart, HELP_CONTROL, CMD_EXACT},
+    {"scene", "sceneN", "Recall scene N (e.g. scene2)", cmdScene, HELP_AMP, CMD_ARGS | CMD_NUMBER},
+    {"scenepc", "scenepc N P", "Map Program Change P to scene N (128 = none)", cmdScenePc, HELP_AMP, CMD_ARGS},
+    {"scenes", nullptr, "List relay scenes (output masks and PC mapping)", cmdScenes, HELP_AMP, CMD_EXACT},
+    {"sceneset", "sceneset N M", "Set scene N outputs to bitmask M (bit0 = relay 1)", cmdSceneSet, HELP_AMP, CMD_ARGS},
+    {"setlog", "setlogN", "Set log level (N=0-4)", cmdSetLog, HELP_CONTROL, CMD_ARGS | CMD_NUMBER},
+    {"speed", nullptr, "Measure switching speed", cmdSpeed, HELP_AMP, CMD_EXACT},
+    {"status", nullptr, "Show complete system status", cmdStatus, HELP_SYSTEM, CMD_EXACT},
+    {"telemetry", "telemetry status|config|perf|espnow|all|stream <ms>", "Binary telemetry frames for tools/telemetry.py", cmdTelemetry, HELP_DEBUG, CMD_ARGS},
+    {"test", nullptr, "Test relay pin toggle", cmdTest, HELP_AMP, CMD_EXACT},
+    {"testbuttons", nullptr, "Show current button states", cmdTestButtons, HELP_TEST, CMD_EXACT},
+    {"testled", nullptr, "Test status LED", cmdTestLed, HELP_TEST, CMD_EXACT},
+    {"testpairing", nullptr, "Test pairing LED", cmdTestPairing, HELP_TEST, CMD_EXACT},
+    {"uptime", nullptr, "Show system uptime", cmdUptime, HELP_SYSTEM, CMD_EXACT},
+    {"version", nullptr, "Show firmware version", cmdVersion, HELP_SYSTEM, CMD_EXACT},
+};
+
+#define SERIAL_COMMAND_COUNT (sizeof(serialCommands) / sizeof(serialCommands[0]))
+static_assert(serialCommandsSorted(serialCommands, SERIAL_COMMAND_COUNT),
+              "serialCommands[] must stay sorted by name");
+
+void handleSerialCommand(const char* line) {
+    if (*line == '\0') return;
+    if (!runSerialCommand(serialCommands, SERIAL_COMMAND_COUNT, line)) {
+        showUnknownCommand(line);
+    }
+}
+
+// Lookup cost for a spread of commands: exact hits at both ends of the
+// table, a number run into the name, a subcommand, a channel and a miss
+void runCommandBenchmark() {
+    static const char* const samples[] = {"amp", "version", "setlog3", "debugperf", "2", "nosuch"};
+    const int rounds = 100;
+    log(LOG_INFO, "Command lookup (cycles per call):");
+    for (size_t s = 0; s < sizeof(samples) / sizeof(samples[0]); s++) {
+        const char* args;
+        uint32_t start = ESP.getCycleCount();
+        for (int i = 0; i < rounds; i++) {
+            findSerialCommand(serialCommands, SERIAL_COMMAND_COUNT, samples[s], &args);
         }
-        return true;
+        uint32_t perCall = (ESP.getCycleCount() - start) / rounds;
+        logf(LOG_INFO, "  %-10s %lu (%lu ns)", samples[s], (unsigned long)perCall,
+             (unsigned long)(perCall * 1000UL / ESP.getCpuFreqMHz()));
+    }
+
+    const char line[] = "sceneset 2 0x3\n";
+    SerialLineBuffer buffer = {};
+    uint32_t start = ESP.getCycleCount();
+    for (int i = 0; i < rounds; i++) {
+        for (const char* p = line; *p; p++) feedSerialLine(buffer, *p);
     }
-    return false;
+    uint32_t perByte = (ESP.getCycleCount() - start) / (rounds * (sizeof(line) - 1));
+    logf(LOG_INFO, "  Line assembly: %lu cycles/byte, %u commands in table", (unsigned long)perByte,
+         (unsigned)SERIAL_COMMAND_COUNT);
 }
 
 void handlePinCommand() {
     log(LOG_INFO, "=== PIN ASSIGNMENTS ===");
     
     // Build pin strings using char arrays to avoid String concatenation
-    char switchPinsStr[32] = "";
-    char buttonPinsStr[32] = "";
+    char switchPinsStr[128] = "";
+    char buttonPinsStr[128] = "";
     
     for (int i = 0; i < MAX_AMPSWITCHS; i++) {
         char pinStr[8];
@@ -427,113 +662,37 @@ void handlePinCommand() {
     
     logf(LOG_INFO, "Amp Switch Pins: %s", switchPinsStr);
     logf(LOG_INFO, "Amp Button Pins: %s", buttonPinsStr);
+    #if STATUS_LED_BACKEND == STATUS_LED_WS2812
+    logf(LOG_INFO, "Status LED: WS2812 on pin %u (RMT)", RGB_LED_PIN);
+    #else
     logf(LOG_INFO, "Status/Pairing LED Pin: %u", PAIRING_LED_PIN);
+    #endif
     logf(LOG_INFO, "MIDI RX Pin: %u", MIDI_RX_PIN);
     logf(LOG_INFO, "MIDI TX Pin: %u", MIDI_TX_PIN);
     log(LOG_INFO, "======================");
 }
 
-void showUnknownCommand(const String& cmd) {
-    logf(LOG_WARN, "Unknown command: '%s'", cmd.c_str());
+void showUnknownCommand(const char* cmd) {
+    logf(LOG_WARN, "Unknown command: '%s'", cmd);
     log(LOG_INFO, "Type 'help' for available commands");
 }
 
-// Helper functions for printing help menu sections
-void printHelpHeader();
-void printSystemCommandsHelp();
-void printMIDICommandsHelp();
-void printControlCommandsHelp();
-void printTestCommandsHelp();
-void printDebugCommandsHelp();
-void printAmpChannelCommandsHelp();
-void printLogLevelsHelp();
-void printExamplesHelp();
-void printHelpFooter();
-
+// Generated from serialCommands[]; debug subcommands come from debug.cpp
 void printHelpMenu() {
-    printHelpHeader();
-    printSystemCommandsHelp();
-    printMIDICommandsHelp();
-    printControlCommandsHelp();
-    printTestCommandsHelp();
-    printDebugCommandsHelp();
-    printAmpChannelCommandsHelp();
+    Serial.println(F("\n========== SERIAL COMMANDS =========="));
+    for (uint8_t section = 0; section < HELP_SECTIONS; section++) {
+        Serial.println(helpSectionTitles[section]);
+        printSerialCommandHelp(serialCommands, SERIAL_COMMAND_COUNT, section, "");
+        if (section == HELP_DEBUG) {
+            printDebugCommandList("debug");
+        }
+        Serial.println(F(""));
+    }
     printLogLevelsHelp();
     printExamplesHelp();
     printHelpFooter();
 }
 
-void printHelpHeader() {
-    Serial.println(F("\n========== SERIAL COMMANDS =========="));
-}
-
-void printSystemCommandsHelp() {
-    Serial.println(F("SYSTEM COMMANDS:"));
-    Serial.println(F("  help        : Show this help menu"));
-    Serial.println(F("  status      : Show complete system status"));
-    Serial.println(F("  memory      : Show memory usage"));
-    Serial.println(F("  network     : Show network status"));
-    Serial.println(F("  amp         : Show amp channel status"));
-    Serial.println(F("  pairing     : Show pairing status"));
-    Serial.println(F("  pins        : Show pin assignments (amp, button, LED, MIDI)"));
-    Serial.println(F("  uptime      : Show system uptime"));
-    Serial.println(F("  version     : Show firmware version"));
-    Serial.println(F("  buttons     : Toggle button checking on/off"));
-    Serial.println(F("  loglevel    : Show current log level"));
-    Serial.println(F("  clearlog    : Clear saved log level (reset to default)"));
-    Serial.println(F(""));
-}
-
-void printMIDICommandsHelp() {
-    Serial.println(F("MIDI COMMANDS:"));
-    Serial.println(F("  midi        : Show current MIDI configuration and channel"));
-    Serial.println(F("  midimap     : Show MIDI Program Change to channel mapping"));
-    Serial.println(F("  ch          : Show the current MIDI channel (persistent, set via channel select mode)"));
-    Serial.println(F("  chset       : Print instructions for entering channel select mode"));
-    Serial.println(F(""));
-}
-
-void printControlCommandsHelp() {
-    Serial.println(F("CONTROL COMMANDS:"));
-    Serial.println(F("  restart     : Reboot the device"));
-    Serial.println(F("  ota         : Enter OTA update mode"));
-    Serial.println(F("  pair        : Clear pairing and re-pair"));
-    Serial.println(F("  setlogN     : Set log level (N=0-4)"));
-    Serial.println(F("  clearall    : Clear all NVS data (pairing + log level)"));
-    Serial.println(F(""));
-}
-
-void printTestCommandsHelp() {
-    Serial.println(F("TEST COMMANDS:"));
-    Serial.println(F("  testled     : Test status LED"));
-    Serial.println(F("  testpairing : Test pairing LED"));
-    Serial.println(F("  testbuttons : Show current button states"));
-    Serial.println(F("  forcepair   : Force pairing mode (for testing LED fade)"));
-    Serial.println(F(""));
-}
-
-void printDebugCommandsHelp() {
-    Serial.println(F("DEBUG COMMANDS:"));
-    Serial.println(F("  debug       : Show complete debug info"));
-    Serial.println(F("  debugperf   : Show performance metrics"));
-    Serial.println(F("  debugmemory : Show memory analysis"));
-    Serial.println(F("  debugwifi   : Show WiFi stats"));
-    Serial.println(F("  debugespnow : Show ESP-NOW stats"));
-    Serial.println(F("  debugtask   : Show task stats"));
-    Serial.println(F("  debughelp   : Show debug commands"));
-    Serial.println(F(""));
-}
-
-void printAmpChannelCommandsHelp() {
-    Serial.println(F("AMP CHANNEL COMMANDS:"));
-    Serial.println(F("  1-4         : Switch to amp channel 1-4"));
-    Serial.println(F("  b1-b4       : Simulate button press 1-4"));
-    Serial.println(F("  off         : Turn all channels off"));
-    Serial.println(F("  test        : Test relay pin toggle"));
-    Serial.println(F("  speed       : Measure switching speed"));
-    Serial.println(F(""));
-}
-
 void printLogLevelsHelp() {
     Serial.println(F("LOG LEVELS:"));
     Serial.println(F("  0=OFF, 1=ERROR, 2=WARN, 3=INFO, 4=DEBUG"));
@@ -603,7 +762,11 @@ void getUptimeString(char* buffer, size_t bufferSize) {
         return;
     }
     
-    unsigned long uptime = millis();
+    formatUptime(millis(), buffer, bufferSize);
+}
+
+// Uptime as [d ]hh:mm:ss / mm:ss; no logging, the log task uses it too
+void formatUptime(unsigned long uptime, char* buffer, size_t bufferSize) {
     unsigned long seconds = uptime / 1000;
     unsigned long minutes = seconds / 60;
     unsigned long hours = minutes / 60;
@@ -617,194 +780,18 @@ void getUptimeString(char* buffer, size_t bufferSize) {
     } else {
         result = snprintf(buffer, bufferSize, "%02lu:%02lu", minutes, seconds % 60);
     }
-    
-    // Check for snprintf truncation or error
-    if (result < 0) {
-        log(LOG_ERROR, "Error formatting uptime string");
+    if (result < 0 && bufferSize > 0) {
         buffer[0] = '\0';
-    } else if (result >= (int)bufferSize) {
-        logf(LOG_WARN, "Uptime string truncated: needed %d bytes, had %zu", result, bufferSize);
     }
 }
 
 uint32_t getFreeHeap() {
     uint32_t freeHeap = heap_caps_get_free_size(MALLOC_CAP_8BIT);
-    if (freeHeap < minFreeHeap) {
-        minFreeHeap = freeHeap;
-    }
+    heapFreeBytes.set(freeHeap);
+    heapMinFreeBytes.setMin(freeHeap);
     return freeHeap;
 }
 
 uint32_t getMinFreeHeap() {
-    return minFreeHeap;
+    return heapMinFreeBytes.value;
 }
-
-void setStatusLedPattern(StatusLedPattern pattern) {
-    // If pairing or OTA mode is active, ignore other patterns
-    if (pairingStatus == PAIR_REQUEST || pairingStatus == PAIR_REQUESTED) {
-        currentLedPattern = LED_FADE;
-        ledPatternStart = millis();
-        ledPatternStep = 0;
-        return;
-    }
-    if (serialOtaTrigger) {
-        currentLedPattern = LED_FAST_BLINK;
-        return;
-    }
-    currentLedPattern = pattern;
-    ledPatternStart = millis();
-    ledPatternStep = 0;
-}
-
-void updateStatusLED() {
-    static uint16_t fadeValue = 0;
-    static int8_t fadeDirection = 1;
-    static unsigned long lastUpdate = 0;
-    static bool ledState = LOW;
-    static unsigned long lastFadeUpdate = 0;
-    static StatusLedPattern lastPattern = LED_OFF;
-    static PairingStatus lastPairingStatus = NOT_PAIRED;
-    unsigned long now = millis();
-
-    // Detect pairing status changes
-    if (lastPairingStatus != pairingStatus) {
-        // Reset LED to OFF when pairing completes successfully
-        if (pairingStatus == PAIR_PAIRED && lastPairingStatus != PAIR_PAIRED) {
-            currentLedPattern = LED_OFF;
-            ledPatternStart = now;
-            ledPatternStep = 0;
-            ledcWrite(LEDC_CHANNEL_0, 0);
-        }
-        
-        lastPairingStatus = pairingStatus;
-    }
-
-    // Only override patterns during active pairing phases, not when paired
-    if (pairingStatus == PAIR_REQUEST || pairingStatus == PAIR_REQUESTED) {
-        if (currentLedPattern != LED_FADE) {
-            currentLedPattern = LED_FADE;
-            ledPatternStart = now;
-            ledPatternStep = 0;
-        }
-    } else if (serialOtaTrigger) {
-        if (currentLedPattern != LED_FAST_BLINK) {
-            currentLedPattern = LED_FAST_BLINK;
-            ledPatternStart = now;
-            ledPatternStep = 0;
-        }
-    }
-
-    // Reset fade variables when pattern changes to fade
-    if (currentLedPattern == LED_FADE && lastPattern != LED_FADE) {
-        fadeValue = 0;
-        fadeDirection = 1;
-        lastFadeUpdate = now;
-    }
-    lastPattern = currentLedPattern;
-
-    switch (currentLedPattern) {
-        case LED_SINGLE_FLASH:
-            if (ledPatternStep == 0) {
-                ledcWrite(LEDC_CHANNEL_0, 8191);
-                if (now - ledPatternStart > 80) { ledPatternStep = 1; ledPatternStart = now; }
-            } else if (ledPatternStep == 1) {
-                ledcWrite(LEDC_CHANNEL_0, 0);
-                if (now - ledPatternStart > 120) { currentLedPattern = LED_OFF; }
-            }
-            break;
-        case LED_DOUBLE_FLASH:
-            if (ledPatternStep == 0 || ledPatternStep == 2) {
-                ledcWrite(LEDC_CHANNEL_0, 8191);
-                if (now - ledPatternStart > 60) { ledPatternStep++; ledPatternStart = now; }
-            } else if (ledPatternStep == 1 || ledPatternStep == 3) {
-                ledcWrite(LEDC_CHANNEL_0, 0);
-                if (now - ledPatternStart > 60) { ledPatternStep++; ledPatternStart = now; }
-            } else {
-                currentLedPattern = LED_OFF;
-            }
-            break;
-        case LED_TRIPLE_FLASH:
-            if (ledPatternStep % 2 == 0) {
-                ledcWrite(LEDC_CHANNEL_0, 8191);
-            } else {
-                ledcWrite(LEDC_CHANNEL_0, 0);
-            }
-            if (now - ledPatternStart > 50) {
-                ledPatternStep++;
-                ledPatternStart = now;
-            }
-            if (ledPatternStep > 5) {
-                currentLedPattern = LED_OFF;
-            }
-            break;
-        case LED_QUAD_FLASH:
-            if (ledPatternStep % 2 == 0) {
-                ledcWrite(LEDC_CHANNEL_0, 8191);
-            } else {
-                ledcWrite(LEDC_CHANNEL_0, 0);
-            }
-            if (now - ledPatternStart > 50) {
-                ledPatternStep++;
-                ledPatternStart = now;
-            }
-            if (ledPatternStep > 7) {
-                currentLedPattern = LED_OFF;
-            }
-            break;
-        case LED_PENTA_FLASH:
-            if (ledPatternStep % 2 == 0) {
-                ledcWrite(LEDC_CHANNEL_0, 8191);
-            } else {
-                ledcWrite(LEDC_CHANNEL_0, 0);
-            }
-            if (now - ledPatternStart > 50) {
-                ledPatternStep++;
-                ledPatternStart = now;
-            }
-            if (ledPatternStep > 9) {
-                currentLedPattern = LED_OFF;
-            }
-            break;
-        case LED_HEXA_FLASH:
-            if (ledPatternStep % 2 == 0) {
-                ledcWrite(LEDC_CHANNEL_0, 8191);
-            } else {
-                ledcWrite(LEDC_CHANNEL_0, 0);
-            }
-            if (now - ledPatternStart > 50) {
-                ledPatternStep++;
-                ledPatternStart = now;
-            }
-            if (ledPatternStep > 11) {
-                currentLedPattern = LED_OFF;
-            }
-            break;
-        case LED_FAST_BLINK:
-            ledcWrite(LEDC_CHANNEL_0, (now / 100) % 2 ? 8191 : 0);
-            break;
-        case LED_SOLID_ON:
-            ledcWrite(LEDC_CHANNEL_0, 8191);
-            break;
-        case LED_FADE:
-            // Smooth 2-second fade cycle - continuous fade from bottom to top and back
-            if (now - lastFadeUpdate > 20) { // Update every 20ms for smooth fade
-                fadeValue += fadeDirection * 20; // Smaller increment for smooth fade
-                
-                if (fadeValue >= 8191) {
-                    fadeValue = 8191;
-                    fadeDirection = -1; // Start fading down
-                } else if (fadeValue <= 0) {
-                    fadeValue = 0;
-                    fadeDirection = 1; // Start fading up
-                }
-                
-                ledcWrite(LEDC_CHANNEL_0, fadeValue);
-                lastFadeUpdate = now;
-            }
-            break;
-        case LED_OFF:
-        default:
-            ledcWrite(LEDC_CHANNEL_0, 0);
-            break;
-    }
-}
\ No newline at end of file
@@ -0,0 +1,107 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Minimal Arduino.h for the host tests: just enough for the firmware
+// sources under test to build with the host compiler. Time, pins and
+// timers are declared here and simulated by hostBoard.cpp; Serial is
+// header-only so tests of hardware-free code need nothing else.
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+typedef uint8_t byte;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 1
+#define OUTPUT 3
+#define INPUT_PULLUP 5
+#define OUTPUT_OPEN_DRAIN 0x13
+#define F(x) (x)
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+class String {
+public:
+    String(const char* s = "") : str(s ? s : "") {}
+    const char* c_str() const { return str.c_str(); }
+    unsigned int length() const { return str.length(); }
+private:
+    std::string str;
+};
+
+// Output goes to stdout, or into 'captured' when a test sets 'capture'
+struct HardwareSerial {
+    bool capture = false;
+    char captured[8192];
+    size_t capturedLen = 0;
+    size_t bytesWritten = 0;
+
+    size_t write(const uint8_t* data, size_t len) {
+        bytesWritten += len;
+        if (!capture) return fwrite(data, 1, len, stdout);
+        size_t room = sizeof(captured) - 1 - capturedLen;
+        if (len > room) len = room;
+        memcpy(captured + capturedLen, data, len);
+        capturedLen += len;
+        captured[capturedLen] = '\0';
+        return len;
+    }
+    size_t print(const char* text) {
+        return write((const uint8_t*)text, strlen(text));
+    }
+    size_t println(const char* text = "") {
+        return print(text) + print("\n");
+    }
+    template <typename... Args>
+    int printf(const char* format, Args... args) {
+        char line[512];
+        int len = snprintf(line, sizeof(line), format, args...);
+        if (len < 0) return len;
+        if (len >= (int)sizeof(line)) len = sizeof(line) - 1;
+        return write((const uint8_t*)line, len);
+    }
+    void flush() {}
+    void clearCapture() {
+        capturedLen = 0;
+        captured[0] = '\0';
+    }
+};
+
+extern HardwareSerial Serial;
+
+struct EspClass {
+    uint32_t getCycleCount();
+    uint32_t getCpuFreqMHz() { return 160; }
+};
+
+extern EspClass ESP;
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t level);
+int digitalRead(uint8_t pin);
+uint32_t ledcSetup(uint8_t channel, uint32_t freq, uint8_t resolutionBits);
+void ledcAttachPin(uint8_t pin, uint8_t channel);
+void ledcWrite(uint8_t channel, uint32_t duty);
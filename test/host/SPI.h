@@ -0,0 +1,35 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPI for the host tests: bytes written in a transaction are traced by
+// hostBoard.cpp with the time they were sent
+#pragma once
+#include <stdint.h>
+
+#define MSBFIRST 1
+#define SPI_MODE0 0
+
+struct SPISettings {
+    SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode) : clock(clock) {}
+    uint32_t clock;
+};
+
+struct SPIClass {
+    void begin(int8_t sck = -1, int8_t miso = -1, int8_t mosi = -1, int8_t ss = -1) {}
+    void beginTransaction(SPISettings settings);
+    void endTransaction();
+    void writeBytes(const uint8_t* data, uint32_t len);
+};
+
+extern SPIClass SPI;
@@ -0,0 +1,27 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// LEDC fader entry points on hostBoard.cpp: a fade is traced when it
+// starts, with its target duty
+#pragma once
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum { LEDC_LOW_SPEED_MODE } ledc_mode_t;
+typedef enum { LEDC_CHANNEL_0 } ledc_channel_t;
+typedef enum { LEDC_FADE_NO_WAIT, LEDC_FADE_WAIT_DONE } ledc_fade_mode_t;
+
+esp_err_t ledc_fade_func_install(int intrAllocFlags);
+esp_err_t ledc_set_fade_with_time(ledc_mode_t mode, ledc_channel_t channel, uint32_t targetDuty, int maxFadeTimeMs);
+esp_err_t ledc_fade_start(ledc_mode_t mode, ledc_channel_t channel, ledc_fade_mode_t fadeMode);
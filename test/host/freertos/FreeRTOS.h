@@ -0,0 +1,46 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// FreeRTOS for the host tests: one thread, so critical sections and
+// mutexes are no-ops and tasks are never started
+#pragma once
+#include <stdint.h>
+
+typedef void* TaskHandle_t;
+typedef void* SemaphoreHandle_t;
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef void (*TaskFunction_t)(void*);
+
+#define pdPASS 1
+#define pdTRUE 1
+#define pdFALSE 0
+#define portMAX_DELAY 0xffffffffUL
+#define pdMS_TO_TICKS(ms) (ms)
+
+typedef struct { int owner; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+inline void portENTER_CRITICAL(portMUX_TYPE*) {}
+inline void portEXIT_CRITICAL(portMUX_TYPE*) {}
+inline void portENTER_CRITICAL_ISR(portMUX_TYPE*) {}
+inline void portEXIT_CRITICAL_ISR(portMUX_TYPE*) {}
+
+BaseType_t xTaskCreate(TaskFunction_t task, const char* name, uint32_t stack, void* arg,
+                       UBaseType_t priority, TaskHandle_t* handle);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+void vTaskDelay(TickType_t ticks);
+SemaphoreHandle_t xSemaphoreCreateMutex();
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t, TickType_t) { return pdTRUE; }
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t) { return pdTRUE; }
@@ -0,0 +1,338 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include <Arduino.h>
+#include <SPI.h>
+#include <driver/ledc.h>
+#include <esp_timer.h>
+#include <soc/gpio_reg.h>
+#include <soc/soc_memory_layout.h>
+#include <chrono>
+#include "hostBoard.h"
+#include "utils.h"
+
+HardwareSerial Serial;
+EspClass ESP;
+SPIClass SPI;
+
+uint64_t hostNowUs = 0;
+uint32_t hostGpioOut = 0;
+uint8_t hostPinInput[32];
+HostIoEvent hostIoTrace[HOST_IO_TRACE_MAX];
+size_t hostIoCount = 0;
+bool (*hostInDrom)(const void* p) = nullptr;
+uint32_t hostIoCostUs = 0;
+void (*hostTimerDue)() = nullptr;
+uint32_t (*hostGpioIn)(uint32_t in) = nullptr;
+char hostLastLog[256];
+uint32_t hostLogCount = 0;
+
+static uint32_t hostOutputPins = 0;  // pinMode(OUTPUT) pins read back their driven level
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void* arg;
+    bool active;
+    uint64_t expiryUs;
+    uint64_t periodUs;   // 0: one-shot
+};
+
+static esp_timer hostTimers[16];
+static size_t hostTimerCount = 0;
+static bool hostInTimer = false;
+
+static void traceIo(HostIoKind kind, uint8_t pin, uint32_t value) {
+    if (hostIoCount < HOST_IO_TRACE_MAX) {
+        hostIoTrace[hostIoCount++] = {hostNowUs, kind, pin, value, ESP.getCycleCount()};
+    }
+    hostNowUs += hostIoCostUs;
+}
+
+void hostClearIo() {
+    hostIoCount = 0;
+}
+
+size_t hostCountIo(HostIoKind kind) {
+    size_t n = 0;
+    for (size_t i = 0; i < hostIoCount; i++) {
+        if (hostIoTrace[i].kind == kind) n++;
+    }
+    return n;
+}
+
+size_t hostRegisterWrites() {
+    return hostCountIo(HOST_IO_W1TS) + hostCountIo(HOST_IO_W1TC) + hostCountIo(HOST_IO_OUT);
+}
+
+void hostReset() {
+    hostNowUs = 0;
+    hostGpioOut = 0;
+    hostOutputPins = 0;
+    memset(hostPinInput, HIGH, sizeof(hostPinInput));
+    for (size_t i = 0; i < hostTimerCount; i++) {
+        hostTimers[i].active = false;
+    }
+    hostClearIo();
+    hostTimerDue = nullptr;
+    hostGpioIn = nullptr;
+    hostLogCount = 0;
+    hostLastLog[0] = '\0';
+}
+
+// Timers run one at a time in expiry order, like the esp_timer task
+void hostAdvanceUs(uint64_t us) {
+    uint64_t target = hostNowUs + us;
+    for (;;) {
+        esp_timer* next = nullptr;
+        for (size_t i = 0; i < hostTimerCount; i++) {
+            esp_timer* t = &hostTimers[i];
+            if (t->active && t->expiryUs <= target && (!next || t->expiryUs < next->expiryUs)) {
+                next = t;
+            }
+        }
+        if (next == nullptr) break;
+        if (next->expiryUs > hostNowUs) hostNowUs = next->expiryUs;
+        if (next->periodUs) {
+            next->expiryUs += next->periodUs;
+        } else {
+            next->active = false;
+        }
+        if (hostTimerDue) hostTimerDue();
+        hostInTimer = true;
+        next->callback(next->arg);
+        hostInTimer = false;
+    }
+    if (target > hostNowUs) hostNowUs = target;
+}
+
+// ---- Arduino ----
+
+uint32_t EspClass::getCycleCount() {
+    using namespace std::chrono;
+    uint64_t ns = duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+    return (uint32_t)(ns * getCpuFreqMHz() / 1000);
+}
+
+unsigned long millis() {
+    return (unsigned long)(hostNowUs / 1000);
+}
+
+unsigned long micros() {
+    return (unsigned long)hostNowUs;
+}
+
+// A busy-wait in a timer callback only moves the clock; anywhere else the
+// timer task gets to run meanwhile
+void delayMicroseconds(uint32_t us) {
+    if (hostInTimer) {
+        hostNowUs += us;
+    } else {
+        hostAdvanceUs(us);
+    }
+}
+
+void delay(uint32_t ms) {
+    delayMicroseconds(ms * 1000);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    if ((mode & OUTPUT) == OUTPUT) {
+        hostOutputPins |= 1UL << pin;
+    } else {
+        hostOutputPins &= ~(1UL << pin);
+    }
+}
+
+void digitalWrite(uint8_t pin, uint8_t level) {
+    if (level) {
+        hostGpioOut |= 1UL << pin;
+    } else {
+        hostGpioOut &= ~(1UL << pin);
+    }
+    traceIo(HOST_IO_PIN, pin, level);
+}
+
+int digitalRead(uint8_t pin) {
+    if (hostOutputPins & (1UL << pin)) return (hostGpioOut >> pin) & 1;
+    return hostPinInput[pin];
+}
+
+uint32_t ledcSetup(uint8_t channel, uint32_t freq, uint8_t resolutionBits) {
+    return freq;
+}
+
+void ledcAttachPin(uint8_t pin, uint8_t channel) {
+}
+
+void ledcWrite(uint8_t channel, uint32_t duty) {
+    traceIo(HOST_IO_LEDC, channel, duty);
+}
+
+// ---- Registers, SPI, LEDC, timers ----
+
+void hostRegWrite(uint32_t reg, uint32_t value) {
+    switch (reg) {
+        case GPIO_OUT_W1TS_REG:
+            hostGpioOut |= value;
+            traceIo(HOST_IO_W1TS, 0, value);
+            break;
+        case GPIO_OUT_W1TC_REG:
+            hostGpioOut &= ~value;
+            traceIo(HOST_IO_W1TC, 0, value);
+            break;
+        case GPIO_OUT_REG:
+            hostGpioOut = value;
+            traceIo(HOST_IO_OUT, 0, value);
+            break;
+        default:
+            break;
+    }
+}
+
+uint32_t hostRegRead(uint32_t reg) {
+    if (reg == GPIO_OUT_REG) return hostGpioOut;
+    if (reg != GPIO_IN_REG) return 0;
+    uint32_t in = hostGpioOut & hostOutputPins;
+    for (int pin = 0; pin < 32; pin++) {
+        if (!(hostOutputPins & (1UL << pin)) && hostPinInput[pin]) in |= 1UL << pin;
+    }
+    return hostGpioIn ? hostGpioIn(in) : in;
+}
+
+void SPIClass::beginTransaction(SPISettings settings) {
+}
+
+void SPIClass::endTransaction() {
+}
+
+void SPIClass::writeBytes(const uint8_t* data, uint32_t len) {
+    for (uint32_t i = 0; i < len; i++) {
+        traceIo(HOST_IO_SPI, 0, data[i]);
+    }
+}
+
+static uint32_t hostFadeDuty;
+
+esp_err_t ledc_fade_func_install(int intrAllocFlags) {
+    return ESP_OK;
+}
+
+esp_err_t ledc_set_fade_with_time(ledc_mode_t mode, ledc_channel_t channel, uint32_t targetDuty, int maxFadeTimeMs) {
+    hostFadeDuty = targetDuty;
+    return ESP_OK;
+}
+
+esp_err_t ledc_fade_start(ledc_mode_t mode, ledc_channel_t channel, ledc_fade_mode_t fadeMode) {
+    traceIo(HOST_IO_FADE, channel, hostFadeDuty);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* handle) {
+    if (hostTimerCount >= sizeof(hostTimers) / sizeof(hostTimers[0])) return ESP_ERR_NO_MEM;
+    esp_timer* t = &hostTimers[hostTimerCount++];
+    t->callback = args->callback;
+    t->arg = args->arg;
+    t->active = false;
+    *handle = t;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeoutUs) {
+    if (timer->active) return ESP_ERR_INVALID_STATE;
+    timer->active = true;
+    timer->expiryUs = hostNowUs + timeoutUs;
+    timer->periodUs = 0;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t periodUs) {
+    if (timer->active) return ESP_ERR_INVALID_STATE;
+    timer->active = true;
+    timer->expiryUs = hostNowUs + periodUs;
+    timer->periodUs = periodUs;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    if (!timer->active) return ESP_ERR_INVALID_STATE;
+    timer->active = false;
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer) {
+    return timer->active;
+}
+
+int64_t esp_timer_get_time() {
+    return (int64_t)hostNowUs;
+}
+
+bool esp_ptr_in_drom(const void* p) {
+    return hostInDrom ? hostInDrom(p) : false;
+}
+
+// ---- FreeRTOS: one thread, tasks never start ----
+
+static int hostTaskHandle;
+static int hostMutex;
+
+BaseType_t xTaskCreate(TaskFunction_t task, const char* name, uint32_t stack, void* arg,
+                       UBaseType_t priority, TaskHandle_t* handle) {
+    if (handle) *handle = &hostTaskHandle;
+    return pdPASS;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    return nullptr;
+}
+
+void vTaskDelay(TickType_t ticks) {
+    hostAdvanceUs((uint64_t)ticks * 1000);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    return &hostMutex;
+}
+
+// ---- Weak firmware stand-ins ----
+
+__attribute__((weak)) LogLevel currentLogLevel = LOG_DEBUG;
+__attribute__((weak)) uint8_t currentAmpChannel = 0;
+__attribute__((weak)) uint32_t ampOutputs = 0;
+
+__attribute__((weak)) void logText(LogLevel level, const char* msg) {
+    snprintf(hostLastLog, sizeof(hostLastLog), "%s", msg);
+    hostLogCount++;
+}
+
+__attribute__((weak)) void logFormat(LogLevel level, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    vsnprintf(hostLastLog, sizeof(hostLastLog), format, args);
+    va_end(args);
+    hostLogCount++;
+}
+
+__attribute__((weak)) void recordEvent(EventType type, uint16_t arg, uint32_t data) {
+}
+
+__attribute__((weak)) const char* getLogLevelString(LogLevel level) {
+    static const char* const names[] = {"NONE", "ERROR", "WARN", "INFO", "DEBUG"};
+    return level <= LOG_DEBUG ? names[level] : "UNKNOWN";
+}
+
+__attribute__((weak)) void formatUptime(unsigned long uptime, char* buffer, size_t bufferSize) {
+    unsigned long seconds = uptime / 1000;
+    snprintf(buffer, bufferSize, "%02lu:%02lu", seconds / 60, seconds % 60);
+}
@@ -0,0 +1,79 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Simulated board for the host tests of hardware-facing code (link
+// hostBoard.cpp). Time is a virtual microsecond clock that only moves when
+// a test advances it, or when firmware busy-waits in delay() or
+// delayMicroseconds(); esp_timer callbacks fire as the clock passes their
+// expiry, the way the timer task preempts the loop on the device. Every
+// GPIO register write, digitalWrite(), SPI byte and LEDC duty is traced with
+// the time it happened.
+//
+// hostBoard.cpp also has weak stand-ins for the firmware's logging and
+// event log entry points and the few globals most sources touch; a test
+// that needs the real thing links it or defines its own.
+#pragma once
+#include <Arduino.h>
+
+enum HostIoKind : uint8_t {
+    HOST_IO_W1TS,    // GPIO_OUT_W1TS_REG write, value = mask
+    HOST_IO_W1TC,    // GPIO_OUT_W1TC_REG write, value = mask
+    HOST_IO_OUT,     // GPIO_OUT_REG write, value = new level
+    HOST_IO_PIN,     // digitalWrite(), pin and value = level
+    HOST_IO_SPI,     // One SPI byte, value = byte
+    HOST_IO_LEDC,    // ledcWrite(), pin = channel, value = duty
+    HOST_IO_FADE     // LEDC fader started, pin = channel, value = target duty
+};
+
+struct HostIoEvent {
+    uint64_t us;
+    HostIoKind kind;
+    uint8_t pin;
+    uint32_t value;
+    uint32_t cycles;   // ESP.getCycleCount(): real host time, for sub-microsecond spacing
+};
+
+#define HOST_IO_TRACE_MAX 1024
+
+extern uint64_t hostNowUs;
+extern uint32_t hostGpioOut;                 // Output register level
+extern uint8_t hostPinInput[32];             // Input pin levels, HIGH after hostReset()
+extern HostIoEvent hostIoTrace[HOST_IO_TRACE_MAX];
+extern size_t hostIoCount;
+extern bool (*hostInDrom)(const void* p);   // esp_ptr_in_drom(), default: never
+
+// Each GPIO register write, digitalWrite() and SPI byte costs this much
+// virtual time (default 0): lets a test see back-to-back writes apart
+extern uint32_t hostIoCostUs;
+
+// Called on each GPIO_IN_REG read with the levels hostPinInput and the
+// outputs give, to model wiring that depends on what is driven (a key
+// matrix); null by default
+extern uint32_t (*hostGpioIn)(uint32_t in);
+
+// Called when a timer has expired but before its callback runs, as if
+// another task got in first (esp_timer_stop() then fails); null by default
+extern void (*hostTimerDue)();
+
+// Weak log stand-in: the last line and how many were logged
+extern char hostLastLog[256];
+extern uint32_t hostLogCount;
+
+void hostReset();                 // Clock to 0, timers stopped, traces cleared
+void hostAdvanceUs(uint64_t us);  // Move the clock, firing due timers in order
+void hostClearIo();
+
+// Trace entries of one kind, and the register writes (W1TS/W1TC/OUT)
+size_t hostCountIo(HostIoKind kind);
+size_t hostRegisterWrites();
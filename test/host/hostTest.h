@@ -0,0 +1,43 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Tiny check harness for the host tests: failures are printed and counted,
+// main() returns hostTestResult()
+#pragma once
+#include <stdio.h>
+#include <string.h>
+
+static int hostTestFailures = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            hostTestFailures++; \
+        } \
+    } while (0)
+
+#define CHECK_STR(actual, expected) do { \
+        const char* a_ = (actual); \
+        const char* e_ = (expected); \
+        if (a_ == nullptr || strcmp(a_, e_) != 0) { \
+            printf("%s:%d: %s is \"%s\", expected \"%s\"\n", __FILE__, __LINE__, #actual, \
+                   a_ ? a_ : "(null)", e_); \
+            hostTestFailures++; \
+        } \
+    } while (0)
+
+static inline int hostTestResult(const char* name) {
+    printf("%s: %s\n", name, hostTestFailures ? "FAILED" : "ok");
+    return hostTestFailures ? 1 : 0;
+}
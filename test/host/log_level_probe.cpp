@@ -0,0 +1,36 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Compile-only probe for the LOG_LEVEL floor (run.sh builds it with
+// LOG_LEVEL=LOG_LEVEL_WARN and inspects the object file): the DEBUG and
+// INFO calls below must leave no format string and no call behind, their
+// pure arguments included, while the WARN and ERROR calls stay.
+#include <Arduino.h>
+#include "utils.h"
+#include "logRateLimit.h"
+
+uint32_t probeDisabledArgument() __attribute__((pure));
+uint32_t probeEnabledArgument() __attribute__((pure));
+
+void probeLogLevels(int channel, LogLevel level) {
+    log(LOG_DEBUG, "probe-disabled: debug literal");
+    logf(LOG_DEBUG, "probe-disabled: debug %d %s", channel, getLogLevelString(level));
+    logf(LOG_INFO, "probe-disabled: info %lu", (unsigned long)probeDisabledArgument());
+    LOG_LIMITED(LOG_INFO, "probe-disabled: limited info");
+    LOGF_LIMITED(LOG_DEBUG, "probe-disabled: limited debug %d", channel);
+
+    log(LOG_WARN, "probe-enabled: warn literal");
+    logf(LOG_ERROR, "probe-enabled: error %lu", (unsigned long)probeEnabledArgument());
+    LOGF_LIMITED(LOG_WARN, "probe-enabled: limited warn %d", channel);
+}
@@ -0,0 +1,79 @@
+#!/bin/sh
+# Copyright (c) Craig Millard and contributors. All rights reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# Build and run the host tests of the hardware-free firmware code with the
+# host compiler (no PlatformIO, no board). Run from anywhere:
+#     sh test/host/run.sh
+set -e
+cd "$(dirname "$0")/../.."
+CXX=${CXX:-g++}
+OUT=${TMPDIR:-/tmp}/ampswitch-host-tests
+mkdir -p "$OUT"
+CXXFLAGS="-std=gnu++11 -Wall -Werror -Itest/host -Iinclude"
+
+# test source, then the firmware sources it exercises
+build_and_run() {
+    name=$(basename "$1" .cpp)
+    $CXX $CXXFLAGS "$@" -o "$OUT/$name"
+    "$OUT/$name"
+}
+
+build_and_run test/host/test_serial_commands.cpp src/serialCommands.cpp
+build_and_run test/host/test_ws2812.cpp
+build_and_run test/host/test_log_buffer.cpp test/host/hostBoard.cpp src/logBuffer.cpp src/metrics.cpp
+build_and_run test/host/test_status_led.cpp test/host/hostBoard.cpp src/statusLed.cpp src/rgbLed.cpp
+
+# Relay tests: four outputs, a 3-channel amp and a boost
+RELAYS="-DMAX_AMPSWITCHS=4 -DAMP_SWITCH_PINS=\"4,5,6,7\" -DAMP_BUTTON_PINS=\"1,3,8,10\" -DRELAY_GROUPS=\"E3,I1\""
+build_and_run test/host/test_command_coalescer.cpp test/host/hostBoard.cpp src/commandCoalescer.cpp src/metrics.cpp $RELAYS
+build_and_run test/host/test_switch_driver.cpp test/host/hostBoard.cpp $RELAYS
+for order in "" "-DRELAY_SWITCH_GAP_US=500" "-DRELAY_SWITCH_ORDER=RELAY_MAKE_BEFORE_BREAK -DRELAY_SWITCH_GAP_US=500"; do
+    build_and_run test/host/test_relay_masks.cpp test/host/hostBoard.cpp src/relayDriver.cpp $RELAYS $order
+done
+for mode in "-DRELAY_DRIVE_MODE=RELAY_DRIVE_LATCHING -DAMP_RESET_PINS=\"0,2,20,21\"" "-DRELAY_DRIVE_MODE=RELAY_DRIVE_MOMENTARY"; do
+    build_and_run test/host/test_relay_pulse.cpp test/host/hostBoard.cpp src/relayDriver.cpp $RELAYS $mode
+done
+build_and_run test/host/test_switch_mute.cpp test/host/hostBoard.cpp src/switchMute.cpp src/relayDriver.cpp \
+    $RELAYS -DSWITCH_MUTE_PIN=21
+for diodes in 1 0; do
+    build_and_run test/host/test_button_matrix.cpp test/host/hostBoard.cpp src/buttonMatrix.cpp \
+        -DBUTTON_MATRIX_ROWS=4 -DBUTTON_MATRIX_COLS=4 -DBUTTON_MATRIX_ROW_PINS=\"0,1,2,3\" \
+        -DBUTTON_MATRIX_COL_PINS=\"7,8,9,10\" -DBUTTON_MATRIX_DIODES=$diodes
+done
+# 32 outputs on four 74HC595s, footswitches on a 4x8 matrix
+build_and_run test/host/test_shift_register.cpp test/host/hostBoard.cpp src/relayDriver.cpp \
+    -DMAX_AMPSWITCHS=32 -DRELAY_OUTPUT_BACKEND=RELAY_BACKEND_SHIFT_REG \
+    -DSHIFT_REG_DATA_PIN=6 -DSHIFT_REG_CLOCK_PIN=4 -DSHIFT_REG_LATCH_PIN=5 \
+    -DBUTTON_MATRIX_ROWS=4 -DBUTTON_MATRIX_COLS=8 \
+    -DBUTTON_MATRIX_ROW_PINS=\"0,1,2,3\" -DBUTTON_MATRIX_COL_PINS=\"7,8,9,10,18,19,20,21\"
+
+# Calls above the LOG_LEVEL floor must leave no format string and no call
+# in the object file, at the firmware's -Os
+check_log_floor() {
+    obj="$OUT/log_level_probe.o"
+    $CXX $CXXFLAGS -Os -DLOG_LEVEL=LOG_LEVEL_WARN -c test/host/log_level_probe.cpp -o "$obj"
+    symbols=$(nm "$obj")
+    if grep -a -q "probe-disabled" "$obj" || echo "$symbols" | grep -q probeDisabledArgument; then
+        echo "logLevelFloor: FAILED, DEBUG/INFO calls left code behind with LOG_LEVEL_WARN"
+        return 1
+    fi
+    if ! grep -a -q "probe-enabled: warn literal" "$obj" || ! echo "$symbols" | grep -q probeEnabledArgument; then
+        echo "logLevelFloor: FAILED, WARN/ERROR calls missing"
+        return 1
+    fi
+    echo "logLevelFloor: ok"
+}
+
+check_log_floor
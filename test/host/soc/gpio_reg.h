@@ -0,0 +1,29 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// GPIO registers for the host tests: writes and reads go through
+// hostBoard.cpp, which keeps the output level and a trace of every write
+#pragma once
+#include <stdint.h>
+
+#define GPIO_OUT_REG 0x60004004
+#define GPIO_OUT_W1TS_REG 0x60004008
+#define GPIO_OUT_W1TC_REG 0x6000400c
+#define GPIO_IN_REG 0x6000403c
+
+void hostRegWrite(uint32_t reg, uint32_t value);
+uint32_t hostRegRead(uint32_t reg);
+
+#define REG_WRITE(reg, value) hostRegWrite((reg), (value))
+#define REG_READ(reg) hostRegRead(reg)
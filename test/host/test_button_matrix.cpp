@@ -0,0 +1,271 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Host test of the button matrix scanner on its esp_timer at
+// BUTTON_MATRIX_SCAN_US (run.sh builds it 4x4 with and without diodes).
+// GPIO_IN_REG reads come from a model of the wiring: a driven row pulls
+// down the columns of its closed keys, and without diodes also whatever
+// the closed keys join to it through released rows. Footswitch presses
+// with contact bounce on both edges run on overlapping lanes and the loop
+// reads the keys every pass with the leading-edge lockout of
+// processButtonState() at its widest, BUTTON_DEBOUNCE_MAX_MS. Every press
+// must give exactly one press and one release event within a scan period
+// of the contacts settling, and sooner than BUTTON_DEBOUNCE_MIN_MS, and
+// nothing else: no missed presses, no bounce events, and the fourth corner
+// of three pressed keys never shows up.
+#include <Arduino.h>
+#include "buttonMatrix.h"
+#include "hostBoard.h"
+#include "hostTest.h"
+
+uint8_t currentAmpChannel = 0;
+uint32_t ampOutputs = 0;
+
+#define KEY(r, c) ((r) * BUTTON_MATRIX_COLS + (c))
+#define PASS_US 100              // Loop pass
+#define BOUNCE_MAX_US 3000       // Contact chatter after each edge
+#define LOCKOUT_US (BUTTON_DEBOUNCE_MAX_MS * 1000UL)
+// The last bounce ends just after a scan: seen one period later, plus the
+// rows driven before the key's and the loop pass that reads the result
+#define MAX_LATENCY_US \
+    (BOUNCE_MAX_US + BUTTON_MATRIX_SCAN_US + BUTTON_MATRIX_ROWS * BUTTON_MATRIX_SETTLE_US + PASS_US)
+
+struct Press {
+    uint8_t key;
+    uint64_t downUs;
+    uint64_t upUs;
+    uint64_t reportUs;       // Earliest the press may be reported
+    uint32_t chatterUs;      // Open/closed step while bouncing
+    bool pressSeen;
+    bool releaseSeen;
+};
+
+#define MAX_PRESSES 800
+static Press presses[MAX_PRESSES];
+static size_t pressCount = 0;
+
+// Presses of one key in time order, and the one the contacts are on
+static uint16_t keyPresses[NUM_BUTTONS][MAX_PRESSES / 4];
+static size_t keyPressCount[NUM_BUTTONS];
+static size_t keyCursor[NUM_BUTTONS];
+
+static uint32_t seed = 1;
+
+static uint32_t randomUs(uint32_t low, uint32_t high) {
+    seed = seed * 1103515245 + 12345;
+    return low + (seed >> 8) % (high - low + 1);
+}
+
+static Press* addPress(uint8_t key, uint64_t downUs, uint64_t upUs) {
+    Press* p = &presses[pressCount];
+    *p = {key, downUs, upUs, downUs, randomUs(200, 500), false, false};
+    keyPresses[key][keyPressCount[key]++] = (uint16_t)pressCount++;
+    return p;
+}
+
+static bool contactClosed(const Press& p, uint64_t now) {
+    if (now < p.downUs || now >= p.upUs + BOUNCE_MAX_US) return false;
+    if (now < p.downUs + BOUNCE_MAX_US) return ((now - p.downUs) / p.chatterUs) % 2 == 0;
+    if (now < p.upUs) return true;
+    return ((now - p.upUs) / p.chatterUs) % 2 == 1;
+}
+
+static uint32_t closedKeys(uint64_t now) {
+    uint32_t closed = 0;
+    for (int k = 0; k < NUM_BUTTONS; k++) {
+        while (keyCursor[k] < keyPressCount[k] &&
+               now >= presses[keyPresses[k][keyCursor[k]]].upUs + BOUNCE_MAX_US) {
+            keyCursor[k]++;
+        }
+        if (keyCursor[k] < keyPressCount[k] && contactClosed(presses[keyPresses[k][keyCursor[k]]], now)) {
+            closed |= 1UL << k;
+        }
+    }
+    return closed;
+}
+
+// Column levels for the rows the scanner is driving low
+static uint32_t matrixInputs(uint32_t in) {
+    uint32_t closed = closedKeys(hostNowUs);
+    uint32_t rows = 0;
+    for (int r = 0; r < BUTTON_MATRIX_ROWS; r++) {
+        if (!(hostGpioOut & (1UL << matrixRowPins[r]))) rows |= 1U << r;
+    }
+    uint32_t cols = 0;
+    uint32_t joined;
+    do {
+        joined = rows << 16 | cols;
+        for (int r = 0; r < BUTTON_MATRIX_ROWS; r++) {
+            for (int c = 0; c < BUTTON_MATRIX_COLS; c++) {
+                if (!(closed & (1UL << KEY(r, c)))) continue;
+                if (rows & (1U << r)) cols |= 1U << c;
+#if !BUTTON_MATRIX_DIODES
+                // Current flows back up a closed key into a released row
+                if (cols & (1U << c)) rows |= 1U << r;
+#endif
+            }
+        }
+    } while ((rows << 16 | cols) != joined);
+    for (int c = 0; c < BUTTON_MATRIX_COLS; c++) {
+        if (cols & (1U << c)) in &= ~(1UL << matrixColPins[c]);
+    }
+    return in;
+}
+
+// What processButtonState() does with each reading
+struct KeyEvents {
+    bool pressed;
+    uint64_t lastTransitionUs;
+};
+
+static KeyEvents keyEvents[NUM_BUTTONS];
+static uint32_t strayEvents = 0;
+static uint32_t worstLatencyUs = 0;
+
+static void expectEvent(int key, bool press, uint64_t now) {
+    for (size_t i = 0; i < keyPressCount[key]; i++) {
+        Press& p = presses[keyPresses[key][i]];
+        bool& seen = press ? p.pressSeen : p.releaseSeen;
+        uint64_t from = press ? p.reportUs : p.upUs;
+        if (seen || now < from || now > from + MAX_LATENCY_US) continue;
+        seen = true;
+        if (now - from > worstLatencyUs) worstLatencyUs = (uint32_t)(now - from);
+        return;
+    }
+    printf("buttonMatrix: stray %s of key %d at %lluus\n", press ? "press" : "release", key,
+           (unsigned long long)now);
+    strayEvents++;
+}
+
+static void readKeys() {
+    uint64_t now = hostNowUs;
+    for (int k = 0; k < NUM_BUTTONS; k++) {
+        bool reading = readButtonLevel(k) == LOW;
+        KeyEvents& e = keyEvents[k];
+        bool locked = now - e.lastTransitionUs <= LOCKOUT_US;
+        if (reading != e.pressed && !locked) {
+            e.pressed = reading;
+            e.lastTransitionUs = now;
+            expectEvent(k, reading, now);
+        }
+    }
+}
+
+// The fourth corner is checked on every scan, not just on the events
+static uint32_t ghostCorner = 1UL << KEY(1, 1);
+static uint64_t ghostCornerUntilUs = 0;
+
+static void runUntil(uint64_t endUs) {
+    while (hostNowUs < endUs) {
+        hostAdvanceUs(PASS_US);
+        hostClearIo();
+        readKeys();
+        if (hostNowUs < ghostCornerUntilUs) CHECK(!(buttonMatrixState & ghostCorner));
+    }
+}
+
+static uint32_t missedEvents() {
+    uint32_t missed = 0;
+    for (size_t i = 0; i < pressCount; i++) {
+        if (!presses[i].pressSeen || !presses[i].releaseSeen) {
+            printf("buttonMatrix: key %d pressed %llu-%lluus %s\n", presses[i].key,
+                   (unsigned long long)presses[i].downUs, (unsigned long long)presses[i].upUs,
+                   presses[i].pressSeen ? "release missed" : "missed");
+            missed++;
+        }
+    }
+    return missed;
+}
+
+// Overlapping streams of taps and holds; a key belongs to one lane, so
+// with diodes four keys can be down at once, anywhere on the matrix, and
+// without them two, which cannot make a ghost
+static uint64_t scheduleLanes(uint64_t startUs, int lanes, int pressesPerLane) {
+    uint64_t endUs = startUs;
+    for (int lane = 0; lane < lanes; lane++) {
+        int laneKeys[NUM_BUTTONS];
+        int laneKeyCount = 0;
+        for (int r = 0; r < BUTTON_MATRIX_ROWS; r++) {
+            for (int c = 0; c < BUTTON_MATRIX_COLS; c++) {
+                if ((r + c) % lanes == lane) laneKeys[laneKeyCount++] = KEY(r, c);
+            }
+        }
+        uint64_t t = startUs + randomUs(0, 50000);
+        for (int i = 0; i < pressesPerLane; i++) {
+            uint64_t hold = randomUs(LOCKOUT_US + 2 * MAX_LATENCY_US, 400000);
+            addPress((uint8_t)laneKeys[randomUs(0, laneKeyCount - 1)], t, t + hold);
+            t += hold + randomUs(LOCKOUT_US + 2 * MAX_LATENCY_US, 300000);
+        }
+        if (t > endUs) endUs = t;
+    }
+    return endUs;
+}
+
+// Three corners of a rectangle: the fourth never reads as pressed. Without
+// diodes the third key is ambiguous too and waits until the pattern clears.
+static uint64_t scheduleCorners(uint64_t startUs) {
+    uint64_t t = startUs;
+    addPress(KEY(0, 0), t, t + 600000);
+    Press* b = addPress(KEY(0, 1), t + 100000, t + 400000);
+    Press* c = addPress(KEY(1, 0), t + 200000, t + 500000);
+#if !BUTTON_MATRIX_DIODES
+    c->reportUs = b->upUs;
+#else
+    (void)b;
+    (void)c;
+#endif
+    ghostCornerUntilUs = t + 700000;
+    return ghostCornerUntilUs;
+}
+
+int main() {
+    hostReset();
+    hostGpioIn = matrixInputs;
+    initButtonMatrix();
+    for (int k = 0; k < NUM_BUTTONS; k++) {
+        keyEvents[k].lastTransitionUs = hostNowUs - LOCKOUT_US - 1;
+    }
+    CHECK(buttonMatrixState == 0);
+
+#if BUTTON_MATRIX_DIODES
+    const int lanes = 4;
+#else
+    const int lanes = 2;
+#endif
+    uint64_t endUs = scheduleCorners(hostNowUs + 10000);
+    endUs = scheduleLanes(endUs, lanes, MAX_PRESSES / 4 / lanes * 3);
+    runUntil(endUs + 100000);
+
+    CHECK(strayEvents == 0);
+    CHECK(missedEvents() == 0);
+    CHECK(buttonMatrixState == 0);
+    CHECK(worstLatencyUs <= MAX_LATENCY_US);
+    // The scan rate is fast enough when a press, bounce included, is seen
+    // sooner than the shortest debounce window would let it act again
+    CHECK(worstLatencyUs < BUTTON_DEBOUNCE_MIN_MS * 1000UL);
+#if BUTTON_MATRIX_DIODES
+    CHECK(buttonMatrixStats.ghostScans == 0);
+#else
+    CHECK(buttonMatrixStats.ghostScans > 0);
+#endif
+    printf("buttonMatrix: %lu presses over %llums, %lu scans (%lu ghost holds), worst latency %luus "
+           "(scan %uus)\n", (unsigned long)pressCount, (unsigned long long)(hostNowUs / 1000),
+           (unsigned long)buttonMatrixStats.scans, (unsigned long)buttonMatrixStats.ghostScans,
+           (unsigned long)worstLatencyUs, BUTTON_MATRIX_SCAN_US);
+
+    char name[64];
+    snprintf(name, sizeof(name), "buttonMatrix (%dx%d, diodes %s)", BUTTON_MATRIX_ROWS, BUTTON_MATRIX_COLS,
+             BUTTON_MATRIX_DIODES ? "yes" : "no");
+    return hostTestResult(name);
+}
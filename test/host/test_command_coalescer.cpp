@@ -0,0 +1,221 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Host simulation of remote/MIDI command bursts through the coalescer
+// (run.sh builds it with RELAY_GROUPS "E3,I1": a 3-channel amp and a
+// boost). Each burst is replayed twice, with the loop polling the
+// coalescer every pass, as both loops do, and every 100th pass, where the
+// FAST_SWITCHING loop used to reach it; the report is the relay contact
+// operations against applying every command, how long after the last
+// command the net state lands, and the longest the outputs lag the
+// commands.
+#include <Arduino.h>
+#include "commandCoalescer.h"
+#include "commandHandler.h"
+#include "relayGroups.h"
+#include "metrics.h"
+#include "hostBoard.h"
+#include "hostTest.h"
+
+#define LOOP_PASS_US 100   // One FAST_SWITCHING loop pass
+#define TOGGLE 0xFF        // Program 1: toggle channel 1 against the coalesced state
+
+uint8_t currentAmpChannel = 0;
+uint32_t ampOutputs = 0;
+
+static uint32_t contactOperations = 0;
+static uint64_t lastChangeUs = 0;
+
+// Stand-in driver: counts every relay that changes state
+void setAmpOutputs(uint32_t outputs) {
+    if (outputs != ampOutputs) lastChangeUs = hostNowUs;
+    contactOperations += __builtin_popcount(outputs ^ ampOutputs);
+    ampOutputs = outputs;
+    currentAmpChannel = ampChannelFromOutputs(outputs);
+}
+
+void setAmpChannel(uint8_t channel) {
+    setAmpOutputs(nextAmpOutputs(ampOutputs, channel));
+}
+
+struct Command {
+    uint32_t atMs;
+    uint8_t channel;
+};
+
+struct Burst {
+    const char* name;
+    const Command* commands;
+    size_t count;
+};
+
+struct BurstResult {
+    uint32_t naiveOperations;
+    uint32_t operations;
+    uint32_t settleMs;      // Last command -> last relay change
+    uint32_t worstLagMs;    // Longest stretch the outputs differed from every command applied
+    bool netStateMatches;
+};
+
+static uint32_t metricValue(const char* name) {
+    for (uint8_t i = 0; i < getMetricCount(); i++) {
+        if (strcmp(getMetric(i)->name, name) == 0) return getMetric(i)->value;
+    }
+    return 0xFFFFFFFF;
+}
+
+// Let any open burst close, then start from all off. Bursts start off the
+// millisecond grid, so they do not line up with a slow poll.
+static void quiesce() {
+    for (int i = 0; i < 2 * COMMAND_COALESCE_MAX_MS; i++) {
+        hostAdvanceUs(1000);
+        pollCommandCoalescer();
+    }
+    hostAdvanceUs(3700);
+    setAmpOutputs(0);
+    contactOperations = 0;
+}
+
+static BurstResult runBurst(const Burst& burst, uint32_t pollEvery) {
+    quiesce();
+    BurstResult result = {0, 0, 0, 0, false};
+    uint64_t startUs = hostNowUs;
+    uint64_t endUs = startUs + (burst.commands[burst.count - 1].atMs + 2 * COMMAND_COALESCE_MAX_MS) * 1000ULL;
+    uint64_t lastCommandUs = startUs;
+    uint64_t laggingSinceUs = 0;
+    bool lagging = false;
+    uint32_t naive = 0;
+    size_t next = 0;
+    lastChangeUs = startUs;
+
+    for (uint32_t pass = 0; hostNowUs < endUs; pass++) {
+        while (next < burst.count && hostNowUs >= startUs + burst.commands[next].atMs * 1000ULL) {
+            uint8_t channel = burst.commands[next].channel;
+            if (channel == TOGGLE) {
+                channel = getCoalescedAmpChannel() == 1 ? 0 : 1;
+            }
+            uint32_t naiveNext = nextAmpOutputs(naive, channel);
+            result.naiveOperations += __builtin_popcount(naiveNext ^ naive);
+            naive = naiveNext;
+            coalesceAmpChannel(channel);
+            lastCommandUs = hostNowUs;
+            next++;
+        }
+        if (pass % pollEvery == 0) {
+            pollCommandCoalescer();
+        }
+        if (ampOutputs != naive) {
+            if (!lagging) laggingSinceUs = hostNowUs;
+            lagging = true;
+            uint32_t lagMs = (hostNowUs - laggingSinceUs) / 1000;
+            if (lagMs > result.worstLagMs) result.worstLagMs = lagMs;
+        } else {
+            lagging = false;
+        }
+        hostAdvanceUs(LOOP_PASS_US);
+    }
+    result.operations = contactOperations;
+    result.settleMs = lastChangeUs > lastCommandUs ? (lastChangeUs - lastCommandUs) / 1000 : 0;
+    result.netStateMatches = ampOutputs == naive;
+    printf("coalescer: %-14s poll every %3lu passes: contact ops %2lu -> %2lu, net state %3lums after the "
+           "last command, outputs lag up to %3lums\n", burst.name, (unsigned long)pollEvery,
+           (unsigned long)result.naiveOperations, (unsigned long)result.operations,
+           (unsigned long)result.settleMs, (unsigned long)result.worstLagMs);
+    return result;
+}
+
+// Resent toggle PCs 25ms apart, ending on
+static const Command kToggleStorm[] = {
+    {0, TOGGLE}, {25, TOGGLE}, {50, TOGGLE}, {75, TOGGLE}, {100, TOGGLE}, {125, TOGGLE},
+    {150, TOGGLE}, {175, TOGGLE}, {200, TOGGLE}, {225, TOGGLE}, {250, TOGGLE}
+};
+// Scrolling through programs on the amp
+static const Command kProgramScroll[] = {
+    {0, 1}, {40, 2}, {80, 3}, {120, 2}, {160, 3}, {200, 1}, {240, 2}
+};
+// ESP-NOW retries of one command
+static const Command kRetries[] = {
+    {0, 2}, {10, 2}, {20, 2}, {30, 2}, {40, 2}
+};
+// Boost toggles interleaved with amp channels: separate groups
+static const Command kBoostAndAmp[] = {
+    {0, 4}, {30, 2}, {60, 4}, {90, 3}, {120, 4}, {150, 1}
+};
+// A controller that never stops: every 100ms for two seconds
+static const Command kEndless[] = {
+    {0, 1}, {100, 2}, {200, 3}, {300, 1}, {400, 2}, {500, 3}, {600, 1}, {700, 2}, {800, 3},
+    {900, 1}, {1000, 2}, {1100, 3}, {1200, 1}, {1300, 2}, {1400, 3}, {1500, 1}, {1600, 2},
+    {1700, 3}, {1800, 1}, {1900, 2}, {2000, 3}
+};
+// Commands further apart than the window
+static const Command kSparse[] = {
+    {0, 1}, {400, 2}, {800, 3}
+};
+
+#define BURST(name, commands) {name, commands, sizeof(commands) / sizeof(commands[0])}
+
+static const Burst kBursts[] = {
+    BURST("toggle storm", kToggleStorm),
+    BURST("program scroll", kProgramScroll),
+    BURST("retries", kRetries),
+    BURST("boost and amp", kBoostAndAmp),
+    BURST("endless", kEndless),
+    BURST("sparse", kSparse),
+};
+
+int main() {
+    hostReset();
+    const size_t bursts = sizeof(kBursts) / sizeof(kBursts[0]);
+    BurstResult results[bursts];
+    uint32_t naiveTotal = 0;
+    uint32_t coalescedTotal = 0;
+    uint32_t worstSettleMs = 0;
+    uint32_t worstLagMs = 0;
+    uint32_t slowWorstSettleMs = 0;
+
+    for (size_t i = 0; i < bursts; i++) {
+        BurstResult& result = results[i];
+        result = runBurst(kBursts[i], 1);
+        CHECK(result.netStateMatches);
+        CHECK(result.operations <= result.naiveOperations);
+        // Net state one window after the last command, and never held
+        // longer than COMMAND_COALESCE_MAX_MS, give or take a loop pass
+        CHECK(result.settleMs <= COMMAND_COALESCE_MS + 1);
+        CHECK(result.worstLagMs <= COMMAND_COALESCE_MAX_MS + 1);
+        naiveTotal += result.naiveOperations;
+        coalescedTotal += result.operations;
+        if (result.settleMs > worstSettleMs) worstSettleMs = result.settleMs;
+        if (result.worstLagMs > worstLagMs) worstLagMs = result.worstLagMs;
+
+        BurstResult slow = runBurst(kBursts[i], 100);
+        CHECK(slow.netStateMatches);
+        if (slow.settleMs > slowWorstSettleMs) slowWorstSettleMs = slow.settleMs;
+    }
+
+    // A collapsing burst costs the first command and one settle; retries
+    // and sparse commands pass straight through, undelayed
+    CHECK(results[0].operations == 1);
+    CHECK(results[1].operations == 3);
+    CHECK(results[2].operations == 1 && results[2].settleMs == 0);
+    CHECK(results[5].operations == results[5].naiveOperations && results[5].worstLagMs == 0);
+    CHECK(coalescedTotal * 2 <= naiveTotal);
+    CHECK(metricValue("coalesce_latency_max_ms") <= COMMAND_COALESCE_MAX_MS + 1);
+    CHECK(slowWorstSettleMs > worstSettleMs);
+
+    printf("coalescer: %lu contact operations instead of %lu (%lu saved), net state at most %lums after "
+           "the last command (%lums polling every 100 passes), outputs lag up to %lums\n",
+           (unsigned long)coalescedTotal, (unsigned long)naiveTotal, (unsigned long)(naiveTotal - coalescedTotal),
+           (unsigned long)worstSettleMs, (unsigned long)slowWorstSettleMs, (unsigned long)worstLagMs);
+    return hostTestResult("commandCoalescer");
+}
@@ -0,0 +1,193 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Host test and benchmark for the deferred log ring: a full ring drops and
+// counts without touching the serial port, drained records come out as
+// text lines, long text is clamped, the bytes tokenised output saves, and
+// the per-call capture cost against formatting and writing each line
+// synchronously
+#include <Arduino.h>
+#include <chrono>
+#include "logBuffer.h"
+#include "metrics.h"
+#include "utils.h"
+#include "hostBoard.h"
+#include "hostTest.h"
+
+// Same routing as utils.cpp
+void logText(LogLevel level, const char* msg) {
+    logCaptureText(level, msg);
+}
+
+void logFormat(LogLevel level, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    logCapture(level, format, args);
+    va_end(args);
+}
+
+static const char* kLongLiteral;
+
+static bool literalInDrom(const void* p) {
+    return p == kLongLiteral;
+}
+
+static uint32_t metricValue(const char* name) {
+    for (uint8_t i = 0; i < getMetricCount(); i++) {
+        if (strcmp(getMetric(i)->name, name) == 0) return getMetric(i)->value;
+    }
+    return 0xFFFFFFFF;
+}
+
+static size_t countLines(const char* text) {
+    size_t n = 0;
+    for (; *text; text++) {
+        if (*text == '\n') n++;
+    }
+    return n;
+}
+
+static void testFullRingDrops() {
+    uint32_t dropped = metricValue("log_dropped_total");
+    Serial.clearCapture();
+    Serial.bytesWritten = 0;
+    for (int i = 0; i < LOG_RING_SLOTS + 5; i++) {
+        logf(LOG_ERROR, "record %d on channel %u (%s)", i, 3u, "ok");
+    }
+    // Capture never writes the port, even with the ring full
+    CHECK(Serial.bytesWritten == 0);
+    CHECK(metricValue("log_dropped_total") == dropped + 5);
+
+    flushLogs();
+    CHECK(countLines(Serial.captured) == LOG_RING_SLOTS);
+    CHECK(strncmp(Serial.captured, "[00:01][ERROR] record 0 on channel 3 (ok)\n", 42) == 0);
+    char last[64];
+    snprintf(last, sizeof(last), "record %d on channel 3 (ok)\n", LOG_RING_SLOTS - 1);
+    CHECK(strstr(Serial.captured, last) != nullptr);
+
+    // Room again once drained
+    Serial.clearCapture();
+    log(LOG_WARN, "after drain");
+    flushLogs();
+    CHECK_STR(Serial.captured, "[00:01][WARN] after drain\n");
+    CHECK(metricValue("log_dropped_total") == dropped + 5);
+}
+
+static void testLongTextClamped() {
+    static char text[600];
+    memset(text, 'x', sizeof(text) - 1);
+    text[sizeof(text) - 1] = '\0';
+
+    // A flash literal is kept by pointer and clamped when written
+    kLongLiteral = text;
+    Serial.clearCapture();
+    log(LOG_INFO, text);
+    flushLogs();
+    CHECK(Serial.capturedLen == 299);
+    CHECK(Serial.captured[Serial.capturedLen - 1] == '\n');
+
+    // Text from RAM is copied into the record and truncated there
+    kLongLiteral = nullptr;
+    Serial.clearCapture();
+    log(LOG_INFO, text);
+    flushLogs();
+    CHECK(Serial.capturedLen == strlen("[00:01][INFO] ") + LOG_RECORD_BYTES - 1 + 1);
+}
+
+// A burst of switching-path and ESP-NOW lines, 40ms apart
+static size_t logSwitchBurst() {
+    static const char* const literal = "All amp channels turned off";
+    kLongLiteral = literal;
+    size_t before = Serial.bytesWritten;
+    for (int i = 0; i < 8; i++) {
+        logf(LOG_INFO, "Switching amp channel from %u to %u", (unsigned)i % 4, (unsigned)(i + 1) % 4);
+        logf(LOG_INFO, "Amp channel %u activated", (unsigned)(i + 1) % 4);
+        hostAdvanceUs(40 * 1000);
+        logf(LOG_INFO, "Status request received - current channel: %u", (unsigned)(i + 1) % 4);
+        logf(LOG_WARN, "Data send failed to %02X:%02X:%02X:%02X:%02X:%02X", 0x24, 0x6f, 0x28, 0x1a, 0x3c, i);
+        logf(LOG_DEBUG, "Button %d released after %lu ms, channelSelectMode=%d, midiLearnJustTimedOut=%d",
+             i % 4 + 1, 120UL + i, 0, 0);
+        log(LOG_INFO, literal);
+        hostAdvanceUs(40 * 1000);
+        flushLogs();
+    }
+    kLongLiteral = nullptr;
+    return Serial.bytesWritten - before;
+}
+
+// Same lines as text and as token frames. Most of a text line is the
+// timestamp, level and fixed words, which a frame replaces with a 3-byte
+// token and a 1-byte time delta; the arguments remain.
+static void testTokenisedSize() {
+    Serial.clearCapture();
+    size_t textBytes = logSwitchBurst();
+    setLogTokenized(true);
+    Serial.clearCapture();
+    size_t frameBytes = logSwitchBurst();
+    CHECK((unsigned char)Serial.captured[0] == LOG_TOKEN_MARKER);
+    setLogTokenized(false);
+    printf("logBuffer: switching burst %lu bytes as text, %lu tokenised (%.1fx)\n",
+           (unsigned long)textBytes, (unsigned long)frameBytes, (double)textBytes / frameBytes);
+    CHECK(textBytes >= 5 * frameBytes);
+}
+
+// Per-call cost of capturing into the ring, against what LOG_ASYNC=0 does:
+// format the line and hand it to the serial driver (here a memory buffer,
+// so the UART time itself is not even counted)
+static void benchmarkCapture() {
+    using namespace std::chrono;
+    const int rounds = 2000;
+    const int calls = LOG_RING_SLOTS / 2;
+    uint64_t captureNs = 0;
+    uint64_t syncNs = 0;
+
+    for (int r = 0; r < rounds; r++) {
+        Serial.clearCapture();
+        steady_clock::time_point start = steady_clock::now();
+        for (int i = 0; i < calls; i++) {
+            logf(LOG_ERROR, "logbench %d: channel %u, %s", i, currentAmpChannel, "ok");
+        }
+        captureNs += duration_cast<nanoseconds>(steady_clock::now() - start).count();
+        flushLogs();
+
+        Serial.clearCapture();
+        start = steady_clock::now();
+        for (int i = 0; i < calls; i++) {
+            char buffer[256];
+            snprintf(buffer, sizeof(buffer), "logbench %d: channel %u, %s", i, currentAmpChannel, "ok");
+            char timestamp[32];
+            formatUptime(millis(), timestamp, sizeof(timestamp));
+            Serial.printf("[%s][%s] %s\n", timestamp, getLogLevelString(LOG_ERROR), buffer);
+        }
+        syncNs += duration_cast<nanoseconds>(steady_clock::now() - start).count();
+    }
+    uint32_t total = rounds * calls;
+    printf("logBuffer: capture %.0f ns/call, synchronous format + write %.0f ns/call (%lu calls)\n",
+           (double)captureNs / total, (double)syncNs / total, (unsigned long)total);
+    CHECK(metricValue("log_dropped_total") == 5);
+}
+
+int main() {
+    hostReset();
+    hostInDrom = literalInDrom;
+    Serial.capture = true;
+    hostAdvanceUs(1500 * 1000);
+    initLogBuffer();
+
+    testFullRingDrops();
+    testLongTextClamped();
+    testTokenisedSize();
+    benchmarkCapture();
+    return hostTestResult("logBuffer");
+}
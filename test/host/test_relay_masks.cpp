@@ -0,0 +1,124 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Host test of writeRelayMasks() on direct GPIO against the traced
+// W1TS/W1TC registers (run.sh builds it once per switch order, with and
+// without a gap, RELAY_GROUPS "E3,I1"). For every pair of output states:
+// at most two register writes, clear then set for break-before-make and
+// set then clear for make-before-break, RELAY_SWITCH_GAP_US between them
+// and no wait when only one is needed, and in between the relays hold only
+// what both states share (break-before-make) or both states at once
+// (make-before-break).
+#include <Arduino.h>
+#include "relayDriver.h"
+#include "relayGroups.h"
+#include "hostBoard.h"
+#include "hostTest.h"
+
+uint8_t currentAmpChannel = 0;
+uint32_t ampOutputs = 0;
+
+#define OUTPUT_STATES (1UL << MAX_AMPSWITCHS)
+
+static void checkTransition(uint32_t from, uint32_t to) {
+    uint32_t fromGpio = relayOutputsToGpioMask(from);
+    uint32_t toGpio = relayOutputsToGpioMask(to);
+    hostGpioOut = fromGpio;
+    hostClearIo();
+    uint64_t start = hostNowUs;
+
+    driveRelayOutputs(to);
+
+    uint32_t rising = toGpio & ~fromGpio;
+    uint32_t falling = fromGpio & ~toGpio;
+    CHECK((hostGpioOut & ampRelayMask) == toGpio);
+    CHECK(hostRegisterWrites() == hostIoCount);
+    CHECK(hostIoCount <= 2);
+    CHECK(hostCountIo(HOST_IO_W1TS) <= 1);
+    CHECK(hostCountIo(HOST_IO_W1TC) <= 1);
+
+    if (hostIoCount == 2) {
+        const HostIoEvent& first = hostIoTrace[0];
+        const HostIoEvent& second = hostIoTrace[1];
+#if RELAY_SWITCH_ORDER == RELAY_MAKE_BEFORE_BREAK
+        CHECK(first.kind == HOST_IO_W1TS && second.kind == HOST_IO_W1TC);
+        uint32_t between = fromGpio | first.value;
+        // Both states on together for the overlap
+        CHECK((between & (fromGpio | toGpio)) == (fromGpio | toGpio));
+#else
+        CHECK(first.kind == HOST_IO_W1TC && second.kind == HOST_IO_W1TS);
+        uint32_t between = fromGpio & ~first.value;
+        // Dead time: nothing on but what both states keep
+        CHECK((between & ampRelayMask) == (fromGpio & toGpio));
+#endif
+        CHECK(second.us - first.us == RELAY_SWITCH_GAP_US);
+        CHECK(hostNowUs - start == RELAY_SWITCH_GAP_US);
+    } else {
+        // One write, or none: never a gap
+        CHECK(hostNowUs == start);
+    }
+    // Whatever moves is covered, and only the relay bits are touched
+    for (size_t i = 0; i < hostIoCount; i++) {
+        CHECK((hostIoTrace[i].value & ~ampRelayMask) == 0);
+        if (hostIoTrace[i].kind == HOST_IO_W1TS) CHECK((hostIoTrace[i].value & rising) == rising);
+        if (hostIoTrace[i].kind == HOST_IO_W1TC) CHECK((hostIoTrace[i].value & falling) == falling);
+    }
+    if (rising) CHECK(hostCountIo(HOST_IO_W1TS) == 1);
+    if (falling) CHECK(hostCountIo(HOST_IO_W1TC) == 1);
+}
+
+// The precomputed channel pairs: channel 1 -> 2 writes both masks, with
+// the gap; 0 -> 1 only sets, 1 -> 0 only clears, neither waits
+static void checkChannelMasks() {
+    hostGpioOut = ampChannelSetMask[1];
+    hostClearIo();
+    uint64_t start = hostNowUs;
+    writeRelayMasks(ampChannelSetMask[2], ampChannelClearMask[2]);
+    CHECK(hostIoCount == 2);
+    CHECK((hostGpioOut & ampRelayMask) == ampChannelSetMask[2]);
+    CHECK(hostNowUs - start == RELAY_SWITCH_GAP_US);
+
+    hostGpioOut = 0;
+    hostClearIo();
+    start = hostNowUs;
+    writeRelayMasks(ampChannelSetMask[1], 0);
+    CHECK(hostIoCount == 1 && hostIoTrace[0].kind == HOST_IO_W1TS);
+    CHECK(hostNowUs == start);
+
+    hostClearIo();
+    writeRelayMasks(0, ampChannelClearMask[0]);
+    CHECK(hostIoCount == 1 && hostIoTrace[0].kind == HOST_IO_W1TC);
+    CHECK((hostGpioOut & ampRelayMask) == 0);
+    CHECK(hostNowUs == start);
+
+    hostClearIo();
+    writeRelayMasks(0, 0);
+    CHECK(hostIoCount == 0);
+}
+
+int main() {
+    hostReset();
+    initRelayMasks();
+
+    checkChannelMasks();
+    for (uint32_t from = 0; from < OUTPUT_STATES; from++) {
+        for (uint32_t to = 0; to < OUTPUT_STATES; to++) {
+            checkTransition(from, to);
+        }
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "relayMasks (%s, %uus)", getRelaySwitchOrderString(), RELAY_SWITCH_GAP_US);
+    return hostTestResult(name);
+}
@@ -0,0 +1,186 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Host test of the relay pulse driver (run.sh builds it for latching and
+// momentary drive). esp_timer runs on the simulated board's virtual clock
+// and setOutputs-style requests are replayed faster than pulses finish.
+// The traced W1TS/W1TC writes are played into a model of the relays: a set
+// or reset coil for latching, an input that toggles per pulse for momentary.
+// Every pulse must be RELAY_PULSE_US wide, follow the last one by at least
+// RELAY_PULSE_GAP_US and never overlap it; requests made meanwhile collapse
+// into one pulse for the net change, and the relays end up where the last
+// request put them.
+#include <Arduino.h>
+#include "relayDriver.h"
+#include "relayGroups.h"
+#include "hostBoard.h"
+#include "hostTest.h"
+
+uint8_t currentAmpChannel = 0;
+uint32_t ampOutputs = 0;
+
+#define ALL_OUTPUTS ((1UL << MAX_AMPSWITCHS) - 1)
+
+struct PulseModel {
+    uint32_t relays;        // Relay state the pulses left behind
+    uint32_t pulses;
+    uint32_t minGapUs;
+    uint32_t badWidths;
+    uint32_t overlaps;
+    uint64_t lastEndUs;
+    bool seenPulse;
+};
+
+// Pulses in the trace since hostClearIo(), applied to 'model'
+static void replayPulses(PulseModel* model) {
+    bool high = false;
+    uint32_t mask = 0;
+    uint64_t startUs = 0;
+    for (size_t i = 0; i < hostIoCount; i++) {
+        const HostIoEvent& e = hostIoTrace[i];
+        if (e.kind == HOST_IO_W1TS) {
+            if (high) model->overlaps++;
+            if (model->seenPulse) {
+                uint32_t gap = (uint32_t)(e.us - model->lastEndUs);
+                if (gap < model->minGapUs) model->minGapUs = gap;
+            }
+            high = true;
+            mask = e.value;
+            startUs = e.us;
+            for (int out = 0; out < MAX_AMPSWITCHS; out++) {
+#if RELAY_DRIVE_MODE == RELAY_DRIVE_LATCHING
+                if (mask & (1UL << ampSwitchPins[out])) model->relays |= 1UL << out;
+                if (mask & (1UL << ampResetPins[out])) model->relays &= ~(1UL << out);
+#else
+                if (mask & (1UL << ampSwitchPins[out])) model->relays ^= 1UL << out;
+#endif
+            }
+        } else if (e.kind == HOST_IO_W1TC && high) {
+            CHECK(e.value == mask);
+            if (e.us - startUs != RELAY_PULSE_US) model->badWidths++;
+            high = false;
+            model->pulses++;
+            model->lastEndUs = e.us;
+            model->seenPulse = true;
+        }
+    }
+    CHECK(!high);
+    hostClearIo();
+}
+
+static PulseModel model;
+
+// Let every pulse and gap finish, then account for them
+static void settle() {
+    hostAdvanceUs(10 * (RELAY_PULSE_US + RELAY_PULSE_GAP_US));
+    replayPulses(&model);
+}
+
+static uint32_t pulsesFor(uint32_t requests[], size_t count, uint32_t spacingUs) {
+    uint32_t before = model.pulses;
+    for (size_t i = 0; i < count; i++) {
+        requestRelayOutputs(requests[i]);
+        hostAdvanceUs(spacingUs);
+    }
+    settle();
+    CHECK(model.relays == requests[count - 1]);
+    return model.pulses - before;
+}
+
+// Channel changes 500us apart, all inside the first pulse: the first
+// request pulses at once, the rest collapse into one pulse for 0x2 -> 0x4
+static void testRapidRequestsCollapse() {
+    uint32_t requests[] = {0x2, 0x4, 0x1, 0x4};
+    CHECK(pulsesFor(requests, 4, 500) == 2);
+}
+
+// Requests that return to the state the running pulse is latching need no
+// second pulse
+static void testRequestsBackToLatched() {
+    uint32_t requests[] = {0x1, 0x4, 0x1};
+    CHECK(pulsesFor(requests, 3, 500) == 1);
+}
+
+// A request arriving in the gap after a pulse waits the gap out
+static void testRequestDuringGap() {
+    requestRelayOutputs(0x8);
+    hostAdvanceUs(RELAY_PULSE_US + RELAY_PULSE_GAP_US / 2);
+    requestRelayOutputs(0x9);
+    settle();
+    CHECK(model.relays == 0x9);
+}
+
+// Requests spaced wider than a pulse and its gap each get their own
+static void testSpacedRequests() {
+    uint32_t requests[] = {0x1, 0x2, 0x0, 0x8};
+    CHECK(pulsesFor(requests, 4, RELAY_PULSE_US + RELAY_PULSE_GAP_US + 100) == 4);
+}
+
+// A storm of requests at random moments: fewer pulses than requests, and
+// the timing holds throughout
+static void testRequestStorm() {
+    uint32_t seed = 12345;
+    uint32_t before = model.pulses;
+    uint32_t last = model.relays;
+    const int requests = 200;
+    for (int i = 0; i < requests; i++) {
+        seed = seed * 1103515245 + 12345;
+        last = (seed >> 8) & ALL_OUTPUTS;
+        requestRelayOutputs(last);
+        hostAdvanceUs((seed >> 20) % 4000);
+        if (hostIoCount > HOST_IO_TRACE_MAX / 2) replayPulses(&model);
+    }
+    settle();
+    CHECK(model.relays == last);
+    uint32_t pulses = model.pulses - before;
+    CHECK(pulses < requests / 2);
+    printf("relayPulse: %d requests up to 4ms apart took %lu pulses\n", requests, (unsigned long)pulses);
+}
+
+int main() {
+    hostReset();
+    for (int i = 0; i < MAX_AMPSWITCHS; i++) {
+        pinMode(ampSwitchPins[i], OUTPUT);
+    }
+    initRelayMasks();
+    model.minGapUs = 0xFFFFFFFF;
+
+    initRelayPulseDriver();
+#if RELAY_DRIVE_MODE == RELAY_DRIVE_LATCHING
+    // Boot: one pulse on every reset coil, the latched state is then all off
+    model.relays = ALL_OUTPUTS;
+    settle();
+    CHECK(model.pulses == 1);
+#else
+    settle();
+    CHECK(model.pulses == 0);
+#endif
+    CHECK(model.relays == 0);
+
+    testRapidRequestsCollapse();
+    testRequestsBackToLatched();
+    testRequestDuringGap();
+    testSpacedRequests();
+    testRequestStorm();
+
+    CHECK(model.badWidths == 0);
+    CHECK(model.overlaps == 0);
+    CHECK(model.minGapUs >= RELAY_PULSE_GAP_US);
+    printf("relayPulse: %lu pulses, all %uus wide, closest %luus apart\n", (unsigned long)model.pulses,
+           RELAY_PULSE_US, (unsigned long)model.minGapUs);
+
+    char name[64];
+    snprintf(name, sizeof(name), "relayPulse, %s", getRelayDriveModeString());
+    return hostTestResult(name);
+}
@@ -0,0 +1,208 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Host test for the serial console plumbing: the line assembler and the
+// sorted command table lookup
+#include <Arduino.h>
+#include "serialCommands.h"
+#include "hostTest.h"
+
+HardwareSerial Serial;
+
+static const char* lastHandler = nullptr;
+static const char* lastArgs = nullptr;
+
+#define HANDLER(name) static void name(const char* args) { lastHandler = #name; lastArgs = args; }
+HANDLER(cmdChannel)
+HANDLER(cmdAmp)
+HANDLER(cmdB)
+HANDLER(cmdButtons)
+HANDLER(cmdDebug)
+HANDLER(cmdRelayStats)
+HANDLER(cmdScene)
+HANDLER(cmdScenes)
+HANDLER(cmdSceneSet)
+HANDLER(cmdSetLog)
+HANDLER(cmdStatus)
+
+// Shaped like the console table in utils.cpp: a prefix family
+// (scene/scenes/sceneset), a name with digits run in and a subcommand name
+static constexpr SerialCommand kTable[] = {
+    {"1", "<n>", "Select channel", cmdChannel, 0, CMD_CHANNEL | CMD_HIDDEN},
+    {"amp", nullptr, "Amp status", cmdAmp, 0, CMD_EXACT},
+    {"b", "b<n>", "Press button", cmdB, 1, CMD_NUMBER},
+    {"buttons", nullptr, "Button states", cmdButtons, 1, CMD_EXACT},
+    {"debug", nullptr, "Debug info", cmdDebug, 0, CMD_ARGS | CMD_SUBCOMMAND},
+    {"relaystats", nullptr, "Relay wear", cmdRelayStats, 0, CMD_ARGS},
+    {"scene", "scene <n>", "Recall scene", cmdScene, 0, CMD_ARGS | CMD_NUMBER},
+    {"scenes", nullptr, "List scenes", cmdScenes, 0, CMD_EXACT},
+    {"sceneset", nullptr, "Store scene", cmdSceneSet, 0, CMD_ARGS},
+    {"setlog", "setlog <n>", "Set log level", cmdSetLog, 0, CMD_ARGS | CMD_NUMBER},
+    {"status", nullptr, "Status", cmdStatus, 0, CMD_EXACT},
+};
+static const size_t kCount = sizeof(kTable) / sizeof(kTable[0]);
+static_assert(serialCommandsSorted(kTable, kCount), "test table must be sorted");
+
+static constexpr SerialCommand kUnsorted[] = {
+    {"status", nullptr, "", cmdStatus, 0, CMD_EXACT},
+    {"Amp", nullptr, "", cmdAmp, 0, CMD_EXACT},
+};
+static_assert(!serialCommandsSorted(kUnsorted, 2), "order check must catch an unsorted table");
+static_assert(!serialNameLess("amp", "AMP") && !serialNameLess("AMP", "amp"), "names compare case-insensitively");
+
+// Run one line; the handler that ran (nullptr for none) and its arguments
+static bool run(const char* line) {
+    lastHandler = nullptr;
+    lastArgs = nullptr;
+    return runSerialCommand(kTable, kCount, line);
+}
+
+#define CHECK_RUNS(line, handler, args) do { \
+        CHECK(run(line)); \
+        CHECK_STR(lastHandler, handler); \
+        CHECK_STR(lastArgs, args); \
+    } while (0)
+
+#define CHECK_UNKNOWN(line) do { \
+        CHECK(!run(line)); \
+        CHECK(lastHandler == nullptr); \
+    } while (0)
+
+static void testLookup() {
+    CHECK_RUNS("amp", "cmdAmp", "");
+    CHECK_RUNS("AMP", "cmdAmp", "");
+    CHECK_UNKNOWN("amp x");          // CMD_EXACT takes no arguments
+    CHECK_RUNS("buttons", "cmdButtons", "");
+    CHECK_RUNS("status", "cmdStatus", "");
+    CHECK_UNKNOWN("bogus");
+    CHECK_UNKNOWN("nosuch");
+    CHECK_UNKNOWN("s");              // A prefix is not a match
+    CHECK_UNKNOWN("stat");
+
+    // Arguments after a space, extra spaces skipped
+    CHECK_RUNS("relaystats reset 2", "cmdRelayStats", "reset 2");
+    CHECK_RUNS("sceneset 2 0x3", "cmdSceneSet", "2 0x3");
+    CHECK_RUNS("setlog    3", "cmdSetLog", "3");
+    CHECK_RUNS("setlog", "cmdSetLog", "");
+
+    // Digits run into the name (CMD_NUMBER), longest name first
+    CHECK_RUNS("b3", "cmdB", "3");
+    CHECK_RUNS("setlog3", "cmdSetLog", "3");
+    CHECK_RUNS("scene2", "cmdScene", "2");
+    CHECK_RUNS("scene 2", "cmdScene", "2");
+    CHECK_RUNS("scenes", "cmdScenes", "");
+    CHECK_UNKNOWN("bx");             // CMD_NUMBER needs a digit
+    CHECK_UNKNOWN("scenesx");
+
+    // Subcommand run into the name (CMD_SUBCOMMAND)
+    CHECK_RUNS("debug", "cmdDebug", "");
+    CHECK_RUNS("debugperf", "cmdDebug", "perf");
+    CHECK_RUNS("debug perf", "cmdDebug", "perf");
+
+    // A bare number selects a channel (CMD_CHANNEL), whole line as arguments
+    CHECK_RUNS("2", "cmdChannel", "2");
+    CHECK_RUNS("17", "cmdChannel", "17");
+    CHECK_RUNS("1", "cmdChannel", "");
+
+    const char* args = "untouched";
+    CHECK(findSerialCommand(kTable, kCount, "nosuch", &args) == nullptr);
+    CHECK(findSerialCommand(kTable, 0, "amp", &args) == nullptr);
+}
+
+// Feed a string; the last complete line (empty if none) and the number of
+// LINE_READY / LINE_OVERFLOW results
+struct FeedResult {
+    char line[SERIAL_LINE_MAX + 1];
+    int ready;
+    int overflow;
+};
+
+static FeedResult feed(SerialLineBuffer& buffer, const char* bytes, size_t count) {
+    FeedResult result = {{0}, 0, 0};
+    for (size_t i = 0; i < count; i++) {
+        switch (feedSerialLine(buffer, bytes[i])) {
+            case LINE_READY:
+                result.ready++;
+                strcpy(result.line, buffer.data);
+                break;
+            case LINE_OVERFLOW:
+                result.overflow++;
+                break;
+            case LINE_PARTIAL:
+                break;
+        }
+    }
+    return result;
+}
+
+static FeedResult feed(SerialLineBuffer& buffer, const char* text) {
+    return feed(buffer, text, strlen(text));
+}
+
+static void testLineAssembler() {
+    SerialLineBuffer buffer = {{0}, 0, false};
+
+    FeedResult r = feed(buffer, "status\n");
+    CHECK(r.ready == 1);
+    CHECK_STR(r.line, "status");
+
+    // CRLF gives one line; the second half is an empty line, not a command
+    r = feed(buffer, "amp\r\n");
+    CHECK(r.ready == 1);
+    CHECK_STR(r.line, "amp");
+    r = feed(buffer, "\r\n\n");
+    CHECK(r.ready == 0 && r.overflow == 0);
+
+    // Leading spaces dropped, trailing spaces trimmed, tabs become spaces
+    r = feed(buffer, "   scene\t2   \n");
+    CHECK(r.ready == 1);
+    CHECK_STR(r.line, "scene 2");
+
+    // Backspace and DEL edit the line; other control bytes are dropped
+    r = feed(buffer, "stx\bat\x7ftus\x01\x1b\n");
+    CHECK(r.ready == 1);
+    CHECK_STR(r.line, "status");
+    r = feed(buffer, "\b\b\n");
+    CHECK(r.ready == 0);
+
+    // Bytes can arrive one poll at a time
+    CHECK(feedSerialLine(buffer, 'a') == LINE_PARTIAL);
+    CHECK(feedSerialLine(buffer, 'm') == LINE_PARTIAL);
+    CHECK(feedSerialLine(buffer, 'p') == LINE_PARTIAL);
+    CHECK(feedSerialLine(buffer, '\r') == LINE_READY);
+    CHECK_STR(buffer.data, "amp");
+
+    // Exactly SERIAL_LINE_MAX characters fit
+    char longLine[SERIAL_LINE_MAX + 2];
+    memset(longLine, 'x', SERIAL_LINE_MAX);
+    longLine[SERIAL_LINE_MAX] = '\n';
+    r = feed(buffer, longLine, SERIAL_LINE_MAX + 1);
+    CHECK(r.ready == 1 && r.overflow == 0);
+    CHECK(strlen(r.line) == SERIAL_LINE_MAX);
+
+    // One more is dropped whole and reported once; the next line is clean
+    memset(longLine, 'y', SERIAL_LINE_MAX + 1);
+    longLine[SERIAL_LINE_MAX + 1] = '\n';
+    r = feed(buffer, longLine, SERIAL_LINE_MAX + 2);
+    CHECK(r.ready == 0 && r.overflow == 1);
+    r = feed(buffer, "b3\n");
+    CHECK(r.ready == 1 && r.overflow == 0);
+    CHECK_STR(r.line, "b3");
+}
+
+int main() {
+    testLookup();
+    testLineAssembler();
+    return hostTestResult("serialCommands");
+}
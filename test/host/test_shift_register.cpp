@@ -0,0 +1,153 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Host test of shiftRegisterUpdate() with 32 outputs on four chained
+// 74HC595s (buttons on a matrix, so no per-button GPIOs are needed). The
+// traced SPI bytes are clocked MSB first into a model of the chain (chip 0
+// nearest the MCU, Q7' feeding the next chip) and latched on the RCLK
+// rising edge, so output N must come out on Q(N%8) of chip N/8 for every
+// bit. Each update is one transfer and one latch pulse after the last
+// byte, held high for at least SHIFT_REG_LATCH_HOLD_NS by the cycle count
+// the trace records. Boot clears the chain, with /OE (when fitted) held high
+// until that first latch.
+#include <Arduino.h>
+#include "relayDriver.h"
+#include "relayGroups.h"
+#include "hostBoard.h"
+#include "hostTest.h"
+
+uint8_t currentAmpChannel = 0;
+uint32_t ampOutputs = 0;
+
+#define LATCH_BIT (1UL << SHIFT_REG_LATCH_PIN)
+
+// Four 74HC595s: SER of chip 0 is the MOSI line
+struct ShiftChain {
+    uint32_t shift;     // Shift registers, bit 8*c + q = chip c, stage q
+    uint32_t outputs;   // Storage registers, what the relays see
+    uint32_t latches;
+    uint32_t minHoldCycles;
+    uint32_t bitsSinceLatch;
+    bool latchedEarly;  // RCLK rose before a whole frame was in
+};
+
+static ShiftChain chain;
+
+static void replayChain() {
+    bool rclk = false;
+    uint32_t risingCycles = 0;
+    for (size_t i = 0; i < hostIoCount; i++) {
+        const HostIoEvent& e = hostIoTrace[i];
+        if (e.kind == HOST_IO_SPI) {
+            for (int b = 7; b >= 0; b--) {
+                chain.shift = (chain.shift << 1) | ((e.value >> b) & 1);
+            }
+            chain.bitsSinceLatch += 8;
+        } else if (e.kind == HOST_IO_W1TS && (e.value & LATCH_BIT) && !rclk) {
+            rclk = true;
+            risingCycles = e.cycles;
+            if (chain.bitsSinceLatch < 8 * SHIFT_REG_CHIPS) chain.latchedEarly = true;
+            chain.outputs = chain.shift;
+            chain.latches++;
+            chain.bitsSinceLatch = 0;
+        } else if (e.kind == HOST_IO_W1TC && (e.value & LATCH_BIT) && rclk) {
+            rclk = false;
+            uint32_t held = e.cycles - risingCycles;
+            if (held < chain.minHoldCycles) chain.minHoldCycles = held;
+        }
+    }
+    CHECK(!rclk);
+    hostClearIo();
+}
+
+static void update(uint32_t setMask, uint32_t clearMask) {
+    uint32_t latches = chain.latches;
+    shiftRegisterUpdate(setMask, clearMask);
+    CHECK(hostCountIo(HOST_IO_SPI) == SHIFT_REG_CHIPS);
+    CHECK(hostCountIo(HOST_IO_W1TS) == 1 && hostCountIo(HOST_IO_W1TC) == 1);
+    // Latch after the last byte
+    CHECK(hostIoCount == SHIFT_REG_CHIPS + 2);
+    CHECK(hostIoTrace[SHIFT_REG_CHIPS].kind == HOST_IO_W1TS);
+    replayChain();
+    CHECK(chain.latches == latches + 1);
+    CHECK(chain.outputs == getShiftRegisterState());
+}
+
+static void testBoot() {
+    hostClearIo();
+    chain.shift = 0xA5A5A5A5;   // Power-up garbage
+    initShiftRegister();
+#ifdef SHIFT_REG_OE_PIN
+    // /OE high before anything is shifted, low only after the first latch
+    size_t oeHigh = HOST_IO_TRACE_MAX, oeLow = HOST_IO_TRACE_MAX, latch = HOST_IO_TRACE_MAX;
+    for (size_t i = 0; i < hostIoCount; i++) {
+        const HostIoEvent& e = hostIoTrace[i];
+        if (e.kind == HOST_IO_PIN && e.pin == SHIFT_REG_OE_PIN) {
+            if (e.value == HIGH && oeHigh == HOST_IO_TRACE_MAX) oeHigh = i;
+            if (e.value == LOW) oeLow = i;
+        }
+        if (e.kind == HOST_IO_W1TS && (e.value & LATCH_BIT) && latch == HOST_IO_TRACE_MAX) latch = i;
+    }
+    CHECK(oeHigh < latch && latch < oeLow && oeLow < HOST_IO_TRACE_MAX);
+#endif
+    replayChain();
+    CHECK(chain.outputs == 0);
+    CHECK(getShiftRegisterState() == 0);
+}
+
+// Output N on its own, then everything but output N
+static void testWalkingBits() {
+    for (int n = 0; n < 32; n++) {
+        uint32_t bit = 1UL << n;
+        update(bit, ~bit);
+        CHECK(chain.outputs == bit);
+        CHECK(((chain.outputs >> (8 * (n / 8))) & 0xFF) == 1U << (n % 8));
+    }
+    for (int n = 0; n < 32; n++) {
+        uint32_t bit = 1UL << n;
+        update(~bit, bit);
+        CHECK(chain.outputs == (uint32_t)~bit);
+    }
+}
+
+// Set/clear pairs keep every other output as it was
+static void testSetClearPairs() {
+    update(0, 0xFFFFFFFF);
+    uint32_t expected = 0;
+    uint32_t seed = 1;
+    for (int i = 0; i < 200; i++) {
+        seed = seed * 1664525 + 1013904223;
+        uint32_t setMask = seed & (seed >> 7);
+        uint32_t clearMask = ~seed & (seed >> 3) & ~setMask;
+        expected = (expected & ~clearMask) | setMask;
+        update(setMask, clearMask);
+        CHECK(chain.outputs == expected);
+    }
+}
+
+int main() {
+    hostReset();
+    chain.minHoldCycles = 0xFFFFFFFF;
+
+    testBoot();
+    testWalkingBits();
+    testSetClearPairs();
+
+    CHECK(!chain.latchedEarly);
+    uint32_t holdNs = chain.minHoldCycles * 1000 / ESP.getCpuFreqMHz();
+    CHECK(holdNs >= SHIFT_REG_LATCH_HOLD_NS);
+    printf("shiftRegister: %lu latches, RCLK held high at least %luns (SHIFT_REG_LATCH_HOLD_NS %u)\n",
+           (unsigned long)chain.latches, (unsigned long)holdNs, SHIFT_REG_LATCH_HOLD_NS);
+    return hostTestResult("shiftRegister");
+}
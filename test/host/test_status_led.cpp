@@ -0,0 +1,199 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Host test of the status LED sequencer (LEDC backend, hardware fader) on
+// the virtual clock, with updateStatusLED() called every millisecond like
+// the loop. The traced ledcWrite() duties and fader starts must match the
+// step tables to the millisecond: a feedback flash plays over the
+// background, a confirmation preempts a running flash and a feedback queued
+// under it plays after it, OTA takes over from a confirmation, a flash
+// queued under the pairing fade waits and plays once pairing ends, or is
+// dropped once it is older than LED_QUEUE_STALE_MS, and the background
+// resumes from its first step after every one-shot.
+#include <Arduino.h>
+#include "statusLed.h"
+#include "pairing.h"
+#include "hostBoard.h"
+#include "hostTest.h"
+
+uint8_t currentAmpChannel = 0;
+uint32_t ampOutputs = 0;
+PairingStatus pairingStatus = NOT_PAIRED;
+bool serialOtaTrigger = false;
+volatile StatusLedPattern currentLedPattern = LED_OFF;
+volatile unsigned long ledPatternStart = 0;
+volatile int ledPatternStep = 0;
+
+#define FULL 8191
+
+struct LedWrite {
+    uint32_t ms;       // After the scenario started
+    HostIoKind kind;   // HOST_IO_LEDC or HOST_IO_FADE
+    uint32_t duty;
+};
+
+#define SET(ms, duty) {ms, HOST_IO_LEDC, duty}
+#define FADE(ms, duty) {ms, HOST_IO_FADE, duty}
+
+static uint64_t scenarioUs = 0;
+
+static void start() {
+    hostClearIo();
+    scenarioUs = hostNowUs;
+}
+
+static void run(uint32_t ms) {
+    for (uint32_t i = 0; i < ms; i++) {
+        hostAdvanceUs(1000);
+        updateStatusLED();
+    }
+}
+
+static uint32_t nowMs() {
+    return (uint32_t)((hostNowUs - scenarioUs) / 1000);
+}
+
+static void checkWrites(const char* scenario, const LedWrite* expected, size_t count) {
+    bool same = hostIoCount == count;
+    for (size_t i = 0; same && i < count; i++) {
+        const HostIoEvent& e = hostIoTrace[i];
+        same = e.kind == expected[i].kind && e.value == expected[i].duty &&
+               e.us - scenarioUs == expected[i].ms * 1000ULL;
+    }
+    if (!same) {
+        printf("statusLed: %s wrote\n", scenario);
+        for (size_t i = 0; i < hostIoCount; i++) {
+            const HostIoEvent& e = hostIoTrace[i];
+            printf("  %s %lu at %llums\n", e.kind == HOST_IO_FADE ? "fade to" : "duty", (unsigned long)e.value,
+                   (unsigned long long)((e.us - scenarioUs) / 1000));
+        }
+    }
+    CHECK(same);
+}
+
+struct QueueStats {
+    unsigned long queued, played, preempted, expired, dropped;
+};
+
+static QueueStats queueStats() {
+    QueueStats s = {0, 0, 0, 0, 0};
+    unsigned pending, depth;
+    printStatusLedStats();
+    CHECK(sscanf(hostLastLog, "  LED Queue: %u/%u pending, %lu queued, %lu played, %lu preempted, %lu expired, "
+                 "%lu dropped", &pending, &depth, &s.queued, &s.played, &s.preempted, &s.expired, &s.dropped) == 7);
+    return s;
+}
+
+// Single flash over the fast blink; the blink then starts over
+static void testFlashOverBackground() {
+    setStatusLedPattern(LED_FAST_BLINK);
+    run(150);
+    start();
+    setStatusLedPattern(LED_SINGLE_FLASH);
+    run(450);
+    const LedWrite expected[] = {SET(1, FULL), SET(81, 0), SET(201, FULL), SET(301, 0), SET(401, FULL)};
+    checkWrites("single flash over fast blink", expected, sizeof(expected) / sizeof(expected[0]));
+}
+
+// A confirmation preempts a triple flash, which is not resumed; a single
+// flash queued meanwhile outranks the background and plays after it
+static void testConfirmPreemptsFeedback() {
+    setStatusLedPattern(LED_OFF);
+    run(50);
+    QueueStats before = queueStats();
+    start();
+    setStatusLedPattern(LED_TRIPLE_FLASH);
+    run(20);
+    queueStatusLedFlashes(2, LED_PRIORITY_CONFIRM);
+    run(80);
+    setStatusLedPattern(LED_SINGLE_FLASH);
+    run(1200);
+    // Confirm: off 200, on 200, twice; the single flash's on step follows
+    // the last one without a write, its off step shows it played
+    const LedWrite expected[] = {SET(1, FULL), SET(21, 0), SET(221, FULL), SET(421, 0), SET(621, FULL), SET(901, 0)};
+    checkWrites("confirm over triple flash", expected, sizeof(expected) / sizeof(expected[0]));
+    QueueStats after = queueStats();
+    CHECK(after.played - before.played == 3);
+    CHECK(after.preempted - before.preempted == 1);
+    CHECK(after.expired == before.expired);
+}
+
+// OTA outranks every one-shot: it takes over at once and the confirmation
+// is gone when it ends
+static void testOtaPreemptsConfirm() {
+    QueueStats before = queueStats();
+    start();
+    queueStatusLedFlashes(3, LED_PRIORITY_CONFIRM);
+    run(450);
+    serialOtaTrigger = true;
+    run(250);
+    serialOtaTrigger = false;
+    run(1500);
+    // Confirm off (already), on, off; OTA blink from its on step; off
+    const LedWrite expected[] = {SET(201, FULL), SET(401, 0), SET(451, FULL), SET(551, 0), SET(651, FULL),
+                                 SET(701, 0)};
+    checkWrites("OTA over confirm", expected, sizeof(expected) / sizeof(expected[0]));
+    QueueStats after = queueStats();
+    CHECK(after.preempted - before.preempted == 1);
+    CHECK(after.played - before.played == 1);
+}
+
+// A flash queued under the pairing fade waits for pairing to end. The
+// fader finishes its ramp first; if the flash is older than
+// LED_QUEUE_STALE_MS by then it is dropped and the background shows.
+static void pairWithQueuedFlash(uint32_t pairedAtMs) {
+    pairingStatus = PAIR_REQUEST;
+    run(1);
+    setStatusLedPattern(LED_DOUBLE_FLASH);
+    run(pairedAtMs - nowMs());
+    pairingStatus = PAIR_PAIRED;
+    run(LED_QUEUE_STALE_MS + 1000);
+}
+
+static void testFlashAfterPairing() {
+    QueueStats before = queueStats();
+    start();
+    pairWithQueuedFlash(800);
+    // The ramp up ends at 1001, the flash's on step needs no write
+    const LedWrite expected[] = {FADE(1, FULL), SET(1061, 0), SET(1121, FULL), SET(1181, 0)};
+    checkWrites("flash after pairing", expected, sizeof(expected) / sizeof(expected[0]));
+    QueueStats after = queueStats();
+    CHECK(after.played - before.played == 1);
+    CHECK(after.expired == before.expired);
+}
+
+static void testStaleFlashDropped() {
+    QueueStats before = queueStats();
+    start();
+    pairWithQueuedFlash(LED_QUEUE_STALE_MS + 500);
+    const LedWrite expected[] = {FADE(1, FULL), FADE(1001, 0), FADE(2001, FULL), SET(3001, 0)};
+    checkWrites("stale flash", expected, sizeof(expected) / sizeof(expected[0]));
+    QueueStats after = queueStats();
+    CHECK(after.played == before.played);
+    CHECK(after.expired - before.expired == 1);
+}
+
+int main() {
+    hostReset();
+    initStatusLed();
+    run(10);
+
+    testFlashOverBackground();
+    testConfirmPreemptsFeedback();
+    testOtaPreemptsConfirm();
+    testFlashAfterPairing();
+    testStaleFlashDropped();
+
+    return hostTestResult("statusLed");
+}
@@ -0,0 +1,261 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Host test of SwitchDriver<N, Backend, Policy> (run.sh builds it with
+// RELAY_GROUPS "E3,I1"): one channel sequence runs through every backend
+// and policy, plus a MockBackend that records each mask pair it is handed.
+// Every combination must leave the same ampOutputs and currentAmpChannel
+// after each step, and each backend's outputs must end up where ampOutputs
+// says: the GPIO register for the register and digitalWrite backends, the
+// requested state for the pulse and mute sequencers.
+#include <Arduino.h>
+#include "switchDriver.h"
+#include "hostBoard.h"
+#include "hostTest.h"
+
+uint8_t currentAmpChannel = 0;
+uint32_t ampOutputs = 0;
+
+// Direct GPIO masks as relayDriver.cpp builds them
+uint32_t ampChannelSetMask[MAX_AMPSWITCHS + 1];
+uint32_t ampChannelClearMask[MAX_AMPSWITCHS + 1];
+uint32_t ampRelayMask = AMP_SWITCH_PIN_MASK;
+
+uint32_t relayOutputsToGpioMask(uint32_t outputs) {
+    uint32_t gpio = 0;
+    for (int i = 0; i < MAX_AMPSWITCHS; i++) {
+        if (outputs & (1UL << i)) gpio |= 1UL << ampSwitchPins[i];
+    }
+    return gpio;
+}
+
+void initRelayMasks() {
+    ampChannelSetMask[0] = 0;
+    ampChannelClearMask[0] = ampRelayMask;
+    for (int ch = 1; ch <= MAX_AMPSWITCHS; ch++) {
+        uint32_t bit = 1UL << (ch - 1);
+        ampChannelSetMask[ch] = relayOutputsToGpioMask(bit);
+        ampChannelClearMask[ch] =
+            (RELAY_INDEPENDENT_OUTPUTS & bit) ? 0 : relayOutputsToGpioMask(ampChannelGroupOutputs[ch] & ~bit);
+    }
+}
+
+// The pulse and mute sequencers are tested on their own; here they only
+// take the requested state
+static uint32_t requestedOutputs = 0;
+static uint32_t requestCount = 0;
+static uint32_t recordedOutputs = 0;
+
+void requestRelayOutputs(uint32_t outputs) {
+    requestedOutputs = outputs;
+    requestCount++;
+}
+
+void requestMutedSwitch(uint32_t outputs) {
+    requestedOutputs = outputs;
+    requestCount++;
+}
+
+void recordRelayOutputs(uint32_t outputs) {
+    recordedOutputs = outputs;
+}
+
+// Records every mask pair and applies it to a register of its own
+struct MockBackend {
+    struct Applied {
+        uint32_t setMask;
+        uint32_t clearMask;
+        uint32_t outputs;
+    };
+    static Applied applied[32];
+    static size_t count;
+    static uint32_t relays;
+    static size_t verified;
+
+    static void apply(uint32_t setMask, uint32_t clearMask, uint32_t outputs) {
+        if (count < sizeof(applied) / sizeof(applied[0])) {
+            applied[count] = {setMask, clearMask, outputs};
+        }
+        count++;
+        relays = (relays & ~clearMask) | setMask;
+    }
+    static void verify(uint32_t setMask, uint32_t clearMask) {
+        verified++;
+    }
+    static void reset() {
+        count = 0;
+        relays = 0;
+        verified = 0;
+    }
+};
+
+MockBackend::Applied MockBackend::applied[32];
+size_t MockBackend::count = 0;
+uint32_t MockBackend::relays = 0;
+size_t MockBackend::verified = 0;
+
+#define SET_OUTPUTS 0x100  // Step is a setOutputs() state, not a channel
+
+// Channels, a rejected channel, repeats, the independent boost toggling on
+// and off across amp changes, and scene-style output states
+static const uint16_t kSequence[] = {
+    1, 2, 2, 0, 0, 3, 9, 4, 1, 4, 4, 2,
+    SET_OUTPUTS | 0x9, SET_OUTPUTS | 0x9, 3, SET_OUTPUTS | 0x0, 4, SET_OUTPUTS | 0x2, 0, 5
+};
+static const size_t kSteps = sizeof(kSequence) / sizeof(kSequence[0]);
+
+struct StepState {
+    uint32_t outputs;
+    uint8_t channel;
+};
+
+// Each step, then whether the relays sit where ampOutputs says
+template <class Backend, class Policy>
+static void runSequence(StepState* states, size_t* switches, uint32_t* logs, bool (*relaysMatch)()) {
+    typedef SwitchDriver<MAX_AMPSWITCHS, Backend, Policy> Driver;
+    uint32_t logsBefore = hostLogCount;
+    size_t commits = 0;
+    for (size_t i = 0; i < kSteps; i++) {
+        uint32_t before = ampOutputs;
+        uint32_t recordedBefore = recordedOutputs;
+        if (kSequence[i] & SET_OUTPUTS) {
+            Driver::setOutputs(kSequence[i] & ~SET_OUTPUTS);
+        } else {
+            Driver::set(kSequence[i]);
+        }
+        states[i] = {ampOutputs, currentAmpChannel};
+        if (ampOutputs != before) {
+            commits++;
+            CHECK(recordedOutputs == ampOutputs);
+        } else {
+            CHECK(recordedOutputs == recordedBefore);
+        }
+        CHECK(relaysMatch());
+    }
+    *switches = commits;
+    *logs = hostLogCount - logsBefore;
+}
+
+static bool gpioMatches() {
+    return (hostGpioOut & ampRelayMask) == relayOutputsToGpioMask(ampOutputs);
+}
+
+static bool requestMatches() {
+    return requestedOutputs == ampOutputs;
+}
+
+static bool mockMatches() {
+    return MockBackend::relays == relayOutputsToGpioMask(ampOutputs);
+}
+
+static void resetOutputs() {
+    ampOutputs = 0;
+    currentAmpChannel = 0;
+    recordedOutputs = 0;
+    requestedOutputs = 0;
+    hostGpioOut = 0;
+    MockBackend::reset();
+}
+
+template <class Backend, class Policy>
+static void checkCombination(const char* name, const StepState* reference, size_t referenceSwitches,
+                             bool (*relaysMatch)(), bool logging) {
+    StepState states[kSteps];
+    size_t switches = 0;
+    uint32_t logs = 0;
+    resetOutputs();
+    runSequence<Backend, Policy>(states, &switches, &logs, relaysMatch);
+    bool same = switches == referenceSwitches;
+    for (size_t i = 0; i < kSteps; i++) {
+        if (states[i].outputs != reference[i].outputs || states[i].channel != reference[i].channel) {
+            printf("%s: step %lu (%u) left outputs 0x%lX channel %u, expected 0x%lX channel %u\n", name,
+                   (unsigned long)i, kSequence[i], (unsigned long)states[i].outputs, states[i].channel,
+                   (unsigned long)reference[i].outputs, reference[i].channel);
+            same = false;
+        }
+    }
+    CHECK(same);
+    // Silent means silent; the logging policy reports every set(), switched,
+    // unchanged or rejected (setOutputs() is quiet in both)
+    CHECK(logging ? logs > 0 : logs == 0);
+}
+
+template <class Policy>
+static void checkBackends(const char* policy, const StepState* reference, size_t referenceSwitches, bool logging) {
+    char name[64];
+    snprintf(name, sizeof(name), "Register/%s", policy);
+    checkCombination<RegisterSwitchBackend, Policy>(name, reference, referenceSwitches, gpioMatches, logging);
+    snprintf(name, sizeof(name), "DigitalWrite/%s", policy);
+    checkCombination<DigitalWriteSwitchBackend, Policy>(name, reference, referenceSwitches, gpioMatches, logging);
+    snprintf(name, sizeof(name), "Pulse/%s", policy);
+    requestCount = 0;
+    checkCombination<PulseSwitchBackend, Policy>(name, reference, referenceSwitches, requestMatches, logging);
+    CHECK(requestCount == referenceSwitches);
+    snprintf(name, sizeof(name), "Muted/%s", policy);
+    requestCount = 0;
+    checkCombination<MutedSwitchBackend, Policy>(name, reference, referenceSwitches, requestMatches, logging);
+    CHECK(requestCount == referenceSwitches);
+    snprintf(name, sizeof(name), "Mock/%s", policy);
+    checkCombination<MockBackend, Policy>(name, reference, referenceSwitches, mockMatches, logging);
+}
+
+int main() {
+    hostReset();
+    for (int i = 0; i < MAX_AMPSWITCHS; i++) {
+        pinMode(ampSwitchPins[i], OUTPUT);
+    }
+    initRelayMasks();
+
+    // Reference: the mock backend, silent
+    StepState reference[kSteps];
+    size_t switches = 0;
+    uint32_t logs = 0;
+    resetOutputs();
+    runSequence<MockBackend, SilentSwitchPolicy>(reference, &switches, &logs, mockMatches);
+
+    // The expected walk through the E3,I1 topology
+    static const StepState kExpected[kSteps] = {
+        {0x1, 1}, {0x2, 2}, {0x2, 2}, {0x0, 0}, {0x0, 0}, {0x4, 3}, {0x4, 3}, {0xC, AMP_CHANNEL_SCENE},
+        {0x9, AMP_CHANNEL_SCENE}, {0x1, 1}, {0x9, AMP_CHANNEL_SCENE}, {0xA, AMP_CHANNEL_SCENE},
+        {0x9, AMP_CHANNEL_SCENE}, {0x9, AMP_CHANNEL_SCENE}, {0xC, AMP_CHANNEL_SCENE}, {0x0, 0},
+        {0x8, 4}, {0x2, 2}, {0x0, 0}, {0x0, 0}
+    };
+    for (size_t i = 0; i < kSteps; i++) {
+        CHECK(reference[i].outputs == kExpected[i].outputs);
+        CHECK(reference[i].channel == kExpected[i].channel);
+    }
+
+    // One mask pair per change, none for repeats or rejected channels, and
+    // only the relays that move: channel 2 from 1 clears 1, sets 2
+    CHECK(MockBackend::count == switches);
+    CHECK(MockBackend::verified == switches);
+    CHECK(switches == 15);
+    CHECK(MockBackend::applied[1].setMask == ampChannelSetMask[2]);
+    CHECK(MockBackend::applied[1].clearMask == relayOutputsToGpioMask(0x5));
+    CHECK(MockBackend::applied[1].outputs == 0x2);
+    // Boost off: its own bit moves to the clear mask, nothing is set
+    CHECK(MockBackend::applied[6].setMask == 0);
+    CHECK(MockBackend::applied[6].clearMask == ampChannelSetMask[4]);
+
+    checkBackends<SilentSwitchPolicy>("Silent", reference, switches, false);
+    checkBackends<LoggingSwitchPolicy>("Logging", reference, switches, true);
+
+    // The logging policy names the rejected channel
+    resetOutputs();
+    SwitchDriver<MAX_AMPSWITCHS, MockBackend, LoggingSwitchPolicy>::set(MAX_AMPSWITCHS + 1);
+    CHECK_STR(hostLastLog, "Invalid channel 5 requested (max: 4)");
+    CHECK(MockBackend::count == 0);
+
+    return hostTestResult("switchDriver");
+}
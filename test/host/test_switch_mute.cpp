@@ -0,0 +1,232 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Host test of the switch mute sequencer (IDLE -> SETTLING -> RELEASING)
+// on the simulated board's esp_timer, with direct GPIO level drive. A
+// switch arrives while idle, during SETTLING, during RELEASING, and just as
+// the release falls due (esp_timer_stop() fails and switchPending hands the
+// target to the timer callback). From the traced mute pin and relay
+// register writes: the relays only ever move while muted, the mute drops
+// once per sequence, each request's relay change lands when the state
+// machine says it should, and debugrelay reports the added latency that
+// actually happened.
+#include <Arduino.h>
+#include "switchMute.h"
+#include "relayDriver.h"
+#include "relayGroups.h"
+#include "hostBoard.h"
+#include "hostTest.h"
+
+uint8_t currentAmpChannel = 0;
+uint32_t ampOutputs = 0;
+
+static char logLines[2048];
+static size_t logLength = 0;
+
+void logText(LogLevel level, const char* msg) {
+    logLength += snprintf(logLines + logLength, sizeof(logLines) - logLength, "%s\n", msg);
+}
+
+void logFormat(LogLevel level, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    logLength += vsnprintf(logLines + logLength, sizeof(logLines) - logLength, format, args);
+    va_end(args);
+    logLength += snprintf(logLines + logLength, sizeof(logLines) - logLength, "\n");
+}
+
+// What the trace since hostClearIo() shows
+struct MuteTrace {
+    uint32_t muteEdges;       // Mute asserted
+    uint32_t unmuteEdges;
+    uint64_t mutedUs;         // First mute edge
+    uint64_t unmutedUs;       // Last unmute edge
+    uint32_t relayChanges;    // Distinct relay states driven
+    uint64_t lastChangeUs;
+    uint32_t writesUnmuted;   // Relay writes with the mute released: must stay 0
+};
+
+static bool isMuteLevel(uint32_t level) {
+    return level == SWITCH_MUTE_ACTIVE_LEVEL;
+}
+
+static MuteTrace readTrace() {
+    MuteTrace t = {0, 0, 0, 0, 0, 0, 0};
+    bool muted = false;
+    uint64_t lastWriteUs = UINT64_MAX;
+    for (size_t i = 0; i < hostIoCount; i++) {
+        const HostIoEvent& e = hostIoTrace[i];
+        if (e.kind == HOST_IO_PIN && e.pin == SWITCH_MUTE_PIN) {
+            if (isMuteLevel(e.value) && !muted) {
+                if (t.muteEdges++ == 0) t.mutedUs = e.us;
+            } else if (!isMuteLevel(e.value) && muted) {
+                t.unmuteEdges++;
+                t.unmutedUs = e.us;
+            }
+            muted = isMuteLevel(e.value);
+        } else if (e.kind == HOST_IO_W1TS || e.kind == HOST_IO_W1TC) {
+            if (!muted) t.writesUnmuted++;
+            // The W1TC/W1TS pair of one change lands at the same instant
+            if (e.us != lastWriteUs) {
+                t.relayChanges++;
+                t.lastChangeUs = e.us;
+                lastWriteUs = e.us;
+            }
+        }
+    }
+    return t;
+}
+
+// Added latency lines from printSwitchMuteStatus()
+static void reportedLatency(unsigned long* lastUs, unsigned long* maxUs) {
+    logLength = 0;
+    logLines[0] = '\0';
+    printSwitchMuteStatus();
+    const char* line = strstr(logLines, "Added Latency:");
+    CHECK(line != nullptr);
+    *lastUs = *maxUs = 0xFFFFFFFF;
+    if (line) sscanf(line, "Added Latency: last %luus, max %luus", lastUs, maxUs);
+}
+
+static uint32_t relaysNow() {
+    return hostGpioOut & ampRelayMask;
+}
+
+static void settle() {
+    hostAdvanceUs(10 * (SWITCH_MUTE_SETTLE_US + SWITCH_MUTE_RELEASE_US));
+}
+
+// Idle: mute, relays after the settle time, unmute after the release time
+static void testIdleSwitch() {
+    settle();
+    hostClearIo();
+    uint64_t start = hostNowUs;
+    requestMutedSwitch(0x1);
+    settle();
+    MuteTrace t = readTrace();
+    CHECK(t.muteEdges == 1 && t.unmuteEdges == 1);
+    CHECK(t.mutedUs == start);
+    CHECK(t.relayChanges == 1);
+    CHECK(t.lastChangeUs - start == SWITCH_MUTE_SETTLE_US);
+    CHECK(t.unmutedUs - t.lastChangeUs == SWITCH_MUTE_RELEASE_US);
+    CHECK(t.writesUnmuted == 0);
+    CHECK(relaysNow() == relayOutputsToGpioMask(0x1));
+
+    unsigned long last, max;
+    reportedLatency(&last, &max);
+    CHECK(last == SWITCH_MUTE_SETTLE_US);
+}
+
+// During SETTLING: the new target replaces the pending one, the relays
+// move once, straight to it, still at the end of the original settle
+static void testSwitchWhileSettling() {
+    settle();
+    hostClearIo();
+    uint64_t start = hostNowUs;
+    requestMutedSwitch(0x2);
+    hostAdvanceUs(SWITCH_MUTE_SETTLE_US / 3);
+    requestMutedSwitch(0x4);
+    settle();
+    MuteTrace t = readTrace();
+    CHECK(t.muteEdges == 1 && t.unmuteEdges == 1);
+    CHECK(t.relayChanges == 1);
+    CHECK(t.lastChangeUs - start == SWITCH_MUTE_SETTLE_US);
+    CHECK(t.writesUnmuted == 0);
+    CHECK(relaysNow() == relayOutputsToGpioMask(0x4));
+
+    // The second request waited less than the settle time; the report is
+    // from the start of the mute
+    unsigned long last, max;
+    reportedLatency(&last, &max);
+    CHECK(last == SWITCH_MUTE_SETTLE_US);
+}
+
+// During RELEASING: the relays are still muted, so they switch at once and
+// the release delay restarts from there
+static void testSwitchWhileReleasing() {
+    settle();
+    hostClearIo();
+    uint64_t start = hostNowUs;
+    requestMutedSwitch(0x1);
+    hostAdvanceUs(SWITCH_MUTE_SETTLE_US + SWITCH_MUTE_RELEASE_US / 2);
+    uint64_t second = hostNowUs;
+    requestMutedSwitch(0x2);
+    CHECK(relaysNow() == relayOutputsToGpioMask(0x2));
+    settle();
+    MuteTrace t = readTrace();
+    CHECK(t.muteEdges == 1 && t.unmuteEdges == 1);
+    CHECK(t.relayChanges == 2);
+    CHECK(t.lastChangeUs == second);
+    CHECK(t.unmutedUs - second == SWITCH_MUTE_RELEASE_US);
+    CHECK(t.unmutedUs - start == SWITCH_MUTE_SETTLE_US + SWITCH_MUTE_RELEASE_US / 2 + SWITCH_MUTE_RELEASE_US);
+    CHECK(t.writesUnmuted == 0);
+}
+
+// The release is due but its callback has not run: esp_timer_stop() fails,
+// switchPending hands the target over and the callback starts the next
+// sequence without unmuting in between
+static uint32_t dueRequestOutputs;
+static uint64_t dueRequestUs;
+
+static void requestAsReleaseFallsDue() {
+    hostTimerDue = nullptr;
+    dueRequestUs = hostNowUs;
+    requestMutedSwitch(dueRequestOutputs);
+}
+
+static void testSwitchAsReleaseFallsDue() {
+    settle();
+    hostClearIo();
+    uint64_t start = hostNowUs;
+    requestMutedSwitch(0x1);
+    hostAdvanceUs(SWITCH_MUTE_SETTLE_US + SWITCH_MUTE_RELEASE_US / 2);
+    dueRequestOutputs = 0x8;
+    hostTimerDue = requestAsReleaseFallsDue;
+    settle();
+    MuteTrace t = readTrace();
+    CHECK(dueRequestUs == start + SWITCH_MUTE_SETTLE_US + SWITCH_MUTE_RELEASE_US);
+    CHECK(t.muteEdges == 1 && t.unmuteEdges == 1);
+    CHECK(t.relayChanges == 2);
+    // Worst case for a request: one full settle after the release it missed
+    CHECK(t.lastChangeUs - dueRequestUs == SWITCH_MUTE_SETTLE_US);
+    CHECK(t.unmutedUs - t.lastChangeUs == SWITCH_MUTE_RELEASE_US);
+    CHECK(t.writesUnmuted == 0);
+    CHECK(relaysNow() == relayOutputsToGpioMask(0x8));
+
+    unsigned long last, max;
+    reportedLatency(&last, &max);
+    CHECK(last == SWITCH_MUTE_SETTLE_US);
+}
+
+int main() {
+    hostReset();
+    for (int i = 0; i < MAX_AMPSWITCHS; i++) {
+        pinMode(ampSwitchPins[i], OUTPUT);
+    }
+    initRelayMasks();
+    initSwitchMute();
+
+    testIdleSwitch();
+    testSwitchWhileSettling();
+    testSwitchWhileReleasing();
+    testSwitchAsReleaseFallsDue();
+
+    // Added latency never exceeds the settle time, and the report says so
+    unsigned long last, max;
+    reportedLatency(&last, &max);
+    CHECK(max == SWITCH_MUTE_SETTLE_US);
+    printf("switchMute: added latency last %luus, max %luus (settle %uus, release %uus)\n", last, max,
+           SWITCH_MUTE_SETTLE_US, SWITCH_MUTE_RELEASE_US);
+    return hostTestResult("switchMute");
+}
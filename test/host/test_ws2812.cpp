@@ -0,0 +1,102 @@
+// Copyright (c) Craig Millard and contributors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Host test for the WS2812 frame encoder: RMT item layout, GRB bit order and
+// the timing table against the WS2812B datasheet
+#include <Arduino.h>
+#include "rgbLed.h"
+#include "hostTest.h"
+
+HardwareSerial Serial;
+
+// rmt_item32_t::val fields
+static uint32_t highTicks(uint32_t item) { return item & 0x7FFF; }
+static uint32_t highLevel(uint32_t item) { return (item >> 15) & 1; }
+static uint32_t lowTicks(uint32_t item) { return (item >> 16) & 0x7FFF; }
+static uint32_t lowLevel(uint32_t item) { return item >> 31; }
+
+// RMT source clock is APB, 80MHz
+static const uint32_t kTickNs = 1000 / (80 / WS2812_RMT_CLK_DIV);
+
+// Datasheet windows (ns): T0H 400, T1H 800, T0L 850, T1L 450, each +-150
+static bool within(uint32_t ticks, uint32_t nominalNs) {
+    uint32_t ns = ticks * kTickNs;
+    return ns + 150 >= nominalNs && ns <= nominalNs + 150;
+}
+
+// Bits back out of a frame: 1 where the high time is the longer one
+static uint32_t decodeFrame(const uint32_t* items) {
+    uint32_t bits = 0;
+    for (int i = 0; i < WS2812_FRAME_BITS; i++) {
+        bits = (bits << 1) | (highTicks(items[i]) > lowTicks(items[i]) ? 1 : 0);
+    }
+    return bits;
+}
+
+static void testTiming() {
+    CHECK(kTickNs == 25);
+    CHECK(within(WS2812_T0H, 400));
+    CHECK(within(WS2812_T0L, 850));
+    CHECK(within(WS2812_T1H, 800));
+    CHECK(within(WS2812_T1L, 450));
+    // Bit period 1.25us +-600ns
+    CHECK((WS2812_T0H + WS2812_T0L) * kTickNs + 600 >= 1250 && (WS2812_T0H + WS2812_T0L) * kTickNs <= 1850);
+    CHECK((WS2812_T1H + WS2812_T1L) * kTickNs + 600 >= 1250 && (WS2812_T1H + WS2812_T1L) * kTickNs <= 1850);
+    // WS2812_FRAME_US covers the frame on the wire; the gap after it latches a WS2812B
+    CHECK(WS2812_FRAME_BITS * (WS2812_T0H + WS2812_T0L) * kTickNs <= WS2812_FRAME_US * 1000);
+    CHECK(WS2812_FRAME_BITS * (WS2812_T1H + WS2812_T1L) * kTickNs <= WS2812_FRAME_US * 1000);
+    CHECK(WS2812_RESET_US >= 280);
+}
+
+static void testItemLayout() {
+    uint32_t items[WS2812_FRAME_BITS];
+    encodeWs2812Frame(RgbColour{0, 0, 0}, items);
+    for (int i = 0; i < WS2812_FRAME_BITS; i++) {
+        CHECK(highLevel(items[i]) == 1 && lowLevel(items[i]) == 0);
+        CHECK(highTicks(items[i]) == WS2812_T0H && lowTicks(items[i]) == WS2812_T0L);
+    }
+    encodeWs2812Frame(RgbColour{255, 255, 255}, items);
+    for (int i = 0; i < WS2812_FRAME_BITS; i++) {
+        CHECK(highLevel(items[i]) == 1 && lowLevel(items[i]) == 0);
+        CHECK(highTicks(items[i]) == WS2812_T1H && lowTicks(items[i]) == WS2812_T1L);
+    }
+}
+
+static void testBitOrder() {
+    uint32_t items[WS2812_FRAME_BITS];
+    // Green first, then red, then blue, each MSB first
+    encodeWs2812Frame(RgbColour{0x12, 0x34, 0x56}, items);
+    CHECK(decodeFrame(items) == 0x341256);
+    encodeWs2812Frame(RgbColour{0x80, 0, 0}, items);
+    CHECK(decodeFrame(items) == 0x008000);
+    CHECK(highTicks(items[8]) == WS2812_T1H);
+    encodeWs2812Frame(RgbColour{0, 0, 0x01}, items);
+    CHECK(decodeFrame(items) == 0x000001);
+    CHECK(highTicks(items[WS2812_FRAME_BITS - 1]) == WS2812_T1H);
+
+    // Every single-bit colour round trips
+    for (int bit = 0; bit < WS2812_FRAME_BITS; bit++) {
+        uint32_t grb = 1UL << bit;
+        RgbColour colour = {(uint8_t)(grb >> 8), (uint8_t)(grb >> 16), (uint8_t)grb};
+        encodeWs2812Frame(colour, items);
+        CHECK(decodeFrame(items) == grb);
+    }
+}
+
+int main() {
+    testTiming();
+    testItemLayout();
+    testBitOrder();
+    return hostTestResult("ws2812");
+}
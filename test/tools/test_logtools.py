@@ -0,0 +1,174 @@
+# Copyright (c) Craig Millard and contributors. All rights reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#
+# See the License for the specific language governing permissions and
+# limitations under the License.
+"""Tests for tools/logtokens.py and tools/logdecode.py (python -m pytest test/tools).
+
+The capture below is what the firmware's formatTokenFrame() wrote for four
+log calls, next to the text the same records print in text mode.
+"""
+import os
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), '..', '..', 'tools'))
+
+import logdecode  # noqa: E402
+import logtokens  # noqa: E402
+
+SOURCE = r'''
+void example(const char* reason, LogLevel level) {
+    logf(LOG_INFO, "Channel %u -> %d (%s)", 3u, -7, "btn");
+    logf(LOG_WARN, "Temp %5.2f C, "
+                   "%02X%%", 21.5, 0xab);
+    logf(LOG_ERROR, "plain");
+    log(LOG_INFO, "Literal \"quoted\"\x41\101\n");
+    log(LOG_DEBUG, reason); // logtokens: text
+    LOGF_LIMITED(LOG_WARN, "Send failed: %d", -1);
+    LOG_LIMITED(LOG_WARN, "Queue full");
+    logf(level, "\"%s\" repeated", "x"); // log(LOG_INFO, "in a comment")
+}
+'''
+
+# logf() calls above, then log(LOG_DEBUG, "raw text") from RAM, written by
+# formatTokenFrame() at 3723004ms, +5ms, +300ms and +1ms
+CAPTURE = bytes.fromhex(
+    'a50df65daff9bbc603030d62746e002d'
+    'a50a04f6950a0000ac41ab01ce'
+    'a505ebc28ed804e9'
+    'a50d00000004027261772074657874cb')
+FRAME_1 = 16
+FRAME_2 = 13
+TEXT = ('[01:02:03][INFO] Channel 3 -> -7 (btn)\n'
+        '[01:02:03][WARN] Temp 21.50 C, AB%\n'
+        '[01:02:03][ERROR] plain\n'
+        '[01:02:03][DEBUG] raw text\n')
+
+
+def build_tokens(tmp_path):
+    (tmp_path / 'example.cpp').write_text(SOURCE)
+    table, errors = logtokens.build_table([str(tmp_path)], str(tmp_path))
+    assert errors == []
+    return table['tokens']
+
+
+def decode(tokens, chunks):
+    out = []
+    decoder = logdecode.Decoder(tokens, out.append)
+    for chunk in chunks:
+        decoder.feed(chunk)
+    decoder.flush()
+    return ''.join(out), decoder
+
+
+def test_token_matches_firmware():
+    # Tokens in the firmware capture above, from logToken() in src/logBuffer.cpp
+    assert logtokens.log_token('Channel %u -> %d (%s)', 3) == 0xaf5df6
+    assert logtokens.log_token('Temp %5.2f C, %02X%%', 2) == 0x95f604
+    assert logtokens.log_token('plain', 1) == 0x8ec2eb
+    # The level is part of the token
+    assert logtokens.log_token('plain', 3) != logtokens.log_token('plain', 1)
+
+
+def test_unescape_c():
+    assert logtokens.unescape_c(r'a\tb\\c\"d') == 'a\tb\\c"d'
+    assert logtokens.unescape_c(r'\x41\101\0') == 'AA\0'
+
+
+def test_scan_finds_literal_calls(tmp_path):
+    tokens = build_tokens(tmp_path)
+    formats = {}
+    for entry in tokens.values():
+        formats.setdefault(entry['format'], []).append(entry)
+    assert set(formats) == {'Channel %u -> %d (%s)', 'Temp %5.2f C, %02X%%', 'plain',
+                            'Literal "quoted"AA\n', 'Send failed: %d', 'Queue full',
+                            '"%s" repeated'}
+    assert formats['Literal "quoted"AA\n'][0]['literal']
+    assert formats['Queue full'][0]['literal']
+    assert not formats['plain'][0]['literal']
+    assert not formats['Send failed: %d'][0]['literal']
+    assert formats['Channel %u -> %d (%s)'][0]['sites'] == ['example.cpp:3']
+    assert formats['Send failed: %d'][0]['level'] == 2
+    # A level that is not a LOG_* constant gets every level
+    assert sorted(e['level'] for e in formats['"%s" repeated']) == [1, 2, 3, 4]
+    for key, entry in tokens.items():
+        assert key == '%06x' % logtokens.log_token(entry['format'], entry['level'])
+
+
+def test_scan_fails_on_format_without_entry(tmp_path):
+    (tmp_path / 'bad.cpp').write_text(r'''
+void log(LogLevel level, const char* msg);
+#define LOG_TWICE(level, msg) do { log(level, msg); log(level, msg); } while (0)
+void bad(const char* fmt, int n) {
+    logf(LOG_INFO, fmt, n);
+    log(LOG_WARN, kMessages[n]);
+    logf(LOG_INFO, fmt, n); // logtokens: text
+}
+''')
+    _, errors = logtokens.build_table([str(tmp_path)], str(tmp_path))
+    assert len(errors) == 3
+    assert errors[0].startswith('bad.cpp:5: logf() message is not a string literal')
+    assert errors[1].startswith('bad.cpp:6: log()')
+    assert errors[2].startswith('bad.cpp:7: logf()')
+
+
+def test_firmware_sources_scan_clean():
+    root = os.path.join(os.path.dirname(__file__), '..', '..')
+    table, errors = logtokens.build_table([os.path.join(root, 'src'), os.path.join(root, 'include')],
+                                          root)
+    assert errors == []
+    formats = set(entry['format'] for entry in table['tokens'].values())
+    assert '"%s" repeated %lu more times' in formats
+    assert 'Unknown message type: %u' in formats
+
+
+def test_decode_firmware_capture(tmp_path):
+    tokens = build_tokens(tmp_path)
+    text, decoder = decode(tokens, [CAPTURE])
+    assert text == TEXT
+    assert decoder.frames == 4
+    assert decoder.unknown == 0
+
+
+def test_decode_byte_at_a_time(tmp_path):
+    tokens = build_tokens(tmp_path)
+    text, _ = decode(tokens, [CAPTURE[i:i + 1] for i in range(len(CAPTURE))])
+    assert text == TEXT
+
+
+def test_text_around_frames_passes_through(tmp_path):
+    tokens = build_tokens(tmp_path)
+    text, decoder = decode(tokens, [b'boot\n', CAPTURE[:FRAME_1], b'> help\n'])
+    assert text == 'boot\n' + TEXT.splitlines(True)[0] + '> help\n'
+    assert decoder.frames == 1
+
+
+def test_bad_checksum_is_not_a_frame(tmp_path):
+    tokens = build_tokens(tmp_path)
+    broken = bytearray(CAPTURE[:FRAME_1])
+    broken[-1] ^= 0xFF
+    text, decoder = decode(tokens, [bytes(broken) + CAPTURE[FRAME_1:FRAME_1 + FRAME_2]])
+    assert decoder.frames == 1
+    # The frame with the full timestamp was lost, the delta has nothing to add to
+    assert text.endswith('[--:--][WARN] Temp 21.50 C, AB%\n')
+    assert text.startswith('�')
+
+
+def test_unknown_token(tmp_path):
+    text, decoder = decode({}, [CAPTURE[:FRAME_1]])
+    assert decoder.unknown == 1
+    assert text == '[01:02:03][UNKNOWN] <unknown token af5df6: 030d62746e00>\n'
+
+
+def test_render_arguments():
+    # %d zigzag, %u/%x plain varints, %s NUL terminated, %f as float
+    args = bytes([0x0d, 0xac, 0x02, 0xff, 0x01]) + b'ok\0' + bytes.fromhex('0000c03f')
+    assert logdecode.render('%d %u %x %s %.1f %%', args) == '-7 300 ff ok 1.5 %'
@@ -0,0 +1,135 @@
+# Copyright (c) Craig Millard and contributors. All rights reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#
+# See the License for the specific language governing permissions and
+# limitations under the License.
+"""Tests for tools/telemetry.py (python -m pytest test/tools).
+
+The frames below are what writeTelemetryFrame() in src/telemetry.cpp wrote
+for "telemetry all"; the MAC addresses hold 0xA5 / 0xA6 bytes on purpose.
+"""
+import os
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), '..', '..', 'tools'))
+
+import telemetry  # noqa: E402
+
+STATUS = bytes.fromhex('a6180100e80300000500000020bf0200f0490200ff0303030706de')
+CONFIG = bytes.fromhex('a6270201010004010000000406010203040506a6a5ff001020312e302e30'
+                       '000000000000000000000071')
+PERF = bytes.fromhex('a61a0302e803000002000000fa000000fa000000110000000b010000fd')
+ESPNOW = bytes.fromhex('a61f040364000000a6a6a6a6370000000200000001000000030603a6a5ff0010203d')
+FRAMES = [STATUS, CONFIG, PERF, ESPNOW]
+# A tokenised log frame (logmode token) whose body holds 0xA6 bytes
+LOG_FRAME = bytes.fromhex('a505a6a6010310a0')
+
+
+def parse(chunks):
+    frames = []
+    other = []
+    parser = telemetry.FrameParser(on_frame=frames.append, on_other=other.append)
+    for chunk in chunks:
+        parser.feed(chunk)
+    parser.flush()
+    return frames, b''.join(other), parser
+
+
+def test_firmware_frames():
+    frames, other, parser = parse([b'boot text\n'] + FRAMES + [b'[INFO] done\n'])
+    assert other == b'boot text\n[INFO] done\n'
+    assert [f['type'] for f in frames] == ['status', 'config', 'perf', 'espnow']
+    assert [f['seq'] for f in frames] == [0, 1, 2, 3]
+    assert parser.frames == 4 and parser.dropped == 0
+
+    status = frames[0]['fields']
+    assert status['uptime_ms'] == 1000
+    assert status['outputs'] == 5
+    assert status['free_heap'] == 180000 and status['min_free_heap'] == 150000
+    assert status['channel'] == 0xFF
+    assert status['pairing'] == 'PAIR_PAIRED'
+    assert (status['fail_streak'], status['log_level'], status['midi_channel'], status['wifi_channel']) == (3, 3, 7, 6)
+
+    config = frames[1]['fields']
+    assert config['outputs'] == 4
+    assert config['client_mac'] == '01:02:03:04:05:06'
+    assert config['server_mac'] == 'A6:A5:FF:00:10:20'
+    assert config['firmware'] == '1.0.0'
+    assert config['log_async'] and config['log_tokenized'] and not config['fast_switching']
+
+    perf = frames[2]['fields']
+    assert (perf['loop_count'], perf['min_loop_ms'], perf['max_loop_ms'], perf['total_loop_ms']) == (2, 17, 250, 267)
+
+    espnow = frames[3]['fields']
+    assert espnow['sent'] == 100 and espnow['send_failed'] == 0xA6A6A6A6
+    assert espnow['server_mac'] == 'A6:A5:FF:00:10:20'
+
+
+def test_byte_at_a_time():
+    stream = b'x' + b''.join(FRAMES) + b'y'
+    whole = parse([stream])
+    split = parse([stream[i:i + 1] for i in range(len(stream))])
+    assert split[0] == whole[0]
+    assert split[1] == whole[1] == b'xy'
+
+
+def test_encode_round_trip():
+    for raw in FRAMES:
+        type_code, seq, payload = raw[2], raw[3], raw[4:-1]
+        fields = telemetry.decode_payload(type_code, payload)
+        assert telemetry.encode_payload(type_code, fields) == payload
+        assert telemetry.encode_frame(type_code, seq, payload) == raw
+
+
+def test_log_frames_stay_whole():
+    frames, other, _ = parse([LOG_FRAME, STATUS, LOG_FRAME])
+    assert other == LOG_FRAME + LOG_FRAME
+    assert [f['type'] for f in frames] == ['status']
+
+
+def test_stray_marker_and_bad_checksum():
+    broken = bytearray(PERF)
+    broken[-1] ^= 0x01
+    frames, other, _ = parse([b'\xa6 stray\n', bytes(broken), STATUS])
+    assert [f['type'] for f in frames] == ['status']
+    assert other == b'\xa6 stray\n' + bytes(broken)
+
+
+def test_unknown_type_and_short_payload_are_text():
+    unknown = telemetry.encode_frame(9, 0, b'\x01\x02')
+    short = telemetry.encode_frame(1, 0, STATUS[4:-2])
+    frames, other, _ = parse([unknown, short, PERF])
+    assert [f['type'] for f in frames] == ['perf']
+    assert other == unknown + short
+
+
+def test_newer_firmware_fields_ignored():
+    longer = telemetry.encode_frame(3, 2, PERF[4:-1] + b'\x99\x99\x99')
+    frames, _, _ = parse([longer])
+    assert frames[0]['fields'] == parse([PERF])[0][0]['fields']
+
+
+def test_partial_frame_waits_then_flushes():
+    frames, other, _ = parse([STATUS[:10]])
+    assert frames == [] and other == STATUS[:10]
+    parser = telemetry.FrameParser(on_frame=frames.append)
+    parser.feed(STATUS[:10])
+    assert frames == []
+    parser.feed(STATUS[10:])
+    assert len(frames) == 1
+
+
+def test_sequence_gaps_counted():
+    payload = STATUS[4:-1]
+    seqs = [254, 255, 0, 4]
+    frames, _, parser = parse([telemetry.encode_frame(1, s, payload) for s in seqs])
+    assert [f['seq'] for f in frames] == seqs
+    assert parser.dropped == 3
@@ -0,0 +1,248 @@
+#!/usr/bin/env python3
+# Copyright (c) Craig Millard and contributors. All rights reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#
+# See the License for the specific language governing permissions and
+# limitations under the License.
+"""Decode tokenised log output (logmode token) back into text.
+
+Reads a raw serial capture or a live port and prints the log lines the
+firmware would have printed in text mode. Bytes outside log frames (boot
+messages, help text, command echo) are passed through unchanged.
+
+    python tools/logdecode.py capture.bin
+    python tools/logdecode.py --port /dev/ttyACM0        (needs pyserial)
+
+Frame layout, see formatTokenFrame() in src/logBuffer.cpp:
+    A5 len token[3] [level] time(varint) args... sum
+The level byte is only there for text records (token 0), the token table
+has the level of every other message. time is (ms since the previous frame)
+<< 1, or (uptime ms << 1) | 1 every few frames; lines before the first full
+timestamp show --:--.
+"""
+import argparse
+import glob
+import json
+import os
+import re
+import struct
+import sys
+
+MARKER = 0xA5
+TABLE_VERSION = 2  # Level-aware tokens, delta timestamps
+LEVELS = {0: 'NONE', 1: 'ERROR', 2: 'WARN', 3: 'INFO', 4: 'DEBUG'}
+SPEC_RE = re.compile(r'%([-+ #0]*)(\d*|\*)(\.\d*)?(hh|h|ll|l|z|j|t|L)?([diouxXcspfFeEgGaA%])')
+
+
+def default_tokens_path():
+    builds = glob.glob(os.path.join('.pio', 'build', '*', 'log_tokens.json'))
+    if builds:
+        return max(builds, key=os.path.getmtime)
+    return 'log_tokens.json'
+
+
+def format_uptime(ms):
+    seconds = ms // 1000
+    minutes = seconds // 60
+    hours = minutes // 60
+    days = hours // 24
+    if days:
+        return '%dd %02d:%02d:%02d' % (days, hours % 24, minutes % 60, seconds % 60)
+    if hours:
+        return '%02d:%02d:%02d' % (hours, minutes % 60, seconds % 60)
+    return '%02d:%02d' % (minutes, seconds % 60)
+
+
+def read_varint(data, pos):
+    value = 0
+    shift = 0
+    while True:
+        b = data[pos]
+        pos += 1
+        value |= (b & 0x7F) << shift
+        shift += 7
+        if b < 0x80:
+            return value, pos
+
+
+def render(fmt, args):
+    """printf-style formatting driven by the encoded argument stream."""
+    out = []
+    pos = 0
+    last = 0
+    for m in SPEC_RE.finditer(fmt):
+        out.append(fmt[last:m.start()])
+        last = m.end()
+        flags, width, prec, _, conv = m.groups()
+        if conv == '%':
+            out.append('%')
+            continue
+        spec = '%' + flags + width + (prec or '')
+        if conv in 'di':
+            raw, pos = read_varint(args, pos)
+            out.append((spec + 'd') % ((raw >> 1) ^ -(raw & 1)))
+        elif conv in 'uoxX':
+            raw, pos = read_varint(args, pos)
+            out.append((spec + ('d' if conv == 'u' else conv)) % raw)
+        elif conv == 'c':
+            raw, pos = read_varint(args, pos)
+            out.append((spec + 'c') % chr(raw & 0xFF))
+        elif conv == 'p':
+            raw, pos = read_varint(args, pos)
+            out.append('0x%x' % raw)
+        elif conv == 's':
+            end = args.index(0, pos)
+            out.append((spec + 's') % args[pos:end].decode('utf-8', 'replace'))
+            pos = end + 1
+        else:
+            value = struct.unpack_from('<f', args, pos)[0]
+            pos += 4
+            out.append((spec + (conv if conv not in 'aA' else 'e')) % value)
+    out.append(fmt[last:])
+    return ''.join(out)
+
+
+class Decoder(object):
+    def __init__(self, tokens, write):
+        self.tokens = tokens
+        self.write = write
+        self.buffer = bytearray()
+        self.frames = 0
+        self.frame_bytes = 0
+        self.text_bytes = 0
+        self.unknown = 0
+        self.ms = None  # Uptime of the last frame, once a full timestamp arrived
+
+    def feed(self, data):
+        buf = self.buffer
+        buf.extend(data)
+        while buf:
+            start = buf.find(MARKER)
+            if start < 0:
+                self.passthrough(buf)
+                del buf[:]
+                return
+            if start:
+                self.passthrough(buf[:start])
+                del buf[:start]
+            if len(buf) < 2 or len(buf) < buf[1] + 3:
+                return  # Wait for the rest of the frame
+            size = buf[1]
+            body = bytes(buf[2:2 + size])
+            if size < 4 or (sum(body) + buf[2 + size]) & 0xFF:
+                self.passthrough(buf[:1])  # Not a frame, just a 0xA5 byte
+                del buf[:1]
+                continue
+            self.decode(body)
+            self.frames += 1
+            self.frame_bytes += size + 3
+            del buf[:size + 3]
+
+    def flush(self):
+        self.passthrough(self.buffer)
+        del self.buffer[:]
+
+    def passthrough(self, data):
+        if data:
+            self.write(bytes(data).decode('utf-8', 'replace'))
+
+    def decode(self, body):
+        token = body[0] | body[1] << 8 | body[2] << 16
+        pos = 3
+        if token == 0:
+            level = LEVELS.get(body[3], 'UNKNOWN')
+            pos = 4
+        time, pos = read_varint(body, pos)
+        if time & 1:
+            self.ms = time >> 1
+        elif self.ms is not None:
+            self.ms += time >> 1
+        args = body[pos:]
+        if token == 0:
+            text = args.decode('utf-8', 'replace')
+        else:
+            entry = self.tokens.get('%06x' % token)
+            if entry is None:
+                self.unknown += 1
+                level = 'UNKNOWN'
+                text = '<unknown token %06x: %s>' % (token, args.hex())
+            else:
+                level = LEVELS.get(entry['level'], 'UNKNOWN')
+                if entry['literal'] and not args:
+                    text = entry['format']
+                else:
+                    try:
+                        text = render(entry['format'], args)
+                    except (IndexError, ValueError, struct.error):
+                        text = '<bad args for %r: %s>' % (entry['format'], args.hex())
+        stamp = format_uptime(self.ms) if self.ms is not None else '--:--'
+        line = '[%s][%s] %s\n' % (stamp, level, text)
+        self.text_bytes += len(line.encode('utf-8'))
+        self.write(line)
+
+
+def open_source(args):
+    if args.port:
+        try:
+            import serial
+        except ImportError:
+            sys.exit('logdecode: --port needs pyserial (pip install pyserial)')
+        port = serial.Serial(args.port, args.baud, timeout=0.1)
+        return lambda: port.read(256), True
+    stream = sys.stdin.buffer if args.capture in (None, '-') else open(args.capture, 'rb')
+    return lambda: stream.read(4096), False
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('capture', nargs='?', help='raw capture file (default stdin)')
+    parser.add_argument('-t', '--tokens', default=None, help='log_tokens.json from tools/logtokens.py')
+    parser.add_argument('-p', '--port', help='read a serial port instead of a file')
+    parser.add_argument('-b', '--baud', type=int, default=115200)
+    parser.add_argument('-s', '--stats', action='store_true', help='print frame/byte counts at the end')
+    args = parser.parse_args()
+
+    tokens_path = args.tokens or default_tokens_path()
+    try:
+        with open(tokens_path) as f:
+            table = json.load(f)
+    except (IOError, OSError, ValueError) as e:
+        sys.exit('logdecode: cannot read token table %s: %s' % (tokens_path, e))
+    if table.get('version') != TABLE_VERSION:
+        sys.exit('logdecode: %s is from an older tools/logtokens.py, rebuild it' % tokens_path)
+    tokens = table['tokens']
+
+    def write(text):
+        sys.stdout.write(text)
+        sys.stdout.flush()
+
+    decoder = Decoder(tokens, write)
+    read, live = open_source(args)
+    try:
+        while True:
+            data = read()
+            if data:
+                decoder.feed(data)
+            elif not live:
+                break
+    except KeyboardInterrupt:
+        pass
+    decoder.flush()
+
+    if args.stats and decoder.frames:
+        sys.stderr.write('logdecode: %d frames, %d bytes on the wire, %d bytes as text (%.1fx), %d unknown\n' % (
+            decoder.frames, decoder.frame_bytes, decoder.text_bytes,
+            float(decoder.text_bytes) / decoder.frame_bytes, decoder.unknown))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,208 @@
+#!/usr/bin/env python3
+# Copyright (c) Craig Millard and contributors. All rights reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#
+# See the License for the specific language governing permissions and
+# limitations under the License.
+"""Build the token table for tokenised logging.
+
+Scans the firmware sources for log()/logf() and LOG_LIMITED/LOGF_LIMITED
+calls with string literal messages and writes a JSON table mapping each
+token (the 24-bit FNV-1a hash of the level and format the firmware computes
+in src/logBuffer.cpp) to its format string and level. A call whose level is
+not a LOG_* constant gets an entry for every level. The table is what
+tools/logdecode.py needs to turn a serial capture back into text.
+
+logf() tokenises whatever format it is given, so a call whose format is not
+a string literal would send a token with no table entry: the scan fails on
+it. log() tokenises only literals in flash; a log() call passing text built
+in RAM is allowed when its line says "logtokens: text".
+
+Standalone:   python tools/logtokens.py -o log_tokens.json src include
+PlatformIO:   extra_scripts = pre:tools/logtokens.py
+              (writes $BUILD_DIR/log_tokens.json on every build)
+"""
+import argparse
+import json
+import os
+import re
+import sys
+
+CALL_RE = re.compile(r'\b(log|logf|LOG_LIMITED|LOGF_LIMITED)\s*\(')
+LITERAL_RE = re.compile(r'"((?:[^"\\\n]|\\.)*)"')
+LITERALS_RE = re.compile(r'(?:"(?:[^"\\\n]|\\.)*"\s*)+$')
+COMMENT_RE = re.compile(r'//[^\n]*|/\*.*?\*/|"(?:[^"\\\n]|\\.)*"|\'(?:[^\'\\\n]|\\.)*\'', re.S)
+PARAMETER_RE = re.compile(r'^[\w:]+[\s*&]+\w+$')   # "LogLevel level": a declaration
+SOURCE_EXTENSIONS = ('.c', '.cpp', '.h', '.hpp')
+LEVELS = {'LOG_ERROR': 1, 'LOG_WARN': 2, 'LOG_INFO': 3, 'LOG_DEBUG': 4}
+TEXT_MARKER = 'logtokens: text'
+
+SIMPLE_ESCAPES = {'n': '\n', 't': '\t', 'r': '\r', '0': '\0', '\\': '\\',
+                  '"': '"', "'": "'", 'a': '\a', 'b': '\b', 'f': '\f', 'v': '\v'}
+
+
+def unescape_c(text):
+    """Decode the escapes a C string literal may contain."""
+    out = []
+    i = 0
+    while i < len(text):
+        ch = text[i]
+        if ch != '\\':
+            out.append(ch)
+            i += 1
+            continue
+        nxt = text[i + 1]
+        if nxt == 'x':
+            m = re.match(r'[0-9a-fA-F]+', text[i + 2:])
+            out.append(chr(int(m.group(0), 16) & 0xFF))
+            i += 2 + len(m.group(0))
+        elif nxt in '01234567':
+            m = re.match(r'[0-7]{1,3}', text[i + 1:])
+            out.append(chr(int(m.group(0), 8)))
+            i += 1 + len(m.group(0))
+        else:
+            out.append(SIMPLE_ESCAPES.get(nxt, nxt))
+            i += 2
+    return ''.join(out)
+
+
+def log_token(fmt, level):
+    """FNV-1a over the level byte and the format, folded to 24 bits; 0 is reserved."""
+    h = ((2166136261 ^ level) * 16777619) & 0xFFFFFFFF
+    for b in fmt.encode('latin-1'):
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    token = (h >> 24) ^ (h & 0xFFFFFF)
+    return token or 1
+
+
+def strip_comments(source):
+    """Blank out comments, keeping string literals and line numbers."""
+    def blank(m):
+        text = m.group(0)
+        return text if text[0] in '"\'' else re.sub(r'[^\n]', ' ', text)
+    return COMMENT_RE.sub(blank, source)
+
+
+def split_args(source, pos):
+    """Top-level arguments of the call whose '(' ends just before pos."""
+    args = []
+    depth = 0
+    start = pos
+    while pos < len(source):
+        ch = source[pos]
+        if ch in '"\'':
+            pos += 1
+            while source[pos] != ch:
+                pos += 2 if source[pos] == '\\' else 1
+        elif ch in '([{':
+            depth += 1
+        elif ch in ')]}':
+            if depth == 0:
+                args.append(source[start:pos].strip())
+                return args
+            depth -= 1
+        elif ch == ',' and depth == 0:
+            args.append(source[start:pos].strip())
+            start = pos + 1
+        pos += 1
+    return args
+
+
+def in_directive(source, pos):
+    """True inside a preprocessor line (a macro body forwards its caller's format)."""
+    line_start = source.rfind('\n', 0, pos) + 1
+    while True:
+        if source[line_start:pos].lstrip().startswith('#'):
+            return True
+        if line_start < 2 or source[line_start - 2] != '\\':
+            return False
+        line_start = source.rfind('\n', 0, line_start - 1) + 1
+
+
+def scan_file(path, table, errors, root):
+    with open(path, encoding='utf-8', errors='replace') as f:
+        raw = f.read()
+    source = strip_comments(raw)
+    lines = raw.split('\n')
+    rel = os.path.relpath(path, root)
+    for m in CALL_RE.finditer(source):
+        args = split_args(source, m.end())
+        if len(args) < 2 or PARAMETER_RE.match(args[0]):
+            continue  # Declaration or definition
+        line = source.count('\n', 0, m.start()) + 1
+        site = '%s:%d' % (rel, line)
+        if not LITERALS_RE.match(args[1]):
+            text_ok = m.group(1) in ('log', 'LOG_LIMITED') and TEXT_MARKER in lines[line - 1]
+            if not in_directive(source, m.start()) and not text_ok:
+                errors.append('%s: %s() message is not a string literal, its token would have '
+                              'no table entry' % (site, m.group(1)))
+            continue
+        fmt = ''.join(unescape_c(s) for s in LITERAL_RE.findall(args[1]))
+        literal = m.group(1) in ('log', 'LOG_LIMITED')
+        levels = [LEVELS[args[0]]] if args[0] in LEVELS else sorted(LEVELS.values())
+        for level in levels:
+            entry = table.setdefault((fmt, level), {'literal': literal, 'sites': []})
+            entry['literal'] = entry['literal'] or literal
+            entry['sites'].append(site)
+
+
+def build_table(paths, root):
+    """Token table and a list of errors (collisions, untokenisable calls)."""
+    formats = {}
+    errors = []
+    for base in paths:
+        for dirpath, _, files in os.walk(base):
+            for name in sorted(files):
+                if name.endswith(SOURCE_EXTENSIONS):
+                    scan_file(os.path.join(dirpath, name), formats, errors, root)
+
+    tokens = {}
+    for (fmt, level), entry in sorted(formats.items()):
+        key = '%06x' % log_token(fmt, level)
+        if key in tokens:
+            errors.append('token %s collides: %r / %r' % (key, tokens[key]['format'], fmt))
+            continue
+        tokens[key] = {'format': fmt, 'level': level, 'literal': entry['literal'],
+                      'sites': entry['sites']}
+    return {'version': 2, 'tokens': tokens}, errors
+
+
+def write_table(paths, out_path, root):
+    table, errors = build_table(paths, root)
+    for error in errors:
+        sys.stderr.write('logtokens: %s\n' % error)
+    out_dir = os.path.dirname(out_path)
+    if out_dir and not os.path.isdir(out_dir):
+        os.makedirs(out_dir)
+    with open(out_path, 'w') as f:
+        json.dump(table, f, indent=1, sort_keys=True)
+    print('logtokens: %d formats -> %s' % (len(table['tokens']), out_path))
+    return not errors
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('paths', nargs='*', default=['src', 'include'])
+    parser.add_argument('-o', '--output', default='log_tokens.json')
+    args = parser.parse_args()
+    return 0 if write_table(args.paths, args.output, os.getcwd()) else 1
+
+
+try:
+    Import('env')  # noqa: F821 - provided by PlatformIO/SCons
+except NameError:
+    if __name__ == '__main__':
+        sys.exit(main())
+else:
+    project = env.subst('$PROJECT_DIR')  # noqa: F821
+    if not write_table([os.path.join(project, 'src'), os.path.join(project, 'include')],
+                       env.subst('$BUILD_DIR/log_tokens.json'), project):  # noqa: F821
+        env.Exit(1)  # noqa: F821
@@ -0,0 +1,253 @@
+#!/usr/bin/env python3
+# Copyright (c) Craig Millard and contributors. All rights reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#
+# See the License for the specific language governing permissions and
+# limitations under the License.
+"""Read telemetry frames (the telemetry command) from the serial console.
+
+Splits a serial stream into telemetry frames, which are decoded into dicts,
+and everything else: log lines, help text and tokenised log frames, which
+are handed on untouched (to tools/logdecode.py's Decoder when a token table
+is given). As a library:
+
+    parser = FrameParser(on_frame=print, on_other=sys.stderr.buffer.write)
+    parser.feed(port.read(256))
+
+From the command line, one JSON object per frame on stdout:
+
+    python tools/telemetry.py --port /dev/ttyACM0 --stream 100 all
+    python tools/telemetry.py --port /dev/ttyACM0 --send "telemetry config"
+    python tools/telemetry.py capture.bin
+
+Frame layout, see writeTelemetryFrame() in src/telemetry.cpp:
+    A6 len type seq payload... sum
+Payload layouts mirror the structs in include/telemetry.h. Newer firmware
+may append fields; the extra bytes are ignored.
+"""
+import argparse
+import json
+import struct
+import sys
+import time
+
+MARKER = 0xA6
+LOG_MARKER = 0xA5
+
+PAIRING_STATUS = {0: 'NOT_PAIRED', 1: 'PAIR_REQUEST', 2: 'PAIR_REQUESTED', 3: 'PAIR_PAIRED'}
+
+# type: (name, struct format, field names)
+LAYOUTS = {
+    1: ('status', '<IIIIBBBBBB',
+        ('uptime_ms', 'outputs', 'free_heap', 'min_free_heap', 'channel', 'pairing_status',
+         'fail_streak', 'log_level', 'midi_channel', 'wifi_channel')),
+    2: ('config', '<BBBBBBBBB6s6s16s',
+        ('version', 'client_type', 'outputs', 'board_id', 'relay_backend', 'relay_drive',
+         'led_backend', 'log_level_floor', 'flags', 'client_mac', 'server_mac', 'firmware')),
+    3: ('perf', '<IIIIII',
+        ('uptime_ms', 'loop_count', 'last_loop_ms', 'max_loop_ms', 'min_loop_ms', 'total_loop_ms')),
+    4: ('espnow', '<IIIIIBBB6s',
+        ('sent', 'send_failed', 'received', 'ignored', 'unknown_type', 'pairing_status',
+         'wifi_channel', 'fail_streak', 'server_mac')),
+}
+TYPES = dict((name, code) for code, (name, _, _) in LAYOUTS.items())
+CONFIG_FLAGS = {'fast_switching': 0x01, 'log_async': 0x02, 'log_tokenized': 0x04}
+
+
+def format_mac(raw):
+    return ':'.join('%02X' % b for b in bytearray(raw))
+
+
+def parse_mac(text):
+    return bytes(bytearray(int(part, 16) for part in text.split(':')))
+
+
+def decode_payload(type_code, payload):
+    """Payload bytes to a field dict; None for an unknown type or short payload."""
+    layout = LAYOUTS.get(type_code)
+    if layout is None:
+        return None
+    name, fmt, fields = layout
+    size = struct.calcsize(fmt)
+    if len(payload) < size:
+        return None
+    values = dict(zip(fields, struct.unpack_from(fmt, payload)))
+    for key, value in values.items():
+        if key.endswith('_mac'):
+            values[key] = format_mac(value)
+    if 'firmware' in values:
+        values['firmware'] = values['firmware'].split(b'\0', 1)[0].decode('ascii', 'replace')
+    if 'pairing_status' in values:
+        values['pairing'] = PAIRING_STATUS.get(values['pairing_status'], 'UNKNOWN')
+    if name == 'config':
+        for flag, bit in CONFIG_FLAGS.items():
+            values[flag] = bool(values['flags'] & bit)
+    return values
+
+
+def encode_payload(type_code, values):
+    """Inverse of decode_payload, for simulators and round-trip checks."""
+    name, fmt, fields = LAYOUTS[type_code]
+    args = []
+    for key in fields:
+        value = values[key]
+        if key.endswith('_mac'):
+            value = parse_mac(value)
+        elif key == 'firmware':
+            value = value.encode('ascii')
+        args.append(value)
+    return struct.pack(fmt, *args)
+
+
+def encode_frame(type_code, seq, payload):
+    body = bytearray([type_code, seq & 0xFF]) + bytearray(payload)
+    return bytes(bytearray([MARKER, len(body)]) + body + bytearray([-sum(body) & 0xFF]))
+
+
+class FrameParser(object):
+    """Splits a byte stream into telemetry frames and everything else.
+
+    on_frame(frame) gets {'type', 'seq', 'fields'} dicts; on_other(data)
+    gets the remaining bytes in order, with tokenised log frames (0xA5)
+    kept whole so their payload bytes are never mistaken for telemetry.
+    """
+
+    def __init__(self, on_frame, on_other=None):
+        self.on_frame = on_frame
+        self.on_other = on_other
+        self.buffer = bytearray()
+        self.frames = 0
+        self.dropped = 0   # Gaps in the sequence numbers
+        self.last_seq = None
+
+    def feed(self, data):
+        buf = self.buffer
+        buf.extend(data)
+        while buf:
+            start = next((i for i, b in enumerate(buf) if b in (MARKER, LOG_MARKER)), -1)
+            if start < 0:
+                self.other(buf)
+                del buf[:]
+                return
+            if start:
+                self.other(buf[:start])
+                del buf[:start]
+            if len(buf) < 2 or len(buf) < buf[1] + 3:
+                return  # Wait for the rest of the frame
+            size = buf[1]
+            body = bytes(buf[2:2 + size])
+            valid = (sum(body) + buf[2 + size]) & 0xFF == 0
+            if buf[0] == LOG_MARKER:
+                if valid and size >= 5:
+                    self.other(buf[:size + 3])
+                    del buf[:size + 3]
+                else:
+                    self.other(buf[:1])
+                    del buf[:1]
+                continue
+            fields = decode_payload(body[0], body[2:]) if valid and size >= 2 else None
+            if fields is None:
+                self.other(buf[:1])  # Not a frame, just a 0xA6 byte
+                del buf[:1]
+                continue
+            self.frame(body[0], body[1], fields)
+            del buf[:size + 3]
+
+    def flush(self):
+        self.other(self.buffer)
+        del self.buffer[:]
+
+    def frame(self, type_code, seq, fields):
+        if self.last_seq is not None:
+            self.dropped += (seq - self.last_seq - 1) & 0xFF
+        self.last_seq = seq
+        self.frames += 1
+        self.on_frame({'type': LAYOUTS[type_code][0], 'seq': seq, 'fields': fields})
+
+    def other(self, data):
+        if data and self.on_other:
+            self.on_other(bytes(data))
+
+
+def text_sink(tokens_path):
+    """Where non-telemetry output goes: stderr, decoded if there is a token table."""
+    def write(text):
+        sys.stderr.write(text)
+        sys.stderr.flush()
+
+    if not tokens_path:
+        return lambda data: write(data.decode('utf-8', 'replace'))
+    import os
+    sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+    import logdecode
+    with open(tokens_path) as f:
+        decoder = logdecode.Decoder(json.load(f)['tokens'], write)
+    return decoder.feed
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('capture', nargs='?', help='raw capture file (default stdin)')
+    parser.add_argument('-p', '--port', help='read a serial port instead of a file')
+    parser.add_argument('-b', '--baud', type=int, default=115200)
+    parser.add_argument('--send', action='append', default=[], help='console command to send first (repeatable)')
+    parser.add_argument('--stream', nargs='+', metavar=('MS', 'FRAMES'),
+                        help='start streaming (telemetry stream MS [status|config|perf|espnow|all])')
+    parser.add_argument('-t', '--tokens', help='log_tokens.json, to decode tokenised log lines on stderr')
+    parser.add_argument('-q', '--quiet', action='store_true', help='drop non-telemetry output')
+    parser.add_argument('--count', type=int, default=0, help='exit after this many frames')
+    args = parser.parse_args()
+
+    def on_frame(frame):
+        sys.stdout.write(json.dumps(frame, sort_keys=True) + '\n')
+        sys.stdout.flush()
+
+    frames = FrameParser(on_frame, None if args.quiet else text_sink(args.tokens))
+
+    if args.port:
+        try:
+            import serial
+        except ImportError:
+            sys.exit('telemetry: --port needs pyserial (pip install pyserial)')
+        port = serial.Serial(args.port, args.baud, timeout=0.1)
+        commands = list(args.send)
+        if args.stream:
+            commands.append('telemetry stream ' + ' '.join(args.stream))
+        for command in commands:
+            port.write((command + '\n').encode('ascii'))
+            time.sleep(0.05)
+        read, live = lambda: port.read(256), True
+    else:
+        if args.send or args.stream:
+            sys.exit('telemetry: --send and --stream need --port')
+        stream = sys.stdin.buffer if args.capture in (None, '-') else open(args.capture, 'rb')
+        read, live = lambda: stream.read(4096), False
+
+    try:
+        while not args.count or frames.frames < args.count:
+            data = read()
+            if data:
+                frames.feed(data)
+            elif not live:
+                break
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if args.port and args.stream:
+            port.write(b'telemetry stream off\n')
+    frames.flush()
+    if frames.dropped:
+        sys.stderr.write('telemetry: %d frames missing (sequence gaps)\n' % frames.dropped)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())